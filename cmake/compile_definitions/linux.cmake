@@ -238,6 +238,8 @@ list(APPEND PLATFORM_TARGET_FILES
         "${CMAKE_SOURCE_DIR}/src/platform/linux/graphics.cpp"
         "${CMAKE_SOURCE_DIR}/src/platform/linux/misc.h"
         "${CMAKE_SOURCE_DIR}/src/platform/linux/misc.cpp"
+        "${CMAKE_SOURCE_DIR}/src/platform/linux/uring.h"
+        "${CMAKE_SOURCE_DIR}/src/platform/linux/uring.cpp"
         "${CMAKE_SOURCE_DIR}/src/platform/linux/audio.cpp"
         "${CMAKE_SOURCE_DIR}/third-party/glad/src/egl.c"
         "${CMAKE_SOURCE_DIR}/third-party/glad/src/gl.c"
@@ -248,8 +250,7 @@ list(APPEND PLATFORM_TARGET_FILES
 
 list(APPEND PLATFORM_LIBRARIES
         dl
-        pulse
-        pulse-simple)
+        pulse)
 
 include_directories(
         SYSTEM
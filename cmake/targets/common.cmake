@@ -96,6 +96,11 @@ set_source_files_properties("${CMAKE_SOURCE_DIR}/src/rswrapper.c"
         DIRECTORY "${CMAKE_SOURCE_DIR}" "${TEST_DIR}"
         PROPERTIES COMPILE_FLAGS "-ftree-vectorize -funroll-loops")
 
+# the wide vectors of the converter are only passed between functions inlined into a variant supporting them
+set_source_files_properties("${CMAKE_SOURCE_DIR}/src/video_convert.cpp"
+        DIRECTORY "${CMAKE_SOURCE_DIR}" "${TEST_DIR}"
+        PROPERTIES COMPILE_FLAGS "-Wno-psabi")
+
 # third-party/ViGEmClient
 set(VIGEM_COMPILE_FLAGS "")
 string(APPEND VIGEM_COMPILE_FLAGS "-Wno-unknown-pragmas ")
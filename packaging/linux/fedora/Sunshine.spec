@@ -31,6 +31,7 @@ BuildRequires: libva-devel
 BuildRequires: libX11-devel
 BuildRequires: libxcb-devel
 BuildRequires: libXcursor-devel
+BuildRequires: libXdamage-devel
 BuildRequires: libXfixes-devel
 BuildRequires: libXi-devel
 BuildRequires: libXinerama-devel
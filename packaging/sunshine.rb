@@ -48,6 +48,7 @@ class @PROJECT_NAME@ < Formula
     depends_on "libx11"
     depends_on "libxcb"
     depends_on "libxcursor"
+    depends_on "libxdamage"
     depends_on "libxfixes"
     depends_on "libxi"
     depends_on "libxinerama"
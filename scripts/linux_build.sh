@@ -185,6 +185,7 @@ function add_arch_deps() {
     'libva'
     'libx11'
     'libxcb'
+    'libxdamage'
     'libxfixes'
     'libxrandr'
     'libxtst'
@@ -242,6 +243,7 @@ function add_debian_based_deps() {
     "libxcb-shm0-dev"  # X11
     "libxcb-xfixes0-dev"  # X11
     "libxcb1-dev"  # X11
+    "libxdamage-dev"  # X11
     "libxfixes-dev"  # X11
     "libxrandr-dev"  # X11
     "libxtst-dev"  # X11
@@ -302,6 +304,7 @@ function add_fedora_deps() {
     "libX11-devel"  # X11
     "libxcb-devel"  # X11
     "libXcursor-devel"  # X11
+    "libXdamage-devel"  # X11
     "libXfixes-devel"  # X11
     "libXi-devel"  # X11
     "libXinerama-devel"  # X11
@@ -0,0 +1,126 @@
+/**
+ * @file src/adaptive_bitrate.cpp
+ * @brief Definitions for the congestion control of video streams.
+ */
+// standard includes
+#include <algorithm>
+
+// local includes
+#include "adaptive_bitrate.h"
+
+using namespace std::literals;
+
+namespace stream {
+  namespace {
+    // The bitrate doesn't go below this percentage of the requested bitrate, nor below min_bitrate_floor
+    constexpr int min_bitrate_percent = 20;
+    constexpr int min_bitrate_floor = 500;
+
+    // Multiplicative decrease on reported loss and on frames piling up in the send path
+    constexpr int loss_decrease_percent = 20;
+    constexpr int backlog_decrease_percent = 10;
+
+    // Loss reports of the same congestion episode only lower the bitrate once
+    constexpr auto decrease_holdoff = 500ms;
+
+    // A frame is backlogged when sending it took longer than this many frame intervals,
+    // the send path is congested after backlog_frames of them in a row
+    constexpr int backlog_frame_intervals = 2;
+    constexpr int backlog_frames = 3;
+
+    // Additive increase of the bitrate once the stream has been clean for a while
+    constexpr auto increase_delay = 2s;
+    constexpr auto increase_interval = 500ms;
+    constexpr int increase_percent = 5;
+
+    // FEC is raised on loss up to fec_percentage_limit, then decays back to the configured percentage
+    constexpr int fec_increase = 10;
+    constexpr int fec_percentage_limit = 50;
+    constexpr auto fec_decrease_delay = 5s;
+    constexpr auto fec_decrease_interval = 1s;
+    constexpr int fec_decrease = 5;
+  }  // namespace
+
+  adaptive_bitrate_t::adaptive_bitrate_t(int max_bitrate, int fec_percentage, int framerate):
+      max_bitrate {max_bitrate},
+      min_bitrate {std::min(max_bitrate, std::max(max_bitrate * min_bitrate_percent / 100, min_bitrate_floor))},
+      base_fec_percentage {fec_percentage},
+      max_fec_percentage {std::max(fec_percentage, fec_percentage_limit)},
+      frame_interval {std::chrono::duration_cast<std::chrono::steady_clock::duration>(1s) / std::max(framerate, 1)},
+      current_bitrate {max_bitrate},
+      current_fec_percentage {fec_percentage} {
+  }
+
+  std::optional<int> adaptive_bitrate_t::frames_lost(int count, time_point now) {
+    std::lock_guard lg {lock};
+
+    if (count <= 0) {
+      return std::nullopt;
+    }
+
+    last_loss = now;
+    current_fec_percentage = std::min(current_fec_percentage + fec_increase, max_fec_percentage);
+
+    return decrease(loss_decrease_percent, now);
+  }
+
+  std::optional<int> adaptive_bitrate_t::frame_sent(std::chrono::steady_clock::duration send_time, time_point now) {
+    std::lock_guard lg {lock};
+
+    frame_sent_once = true;
+
+    if (send_time > frame_interval * backlog_frame_intervals) {
+      if (++slow_frames >= backlog_frames) {
+        slow_frames = 0;
+        return decrease(backlog_decrease_percent, now);
+      }
+    } else {
+      slow_frames = 0;
+    }
+
+    if (current_fec_percentage > base_fec_percentage && now - last_loss >= fec_decrease_delay && now - last_fec_decrease >= fec_decrease_interval) {
+      current_fec_percentage = std::max(current_fec_percentage - fec_decrease, base_fec_percentage);
+      last_fec_decrease = now;
+    }
+
+    auto last_congestion = std::max(last_decrease, last_loss);
+    if (current_bitrate < max_bitrate && now - last_congestion >= increase_delay && now - last_increase >= increase_interval) {
+      current_bitrate = std::min(current_bitrate + std::max(max_bitrate * increase_percent / 100, 1), max_bitrate);
+      last_increase = now;
+
+      return current_bitrate;
+    }
+
+    return std::nullopt;
+  }
+
+  bool adaptive_bitrate_t::started() const {
+    std::lock_guard lg {lock};
+    return frame_sent_once;
+  }
+
+  int adaptive_bitrate_t::bitrate() const {
+    std::lock_guard lg {lock};
+    return current_bitrate;
+  }
+
+  int adaptive_bitrate_t::fec_percentage() const {
+    std::lock_guard lg {lock};
+    return current_fec_percentage;
+  }
+
+  std::optional<int> adaptive_bitrate_t::decrease(int percent, time_point now) {
+    if (last_decrease.time_since_epoch().count() && now - last_decrease < decrease_holdoff) {
+      return std::nullopt;
+    }
+    last_decrease = now;
+
+    auto bitrate = std::max(current_bitrate * (100 - percent) / 100, min_bitrate);
+    if (bitrate == current_bitrate) {
+      return std::nullopt;
+    }
+
+    current_bitrate = bitrate;
+    return current_bitrate;
+  }
+}  // namespace stream
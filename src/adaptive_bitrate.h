@@ -0,0 +1,88 @@
+/**
+ * @file src/adaptive_bitrate.h
+ * @brief Declarations for the congestion control of video streams.
+ */
+#pragma once
+
+// standard includes
+#include <chrono>
+#include <mutex>
+#include <optional>
+
+namespace stream {
+  /**
+   * @brief Adapts the bitrate and FEC percentage of a video stream to the network.
+   * @details Frame loss reported by the client and frames that take too long to send
+   *          lower the bitrate multiplicatively and raise the FEC percentage.
+   *          Once the stream has been clean for a while, the bitrate grows back additively
+   *          to the bitrate requested by the client and FEC returns to the configured percentage.
+   *          The methods may be called from different threads.
+   */
+  class adaptive_bitrate_t {
+  public:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    /**
+     * @param max_bitrate The bitrate requested by the client in Kbps, it is never exceeded.
+     * @param fec_percentage The configured FEC percentage, it is never undercut.
+     * @param framerate The framerate of the stream.
+     */
+    adaptive_bitrate_t(int max_bitrate, int fec_percentage, int framerate);
+
+    /**
+     * @brief Account for frames the client reported as lost.
+     * @param count The number of lost frames.
+     * @param now The current time.
+     * @return The new bitrate in Kbps if it changed.
+     */
+    std::optional<int> frames_lost(int count, time_point now);
+
+    /**
+     * @brief Account for a frame that was sent completely.
+     * @param send_time The time from the end of encoding until the last packet of the frame was sent.
+     * @param now The current time.
+     * @return The new bitrate in Kbps if it changed.
+     */
+    std::optional<int> frame_sent(std::chrono::steady_clock::duration send_time, time_point now);
+
+    /**
+     * @brief Check whether any frame has been sent yet.
+     * @details Clients request IDR frames while the stream starts, those are not caused by congestion.
+     */
+    bool started() const;
+
+    /**
+     * @brief Get the current target bitrate in Kbps.
+     */
+    int bitrate() const;
+
+    /**
+     * @brief Get the current FEC percentage.
+     */
+    int fec_percentage() const;
+
+  private:
+    std::optional<int> decrease(int percent, time_point now);
+
+    mutable std::mutex lock;
+
+    const int max_bitrate;
+    const int min_bitrate;
+    const int base_fec_percentage;
+    const int max_fec_percentage;
+    const std::chrono::steady_clock::duration frame_interval;
+
+    int current_bitrate;
+    int current_fec_percentage;
+
+    bool frame_sent_once {};
+
+    // Consecutive frames that took longer to send than the backlog threshold
+    int slow_frames {};
+
+    time_point last_decrease {};
+    time_point last_loss {};
+    time_point last_increase {};
+    time_point last_fec_decrease {};
+  };
+}  // namespace stream
@@ -3,6 +3,7 @@
  * @brief Definitions for audio capture and encoding.
  */
 // standard includes
+#include <atomic>
 #include <thread>
 
 // lib includes
@@ -10,6 +11,7 @@
 
 // local includes
 #include "audio.h"
+#include "audio_frames.h"
 #include "config.h"
 #include "globals.h"
 #include "logging.h"
@@ -20,7 +22,19 @@
 namespace audio {
   using namespace std::literals;
   using opus_t = util::safe_ptr<OpusMSEncoder, opus_multistream_encoder_destroy>;
-  using sample_queue_t = std::shared_ptr<safe::queue_t<std::vector<float>>>;
+  using sample_pool_t = safe::pool_t<std::vector<float>>;
+  using sample_queue_t = std::shared_ptr<safe::ring_t<sample_pool_t::handle_t>>;
+
+  // Frames waiting to be encoded
+  constexpr auto sample_queue_size = 32;
+
+  // The largest Opus packet the encoder may produce
+  constexpr auto max_packet_size = 1400;
+
+#ifdef SUNSHINE_TESTS
+  // Set by tests that capture without a sound server
+  static std::atomic_bool fake_audio_source;
+#endif
 
   static int start_audio_control(audio_ctx_t &ctx);
   static void stop_audio_control(audio_ctx_t &);
@@ -84,7 +98,7 @@ namespace audio {
   };
 
   void encodeThread(sample_queue_t samples, config_t config, void *channel_data) {
-    auto packets = mail::man->queue<packet_t>(mail::audio_packets);
+    auto packets = mail::man->ring<packet_t>(mail::audio_packets);
     auto stream = stream_configs[map_stream(config.channels, config.flags[config_t::HIGH_QUALITY])];
     if (config.flags[config_t::CUSTOM_SURROUND_PARAMS]) {
       apply_surround_params(stream, config.customStreamParams);
@@ -110,11 +124,21 @@ namespace audio {
                     << stream.channelCount << " channels, "sv
                     << stream.bitrate / 1000 << " kbps (total), LOWDELAY"sv;
 
+    // A buffer for every packet the mailbox can hold, plus the one being encoded and the one being sent
+    packet_pool_t packet_pool {packets->capacity() + 2, buffer_t {max_packet_size}};
+
     auto frame_size = config.packetDuration * stream.sampleRate / 1000;
     while (auto sample = samples->pop()) {
-      buffer_t packet {1400};
+      auto packet = packet_pool.pull();
+      if (!packet) {
+        BOOST_LOG(warning) << "Every audio packet buffer is still in use, dropping the frame"sv;
+        continue;
+      }
 
-      int bytes = opus_multistream_encode_float(opus.get(), sample->data(), frame_size, std::begin(packet), packet.size());
+      // The buffer still has the size of the last packet it held
+      packet->fake_resize(max_packet_size);
+
+      int bytes = opus_multistream_encode_float(opus.get(), (*sample)->data(), frame_size, std::begin(*packet), packet->size());
       if (bytes < 0) {
         BOOST_LOG(error) << "Couldn't encode audio: "sv << opus_strerror(bytes);
         packets->stop();
@@ -122,7 +146,7 @@ namespace audio {
         return;
       }
 
-      packet.fake_resize(bytes);
+      packet->fake_resize(bytes);
       packets->raise(channel_data, std::move(packet));
     }
   }
@@ -207,7 +231,7 @@ namespace audio {
     // Capture takes place on this thread
     platf::adjust_thread_priority(platf::thread_priority_e::critical);
 
-    auto samples = std::make_shared<sample_queue_t::element_type>(30);
+    auto samples = std::make_shared<sample_queue_t::element_type>(sample_queue_size);
     std::thread thread {encodeThread, samples, config, channel_data};
 
     auto fg = util::fail_guard([&]() {
@@ -219,11 +243,22 @@ namespace audio {
 
     int samples_per_frame = frame_size * stream.channelCount;
 
+    // A frame for every slot of the queue, plus the one being captured and the one being encoded,
+    // so the pool shouldn't run dry
+    sample_pool_t sample_pool {samples->capacity() + 2, std::vector<float>(samples_per_frame)};
+
+    // Should the pool run dry anyway, the microphone is still read so it doesn't fall behind
+    std::vector<float> dropped_samples(samples_per_frame);
+
+    logging::min_max_avg_periodic_logger<double> capture_latency_logger(debug, "Audio capture latency", "ms");
+
     while (!shutdown_event->peek()) {
-      std::vector<float> sample_buffer;
-      sample_buffer.resize(samples_per_frame);
+      auto sample_buffer = sample_pool.pull();
+      if (!sample_buffer) {
+        BOOST_LOG(warning) << "Every audio sample buffer is still in use, dropping the frame"sv;
+      }
 
-      auto status = mic->sample(sample_buffer);
+      auto status = mic->sample(sample_buffer ? *sample_buffer : dropped_samples);
       switch (status) {
         case platf::capture_e::ok:
           break;
@@ -246,7 +281,15 @@ namespace audio {
           return;
       }
 
-      samples->raise(std::move(sample_buffer));
+      if (capture_latency_logger.is_enabled()) {
+        if (auto latency = mic->latency()) {
+          capture_latency_logger.collect_and_log(latency->count() / 1000.0);
+        }
+      }
+
+      if (sample_buffer) {
+        samples->raise(std::move(sample_buffer));
+      }
     }
   }
 
@@ -255,6 +298,12 @@ namespace audio {
     return control_shared.ref();
   }
 
+#ifdef SUNSHINE_TESTS
+  void use_fake_audio_source(bool enabled) {
+    fake_audio_source = enabled;
+  }
+#endif
+
   bool is_audio_ctx_sink_available(const audio_ctx_t &ctx) {
     if (!ctx.control) {
       return false;
@@ -291,7 +340,13 @@ namespace audio {
     // The default sink has not been replaced yet.
     ctx.restore_sink = false;
 
-    if (!(ctx.control = platf::audio_control())) {
+#ifdef SUNSHINE_TESTS
+    ctx.control = fake_audio_source ? fake_audio_control() : platf::audio_control();
+#else
+    ctx.control = platf::audio_control();
+#endif
+
+    if (!ctx.control) {
       return 0;
     }
 
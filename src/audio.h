@@ -74,7 +74,8 @@ namespace audio {
   };
 
   using buffer_t = util::buffer_t<std::uint8_t>;
-  using packet_t = std::pair<void *, buffer_t>;
+  using packet_pool_t = safe::pool_t<buffer_t>;
+  using packet_t = std::pair<void *, packet_pool_t::handle_t>;
   using audio_ctx_ref_t = safe::shared_t<audio_ctx_t>::ptr_t;
 
   void capture(safe::mail_t mail, config_t config, void *channel_data);
@@ -91,6 +92,14 @@ namespace audio {
    */
   audio_ctx_ref_t get_audio_ctx_ref();
 
+#ifdef SUNSHINE_TESTS
+  /**
+   * @brief Capture from a generated tone instead of the sound server, see fake_audio_control().
+   * @param enabled Whether audio contexts started from now on use the fake source.
+   */
+  void use_fake_audio_source(bool enabled);
+#endif
+
   /**
    * @brief Check if the audio sink held by audio context is available.
    * @returns True if available (and can probably be restored), false otherwise.
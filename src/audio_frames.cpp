@@ -0,0 +1,186 @@
+/**
+ * @file src/audio_frames.cpp
+ * @brief Definitions for the frame buffering shared by the audio capture backends.
+ */
+// standard includes
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numbers>
+#include <thread>
+
+// local includes
+#include "audio_frames.h"
+#include "logging.h"
+
+using namespace std::literals;
+
+namespace audio {
+  frame_queue_t::frame_queue_t(int frames, int samples_per_frame):
+      samples_per_frame {samples_per_frame},
+      samples((std::size_t) frames * samples_per_frame),
+      frames(frames) {
+  }
+
+  void frame_queue_t::write(const float *data, std::size_t count, clock::duration latency) {
+    const auto captured = clock::now() - latency;
+    const int capacity = frames.size();
+
+    std::unique_lock ul {lock};
+
+    bool frame_completed = false;
+    while (count > 0) {
+      if (complete == capacity) {
+        // The reader fell behind, drop the oldest frame
+        head = (head + 1) % capacity;
+        --complete;
+        ++dropped;
+      }
+
+      auto index = (head + complete) % capacity;
+      if (partial == 0) {
+        frames[index].captured = captured;
+      }
+
+      auto chunk = std::min<std::size_t>(count, samples_per_frame - partial);
+      auto dest = std::begin(samples) + (std::size_t) index * samples_per_frame + partial;
+      if (data) {
+        std::copy_n(data, chunk, dest);
+        data += chunk;
+      } else {
+        std::fill_n(dest, chunk, 0.0f);
+      }
+
+      count -= chunk;
+      partial += chunk;
+      if (partial == samples_per_frame) {
+        partial = 0;
+        ++complete;
+        frame_completed = true;
+      }
+    }
+
+    ul.unlock();
+    if (frame_completed) {
+      cv.notify_one();
+    }
+  }
+
+  platf::capture_e frame_queue_t::read(std::vector<float> &frame, std::chrono::milliseconds timeout) {
+    std::unique_lock ul {lock};
+
+    if (!cv.wait_for(ul, timeout, [this]() {
+          return complete > 0 || stopped;
+        })) {
+      return platf::capture_e::timeout;
+    }
+
+    if (stopped) {
+      return *stopped;
+    }
+
+    auto src = std::begin(samples) + (std::size_t) head * samples_per_frame;
+    std::copy_n(src, std::min<std::size_t>(frame.size(), samples_per_frame), std::begin(frame));
+
+    last_latency = clock::now() - frames[head].captured;
+    head = (head + 1) % (int) frames.size();
+    --complete;
+
+    return platf::capture_e::ok;
+  }
+
+  void frame_queue_t::stop(platf::capture_e status) {
+    {
+      std::lock_guard lg {lock};
+      stopped = status;
+    }
+    cv.notify_all();
+  }
+
+  frame_queue_t::clock::duration frame_queue_t::latency() const {
+    std::lock_guard lg {lock};
+    return last_latency;
+  }
+
+  std::uint64_t frame_queue_t::overruns() const {
+    std::lock_guard lg {lock};
+    return dropped;
+  }
+
+  namespace {
+    // The fake source produces samples in periods like a sound card, not aligned with the Opus frames
+    constexpr int fake_period = 256;
+    constexpr float fake_tone_frequency = 440.0f;
+    constexpr float fake_tone_volume = 0.25f;
+
+    class fake_mic_t: public platf::mic_t {
+    public:
+      fake_mic_t(int channels, std::uint32_t sample_rate, std::uint32_t frame_size):
+          frames {std::max<int>(4, sample_rate / 10 / frame_size), (int) (frame_size * channels)} {
+        thread = std::thread {&fake_mic_t::generate, this, channels, sample_rate};
+      }
+
+      ~fake_mic_t() override {
+        running = false;
+        thread.join();
+      }
+
+      platf::capture_e sample(std::vector<float> &frame_buffer) override {
+        return frames.read(frame_buffer, 1s);
+      }
+
+      std::optional<std::chrono::microseconds> latency() override {
+        return std::chrono::duration_cast<std::chrono::microseconds>(frames.latency());
+      }
+
+    private:
+      void generate(int channels, std::uint32_t sample_rate) {
+        std::vector<float> period((std::size_t) fake_period * channels);
+        const auto period_duration = std::chrono::duration_cast<frame_queue_t::clock::duration>(std::chrono::duration<double>((double) fake_period / sample_rate));
+
+        std::uint64_t position = 0;
+        auto next = frame_queue_t::clock::now() + period_duration;
+        while (running) {
+          std::this_thread::sleep_until(next);
+          next += period_duration;
+
+          for (int x = 0; x < fake_period; ++x) {
+            auto value = fake_tone_volume * std::sin(2.0f * std::numbers::pi_v<float> * fake_tone_frequency * (float) (position++ % sample_rate) / sample_rate);
+            std::fill_n(std::begin(period) + (std::size_t) x * channels, channels, value);
+          }
+
+          // The period was complete at the start of this iteration
+          frames.write(period.data(), period.size(), period_duration);
+        }
+      }
+
+      frame_queue_t frames;
+      std::atomic_bool running {true};
+      std::thread thread;
+    };
+
+    class fake_audio_control_t: public platf::audio_control_t {
+    public:
+      int set_sink(const std::string &sink) override {
+        return 0;
+      }
+
+      std::unique_ptr<platf::mic_t> microphone(const std::uint8_t *mapping, int channels, std::uint32_t sample_rate, std::uint32_t frame_size) override {
+        return std::make_unique<fake_mic_t>(channels, sample_rate, frame_size);
+      }
+
+      bool is_sink_available(const std::string &sink) override {
+        return true;
+      }
+
+      std::optional<platf::sink_t> sink_info() override {
+        return platf::sink_t {"sunshine-fake"};
+      }
+    };
+  }  // namespace
+
+  std::unique_ptr<platf::audio_control_t> fake_audio_control() {
+    BOOST_LOG(info) << "Capturing audio from a fake source"sv;
+    return std::make_unique<fake_audio_control_t>();
+  }
+}  // namespace audio
@@ -0,0 +1,102 @@
+/**
+ * @file src/audio_frames.h
+ * @brief Declarations for the frame buffering shared by the audio capture backends.
+ */
+#pragma once
+
+// standard includes
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// local includes
+#include "platform/common.h"
+
+namespace audio {
+  /**
+   * @brief Assembles captured samples into frames of the Opus frame size.
+   * @details The frames are allocated once. A capture backend writes chunks of any size from its
+   *          own thread, typically a callback of the sound server, and the capture thread reads
+   *          whole frames. When the capture thread falls behind, the oldest frames are dropped
+   *          to keep the latency bounded.
+   */
+  class frame_queue_t {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @param frames The number of frames that can be buffered.
+     * @param samples_per_frame The number of samples of a frame, for all channels.
+     */
+    frame_queue_t(int frames, int samples_per_frame);
+
+    /**
+     * @brief Append captured samples.
+     * @param samples The interleaved samples, or nullptr to append silence.
+     * @param count The number of samples, for all channels.
+     * @param latency The time since the oldest of the samples was captured.
+     */
+    void write(const float *samples, std::size_t count, clock::duration latency = {});
+
+    /**
+     * @brief Wait for a complete frame and copy it.
+     * @param frame The buffer to fill, it must hold the samples of a whole frame.
+     * @param timeout The time to wait for a complete frame.
+     * @return The status of the capture.
+     * @retval capture_e::timeout When no frame completed in time.
+     */
+    platf::capture_e read(std::vector<float> &frame, std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Wake up the reader and let all following reads return the status.
+     * @param status The status to return from read().
+     */
+    void stop(platf::capture_e status);
+
+    /**
+     * @brief Get the time since the first sample of the last read frame was captured.
+     */
+    clock::duration latency() const;
+
+    /**
+     * @brief Get the number of frames dropped because they weren't read in time.
+     */
+    std::uint64_t overruns() const;
+
+  private:
+    struct frame_t {
+      clock::time_point captured;
+    };
+
+    const int samples_per_frame;
+
+    mutable std::mutex lock;
+    std::condition_variable cv;
+
+    std::vector<float> samples;
+    std::vector<frame_t> frames;
+
+    // The frame being read next, and the number of complete frames after it
+    int head {};
+    int complete {};
+
+    // The number of samples written to the frame after the complete ones
+    int partial {};
+
+    std::optional<platf::capture_e> stopped;
+    clock::duration last_latency {};
+    std::uint64_t dropped {};
+  };
+
+  /**
+   * @brief Create an audio control that captures a generated tone instead of a sound server.
+   * @details The tone is produced at the pace of a real sound card, in chunks that don't line up
+   *          with the frame size, so the capture path behaves as with a real backend.
+   *          Tests select it with use_fake_audio_source(), so they can run without a sound server.
+   */
+  std::unique_ptr<platf::audio_control_t> fake_audio_control();
+}  // namespace audio
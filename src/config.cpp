@@ -516,6 +516,7 @@ namespace config {
     "1920x1080x60",  // fallback_mode
     false, // isolated Display
     false, // ignore_encoder_probe_failure
+    false,  // shared_encode
   };
 
   audio_t audio {
@@ -533,6 +534,10 @@ namespace config {
     APPS_JSON_PATH,
 
     20,  // fecPercentage
+    0,  // fec_threads
+    false,  // io_uring
+    false,  // udp_zerocopy
+    false,  // adaptive_bitrate
 
     ENCRYPTION_MODE_NEVER,  // lan_encryption_mode
     ENCRYPTION_MODE_OPPORTUNISTIC,  // wan_encryption_mode
@@ -585,6 +590,7 @@ namespace config {
     false, // envvar_compatibility_mode
     "en",  // locale
     2,  // min_log_level
+    false,  // deferred_logging
     0,  // flags
     {},  // User file
     {},  // Username
@@ -1209,6 +1215,7 @@ namespace config {
     string_f(vars, "fallback_mode", video.fallback_mode);
     bool_f(vars, "isolated_virtual_display_option", video.isolated_virtual_display_option);
     bool_f(vars, "ignore_encoder_probe_failure", video.ignore_encoder_probe_failure);
+    bool_f(vars, "shared_encode", video.shared_encode);
 
     path_f(vars, "pkey", nvhttp.pkey);
     path_f(vars, "cert", nvhttp.cert);
@@ -1240,11 +1247,21 @@ namespace config {
       stream.ping_timeout = std::chrono::milliseconds(to);
     }
 
+    bool_f(vars, "io_uring", stream.io_uring);
+    bool_f(vars, "udp_zerocopy", stream.udp_zerocopy);
+    bool_f(vars, "adaptive_bitrate", stream.adaptive_bitrate);
+    if (stream.adaptive_bitrate && video.shared_encode) {
+      // A shared encoder has a single bitrate, but the congestion control is per session
+      BOOST_LOG(warning) << "config: adaptive_bitrate is disabled while shared_encode is enabled"sv;
+      stream.adaptive_bitrate = false;
+    }
+
     int_between_f(vars, "lan_encryption_mode", stream.lan_encryption_mode, {0, 2});
     int_between_f(vars, "wan_encryption_mode", stream.wan_encryption_mode, {0, 2});
 
     path_f(vars, "file_apps", stream.file_apps);
     int_between_f(vars, "fec_percentage", stream.fec_percentage, {1, 255});
+    int_between_f(vars, "fec_threads", stream.fec_threads, {0, 3});
 
     map_int_int_f(vars, "keybindings"s, input.keybindings);
 
@@ -1367,6 +1384,8 @@ namespace config {
       }
     }
 
+    bool_f(vars, "deferred_logging", sunshine.deferred_logging);
+
     auto it = vars.find("flags"s);
     if (it != std::end(vars)) {
       apply_flags(it->second.c_str());
@@ -1397,6 +1416,8 @@ namespace config {
       if (line == "--help"sv) {
         logging::print_help(*argv);
         return 1;
+      } else if (line == "--reprobe"sv) {
+        sunshine.flags[flag::REPROBE] = true;
       }
 #ifdef _WIN32
       else if (line == "--shortcut"sv) {
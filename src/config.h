@@ -149,6 +149,7 @@ namespace config {
     std::string fallback_mode;
     bool isolated_virtual_display_option;
     bool ignore_encoder_probe_failure;
+    bool shared_encode;  ///< Let sessions with identical video settings share one encoder.
   };
 
   struct audio_t {
@@ -171,6 +172,18 @@ namespace config {
 
     int fec_percentage;
 
+    // Number of worker threads preparing FEC blocks concurrently, 0 prepares them on the broadcast thread
+    int fec_threads;
+
+    // Queue batched sends with io_uring instead of blocking the broadcast thread (Linux only)
+    bool io_uring;
+
+    // Send large video batches with MSG_ZEROCOPY (Linux only)
+    bool udp_zerocopy;
+
+    // Lower the bitrate and raise FEC when the client loses frames or sending falls behind
+    bool adaptive_bitrate;
+
     // Video encryption settings for LAN and WAN streams
     int lan_encryption_mode;
     int wan_encryption_mode;
@@ -224,6 +237,7 @@ namespace config {
       FORCE_VIDEO_HEADER_REPLACE,  ///< force replacing headers inside video data
       UPNP,  ///< Try Universal Plug 'n Play
       CONST_PIN,  ///< Use "universal" pin
+      REPROBE,  ///< Ignore cached encoder probe results
       FLAG_SIZE  ///< Number of flags
     };
   }  // namespace flag
@@ -263,6 +277,9 @@ namespace config {
     bool envvar_compatibility_mode;
     std::string locale;
     int min_log_level;
+
+    // Format LOG_DEFERRED records on a background thread instead of the thread that logs them
+    bool deferred_logging;
     std::bitset<flag::FLAG_SIZE> flags;
     std::string credentials_file;
 
@@ -37,6 +37,7 @@
 #include "nvhttp.h"
 #include "platform/common.h"
 #include "process.h"
+#include "stat_trackers.h"
 #include "utility.h"
 #include "uuid.h"
 
@@ -1154,6 +1155,85 @@ namespace confighttp {
     response->write(SimpleWeb::StatusCode::success_ok, content, headers);
   }
 
+  /**
+   * @brief Get latency statistics of the video frames and send statistics of audio packets since startup or the last reset.
+   * @param response The HTTP response object.
+   * @param request The HTTP request object.
+   *
+   * Each pipeline stage reports its frame count and the 50th, 90th and 99th percentile and maximum latency in microseconds:
+   * @code{.json}
+   * {
+   *   "convert": {"count": 3600, "p50_us": 410, "p90_us": 530, "p99_us": 780, "max_us": 1290},
+   *   "encode_queue": {...},
+   *   "encode": {...},
+   *   "packetize": {...},
+   *   "send": {...},
+   *   "total": {...},
+   *   "audio_sends": {"packets": 18000, "system_calls": 9000, "system_calls_per_packet": 0.5},
+   *   "input": {"count": 52000, "p50_us": 90, "p90_us": 210, "p99_us": 950, "max_us": 4100}
+   * }
+   * @endcode
+   *
+   * `audio_sends` counts audio data and FEC packets and the system calls that sent them.
+   * `input` is the time from receiving an input message to injecting it, coalesced messages count once.
+   *
+   * @api_examples{/api/stats| GET| null}
+   */
+  void getStats(resp_https_t response, req_https_t request) {
+    if (!authenticate(response, request)) {
+      return;
+    }
+
+    print_req(request);
+
+    auto output_tree = stat_trackers::frame_latency().stats();
+    output_tree["audio_sends"] = stat_trackers::audio_sends().stats();
+    output_tree["input"] = stat_trackers::input_latency().stats();
+    send_response(response, output_tree);
+  }
+
+  /**
+   * @brief Get the stages of the most recently sent video frames in the Chrome trace event format.
+   * @param response The HTTP response object.
+   * @param request The HTTP request object.
+   *
+   * The result can be opened with chrome://tracing or https://ui.perfetto.dev.
+   *
+   * @api_examples{/api/stats/trace| GET| null}
+   */
+  void getStatsTrace(resp_https_t response, req_https_t request) {
+    if (!authenticate(response, request)) {
+      return;
+    }
+
+    print_req(request);
+
+    send_response(response, stat_trackers::frame_latency().chrome_trace());
+  }
+
+  /**
+   * @brief Reset the latency statistics of video frames and input, and the send statistics of audio packets.
+   * @param response The HTTP response object.
+   * @param request The HTTP request object.
+   *
+   * @api_examples{/api/stats/reset| POST| null}
+   */
+  void resetStats(resp_https_t response, req_https_t request) {
+    if (!validateContentType(response, request, "application/json") || !authenticate(response, request)) {
+      return;
+    }
+
+    print_req(request);
+
+    stat_trackers::frame_latency().reset();
+    stat_trackers::audio_sends().reset();
+    stat_trackers::input_latency().reset();
+
+    nlohmann::json output_tree;
+    output_tree["status"] = true;
+    send_response(response, output_tree);
+  }
+
   /**
    * @brief Update existing credentials.
    * @param response The HTTP response object.
@@ -1540,6 +1620,9 @@ namespace confighttp {
     server.resource["^/api/apps/launch$"]["POST"] = launchApp;
     server.resource["^/api/apps/close$"]["POST"] = closeApp;
     server.resource["^/api/logs$"]["GET"] = getLogs;
+    server.resource["^/api/stats$"]["GET"] = getStats;
+    server.resource["^/api/stats/trace$"]["GET"] = getStatsTrace;
+    server.resource["^/api/stats/reset$"]["POST"] = resetStats;
     server.resource["^/api/config$"]["GET"] = getConfig;
     server.resource["^/api/config$"]["POST"] = saveConfig;
     server.resource["^/api/configLocale$"]["GET"] = getLocale;
@@ -5,6 +5,9 @@
 // lib includes
 #include <openssl/pem.h>
 #include <openssl/rsa.h>
+#if OPENSSL_VERSION_MAJOR >= 3
+  #include <openssl/core_names.h>
+#endif
 
 // local includes
 #include "crypto.h"
@@ -15,14 +18,34 @@ namespace crypto {
   cert_chain_t::cert_chain_t():
       _certs {}, _cert_ctx { X509_STORE_CTX_new() } {
   }
-  void cert_chain_t::add(p_named_cert_t& named_cert_p) {
+  void cert_chain_t::add(const p_named_cert_t &named_cert_p) {
+    auto cert = x509(named_cert_p->cert);
+    if (!cert) {
+      return;
+    }
+
     x509_store_t x509_store { X509_STORE_new() };
+    X509_STORE_add_cert(x509_store.get(), cert.get());
+
+    std::lock_guard lg {_mutex};
+    _certs.insert_or_assign(fingerprint(cert.get()), std::make_pair(named_cert_p, std::move(x509_store)));
+  }
+
+  void cert_chain_t::remove(const p_named_cert_t &named_cert_p) {
+    auto cert = x509(named_cert_p->cert);
+    if (!cert) {
+      return;
+    }
 
-    X509_STORE_add_cert(x509_store.get(), x509(named_cert_p->cert).get());
-    _certs.emplace_back(std::make_pair(named_cert_p, std::move(x509_store)));
+    std::lock_guard lg {_mutex};
+    auto it = _certs.find(fingerprint(cert.get()));
+    if (it != std::end(_certs) && it->second.first == named_cert_p) {
+      _certs.erase(it);
+    }
   }
 
   void cert_chain_t::clear() {
+    std::lock_guard lg {_mutex};
     _certs.clear();
   }
 
@@ -45,45 +68,114 @@ namespace crypto {
   }
 
   /**
-   * @brief Verify the certificate chain.
+   * @brief The device a TLS session was verified for, stored in the session.
+   */
+  struct verified_session_t {
+    sha256_t fingerprint;
+    std::weak_ptr<named_cert_t> named_cert;
+  };
+
+  static void free_verified_session(void *parent, void *ptr, CRYPTO_EX_DATA *ad, int idx, long argl, void *argp) {
+    delete (verified_session_t *) ptr;
+  }
+
+#if OPENSSL_VERSION_MAJOR >= 3
+  static int dup_verified_session(CRYPTO_EX_DATA *to, const CRYPTO_EX_DATA *from, void **from_d, int idx, long argl, void *argp) {
+#else
+  static int dup_verified_session(CRYPTO_EX_DATA *to, const CRYPTO_EX_DATA *from, void *from_d, int idx, long argl, void *argp) {
+#endif
+    // A copy of the session gets a copy of the result, each session frees its own
+    auto verified = (verified_session_t **) from_d;
+    if (*verified) {
+      *verified = new verified_session_t {**verified};
+    }
+
+    return 1;
+  }
+
+  static int verified_session_index() {
+    static int index = SSL_SESSION_get_ex_new_index(0, nullptr, nullptr, dup_verified_session, free_verified_session);
+    return index;
+  }
+
+  /**
+   * @brief Verify the certificate of a paired device.
    * When certificates from two or more instances of Moonlight have been added to x509_store_t,
    * only one of them will be verified by X509_verify_cert, resulting in only a single instance of
    * Moonlight to be able to use Sunshine
    *
    * To circumvent this, x509_store_t instance will be created for each instance of the certificates.
+   * The store is found by the fingerprint of the certificate, so only one of them has to be tried.
    * @param cert The certificate to verify.
    * @return nullptr if the certificate is valid, otherwise an error string.
    */
   const char * cert_chain_t::verify(x509_t::element_type *cert, p_named_cert_t& named_cert_out) {
-    int err_code = 0;
-    for (auto &[named_cert_p, x509_store] : _certs) {
-      auto fg = util::fail_guard([this]() {
-        X509_STORE_CTX_cleanup(_cert_ctx.get());
-      });
+    auto digest = fingerprint(cert);
 
-      X509_STORE_CTX_init(_cert_ctx.get(), x509_store.get(), cert, nullptr);
-      X509_STORE_CTX_set_verify_cb(_cert_ctx.get(), openssl_verify_cb);
+    std::lock_guard lg {_mutex};
+    return verify_locked(cert, digest, named_cert_out);
+  }
 
-      // We don't care to validate the entire chain for the purposes of client auth.
-      // Some versions of clients forked from Moonlight Embedded produce client certs
-      // that OpenSSL doesn't detect as self-signed due to some X509v3 extensions.
-      X509_STORE_CTX_set_flags(_cert_ctx.get(), X509_V_FLAG_PARTIAL_CHAIN);
+  const char *cert_chain_t::verify(x509_t::element_type *cert, SSL_SESSION *session, p_named_cert_t &named_cert_out) {
+    if (!session) {
+      return verify(cert, named_cert_out);
+    }
+
+    auto index = verified_session_index();
 
-      auto err = X509_verify_cert(_cert_ctx.get());
+    std::lock_guard lg {_mutex};
 
-      if (err == 1) {
-        named_cert_out = named_cert_p;
+    auto verified = (const verified_session_t *) SSL_SESSION_get_ex_data(session, index);
+    if (verified) {
+      // The device may have been unpaired since the session was verified
+      auto named_cert_p = verified->named_cert.lock();
+      auto it = _certs.find(verified->fingerprint);
+      if (named_cert_p && it != std::end(_certs) && it->second.first == named_cert_p) {
+        named_cert_out = std::move(named_cert_p);
         return nullptr;
       }
 
-      err_code = X509_STORE_CTX_get_error(_cert_ctx.get());
+      return verify_locked(cert, fingerprint(cert), named_cert_out);
+    }
 
-      if (err_code != X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT && err_code != X509_V_ERR_INVALID_CA) {
-        return X509_verify_cert_error_string(err_code);
-      }
+    auto digest = fingerprint(cert);
+    auto err_str = verify_locked(cert, digest, named_cert_out);
+    if (!err_str) {
+      SSL_SESSION_set_ex_data(session, index, new verified_session_t {digest, named_cert_out});
     }
 
-    return X509_verify_cert_error_string(err_code);
+    return err_str;
+  }
+
+  const char *cert_chain_t::verify_locked(x509_t::element_type *cert, const sha256_t &fingerprint, p_named_cert_t &named_cert_out) {
+    auto it = _certs.find(fingerprint);
+    if (it == std::end(_certs)) {
+      // The error X509_verify_cert reports for the self-signed certificate of a device that isn't paired
+      return X509_verify_cert_error_string(X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT);
+    }
+
+    auto &[named_cert_p, x509_store] = it->second;
+
+    auto fg = util::fail_guard([this]() {
+      X509_STORE_CTX_cleanup(_cert_ctx.get());
+    });
+
+    X509_STORE_CTX_init(_cert_ctx.get(), x509_store.get(), cert, nullptr);
+    X509_STORE_CTX_set_verify_cb(_cert_ctx.get(), openssl_verify_cb);
+
+    // We don't care to validate the entire chain for the purposes of client auth.
+    // Some versions of clients forked from Moonlight Embedded produce client certs
+    // that OpenSSL doesn't detect as self-signed due to some X509v3 extensions.
+    X509_STORE_CTX_set_flags(_cert_ctx.get(), X509_V_FLAG_PARTIAL_CHAIN);
+
+    auto err = X509_verify_cert(_cert_ctx.get());
+
+    if (err == 1) {
+      named_cert_out = named_cert_p;
+      return nullptr;
+    }
+
+    return X509_verify_cert_error_string(X509_STORE_CTX_get_error(_cert_ctx.get()));
   }
 
   namespace cipher {
@@ -184,33 +276,68 @@ namespace crypto {
      * The resulting ciphertext and the GCM tag are written into the tagged_cipher buffer.
      */
     int gcm_t::encrypt(const std::string_view &plaintext, std::uint8_t *tag, std::uint8_t *ciphertext, aes_t *iv) {
-      if (!encrypt_ctx && init_encrypt_gcm(encrypt_ctx, &key, iv, padding)) {
+      batch_entry_t entry {plaintext, ciphertext, tag, iv->data()};
+      if (encrypt(&entry, 1, iv->size())) {
         return -1;
       }
 
-      // Calling with cipher == nullptr results in a parameter change
-      // without requiring a reallocation of the internal cipher ctx.
-      if (EVP_EncryptInit_ex(encrypt_ctx.get(), nullptr, nullptr, nullptr, iv->data()) != 1) {
-        return -1;
-      }
-
-      int update_outlen, final_outlen;
+      // GCM is a stream cipher mode, so the ciphertext is always the size of the plaintext
+      return plaintext.size();
+    }
 
-      // Encrypt into the caller's buffer
-      if (EVP_EncryptUpdate(encrypt_ctx.get(), ciphertext, &update_outlen, (const std::uint8_t *) plaintext.data(), plaintext.size()) != 1) {
-        return -1;
+    int gcm_t::encrypt(const batch_entry_t *entries, std::size_t count, std::size_t iv_size) {
+      if (count == 0) {
+        return 0;
       }
 
-      // GCM encryption won't ever fill ciphertext here but we have to call it anyway
-      if (EVP_EncryptFinal_ex(encrypt_ctx.get(), ciphertext + update_outlen, &final_outlen) != 1) {
-        return -1;
+      if (!encrypt_ctx) {
+        aes_t iv {entries[0].iv, entries[0].iv + iv_size};
+        if (init_encrypt_gcm(encrypt_ctx, &key, &iv, padding)) {
+          return -1;
+        }
       }
 
-      if (EVP_CIPHER_CTX_ctrl(encrypt_ctx.get(), EVP_CTRL_GCM_GET_TAG, tag_size, tag) != 1) {
-        return -1;
+      for (std::size_t x = 0; x < count; ++x) {
+        auto &entry = entries[x];
+
+        // Calling with cipher == nullptr results in a parameter change
+        // without requiring a reallocation of the internal cipher ctx.
+#if OPENSSL_VERSION_MAJOR >= 3
+        // The 3.0 API passes the IV straight to the provider, skipping the legacy init path
+        if (EVP_EncryptInit_ex2(encrypt_ctx.get(), nullptr, nullptr, entry.iv, nullptr) != 1) {
+#else
+        if (EVP_EncryptInit_ex(encrypt_ctx.get(), nullptr, nullptr, nullptr, entry.iv) != 1) {
+#endif
+          return -1;
+        }
+
+        int update_outlen, final_outlen;
+
+        // Encrypt into the caller's buffer
+        if (EVP_EncryptUpdate(encrypt_ctx.get(), entry.ciphertext, &update_outlen, (const std::uint8_t *) entry.plaintext.data(), entry.plaintext.size()) != 1) {
+          return -1;
+        }
+
+        // GCM encryption won't ever fill ciphertext here but we have to call it anyway
+        if (EVP_EncryptFinal_ex(encrypt_ctx.get(), entry.ciphertext + update_outlen, &final_outlen) != 1) {
+          return -1;
+        }
+
+#if OPENSSL_VERSION_MAJOR >= 3
+        // Querying the tag as a provider parameter avoids translating the legacy ctrl on every shard
+        OSSL_PARAM params[] = {
+          OSSL_PARAM_construct_octet_string(OSSL_CIPHER_PARAM_AEAD_TAG, entry.tag, tag_size),
+          OSSL_PARAM_construct_end(),
+        };
+        if (EVP_CIPHER_CTX_get_params(encrypt_ctx.get(), params) != 1) {
+#else
+        if (EVP_CIPHER_CTX_ctrl(encrypt_ctx.get(), EVP_CTRL_GCM_GET_TAG, tag_size, entry.tag) != 1) {
+#endif
+          return -1;
+        }
       }
 
-      return update_outlen + final_outlen;
+      return 0;
     }
 
     int gcm_t::encrypt(const std::string_view &plaintext, std::uint8_t *tagged_cipher, aes_t *iv) {
@@ -350,6 +477,12 @@ namespace crypto {
     return p;
   }
 
+  sha256_t fingerprint(x509_t::element_type *cert) {
+    sha256_t hsh {};
+    X509_digest(cert, EVP_sha256(), hsh.data(), nullptr);
+    return hsh;
+  }
+
   pkey_t pkey(const std::string_view &k) {
     bio_t io {BIO_new(BIO_s_mem())};
 
@@ -6,12 +6,16 @@
 
 // standard includes
 #include <array>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
 
 // lib includes
 #include <list>
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <openssl/sha.h>
+#include <openssl/ssl.h>
 #include <openssl/x509.h>
 #include <nlohmann/json.hpp>
 
@@ -28,6 +32,17 @@ namespace crypto {
 
   using sha256_t = std::array<std::uint8_t, SHA256_DIGEST_LENGTH>;
 
+  /**
+   * @brief Hash a SHA-256 digest for unordered containers, its leading bytes are already uniformly distributed.
+   */
+  struct sha256_hash_t {
+    std::size_t operator()(const sha256_t &digest) const {
+      std::size_t value;
+      std::memcpy(&value, digest.data(), sizeof(value));
+      return value;
+    }
+  };
+
   using aes_t = std::vector<std::uint8_t>;
   using x509_t = util::safe_ptr<X509, X509_free>;
   using x509_store_t = util::safe_ptr<X509_STORE, X509_STORE_free>;
@@ -120,6 +135,13 @@ namespace crypto {
 
   aes_t gen_aes_key(const std::array<uint8_t, 16> &salt, const std::string_view &pin);
   x509_t x509(const std::string_view &x);
+
+  /**
+   * @brief The SHA-256 fingerprint of a certificate, the hash of its DER encoding.
+   * @param cert The certificate.
+   * @return The fingerprint.
+   */
+  sha256_t fingerprint(x509_t::element_type *cert);
   pkey_t pkey(const std::string_view &k);
   std::string pem(x509_t &x509);
   std::string pem(pkey_t &pkey);
@@ -134,19 +156,45 @@ namespace crypto {
   std::string rand(std::size_t bytes);
   std::string rand_alphabet(std::size_t bytes, const std::string_view &alphabet = std::string_view {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789!%&()=-"});
 
+  /**
+   * @brief The certificates of the paired devices, indexed by their fingerprint.
+   * Devices may be added and removed while other threads verify certificates.
+   */
   class cert_chain_t {
   public:
-    KITTY_DECL_CONSTR(cert_chain_t)
+    cert_chain_t();
 
-    void add(p_named_cert_t& named_cert_p);
+    void add(const p_named_cert_t &named_cert_p);
+
+    /**
+     * @brief Stop accepting the certificate of a device.
+     * @param named_cert_p The device, as passed to add().
+     */
+    void remove(const p_named_cert_t &named_cert_p);
 
     void clear();
 
     const char *verify(x509_t::element_type *cert, p_named_cert_t& named_cert_out);
 
+    /**
+     * @brief Verify the certificate of a TLS peer. The result is cached in the TLS session,
+     * so a resumed session skips the verification, unless the device was unpaired in the meantime.
+     * @param cert The certificate of the peer.
+     * @param session The TLS session the certificate was presented in.
+     * @param named_cert_out The device the certificate belongs to.
+     * @return nullptr if the certificate is valid, otherwise an error string.
+     */
+    const char *verify(x509_t::element_type *cert, SSL_SESSION *session, p_named_cert_t &named_cert_out);
+
   private:
-    std::vector<std::pair<p_named_cert_t, x509_store_t>> _certs;
+    // Verify against the store of the certificate with this fingerprint, with _mutex held
+    const char *verify_locked(x509_t::element_type *cert, const sha256_t &fingerprint, p_named_cert_t &named_cert_out);
+
+    std::unordered_map<sha256_t, std::pair<p_named_cert_t, x509_store_t>, sha256_hash_t> _certs;
     x509_store_ctx_t _cert_ctx;
+
+    // Guards _certs, _cert_ctx and the results cached in TLS sessions
+    std::mutex _mutex;
   };
 
   namespace cipher {
@@ -186,6 +234,26 @@ namespace crypto {
 
       gcm_t(const crypto::aes_t &key, bool padding = true);
 
+      /**
+       * @brief A single buffer of a batched AES GCM encryption.
+       */
+      struct batch_entry_t {
+        std::string_view plaintext;
+        std::uint8_t *ciphertext;  ///< May point to the plaintext to encrypt in place.
+        std::uint8_t *tag;  ///< Receives the GCM tag.
+        const std::uint8_t *iv;  ///< The initialization vector for this buffer.
+      };
+
+      /**
+       * @brief Encrypts a batch of buffers using AES GCM mode, each with its own IV.
+       * The cipher context and key schedule are set up once and only the IV changes between buffers.
+       * @param entries The buffers to encrypt.
+       * @param count The number of buffers.
+       * @param iv_size The size of every IV in the batch, which must not change over the lifetime of the cipher.
+       * @return 0 on success. Returns -1 in case of an error.
+       */
+      int encrypt(const batch_entry_t *entries, std::size_t count, std::size_t iv_size);
+
       /**
        * @brief Encrypts the plaintext using AES GCM mode.
        * @param plaintext The plaintext data to be encrypted.
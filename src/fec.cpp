@@ -0,0 +1,120 @@
+/**
+ * @file src/fec.cpp
+ * @brief Definitions for Reed-Solomon forward error correction of video frames.
+ */
+// standard includes
+#include <cstring>
+
+// local includes
+#include "fec.h"
+#include "logging.h"
+
+using namespace std::literals;
+
+namespace stream::fec {
+  void free_rs(reed_solomon *rs) {
+    reed_solomon_release(rs);
+  }
+
+  shard_counts_t shard_counts(size_t payload_size, size_t blocksize, size_t fecpercentage, size_t minparityshards) {
+    auto data_shards = (payload_size + (blocksize - 1)) / blocksize;
+    auto parity_shards = (data_shards * fecpercentage + 99) / 100;
+
+    // increase the FEC percentage for this frame if the parity shard minimum is not met
+    if (parity_shards < minparityshards && fecpercentage != 0) {
+      parity_shards = minparityshards;
+      fecpercentage = (100 * parity_shards) / data_shards;
+    }
+
+    return {data_shards, parity_shards, fecpercentage};
+  }
+
+  reed_solomon *arena_t::rs(size_t data_shards, size_t parity_shards) {
+    auto key = (std::uint32_t) (data_shards << 16 | parity_shards);
+
+    auto it = rs_cache.find(key);
+    if (it == std::end(rs_cache)) {
+      it = rs_cache.emplace(key, reed_solomon_new(data_shards, parity_shards)).first;
+    }
+
+    return it->second.get();
+  }
+
+  fec_t arena_t::encode(const std::string_view &payload, size_t blocksize, size_t fecpercentage, size_t minparityshards, size_t prefixsize) {
+    auto payload_size = payload.size();
+
+    auto pad = payload_size % blocksize != 0;
+
+    auto aligned_data_shards = payload_size / blocksize;
+    auto [data_shards, parity_shards, percentage] = shard_counts(payload_size, blocksize, fecpercentage, minparityshards);
+    if (percentage != fecpercentage) {
+      fecpercentage = percentage;
+
+      BOOST_LOG(verbose) << "Increasing FEC percentage to "sv << fecpercentage << " to meet parity shard minimum"sv << std::endl;
+    }
+
+    auto nr_shards = data_shards + parity_shards;
+
+    // If we need to store a zero-padded data shard, place that first
+    // to keep the shards in order. The buffers below only ever grow.
+    auto parity_shard_offset = pad ? 1 : 0;
+    auto shards_size = (parity_shard_offset + parity_shards) * blocksize;
+    if (shards.size() < shards_size) {
+      shards.resize(shards_size);
+    }
+    if (shards_p.size() < nr_shards) {
+      shards_p.resize(nr_shards);
+    }
+    if (headers.size() < nr_shards * prefixsize) {
+      headers.resize(nr_shards * prefixsize);
+    }
+    payload_buffers.clear();
+
+    // Point into the payload buffer for all except the final padded data shard
+    auto next = std::begin(payload);
+    for (auto x = 0; x < aligned_data_shards; ++x) {
+      shards_p[x] = (uint8_t *) next;
+      next += blocksize;
+    }
+    payload_buffers.emplace_back(std::begin(payload), aligned_data_shards * blocksize);
+
+    // If the last data shard needs to be zero-padded, we must use the shards buffer
+    if (pad) {
+      shards_p[aligned_data_shards] = (uint8_t *) shards.data();
+
+      // GCC doesn't figure out that std::copy_n() can be replaced with memcpy() here
+      // and ends up compiling a horribly slow element-by-element copy loop, so we
+      // help it by using memcpy()/memset() directly.
+      auto copy_len = std::min<size_t>(blocksize, std::end(payload) - next);
+      std::memcpy(shards_p[aligned_data_shards], next, copy_len);
+      if (copy_len < blocksize) {
+        // Zero any additional space after the end of the payload
+        std::memset(shards_p[aligned_data_shards] + copy_len, 0, blocksize - copy_len);
+      }
+    }
+
+    // Add a payload buffer describing the shard buffer
+    payload_buffers.emplace_back(shards.data(), shards_size);
+
+    if (fecpercentage != 0) {
+      // Point into our buffer for the parity shards
+      for (auto x = 0; x < parity_shards; ++x) {
+        shards_p[data_shards + x] = (uint8_t *) &shards[(parity_shard_offset + x) * blocksize];
+      }
+
+      // packets = parity_shards + data_shards
+      reed_solomon_encode(rs(data_shards, parity_shards), shards_p.data(), nr_shards, blocksize);
+    }
+
+    return {
+      data_shards,
+      nr_shards,
+      fecpercentage,
+      blocksize,
+      prefixsize,
+      headers.data(),
+      shards_p.data(),
+      payload_buffers,
+    };
+  }
+}  // namespace stream::fec
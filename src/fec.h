@@ -0,0 +1,106 @@
+/**
+ * @file src/fec.h
+ * @brief Declarations for Reed-Solomon forward error correction of video frames.
+ */
+#pragma once
+
+// standard includes
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// local includes
+#include "platform/common.h"
+#include "utility.h"
+
+extern "C" {
+#include "rswrapper.h"
+}
+
+namespace stream::fec {
+  void free_rs(reed_solomon *rs);
+
+  using rs_t = util::safe_ptr<reed_solomon, free_rs>;
+
+  struct shard_counts_t {
+    size_t data_shards;
+    size_t parity_shards;
+    size_t percentage;
+  };
+
+  /**
+   * @brief Compute the shard counts of a FEC block without encoding it.
+   * @param payload_size The size of the block payload.
+   * @param blocksize The size of each shard.
+   * @param fecpercentage The percentage of parity shards relative to data shards.
+   * @param minparityshards The minimum number of parity shards if FEC is enabled.
+   * @return The number of data and parity shards, and the effective FEC percentage.
+   */
+  shard_counts_t shard_counts(size_t payload_size, size_t blocksize, size_t fecpercentage, size_t minparityshards);
+
+  /**
+   * @brief A view of one FEC block, backed by the storage of the arena that encoded it.
+   * @details The view is only valid until the next call to `arena_t::encode()` on the same arena.
+   */
+  struct fec_t {
+    size_t data_shards;
+    size_t nr_shards;
+    size_t percentage;
+
+    size_t blocksize;
+    size_t prefixsize;
+    char *headers;
+    uint8_t **shards_p;
+
+    std::vector<platf::buffer_descriptor_t> &payload_buffers;
+
+    char *data(size_t el) {
+      return (char *) shards_p[el];
+    }
+
+    char *prefix(size_t el) {
+      return prefixsize ? &headers[el * prefixsize] : nullptr;
+    }
+
+    size_t size() const {
+      return nr_shards;
+    }
+  };
+
+  /**
+   * @brief Reusable storage for encoding FEC blocks.
+   * @details Shard buffers only grow, and Reed-Solomon contexts are cached by shard counts,
+   *          so once a session has seen its largest frame, encoding does not touch the heap.
+   */
+  class arena_t {
+  public:
+    /**
+     * @brief Split a payload into shards and compute the parity shards.
+     * @param payload The payload, which must outlive the returned view. Data shards point into it.
+     * @param blocksize The size of each shard.
+     * @param fecpercentage The percentage of parity shards relative to data shards.
+     * @param minparityshards The minimum number of parity shards if FEC is enabled.
+     * @param prefixsize The size of the optional per-shard prefix buffer.
+     * @return A view of the encoded FEC block.
+     */
+    fec_t encode(const std::string_view &payload, size_t blocksize, size_t fecpercentage, size_t minparityshards, size_t prefixsize);
+
+    /**
+     * @brief Get a cached Reed-Solomon context for the given shard counts.
+     * @param data_shards The number of data shards.
+     * @param parity_shards The number of parity shards.
+     * @return The context, owned by the arena.
+     */
+    reed_solomon *rs(size_t data_shards, size_t parity_shards);
+
+  private:
+    std::vector<char> shards;
+    std::vector<char> headers;
+    std::vector<uint8_t *> shards_p;
+    std::vector<platf::buffer_descriptor_t> payload_buffers;
+
+    // Keyed by (data_shards << 16 | parity_shards)
+    std::unordered_map<std::uint32_t, rs_t> rs_cache;
+  };
+}  // namespace stream::fec
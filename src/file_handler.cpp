@@ -4,6 +4,7 @@
  */
 
 // standard includes
+#include <cstdio>
 #include <filesystem>
 #include <fstream>
 
@@ -11,6 +12,13 @@
 #include "file_handler.h"
 #include "logging.h"
 
+// conditional includes
+#ifdef _WIN32
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
+
 namespace file_handler {
   std::string get_parent_directory(const std::string &path) {
     // remove any trailing path separators
@@ -53,4 +61,25 @@ namespace file_handler {
 
     return 0;
   }
+
+  int write_file_synced(const char *path, const std::string_view &contents, bool append) {
+    auto file = std::fopen(path, append ? "ab" : "wb");
+    if (!file) {
+      return -1;
+    }
+
+    bool written = std::fwrite(contents.data(), 1, contents.size(), file) == contents.size() && !std::fflush(file);
+#ifdef _WIN32
+    written = written && !_commit(_fileno(file));
+#else
+    written = written && !fsync(fileno(file));
+#endif
+
+    // Closing may report an error of the writes as well
+    if (std::fclose(file) || !written) {
+      return -1;
+    }
+
+    return 0;
+  }
 }  // namespace file_handler
@@ -51,4 +51,16 @@ namespace file_handler {
    * @examples_end
    */
   int write_file(const char *path, const std::string_view &contents);
+
+  /**
+   * @brief Write a file and wait until its contents are on disk.
+   * @param path The path of the file.
+   * @param contents The contents to write.
+   * @param append Append to the file instead of replacing its contents.
+   * @return ``0`` on success, ``-1`` on failure.
+   * @examples
+   * int write_status = write_file_synced("path/to/file", "file contents");
+   * @examples_end
+   */
+  int write_file_synced(const char *path, const std::string_view &contents, bool append = false);
 }  // namespace file_handler
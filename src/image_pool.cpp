@@ -0,0 +1,187 @@
+/**
+ * @file src/image_pool.cpp
+ * @brief Definitions for the pool of images shared between capture and encoding.
+ */
+// standard includes
+#include <algorithm>
+
+// local includes
+#include "image_pool.h"
+
+using namespace std::literals;
+
+namespace video {
+  image_pool_t::image_pool_t(std::size_t capacity, std::chrono::steady_clock::duration trim_timeout, alloc_t alloc):
+      state {std::make_shared<state_t>()},
+      trim_timeout {trim_timeout},
+      alloc {std::move(alloc)} {
+    state->slots.resize(capacity);
+    state->free_slots.reserve(capacity);
+  }
+
+  image_pool_t::~image_pool_t() {
+    clear();
+  }
+
+  std::shared_ptr<platf::img_t> image_pool_t::pull(const std::function<bool()> &running) {
+    // Images are freed after the lock is released
+    std::vector<std::shared_ptr<platf::img_t>> trimmed;
+
+    std::unique_lock ul {state->lock};
+
+    std::optional<std::chrono::steady_clock::time_point> wait_start;
+    std::size_t index;
+    while (true) {
+      // Prefer the most recently released image
+      if (!state->free_slots.empty()) {
+        index = state->free_slots.back();
+        state->free_slots.pop_back();
+        break;
+      }
+
+      auto unallocated = std::find_if(std::begin(state->slots), std::end(state->slots), [](const slot_t &slot) {
+        return !slot.img && !slot.in_use;
+      });
+      if (unallocated != std::end(state->slots)) {
+        index = unallocated - std::begin(state->slots);
+
+        // Releases don't have to wait for the allocation
+        unallocated->in_use = true;
+        ul.unlock();
+        auto img = alloc();
+        ul.lock();
+
+        if (!img) {
+          state->slots[index].in_use = false;
+          return nullptr;
+        }
+        state->slots[index].img = std::move(img);
+        break;
+      }
+
+      // Every image is in use, wait for the encoders to release one
+      if (!wait_start) {
+        wait_start = std::chrono::steady_clock::now();
+        ++state->exhausted;
+      }
+
+      ul.unlock();
+      auto keep_waiting = running();
+      ul.lock();
+
+      if (!keep_waiting) {
+        state->exhausted_wait += std::chrono::steady_clock::now() - *wait_start;
+        return nullptr;
+      }
+
+      // Don't rely on a release to notice when to stop waiting
+      state->released.wait_for(ul, 100ms);
+    }
+
+    if (wait_start) {
+      state->exhausted_wait += std::chrono::steady_clock::now() - *wait_start;
+    }
+
+    auto &slot = state->slots[index];
+    slot.in_use = true;
+    slot.generation = state->generation;
+
+    trim(trimmed);
+
+    return std::shared_ptr<platf::img_t>(slot.img.get(), [state = state, index, generation = slot.generation](platf::img_t *) {
+      state->release(index, generation);
+    });
+  }
+
+  void image_pool_t::clear() {
+    std::vector<std::shared_ptr<platf::img_t>> unused;
+
+    std::lock_guard lg {state->lock};
+
+    ++state->generation;
+    for (auto index : state->free_slots) {
+      unused.emplace_back(std::move(state->slots[index].img));
+    }
+    state->free_slots.clear();
+    state->used_timestamps.clear();
+  }
+
+  std::size_t image_pool_t::allocated() const {
+    std::lock_guard lg {state->lock};
+
+    return std::count_if(std::begin(state->slots), std::end(state->slots), [](const slot_t &slot) {
+      return (bool) slot.img;
+    });
+  }
+
+  std::uint64_t image_pool_t::exhausted_count() const {
+    std::lock_guard lg {state->lock};
+    return state->exhausted;
+  }
+
+  std::chrono::steady_clock::duration image_pool_t::exhausted_wait() const {
+    std::lock_guard lg {state->lock};
+    return state->exhausted_wait;
+  }
+
+  void image_pool_t::state_t::release(std::size_t index, std::uint64_t generation) {
+    // A stale image is freed after the lock is released
+    std::shared_ptr<platf::img_t> stale;
+
+    {
+      std::lock_guard lg {lock};
+
+      auto &slot = slots[index];
+      slot.in_use = false;
+      if (generation != this->generation) {
+        stale = std::move(slot.img);
+      } else {
+        free_slots.push_back(index);
+      }
+    }
+
+    released.notify_one();
+  }
+
+  void image_pool_t::trim(std::vector<std::shared_ptr<platf::img_t>> &trimmed) {
+    // count allocated and used within current pool
+    std::size_t allocated_count = 0;
+    std::size_t used_count = 0;
+    for (const auto &slot : state->slots) {
+      allocated_count += (bool) slot.img;
+      used_count += slot.in_use;
+    }
+
+    // remember the timestamp of currently used count
+    const auto now = std::chrono::steady_clock::now();
+    auto &used_timestamps = state->used_timestamps;
+    if (used_timestamps.size() <= used_count) {
+      used_timestamps.resize(used_count + 1);
+    }
+    used_timestamps[used_count] = now;
+
+    // decide whether to trim allocated unused above the currently used count
+    // based on last used timestamp and universal timeout
+    std::size_t trim_target = used_count;
+    for (std::size_t i = used_count; i < used_timestamps.size(); i++) {
+      if (used_timestamps[i] && now - *used_timestamps[i] < trim_timeout) {
+        trim_target = i;
+      }
+    }
+
+    // trim allocated unused above the newly decided trim target
+    if (allocated_count > trim_target) {
+      auto &free_slots = state->free_slots;
+
+      // prioritize trimming least recently used
+      auto to_trim = std::min(allocated_count - trim_target, free_slots.size());
+      for (std::size_t i = 0; i < to_trim; i++) {
+        trimmed.emplace_back(std::move(state->slots[free_slots[i]].img));
+      }
+      free_slots.erase(std::begin(free_slots), std::begin(free_slots) + to_trim);
+
+      // forget timestamps that no longer relevant
+      used_timestamps.resize(trim_target + 1);
+    }
+  }
+}  // namespace video
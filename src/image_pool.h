@@ -0,0 +1,112 @@
+/**
+ * @file src/image_pool.h
+ * @brief Declarations for the pool of images shared between capture and encoding.
+ */
+#pragma once
+
+// standard includes
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// local includes
+#include "platform/common.h"
+
+namespace video {
+  /**
+   * @brief A fixed number of capture images that are reused once the encoders are done with them.
+   * @details Images are handed out as shared pointers. When the last copy of one is destroyed,
+   *          the image returns to the pool and wakes a capture that is waiting for a free image.
+   *          Allocated images beyond what was recently in use are freed after a timeout.
+   */
+  class image_pool_t {
+  public:
+    using alloc_t = std::function<std::shared_ptr<platf::img_t>()>;
+
+    /**
+     * @param capacity The largest number of images that can be in use at once.
+     * @param trim_timeout How long images must have been unneeded before they are freed.
+     * @param alloc Allocates an image, or returns nullptr on failure.
+     */
+    image_pool_t(std::size_t capacity, std::chrono::steady_clock::duration trim_timeout, alloc_t alloc);
+
+    /**
+     * @brief Free the unused images, images still in use are freed when released.
+     */
+    ~image_pool_t();
+
+    image_pool_t(const image_pool_t &) = delete;
+    image_pool_t &operator=(const image_pool_t &) = delete;
+
+    /**
+     * @brief Take a free image, waiting for one to be released if all of them are in use.
+     * @param running Checked while waiting, waiting stops once it returns `false`.
+     * @return The image, or nullptr if waiting stopped or allocation failed.
+     */
+    std::shared_ptr<platf::img_t> pull(const std::function<bool()> &running);
+
+    /**
+     * @brief Free the unused images and make sure images in use are freed instead of reused.
+     * @details Images can reference the display that allocated them, this allows the display to be destroyed.
+     */
+    void clear();
+
+    /**
+     * @brief Get the number of images currently allocated, whether in use or not.
+     */
+    std::size_t allocated() const;
+
+    /**
+     * @brief Get how often a capture had to wait because all images were in use.
+     */
+    std::uint64_t exhausted_count() const;
+
+    /**
+     * @brief Get the total time spent waiting for an image to be released.
+     */
+    std::chrono::steady_clock::duration exhausted_wait() const;
+
+  private:
+    struct slot_t {
+      std::shared_ptr<platf::img_t> img;
+
+      // Images released after a clear() are freed instead of reused
+      std::uint64_t generation {};
+      bool in_use {};
+    };
+
+    struct state_t {
+      mutable std::mutex lock;
+      std::condition_variable released;
+
+      std::vector<slot_t> slots;
+
+      // Slots with an allocated image that is not in use, the most recently released last
+      std::vector<std::size_t> free_slots;
+
+      // When each number of images in use was last seen
+      std::vector<std::optional<std::chrono::steady_clock::time_point>> used_timestamps;
+
+      std::uint64_t generation {};
+      std::uint64_t exhausted {};
+      std::chrono::steady_clock::duration exhausted_wait {};
+
+      void release(std::size_t index, std::uint64_t generation);
+    };
+
+    /**
+     * @brief Free images that were unneeded for longer than the trim timeout.
+     * @param trimmed Receives the images to free once the lock is no longer held.
+     */
+    void trim(std::vector<std::shared_ptr<platf::img_t>> &trimmed);
+
+    std::shared_ptr<state_t> state;
+    std::chrono::steady_clock::duration trim_timeout;
+    alloc_t alloc;
+  };
+}  // namespace video
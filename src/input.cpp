@@ -12,7 +12,6 @@ extern "C" {
 #include <bitset>
 #include <chrono>
 #include <cmath>
-#include <list>
 #include <thread>
 #include <unordered_map>
 
@@ -25,6 +24,7 @@ extern "C" {
 #include "input.h"
 #include "logging.h"
 #include "platform/common.h"
+#include "stat_trackers.h"
 #include "thread_pool.h"
 #include "utility.h"
 
@@ -115,6 +115,9 @@ namespace input {
   static platf::input_t platf_input;
   static std::bitset<platf::MAX_GAMEPADS> gamepadMask {};
 
+  // Serializes injection between the input threads of the sessions and the delayed tasks on the task_pool
+  static std::mutex injection_lock;
+
   void free_gamepad(platf::input_t &platf_input, int id) {
     platf::gamepad_update(platf_input, id, platf::gamepad_state_t {});
     platf::free_gamepad(platf_input, id);
@@ -132,7 +135,8 @@ namespace input {
 
     ~gamepad_t() {
       if (id >= 0) {
-        task_pool.push([id = this->id]() {
+        task_pool.post([id = this->id]() {
+          std::lock_guard lg {injection_lock};
           free_gamepad(platf_input, id);
         });
       }
@@ -152,6 +156,23 @@ namespace input {
     button_state_e back_button_state;
   };
 
+  // Large enough for every input message, text is sent in chunks of at most 32 bytes
+  constexpr std::size_t max_input_message_size = 128;
+
+  // The number of messages that may wait for the input thread before the control stream has to wait
+  constexpr std::uint32_t input_queue_size = 1024;
+
+  /**
+   * @brief An input message waiting for injection, stored in a preallocated slot of the input queue.
+   */
+  struct input_message_t {
+    std::chrono::steady_clock::time_point received;
+    std::uint16_t size;
+    std::array<std::uint8_t, max_input_message_size> data;
+  };
+
+  using input_queue_t = std::shared_ptr<safe::ring_t<input_message_t>>;
+
   struct input_t {
     enum shortkey_e {
       CTRL = 0x1,  ///< Control key
@@ -169,12 +190,26 @@ namespace input {
         client_context {platf::allocate_client_input_context(platf_input)},
         touch_port_event {std::move(touch_port_event)},
         feedback_queue {std::move(feedback_queue)},
+        input_queue {std::make_shared<input_queue_t::element_type>(input_queue_size)},
         mouse_left_button_timeout {},
         touch_port {{0, 0, 0, 0}, 0, 0, 1.0f},
         accumulated_vscroll_delta {},
         accumulated_hscroll_delta {} {
     }
 
+    ~input_t() {
+      input_queue->stop();
+
+      if (input_thread.joinable()) {
+        // The input thread may hold the last reference for a moment, it can't join itself
+        if (input_thread.get_id() == std::this_thread::get_id()) {
+          input_thread.detach();
+        } else {
+          input_thread.join();
+        }
+      }
+    }
+
     // Keep track of alt+ctrl+shift key combo
     int shortcutFlags;
 
@@ -184,8 +219,9 @@ namespace input {
     safe::mail_raw_t::event_t<input::touch_port_t> touch_port_event;
     platf::feedback_queue_t feedback_queue;
 
-    std::list<std::vector<uint8_t>> input_queue;
-    std::mutex input_queue_lock;
+    // The input thread owns a reference to the queue, so it can outlive this context
+    input_queue_t input_queue;
+    std::thread input_thread;
 
     thread_pool_util::ThreadPool::task_id_t mouse_left_button_timeout;
 
@@ -586,6 +622,8 @@ namespace input {
      */
     if (button == BUTTON_LEFT && release && !input->mouse_left_button_timeout) {
       auto f = [=]() {
+        std::lock_guard lg {injection_lock};
+
         auto left_released = mouse_press[BUTTON_LEFT];
         if (left_released) {
           // Already released left button
@@ -708,6 +746,8 @@ namespace input {
   }
 
   void repeat_key(uint16_t key_code, uint8_t flags, uint8_t synthetic_modifiers) {
+    std::lock_guard lg {injection_lock};
+
     // If key no longer pressed, stop repeating
     if (!key_press[make_kpid(key_code, flags)]) {
       key_press_repeat_id = nullptr;
@@ -1157,6 +1197,8 @@ namespace input {
         // Don't emulate home button if timeout < 0
         if (config::input.back_button_timeout >= 0ms) {
           auto f = [input, controller = packet->controllerNumber]() {
+            std::lock_guard lg {injection_lock};
+
             auto &gamepad = input->gamepads[controller];
 
             auto &state = gamepad.gamepad_state;
@@ -1475,54 +1517,13 @@ namespace input {
   }
 
   /**
-   * @brief Called on a thread pool thread to process an input message.
+   * @brief Send a batched input message to the OS.
    * @param input The input context pointer.
+   * @param payload The input message.
    */
-  void passthrough_next_message(std::shared_ptr<input_t> input) {
-    // 'entry' backs the 'payload' pointer, so they must remain in scope together
-    std::vector<uint8_t> entry;
-    PNV_INPUT_HEADER payload;
-
-    // Lock the input queue while batching, but release it before sending
-    // the input to the OS. This avoids potentially lengthy lock contention
-    // in the control stream thread while input is being processed by the OS.
-    {
-      std::lock_guard<std::mutex> lg(input->input_queue_lock);
-
-      // If all entries have already been processed, nothing to do
-      if (input->input_queue.empty()) {
-        return;
-      }
-
-      // Pop off the first entry, which we will send
-      entry = input->input_queue.front();
-      payload = (PNV_INPUT_HEADER) entry.data();
-      input->input_queue.pop_front();
-
-      // Try to batch with remaining items on the queue
-      auto i = input->input_queue.begin();
-      while (i != input->input_queue.end()) {
-        auto batchable_entry = *i;
-        auto batchable_payload = (PNV_INPUT_HEADER) batchable_entry.data();
-
-        auto batch_result = batch(payload, batchable_payload);
-        if (batch_result == batch_result_e::terminate_batch) {
-          // Stop batching
-          break;
-        } else if (batch_result == batch_result_e::batched) {
-          // Erase this entry since it was batched
-          i = input->input_queue.erase(i);
-        } else {
-          // We couldn't batch this entry, but try to batch later entries.
-          i++;
-        }
-      }
-    }
-
-    // Print the final input packet
+  void inject(std::shared_ptr<input_t> &input, PNV_INPUT_HEADER payload) {
     input::print((void *) payload);
 
-    // Send the batched input to the OS
     switch (util::endian::little(payload->magic)) {
       case MOUSE_MOVE_REL_MAGIC_GEN5:
         passthrough(input, (PNV_REL_MOUSE_MOVE_PACKET) payload);
@@ -1571,6 +1572,80 @@ namespace input {
     }
   }
 
+  /**
+   * @brief Inject the input messages of a session on its own thread.
+   * @details Each message is coalesced with the messages that queued up behind it before it is injected,
+   *          so a burst of mouse or touch motion costs a single injection.
+   * @param weak_input The input context, the thread stops once it's gone.
+   * @param queue The input queue of the context.
+   */
+  void input_thread(std::weak_ptr<input_t> weak_input, input_queue_t queue) {
+    platf::adjust_thread_priority(platf::thread_priority_e::high);
+
+    // The messages taken off the queue that weren't injected yet, allocated once.
+    // Messages that were batched into an earlier one are marked with a size of 0.
+    std::vector<input_message_t> pending;
+    pending.reserve(queue->capacity());
+    std::size_t next = 0;
+
+    while (true) {
+      if (next == pending.size()) {
+        pending.clear();
+        next = 0;
+
+        auto message = queue->pop();
+        if (!message) {
+          return;
+        }
+        pending.push_back(*message);
+      } else if (pending.size() == pending.capacity()) {
+        pending.erase(std::begin(pending), std::begin(pending) + next);
+        next = 0;
+      }
+
+      // Take everything that queued up meanwhile, so it can be batched
+      while (pending.size() < pending.capacity() && queue->peek()) {
+        auto later = queue->pop();
+        if (!later) {
+          break;
+        }
+        pending.push_back(*later);
+      }
+
+      auto &message = pending[next++];
+      if (!message.size) {
+        continue;
+      }
+
+      auto payload = (PNV_INPUT_HEADER) message.data.data();
+      for (auto i = next; i < pending.size(); ++i) {
+        if (!pending[i].size) {
+          continue;
+        }
+
+        auto batch_result = batch(payload, (PNV_INPUT_HEADER) pending[i].data.data());
+        if (batch_result == batch_result_e::terminate_batch) {
+          break;
+        } else if (batch_result == batch_result_e::batched) {
+          pending[i].size = 0;
+        }
+      }
+
+      auto input = weak_input.lock();
+      if (!input) {
+        return;
+      }
+
+      {
+        std::lock_guard lg {injection_lock};
+        inject(input, payload);
+      }
+
+      // A batch is as late as the oldest message in it
+      stat_trackers::input_latency().record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - message.received));
+    }
+  }
+
   /**
    * @brief Called on the control stream thread to queue an input message.
    * @param input The input context pointer.
@@ -1636,19 +1711,51 @@ namespace input {
       }
     }
 
-    {
-      std::lock_guard<std::mutex> lg(input->input_queue_lock);
-      input->input_queue.push_back(std::move(input_data));
+    if (input_data.size() > max_input_message_size) {
+      BOOST_LOG(warning) << "Dropping oversized input message of "sv << input_data.size() << " bytes"sv;
+      return;
+    }
+
+    input_message_t message;
+    message.received = std::chrono::steady_clock::now();
+    message.size = input_data.size();
+    std::copy(std::begin(input_data), std::end(input_data), std::begin(message.data));
+
+    // Give the input thread a moment to catch up rather than dropping input right away, a lost key release
+    // would leave the key stuck. Don't hold up the control stream for long though.
+    auto deadline = message.received + 100ms;
+    while (!input->input_queue->raise(message)) {
+      if (!input->input_queue->running()) {
+        return;
+      }
+
+      if (std::chrono::steady_clock::now() >= deadline) {
+        BOOST_LOG(warning) << "Input queue is full, dropping an input message"sv;
+        return;
+      }
+      std::this_thread::sleep_for(1ms);
     }
-    task_pool.push(passthrough_next_message, input);
   }
 
   void reset(std::shared_ptr<input_t> &input) {
-    task_pool.cancel(key_press_repeat_id);
-    task_pool.cancel(input->mouse_left_button_timeout);
+    // Stop injecting first, so the keys and buttons released below stay released
+    input->input_queue->stop();
+    if (input->input_thread.joinable()) {
+      input->input_thread.join();
+    }
+
+    {
+      // The delayed tasks and the input threads of other sessions update these under the lock
+      std::lock_guard lg {injection_lock};
+
+      task_pool.cancel(key_press_repeat_id);
+      key_press_repeat_id = nullptr;
+      task_pool.cancel(input->mouse_left_button_timeout);
+    }
+
+    task_pool.post([]() {
+      std::lock_guard lg {injection_lock};
 
-    // Ensure input is synchronous, by using the task_pool
-    task_pool.push([]() {
       for (int x = 0; x < mouse_press.size(); ++x) {
         if (mouse_press[x]) {
           platf::button_mouse(platf_input, x, true);
@@ -1696,9 +1803,12 @@ namespace input {
       mail->event<input::touch_port_t>(mail::touch_port),
       mail->queue<platf::gamepad_feedback_msg_t>(mail::gamepad_feedback)
     );
+    input->input_thread = std::thread {input_thread, std::weak_ptr {input}, input->input_queue};
 
     // Workaround to ensure new frames will be captured when a client connects
     task_pool.pushDelayed([]() {
+      std::lock_guard lg {injection_lock};
+
       platf::move_mouse(platf_input, 1, 1);
       platf::move_mouse(platf_input, -1, -1);
     },
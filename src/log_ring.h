@@ -0,0 +1,283 @@
+/**
+ * @file src/log_ring.h
+ * @brief Declarations for the per-thread binary log ring of deferred log records.
+ */
+#pragma once
+
+// standard includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <new>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+namespace logging::deferred {
+  /**
+   * @brief The severities of the global loggers, usable at compile time.
+   */
+  namespace level {
+    constexpr int verbose = 0;
+    constexpr int debug = 1;
+    constexpr int info = 2;
+    constexpr int warning = 3;
+    constexpr int error = 4;
+    constexpr int fatal = 5;
+  }  // namespace level
+
+  // Strings are copied into the record, longer ones are cut off
+  constexpr std::size_t max_string_size = 512;
+
+  /**
+   * @brief Turns the raw arguments that follow a record header into the log message.
+   */
+  using format_fn = std::string (*)(std::string_view format, const std::byte *args);
+
+  /**
+   * @brief The header of a record. Its raw arguments follow it in the ring.
+   */
+  struct record_t {
+    // The size of the record including its arguments, a multiple of the alignment of record_t
+    std::uint32_t size;
+    int severity;
+    std::chrono::system_clock::time_point time;
+
+    // The format string doubles as the format ID, it must be a string literal
+    std::string_view format;
+
+    // nullptr for padding up to the end of the ring
+    format_fn format_args;
+  };
+
+  /**
+   * @brief A single producer, single consumer ring of records, owned by the thread that writes to it.
+   */
+  class ring_t {
+  public:
+    static constexpr std::size_t capacity = 64 * 1024;
+
+    /**
+     * @brief Reserve space for a record. Only the owning thread may call this.
+     * @return nullptr if the ring is full.
+     */
+    std::byte *reserve(std::size_t size) {
+      auto head = _head.load(std::memory_order_relaxed);
+      auto tail = _tail.load(std::memory_order_acquire);
+
+      auto offset = head % capacity;
+      auto to_end = capacity - offset;
+
+      // Records don't wrap around, the space up to the end of the ring is skipped instead
+      auto padding = size > to_end ? to_end : 0;
+      if (head + padding + size - tail > capacity) {
+        return nullptr;
+      }
+
+      // Too little space for a header is skipped by the reader without one
+      if (padding >= sizeof(record_t)) {
+        new (_data + offset) record_t {(std::uint32_t) padding, 0, {}, {}, nullptr};
+      }
+
+      _reserved = head + padding;
+      return _data + _reserved % capacity;
+    }
+
+    /**
+     * @brief Publish the record written to the space returned by the last reserve().
+     * @return The number of bytes waiting to be read.
+     */
+    std::size_t commit(std::size_t size) {
+      _head.store(_reserved + size, std::memory_order_release);
+
+      return _reserved + size - _tail.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Pass all published records to a function and release their space afterwards.
+     */
+    template<class Function>
+    void drain(Function &&f) {
+      auto tail = _tail.load(std::memory_order_relaxed);
+      auto head = _head.load(std::memory_order_acquire);
+
+      while (tail != head) {
+        auto offset = tail % capacity;
+        auto to_end = capacity - offset;
+        if (to_end < sizeof(record_t)) {
+          tail += to_end;
+          continue;
+        }
+
+        auto record = (const record_t *) (_data + offset);
+        if (record->format_args) {
+          f(*record, (const std::byte *) (record + 1));
+        }
+
+        tail += record->size;
+      }
+
+      _tail.store(tail, std::memory_order_release);
+    }
+
+    bool empty() const {
+      return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+    // Records that didn't fit, the writer reports them
+    std::atomic<std::uint64_t> dropped {0};
+
+    // Set when the owning thread exits, the writer removes the ring once it's empty
+    std::atomic_bool closed {false};
+
+  private:
+    alignas(record_t) std::byte _data[capacity];
+
+    std::atomic<std::uint64_t> _head {0};
+    std::atomic<std::uint64_t> _tail {0};
+    std::uint64_t _reserved {0};
+  };
+
+  template<class T>
+  constexpr bool is_string_v = std::is_convertible_v<const T &, std::string_view>;
+
+  /**
+   * @brief Arguments are stored raw: strings as their size and characters, anything else as its bytes.
+   */
+  template<class T>
+  struct codec_t {
+    static_assert(std::is_trivially_copyable_v<T>, "format arguments of deferred log records before passing them");
+
+    using value_type = T;
+
+    static std::size_t size(const T &) {
+      return sizeof(T);
+    }
+
+    static std::byte *encode(std::byte *out, const T &value) {
+      std::memcpy(out, &value, sizeof(T));
+      return out + sizeof(T);
+    }
+
+    static T decode(const std::byte *&in) {
+      T value;
+      std::memcpy(&value, in, sizeof(T));
+      in += sizeof(T);
+      return value;
+    }
+  };
+
+  template<class T>
+    requires is_string_v<T>
+  struct codec_t<T> {
+    using value_type = std::string_view;
+
+    static std::size_t size(const T &value) {
+      return sizeof(std::uint32_t) + std::min(std::string_view {value}.size(), max_string_size);
+    }
+
+    static std::byte *encode(std::byte *out, const T &value) {
+      std::string_view view {value};
+      std::uint32_t size = std::min(view.size(), max_string_size);
+
+      std::memcpy(out, &size, sizeof(size));
+      std::memcpy(out + sizeof(size), view.data(), size);
+      return out + sizeof(size) + size;
+    }
+
+    static std::string_view decode(const std::byte *&in) {
+      std::uint32_t size;
+      std::memcpy(&size, in, sizeof(size));
+
+      std::string_view value {(const char *) in + sizeof(size), size};
+      in += sizeof(size) + size;
+      return value;
+    }
+  };
+
+  template<class T>
+  using codec = codec_t<std::remove_cvref_t<std::decay_t<T>>>;
+
+  template<class... Args>
+  std::string format_args(std::string_view format, const std::byte *args) {
+    // Braced initialization decodes the arguments in order
+    std::tuple<typename codec<Args>::value_type...> values {codec<Args>::decode(args)...};
+
+    return std::apply([format](auto &...values) {
+      return std::vformat(format, std::make_format_args(values...));
+    },
+                      values);
+  }
+
+  // Whether records are queued for the writer thread, or logged right away
+  inline std::atomic_bool active {false};
+  inline std::atomic_int min_level {0};
+
+  /**
+   * @brief The ring of the calling thread, created on first use.
+   */
+  ring_t &thread_ring();
+
+  /**
+   * @brief Wake the writer thread before its interval ends.
+   */
+  void wake_writer();
+
+  /**
+   * @brief Pass the records of all rings to Boost.Log.
+   */
+  void drain();
+
+  /**
+   * @brief Log a formatted message through Boost.Log, while the writer thread isn't running.
+   */
+  void log_now(int severity, std::string &&message);
+
+  inline bool enabled(int severity) {
+    return severity >= min_level.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Queue a record for the writer thread, formatting is deferred until it writes the record.
+   */
+  template<class... Args>
+  void write(int severity, std::format_string<Args...> format, Args &&...args) {
+    if (!active.load(std::memory_order_relaxed)) {
+      log_now(severity, std::format(format, std::forward<Args>(args)...));
+      return;
+    }
+
+    auto time = std::chrono::system_clock::now();
+
+    std::size_t size = sizeof(record_t) + (codec<Args>::size(args) + ... + 0);
+    size = (size + alignof(record_t) - 1) / alignof(record_t) * alignof(record_t);
+
+    auto &ring = thread_ring();
+
+    auto data = size <= ring_t::capacity / 4 ? ring.reserve(size) : nullptr;
+    if (!data) {
+      ring.dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    new (data) record_t {(std::uint32_t) size, severity, time, format.get(), &format_args<Args...>};
+
+    auto out = data + sizeof(record_t);
+    ((out = codec<Args>::encode(out, args)), ...);
+
+    auto pending = ring.commit(size);
+
+    // Pairs with the fence in stop(), the writer thread may have drained the rings for the last time
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!active.load(std::memory_order_relaxed)) {
+      drain();
+    } else if (pending > ring_t::capacity / 2) {
+      wake_writer();
+    }
+  }
+}  // namespace logging::deferred
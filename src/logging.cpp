@@ -3,10 +3,16 @@
  * @brief Definitions for logging related functions.
  */
 // standard includes
+#include <algorithm>
+#include <condition_variable>
 #include <fstream>
 #include <filesystem>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 // lib includes
 #include <boost/core/null_deleter.hpp>
@@ -16,6 +22,7 @@
 #include <boost/log/expressions.hpp>
 #include <boost/log/sinks.hpp>
 #include <boost/log/sources/severity_logger.hpp>
+#include <boost/log/utility/manipulators/add_value.hpp>
 
 // local includes
 #include "logging.h"
@@ -50,22 +57,10 @@ bl::sources::severity_logger<int> tests(10);  // Automatic tests output
 BOOST_LOG_ATTRIBUTE_KEYWORD(severity, "Severity", int)
 
 namespace logging {
-  deinit_t::~deinit_t() {
-    deinit();
-  }
-
-  void deinit() {
-    log_flush();
-    bl::core::get()->remove_sink(sink);
-    sink.reset();
-  }
-
-  void formatter(const boost::log::record_view &view, boost::log::formatting_ostream &os) {
-    constexpr const char *message = "Message";
-    constexpr const char *severity = "Severity";
-
-    auto log_level = view.attribute_values()[severity].extract<int>().get();
-
+  /**
+   * @brief Write the timestamp and severity that start every line of the log.
+   */
+  static void write_prefix(std::ostream &os, std::chrono::system_clock::time_point time, int log_level) {
     std::string_view log_type;
     switch (log_level) {
       case 0:
@@ -93,17 +88,197 @@ namespace logging {
 #endif
     };
 
-    auto now = std::chrono::system_clock::now();
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-      now - std::chrono::time_point_cast<std::chrono::seconds>(now)
+      time - std::chrono::time_point_cast<std::chrono::seconds>(time)
     );
 
-    auto t = std::chrono::system_clock::to_time_t(now);
+    auto t = std::chrono::system_clock::to_time_t(time);
     auto lt = *std::localtime(&t);
 
     os << "["sv << std::put_time(&lt, "%Y-%m-%d %H:%M:%S.") << boost::format("%03u") % ms.count() << "]: "sv
-       << log_type << view.attribute_values()[message].extract<std::string>();
+       << log_type;
   }
+
+  void formatter(const boost::log::record_view &view, boost::log::formatting_ostream &os) {
+    constexpr const char *message = "Message";
+    constexpr const char *severity = "Severity";
+
+    constexpr const char *deferred_time = "DeferredTime";
+
+    auto log_level = view.attribute_values()[severity].extract<int>().get();
+
+    // Deferred records carry the time they were written at, the others are formatted as they are logged
+    auto time = view.attribute_values()[deferred_time].extract<std::chrono::system_clock::time_point>();
+    write_prefix(os.stream(), time ? time.get() : std::chrono::system_clock::now(), log_level);
+    os << view.attribute_values()[message].extract<std::string>();
+  }
+
+  namespace deferred {
+    // How long records may wait in the rings before the writer formats them
+    constexpr auto write_interval = 100ms;
+
+    std::mutex rings_lock;
+    std::vector<std::shared_ptr<ring_t>> rings;
+
+    // Serializes the writer thread and log_flush()
+    std::mutex drain_lock;
+
+    std::mutex writer_lock;
+    std::condition_variable writer_cv;
+    bool writer_stop;
+    std::thread writer;
+
+    /**
+     * @brief Marks the ring of a thread as closed when the thread exits.
+     */
+    struct thread_ring_t {
+      std::shared_ptr<ring_t> ring;
+
+      ~thread_ring_t() {
+        if (ring) {
+          ring->closed = true;
+        }
+      }
+    };
+
+    ring_t &thread_ring() {
+      thread_local thread_ring_t owner;
+
+      if (!owner.ring) {
+        owner.ring = std::make_shared<ring_t>();
+
+        std::lock_guard lg {rings_lock};
+        rings.emplace_back(owner.ring);
+      }
+
+      return *owner.ring;
+    }
+
+    void wake_writer() {
+      writer_cv.notify_one();
+    }
+
+    static bl::sources::severity_logger<int> &logger(int severity) {
+      switch (severity) {
+        case level::verbose:
+          return ::verbose;
+        case level::debug:
+          return ::debug;
+        case level::info:
+          return ::info;
+        case level::warning:
+          return ::warning;
+        case level::error:
+          return ::error;
+        default:
+          return ::fatal;
+      }
+    }
+
+    void log_now(int severity, std::string &&message) {
+      BOOST_LOG(logger(severity)) << message;
+    }
+
+    /**
+     * @brief Format the records of all rings and pass them to Boost.Log, ordered by the time they were written.
+     */
+    void drain() {
+      std::lock_guard lg {drain_lock};
+
+      std::vector<std::shared_ptr<ring_t>> current;
+      {
+        std::lock_guard lg {rings_lock};
+
+        // The rings of exited threads are dropped once they are empty
+        std::erase_if(rings, [](auto &ring) {
+          return ring->closed && ring->empty();
+        });
+        current = rings;
+      }
+
+      struct line_t {
+        std::chrono::system_clock::time_point time;
+        int severity;
+        std::string message;
+      };
+
+      std::vector<line_t> lines;
+      std::uint64_t dropped = 0;
+      for (auto &ring : current) {
+        ring->drain([&lines](const record_t &record, const std::byte *args) {
+          lines.emplace_back(record.time, record.severity, record.format_args(record.format, args));
+        });
+
+        dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+      }
+
+      // Every ring is in order, merge them
+      std::stable_sort(std::begin(lines), std::end(lines), [](auto &l, auto &r) {
+        return l.time < r.time;
+      });
+
+      // The records go through the filter and formatter of the sinks like any other
+      for (auto &line : lines) {
+        BOOST_LOG(logger(line.severity)) << bl::add_value("DeferredTime", line.time) << line.message;
+      }
+
+      if (dropped) {
+        BOOST_LOG(::warning) << "Dropped "sv << dropped << " deferred log records, the log ring of a thread was full"sv;
+      }
+    }
+
+    void writer_thread() {
+      std::unique_lock ul {writer_lock};
+
+      while (!writer_stop) {
+        writer_cv.wait_for(ul, write_interval);
+
+        ul.unlock();
+        drain();
+        ul.lock();
+      }
+    }
+
+    void start(int min_log_level) {
+      min_level = min_log_level;
+
+      writer_stop = false;
+      writer = std::thread {writer_thread};
+      active = true;
+    }
+
+    void stop() {
+      if (!writer.joinable()) {
+        return;
+      }
+
+      // Records written from now on are logged right away. Pairs with the fence in write(), a record written
+      // while stopping is either seen by the last drain below, or its writer sees the flag and drains itself.
+      active = false;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      {
+        std::lock_guard lg {writer_lock};
+        writer_stop = true;
+      }
+      writer_cv.notify_one();
+      writer.join();
+
+      drain();
+    }
+  }  // namespace deferred
+
+  deinit_t::~deinit_t() {
+    deinit();
+  }
+
+  void deinit() {
+    deferred::stop();
+
+    log_flush();
+    bl::core::get()->remove_sink(sink);
+    sink.reset();
+  }
+
 #ifdef __ANDROID__
   namespace sinks = boost::log::sinks;
   namespace expr = boost::log::expressions;
@@ -147,7 +322,7 @@ namespace logging {
   };
 #endif
 
-  [[nodiscard]] std::unique_ptr<deinit_t> init(int min_log_level, const std::string &log_file) {
+  [[nodiscard]] std::unique_ptr<deinit_t> init(int min_log_level, const std::string &log_file, bool deferred) {
     if (sink) {
       // Deinitialize the logging system before reinitializing it. This can probably only ever be hit in tests.
       deinit();
@@ -193,7 +368,13 @@ namespace logging {
 #ifdef __ANDROID__
     auto android_sink = boost::make_shared<sinks::synchronous_sink<android_sink_backend>>();
     bl::core::get()->add_sink(android_sink);
+#else
+    if (deferred) {
+      deferred::start(min_log_level);
+    }
 #endif
+    deferred::min_level = min_log_level;
+
     return std::make_unique<deinit_t>();
   }
 
@@ -258,6 +439,9 @@ namespace logging {
 #endif
 
   void log_flush() {
+    // Also picks up records written while deferred logging stopped
+    deferred::drain();
+
     if (sink) {
       sink->flush();
     }
@@ -273,6 +457,7 @@ namespace logging {
       << "    --help                    | print help"sv << std::endl
       << "    --creds username password | set user credentials for the Web manager"sv << std::endl
       << "    --version                 | print the version of sunshine"sv << std::endl
+      << "    --reprobe                 | ignore cached encoder probe results and probe again"sv << std::endl
       << std::endl
       << "    flags"sv << std::endl
       << "        -0 | Read PIN from stdin"sv << std::endl
@@ -21,8 +21,32 @@ extern boost::log::sources::severity_logger<int> tests;
 #endif
 
 #include "config.h"
+#include "log_ring.h"
 #include "stat_trackers.h"
 
+#ifndef SUNSHINE_LOG_COMPILED_LEVEL
+  #define SUNSHINE_LOG_COMPILED_LEVEL 0
+#endif
+
+/**
+ * @brief Log from a hot path. The arguments are copied raw into a per-thread ring and formatted by a writer thread.
+ * Records below SUNSHINE_LOG_COMPILED_LEVEL are compiled out, records below the minimum log level don't evaluate
+ * their arguments. Without deferred logging, the message is formatted right away and logged through Boost.Log.
+ * @param severity The name of the global logger, e.g. `verbose`.
+ * @param ... A std::format string literal and its arguments.
+ * @examples
+ * LOG_DEFERRED(verbose, "Sent frame {} in {} packets", frame_index, packets);
+ * @examples_end
+ */
+#define LOG_DEFERRED(severity, ...) \
+  do { \
+    if constexpr (logging::deferred::level::severity >= SUNSHINE_LOG_COMPILED_LEVEL) { \
+      if (logging::deferred::enabled(logging::deferred::level::severity)) { \
+        logging::deferred::write(logging::deferred::level::severity, __VA_ARGS__); \
+      } \
+    } \
+  } while (0)
+
 /**
  * @brief Handles the initialization and deinitialization of the logging system.
  */
@@ -49,12 +73,13 @@ namespace logging {
    * @brief Initialize the logging system.
    * @param min_log_level The minimum log level to output.
    * @param log_file The log file to write to.
+   * @param deferred Write the records of LOG_DEFERRED from a background thread.
    * @return An object that will deinitialize the logging system when it goes out of scope.
    * @examples
    * log_init(2, "sunshine.log");
    * @examples_end
    */
-  [[nodiscard]] std::unique_ptr<deinit_t> init(int min_log_level, const std::string &log_file);
+  [[nodiscard]] std::unique_ptr<deinit_t> init(int min_log_level, const std::string &log_file, bool deferred = false);
 
   /**
    * @brief Setup AV logging.
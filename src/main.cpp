@@ -163,7 +163,7 @@ int main(int argc, char *argv[]) {
     return 0;
   }
 
-  auto log_deinit_guard = logging::init(config::sunshine.min_log_level, config::sunshine.log_file);
+  auto log_deinit_guard = logging::init(config::sunshine.min_log_level, config::sunshine.log_file, config::sunshine.deferred_logging);
   if (!log_deinit_guard) {
     BOOST_LOG(error) << "Logging failed to initialize"sv;
   }
@@ -349,6 +349,7 @@ int main(int argc, char *argv[]) {
   }
 
   reed_solomon_init();
+  BOOST_LOG(info) << "Using "sv << reed_solomon_isa() << " Reed-Solomon implementation"sv;
   auto input_deinit_guard = input::init();
 
   if (input::probe_gamepads()) {
@@ -399,6 +400,9 @@ int main(int argc, char *argv[]) {
 #endif
   }
 
+  // Confirm the encoder restored from the probe cache without delaying startup
+  auto revalidate_encoders = std::async(std::launch::async, video::revalidate_probe_cache);
+
   if (http::init()) {
     BOOST_LOG(fatal) << "HTTP interface failed to initialize"sv;
 
@@ -212,6 +212,7 @@ namespace nvenc {
     }
 
     encoder_params.rfi = get_encoder_cap(NV_ENC_CAPS_SUPPORT_REF_PIC_INVALIDATION);
+    encoder_params.dynamic_bitrate = get_encoder_cap(NV_ENC_CAPS_SUPPORT_DYN_BITRATE_CHANGE);
 
     init_params.presetGUID = quality_preset_guid_from_number(config.quality_preset);
     init_params.tuningInfo = NV_ENC_TUNING_INFO_ULTRA_LOW_LATENCY;
@@ -435,6 +436,9 @@ namespace nvenc {
       if (encoder_params.rfi) {
         extra += " rfi";
       }
+      if (encoder_params.dynamic_bitrate) {
+        extra += " dynamic-bitrate";
+      }
       if (init_params.enableWeightedPrediction) {
         extra += " weighted-prediction";
       }
@@ -452,6 +456,9 @@ namespace nvenc {
     }
 
     encoder_state = {};
+    reconfigure_state.init_params = init_params;
+    reconfigure_state.encode_config = enc_config;
+    reconfigure_state.bitrate = enc_config.rcParams.averageBitRate;
     fail_guard.disable();
     return true;
   }
@@ -609,6 +616,40 @@ namespace nvenc {
     return true;
   }
 
+  bool nvenc_base::set_bitrate(uint32_t bitrate_kbps) {
+    if (!encoder || !encoder_params.dynamic_bitrate) {
+      return false;
+    }
+
+    auto bitrate = bitrate_kbps * 1000;
+    if (bitrate == reconfigure_state.bitrate) {
+      return true;
+    }
+
+    // Scale the VBV buffer along with the bitrate, so it keeps holding the same number of frames
+    auto enc_config = reconfigure_state.encode_config;
+    auto &initial_rc_params = reconfigure_state.encode_config.rcParams;
+    enc_config.rcParams.averageBitRate = bitrate;
+    if (initial_rc_params.vbvBufferSize) {
+      enc_config.rcParams.vbvBufferSize = (uint64_t) initial_rc_params.vbvBufferSize * bitrate / initial_rc_params.averageBitRate;
+    }
+
+    NV_ENC_RECONFIGURE_PARAMS reconfigure_params = {min_struct_version(NV_ENC_RECONFIGURE_PARAMS_VER)};
+    reconfigure_params.reInitEncodeParams = reconfigure_state.init_params;
+    reconfigure_params.reInitEncodeParams.encodeConfig = &enc_config;
+    reconfigure_params.resetEncoder = 0;
+    reconfigure_params.forceIDR = 0;
+
+    if (nvenc_failed(nvenc->nvEncReconfigureEncoder(encoder, &reconfigure_params))) {
+      BOOST_LOG(error) << "NvEnc: NvEncReconfigureEncoder() failed: " << last_nvenc_error_string;
+      return false;
+    }
+
+    BOOST_LOG(debug) << "NvEnc: bitrate changed to " << bitrate_kbps << " Kbps";
+    reconfigure_state.bitrate = bitrate;
+    return true;
+  }
+
   bool nvenc_base::nvenc_failed(NVENCSTATUS status) {
     auto status_string = [](NVENCSTATUS status) -> std::string {
       switch (status) {
@@ -69,6 +69,14 @@ namespace nvenc {
      */
     bool invalidate_ref_frames(uint64_t first_frame, uint64_t last_frame);
 
+    /**
+     * @brief Change the target bitrate of the encoder on the fly.
+     *        Reference frames are kept, so the next frame doesn't have to be IDR.
+     * @param bitrate_kbps New target bitrate in Kbps.
+     * @return `true` on success, `false` if the gpu doesn't support it or on error.
+     */
+    bool set_bitrate(uint32_t bitrate_kbps);
+
   protected:
     /**
      * @brief Required. Used for loading NvEnc library and setting `nvenc` variable with `NvEncodeAPICreateInstance()`.
@@ -126,6 +134,7 @@ namespace nvenc {
       NV_ENC_BUFFER_FORMAT buffer_format = NV_ENC_BUFFER_FORMAT_UNDEFINED;
       uint32_t ref_frames_in_dpb = 0;
       bool rfi = false;
+      bool dynamic_bitrate = false;
     } encoder_params;
 
     std::string last_nvenc_error_string;
@@ -150,6 +159,13 @@ namespace nvenc {
       std::pair<uint64_t, uint64_t> last_rfi_range;
       logging::min_max_avg_periodic_logger<double> frame_size_logger = {debug, "NvEnc: encoded frame sizes in kB", ""};
     } encoder_state;
+
+    // Parameters the encoder was initialized with, the base of set_bitrate()
+    struct {
+      NV_ENC_INITIALIZE_PARAMS init_params;
+      NV_ENC_CONFIG encode_config;
+      uint32_t bitrate = 0;
+    } reconfigure_state;
   };
 
 }  // namespace nvenc
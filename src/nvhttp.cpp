@@ -8,7 +8,10 @@
 // standard includes
 #include <filesystem>
 #include <format>
+#include <fstream>
+#include <list>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <string>
 
@@ -53,8 +56,108 @@ namespace nvhttp {
   using p_named_cert_t = crypto::p_named_cert_t;
   using PERM = crypto::PERM;
 
+  /**
+   * @brief The paired devices, indexed by UUID and by certificate fingerprint.
+   * The indexes point into the list, so a client_t can be moved but not copied.
+   */
   struct client_t {
-    std::vector<p_named_cert_t> named_devices;
+    using device_list_t = std::list<p_named_cert_t>;
+
+    struct entry_t {
+      device_list_t::iterator it;
+      crypto::sha256_t fingerprint;
+    };
+
+    client_t() = default;
+    client_t(client_t &&) noexcept = default;
+    client_t &operator=(client_t &&) noexcept = default;
+
+    // In pairing order
+    device_list_t named_devices;
+
+    std::unordered_map<std::string, entry_t> by_uuid;
+    std::unordered_map<crypto::sha256_t, p_named_cert_t, crypto::sha256_hash_t> by_fingerprint;
+
+    // The number of devices sharing a name, without its " (N)" suffix
+    std::unordered_map<std::string, int> name_counts;
+
+    /**
+     * @brief Give the next device with this name a " (N)" suffix, if another device has the name already.
+     */
+    std::string unique_name(const std::string &name) {
+      // Remove any pending id suffix (e.g., " (2)") if present.
+      auto base_name = name.substr(0, name.find(" ("));
+
+      int count = name_counts[base_name]++;
+      if (count > 0) {
+        return base_name + " (" + std::to_string(count + 1) + ")";
+      }
+
+      return base_name;
+    }
+
+    /**
+     * @brief Add a device, unless its certificate is paired already.
+     * @return false if the certificate is invalid or paired already.
+     */
+    bool add(const p_named_cert_t &named_cert_p) {
+      auto x509 = crypto::x509(named_cert_p->cert);
+      if (!x509) {
+        return false;
+      }
+
+      auto fingerprint = crypto::fingerprint(x509.get());
+      if (by_fingerprint.contains(fingerprint)) {
+        return false;
+      }
+
+      if (named_cert_p->uuid.empty() || by_uuid.contains(named_cert_p->uuid)) {
+        named_cert_p->uuid = uuid_util::uuid_t::generate().string();
+      }
+      named_cert_p->name = unique_name(named_cert_p->name);
+
+      auto it = named_devices.insert(std::end(named_devices), named_cert_p);
+      by_uuid.emplace(named_cert_p->uuid, entry_t {it, fingerprint});
+      by_fingerprint.emplace(fingerprint, named_cert_p);
+
+      return true;
+    }
+
+    /**
+     * @brief Rename a device, with a " (N)" suffix if another device has the name already.
+     */
+    void rename(const p_named_cert_t &named_cert_p, const std::string &name) {
+      if (named_cert_p->name != name) {
+        named_cert_p->name = unique_name(name);
+      }
+    }
+
+    /**
+     * @brief Remove a device.
+     * @return The removed device, nullptr if there's no device with this UUID.
+     */
+    p_named_cert_t remove(const std::string &uuid) {
+      auto entry = by_uuid.find(uuid);
+      if (entry == std::end(by_uuid)) {
+        return nullptr;
+      }
+
+      auto named_cert_p = *entry->second.it;
+      by_fingerprint.erase(entry->second.fingerprint);
+      named_devices.erase(entry->second.it);
+      by_uuid.erase(entry);
+
+      return named_cert_p;
+    }
+
+    p_named_cert_t find(const std::string &uuid) const {
+      auto entry = by_uuid.find(uuid);
+      if (entry == std::end(by_uuid)) {
+        return nullptr;
+      }
+
+      return *entry->second.it;
+    }
   };
 
   struct pair_session_t;
@@ -75,6 +178,11 @@ namespace nvhttp {
       context.set_options(boost::asio::ssl::context::no_tlsv1_1);
       context.use_certificate_chain_file(certification_file);
       context.use_private_key_file(private_key_file, boost::asio::ssl::context::pem);
+
+      // OpenSSL only resumes sessions of verified clients with a session ID context.
+      // A resumed session skips verifying the client certificate again.
+      static constexpr unsigned char session_id_context[] = "nvhttp";
+      SSL_CTX_set_session_id_context(context.native_handle(), session_id_context, sizeof(session_id_context) - 1);
     }
 
     std::function<bool(std::shared_ptr<Request>, SSL*)> verify;
@@ -203,6 +311,66 @@ namespace nvhttp {
     return commands;
   }
 
+  nlohmann::json named_cert_to_json(const crypto::named_cert_t &named_cert) {
+    nlohmann::json named_cert_node = nlohmann::json::object();
+    named_cert_node["name"] = named_cert.name;
+    named_cert_node["cert"] = named_cert.cert;
+    named_cert_node["uuid"] = named_cert.uuid;
+    named_cert_node["display_mode"] = named_cert.display_mode;
+    named_cert_node["perm"] = static_cast<uint32_t>(named_cert.perm);
+    named_cert_node["enable_legacy_ordering"] = named_cert.enable_legacy_ordering;
+    named_cert_node["allow_client_commands"] = named_cert.allow_client_commands;
+    named_cert_node["always_use_virtual_display"] = named_cert.always_use_virtual_display;
+
+    // Add "do" commands if available.
+    if (!named_cert.do_cmds.empty()) {
+      nlohmann::json do_cmds_node = nlohmann::json::array();
+      for (const auto &cmd : named_cert.do_cmds) {
+        do_cmds_node.push_back(crypto::command_entry_t::serialize(cmd));
+      }
+      named_cert_node["do"] = do_cmds_node;
+    }
+
+    // Add "undo" commands if available.
+    if (!named_cert.undo_cmds.empty()) {
+      nlohmann::json undo_cmds_node = nlohmann::json::array();
+      for (const auto &cmd : named_cert.undo_cmds) {
+        undo_cmds_node.push_back(crypto::command_entry_t::serialize(cmd));
+      }
+      named_cert_node["undo"] = undo_cmds_node;
+    }
+
+    return named_cert_node;
+  }
+
+  p_named_cert_t named_cert_from_json(const nlohmann::json &el) {
+    auto named_cert_p = std::make_shared<crypto::named_cert_t>();
+    named_cert_p->name = el.value("name", "");
+    named_cert_p->cert = el.value("cert", "");
+    named_cert_p->uuid = el.value("uuid", "");
+    named_cert_p->display_mode = el.value("display_mode", "");
+    named_cert_p->perm = (PERM)(util::get_non_string_json_value<uint32_t>(el, "perm", (uint32_t)PERM::_all)) & PERM::_all;
+    named_cert_p->enable_legacy_ordering = el.value("enable_legacy_ordering", true);
+    named_cert_p->allow_client_commands = el.value("allow_client_commands", true);
+    named_cert_p->always_use_virtual_display = el.value("always_use_virtual_display", false);
+    // Load command entries for "do" and "undo" keys.
+    named_cert_p->do_cmds = extract_command_entries(el, "do");
+    named_cert_p->undo_cmds = extract_command_entries(el, "undo");
+
+    return named_cert_p;
+  }
+
+  // Changes to the paired devices since the state file was last written, one JSON object per line
+  static std::size_t journal_entries = 0;
+
+  static std::string journal_path() {
+    return config::nvhttp.file_state + ".journal";
+  }
+
+  /**
+   * @brief Write all paired devices to the state file and empty the journal.
+   * The state file is replaced atomically, so it's never left half written.
+   */
   void save_state() {
     nlohmann::json root = nlohmann::json::object();
     // If the state file exists, try to read it.
@@ -226,70 +394,112 @@ namespace nvhttp {
     client_t &client = client_root;
     nlohmann::json named_cert_nodes = nlohmann::json::array();
 
-    std::unordered_set<std::string> unique_certs;
-    std::unordered_map<std::string, int> name_counts;
-
+    // Renaming devices may have left names taken twice, so the suffixes are assigned anew.
+    client.name_counts.clear();
     for (auto &named_cert_p : client.named_devices) {
-      // Only add each unique certificate once.
-      if (unique_certs.insert(named_cert_p->cert).second) {
-        nlohmann::json named_cert_node = nlohmann::json::object();
-        std::string base_name = named_cert_p->name;
-        // Remove any pending id suffix (e.g., " (2)") if present.
-        size_t pos = base_name.find(" (");
-        if (pos != std::string::npos) {
-          base_name = base_name.substr(0, pos);
-        }
-        int count = name_counts[base_name]++;
-        std::string final_name = base_name;
-        if (count > 0) {
-          final_name += " (" + std::to_string(count + 1) + ")";
-        }
-        named_cert_node["name"] = final_name;
-        named_cert_node["cert"] = named_cert_p->cert;
-        named_cert_node["uuid"] = named_cert_p->uuid;
-        named_cert_node["display_mode"] = named_cert_p->display_mode;
-        named_cert_node["perm"] = static_cast<uint32_t>(named_cert_p->perm);
-        named_cert_node["enable_legacy_ordering"] = named_cert_p->enable_legacy_ordering;
-        named_cert_node["allow_client_commands"] = named_cert_p->allow_client_commands;
-        named_cert_node["always_use_virtual_display"] = named_cert_p->always_use_virtual_display;
-
-        // Add "do" commands if available.
-        if (!named_cert_p->do_cmds.empty()) {
-          nlohmann::json do_cmds_node = nlohmann::json::array();
-          for (const auto &cmd : named_cert_p->do_cmds) {
-            do_cmds_node.push_back(crypto::command_entry_t::serialize(cmd));
-          }
-          named_cert_node["do"] = do_cmds_node;
-        }
-
-        // Add "undo" commands if available.
-        if (!named_cert_p->undo_cmds.empty()) {
-          nlohmann::json undo_cmds_node = nlohmann::json::array();
-          for (const auto &cmd : named_cert_p->undo_cmds) {
-            undo_cmds_node.push_back(crypto::command_entry_t::serialize(cmd));
-          }
-          named_cert_node["undo"] = undo_cmds_node;
-        }
-
-        named_cert_nodes.push_back(named_cert_node);
-      }
+      named_cert_p->name = client.unique_name(named_cert_p->name);
+      named_cert_nodes.push_back(named_cert_to_json(*named_cert_p));
     }
 
     root["root"]["named_devices"] = named_cert_nodes;
 
+    // The new state must be on disk before it replaces the old one
+    auto file_tmp = config::nvhttp.file_state + ".tmp";
+    if (file_handler::write_file_synced(file_tmp.c_str(), root.dump(4))) {  // Pretty-print with an indent of 4 spaces.
+      BOOST_LOG(error) << "Couldn't write "sv << file_tmp;
+      return;
+    }
+
     try {
-      std::ofstream out(config::nvhttp.file_state);
-      out << root.dump(4);  // Pretty-print with an indent of 4 spaces.
+      fs::rename(file_tmp, config::nvhttp.file_state);
     } catch (std::exception &e) {
       BOOST_LOG(error) << "Couldn't write "sv << config::nvhttp.file_state << ": "sv << e.what();
       return;
     }
+
+    // The state file holds every change of the journal now
+    std::error_code ec;
+    fs::remove(journal_path(), ec);
+    if (ec) {
+      BOOST_LOG(error) << "Couldn't remove "sv << journal_path() << ": "sv << ec.message();
+      return;
+    }
+    journal_entries = 0;
+  }
+
+  /**
+   * @brief Persist a change to the paired devices by appending it to the journal.
+   * The state file is rewritten instead once the journal holds more entries than there are devices,
+   * so each change costs amortized constant time.
+   * @param change The change, replayed by `load_state()`.
+   */
+  void save_change(const nlohmann::json &change) {
+    auto compact_at = std::max<std::size_t>(64, client_root.named_devices.size());
+    if (journal_entries >= compact_at || !fs::exists(config::nvhttp.file_state)) {
+      save_state();
+      return;
+    }
+
+    if (file_handler::write_file_synced(journal_path().c_str(), change.dump() + '\n', true)) {
+      BOOST_LOG(warning) << "Couldn't append to "sv << journal_path();
+      save_state();
+      return;
+    }
+
+    ++journal_entries;
+  }
+
+  /**
+   * @brief Apply the changes saved in the journal since the state file was written.
+   * @param client The devices loaded from the state file.
+   * @return false if the journal ends with a change that was cut off.
+   */
+  bool replay_journal(client_t &client) {
+    journal_entries = 0;
+
+    std::ifstream in(journal_path());
+    std::string line;
+    while (std::getline(in, line)) {
+      try {
+        auto change = nlohmann::json::parse(line);
+        auto op = change.value("op", "");
+
+        if (op == "add") {
+          client.add(named_cert_from_json(change["device"]));
+        } else if (op == "remove") {
+          client.remove(change.value("uuid", ""));
+        } else if (op == "update") {
+          auto device = named_cert_from_json(change["device"]);
+          if (auto named_cert_p = client.find(device->uuid)) {
+            auto name = std::move(device->name);
+            device->cert = std::move(named_cert_p->cert);
+            device->name = std::move(named_cert_p->name);
+            *named_cert_p = std::move(*device);
+
+            // The names are counted in the same order as when the change was made, so this yields the saved name
+            client.rename(named_cert_p, name);
+          }
+        }
+      } catch (std::exception &e) {
+        // Only the last change can be cut off, when Sunshine stopped while writing it
+        BOOST_LOG(warning) << "Couldn't replay "sv << journal_path() << ": "sv << e.what();
+        return false;
+      }
+
+      ++journal_entries;
+    }
+
+    return true;
   }
 
   void load_state() {
     if (!fs::exists(config::nvhttp.file_state)) {
       BOOST_LOG(info) << "File "sv << config::nvhttp.file_state << " doesn't exist"sv;
       http::unique_id = uuid_util::uuid_t::generate().string();
+
+      // Without the state file, the journal has nothing to apply its changes to
+      std::error_code ec;
+      fs::remove(journal_path(), ec);
       return;
     }
 
@@ -331,7 +541,7 @@ namespace nvhttp {
             named_cert_p->enable_legacy_ordering = true;
             named_cert_p->allow_client_commands = true;
             named_cert_p->always_use_virtual_display = false;
-            client.named_devices.emplace_back(named_cert_p);
+            client.add(named_cert_p);
           }
         }
       }
@@ -340,42 +550,40 @@ namespace nvhttp {
     // Import from the new format.
     if (root.contains("named_devices")) {
       for (auto &el : root["named_devices"]) {
-        auto named_cert_p = std::make_shared<crypto::named_cert_t>();
-        named_cert_p->name = el.value("name", "");
-        named_cert_p->cert = el.value("cert", "");
-        named_cert_p->uuid = el.value("uuid", "");
-        named_cert_p->display_mode = el.value("display_mode", "");
-        named_cert_p->perm = (PERM)(util::get_non_string_json_value<uint32_t>(el, "perm", (uint32_t)PERM::_all)) & PERM::_all;
-        named_cert_p->enable_legacy_ordering = el.value("enable_legacy_ordering", true);
-        named_cert_p->allow_client_commands = el.value("allow_client_commands", true);
-        named_cert_p->always_use_virtual_display = el.value("always_use_virtual_display", false);
-        // Load command entries for "do" and "undo" keys.
-        named_cert_p->do_cmds = extract_command_entries(el, "do");
-        named_cert_p->undo_cmds = extract_command_entries(el, "undo");
-        client.named_devices.emplace_back(named_cert_p);
+        client.add(named_cert_from_json(el));
       }
     }
 
+    auto journal_intact = replay_journal(client);
+
     // Clear any existing certificate chain and add the imported certificates.
     cert_chain.clear();
     for (auto &named_cert : client.named_devices) {
       cert_chain.add(named_cert);
     }
 
-    client_root = client;
+    client_root = std::move(client);
+
+    // Changes appended after the cut off one would be lost
+    if (!journal_intact) {
+      save_state();
+    }
   }
 
   void add_authorized_client(const p_named_cert_t& named_cert_p) {
     client_t &client = client_root;
-    client.named_devices.push_back(named_cert_p);
+    if (!client.add(named_cert_p)) {
+      BOOST_LOG(info) << "Client certificate of ["sv << named_cert_p->name << "] is paired already"sv;
+      return;
+    }
+    cert_chain.add(named_cert_p);
 
 #if defined SUNSHINE_TRAY && SUNSHINE_TRAY >= 1
     system_tray::update_tray_paired(named_cert_p->name);
 #endif
 
     if (!config::sunshine.flags[config::flag::FRESH_STATE]) {
-      save_state();
-      load_state();
+      save_change({{"op", "add"}, {"device", named_cert_to_json(*named_cert_p)}});
     }
   }
 
@@ -1018,32 +1226,8 @@ namespace nvhttp {
     std::list<std::string> connected_uuids = rtsp_stream::get_all_session_uuids();
 
     for (auto &named_cert : client.named_devices) {
-      nlohmann::json named_cert_node;
-      named_cert_node["name"] = named_cert->name;
-      named_cert_node["uuid"] = named_cert->uuid;
-      named_cert_node["display_mode"] = named_cert->display_mode;
-      named_cert_node["perm"] = static_cast<uint32_t>(named_cert->perm);
-      named_cert_node["enable_legacy_ordering"] = named_cert->enable_legacy_ordering;
-      named_cert_node["allow_client_commands"] = named_cert->allow_client_commands;
-      named_cert_node["always_use_virtual_display"] = named_cert->always_use_virtual_display;
-
-      // Add "do" commands if available
-      if (!named_cert->do_cmds.empty()) {
-        nlohmann::json do_cmds_node = nlohmann::json::array();
-        for (const auto &cmd : named_cert->do_cmds) {
-          do_cmds_node.push_back(crypto::command_entry_t::serialize(cmd));
-        }
-        named_cert_node["do"] = do_cmds_node;
-      }
-
-      // Add "undo" commands if available
-      if (!named_cert->undo_cmds.empty()) {
-        nlohmann::json undo_cmds_node = nlohmann::json::array();
-        for (const auto &cmd : named_cert->undo_cmds) {
-          undo_cmds_node.push_back(crypto::command_entry_t::serialize(cmd));
-        }
-        named_cert_node["undo"] = undo_cmds_node;
-      }
+      auto named_cert_node = named_cert_to_json(*named_cert);
+      named_cert_node.erase("cert");
 
       // Determine connection status
       bool connected = false;
@@ -1687,7 +1871,7 @@ namespace nvhttp {
 
       });
 
-      auto err_str = cert_chain.verify(x509.get(), named_cert_p);
+      auto err_str = cert_chain.verify(x509.get(), SSL_get_session(ssl), named_cert_p);
       if (err_str) {
         BOOST_LOG(warning) << "SSL Verification error :: "sv << err_str;
         return verified;
@@ -1785,11 +1969,9 @@ namespace nvhttp {
 
   void
   erase_all_clients() {
-    client_t client;
-    client_root = client;
+    client_root = client_t {};
     cert_chain.clear();
     save_state();
-    load_state();
   }
 
   void stop_session(stream::session_t& session, bool graceful) {
@@ -1833,55 +2015,46 @@ namespace nvhttp {
     const bool allow_client_commands,
     const bool always_use_virtual_display
   ) {
-    find_and_udpate_session_info(uuid, name, newPerm);
-
     client_t &client = client_root;
-    auto it = client.named_devices.begin();
-    for (; it != client.named_devices.end(); ++it) {
-      auto named_cert_p = *it;
-      if (named_cert_p->uuid == uuid) {
-        named_cert_p->name = name;
-        named_cert_p->display_mode = display_mode;
-        named_cert_p->perm = newPerm;
-        named_cert_p->do_cmds = do_cmds;
-        named_cert_p->undo_cmds = undo_cmds;
-        named_cert_p->enable_legacy_ordering = enable_legacy_ordering;
-        named_cert_p->allow_client_commands = allow_client_commands;
-        named_cert_p->always_use_virtual_display = always_use_virtual_display;
-        save_state();
-        return true;
-      }
+    auto named_cert_p = client.find(uuid);
+    if (!named_cert_p) {
+      return false;
     }
 
-    return false;
+    client.rename(named_cert_p, name);
+    find_and_udpate_session_info(uuid, named_cert_p->name, newPerm);
+
+    named_cert_p->display_mode = display_mode;
+    named_cert_p->perm = newPerm;
+    named_cert_p->do_cmds = do_cmds;
+    named_cert_p->undo_cmds = undo_cmds;
+    named_cert_p->enable_legacy_ordering = enable_legacy_ordering;
+    named_cert_p->allow_client_commands = allow_client_commands;
+    named_cert_p->always_use_virtual_display = always_use_virtual_display;
+    save_change({{"op", "update"}, {"device", named_cert_to_json(*named_cert_p)}});
+
+    return true;
   }
 
   bool unpair_client(const std::string_view uuid) {
-    bool removed = false;
     client_t &client = client_root;
-    for (auto it = client.named_devices.begin(); it != client.named_devices.end();) {
-      if ((*it)->uuid == uuid) {
-        it = client.named_devices.erase(it);
-        removed = true;
-      } else {
-        ++it;
-      }
+    auto named_cert_p = client.remove(std::string {uuid});
+    if (!named_cert_p) {
+      return false;
     }
 
-    save_state();
-    load_state();
+    cert_chain.remove(named_cert_p);
+    save_change({{"op", "remove"}, {"uuid", std::string {uuid}}});
 
-    if (removed) {
-      auto session = rtsp_stream::find_session(uuid);
-      if (session) {
-        stop_session(*session, true);
-      }
+    auto session = rtsp_stream::find_session(uuid);
+    if (session) {
+      stop_session(*session, true);
+    }
 
-      if (client.named_devices.empty()) {
-        proc::proc.terminate();
-      }
+    if (client.named_devices.empty()) {
+      proc::proc.terminate();
     }
 
-    return removed;
+    return true;
   }
 }  // namespace nvhttp
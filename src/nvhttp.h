@@ -197,6 +197,20 @@ namespace nvhttp {
 
   std::string request_otp(const std::string& passphrase, const std::string& deviceName);
 
+  /**
+   * @brief Load the paired clients from the state file, then apply the changes saved in the journal since.
+   * @examples
+   * nvhttp::load_state();
+   * @examples_end
+   */
+  void load_state();
+
+  /**
+   * @brief Pair a client and save it, unless its certificate is paired already.
+   * @param named_cert_p The client.
+   */
+  void add_authorized_client(const crypto::p_named_cert_t &named_cert_p);
+
   /**
    * @brief Remove single client.
    * @param uuid The UUID of the client to remove.
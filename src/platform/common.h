@@ -549,6 +549,14 @@ namespace platf {
   public:
     virtual capture_e sample(std::vector<float> &frame_buffer) = 0;
 
+    /**
+     * @brief Get the time from capturing the last sampled frame until it was sampled.
+     * @returns The latency, or std::nullopt if the backend can't measure it.
+     */
+    virtual std::optional<std::chrono::microseconds> latency() {
+      return std::nullopt;
+    }
+
     virtual ~mic_t() = default;
   };
 
@@ -604,6 +612,13 @@ namespace platf {
    */
   bool needs_encoder_reenumeration();
 
+  /**
+   * @brief Describe the installed GPUs and their drivers.
+   * @details Used to tell whether cached encoder probe results still apply to this system.
+   * @return One entry per GPU with its PCI IDs and driver version.
+   */
+  std::vector<std::string> gpu_fingerprint();
+
   boost::process::v1::child run_command(bool elevated, bool interactive, const std::string &cmd, boost::filesystem::path &working_dir, const boost::process::v1::environment &env, FILE *file, std::error_code &ec, boost::process::v1::group *group);
 
   enum class thread_priority_e : int {
@@ -696,6 +711,14 @@ namespace platf {
 
   bool send_batch(batched_send_info_t &send_info);
 
+  /**
+   * @brief Wait until every batch sent by `send_batch()` on the calling thread has left our buffers.
+   * @details Platforms may queue batches and return before they are sent. The header and payload
+   *          buffers of a batch must not be modified or freed until this function returns.
+   * @return The number of queued sends that failed since the last call.
+   */
+  int send_batch_wait();
+
   struct send_info_t {
     const char *header;
     size_t header_size;
@@ -710,6 +733,36 @@ namespace platf {
 
   bool send(send_info_t &send_info);
 
+  struct send_message_t {
+    const char *header;
+    size_t header_size;
+    const char *payload;
+    size_t payload_size;
+  };
+
+  struct multi_send_info_t {
+    // Packets with individual headers and payloads, sent in order
+    const send_message_t *messages;
+    size_t message_count;
+
+    std::uintptr_t native_socket;
+    boost::asio::ip::address &target_address;
+    uint16_t target_port;
+    boost::asio::ip::address &source_address;
+
+    // Set to the number of system calls it took to send the packets
+    size_t system_calls;
+  };
+
+  /**
+   * @brief Send several packets of differing sizes to the same destination.
+   * @details Unlike `send_batch()`, every packet may have its own header and payload size.
+   *          Platforms that support it send all packets with a single system call.
+   * @param send_info The packets and their destination.
+   * @return `true` if all packets were sent.
+   */
+  bool send_multiple(multi_send_info_t &send_info);
+
   enum class qos_data_type_e : int {
     audio,  ///< Audio
     video  ///< Video
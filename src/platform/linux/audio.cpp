@@ -11,9 +11,9 @@
 #include <boost/regex.hpp>
 #include <pulse/error.h>
 #include <pulse/pulseaudio.h>
-#include <pulse/simple.h>
 
 // local includes
+#include "src/audio_frames.h"
 #include "src/config.h"
 #include "src/logging.h"
 #include "src/platform/common.h"
@@ -50,26 +50,106 @@ namespace platf {
     return result;
   }
 
+  /**
+   * @brief Record stream of a PulseAudio source, also served by PipeWire through pipewire-pulse.
+   * @details The stream runs asynchronously on a threaded main loop. Its read callback copies the
+   *          captured samples into preallocated frames, so the capture thread only waits for whole frames.
+   */
   struct mic_attr_t: public mic_t {
-    util::safe_ptr<pa_simple, pa_simple_free> mic;
+    using loop_t = util::safe_ptr<pa_threaded_mainloop, pa_threaded_mainloop_free>;
+    using ctx_t = util::safe_ptr<pa_context, pa_context_unref>;
+    using stream_t = util::safe_ptr<pa_stream, pa_stream_unref>;
+
+    mic_attr_t(int frames, int samples_per_frame):
+        frames {frames, samples_per_frame} {
+    }
+
+    ~mic_attr_t() override {
+      if (!loop) {
+        return;
+      }
+
+      // No callbacks run once the loop is stopped
+      pa_threaded_mainloop_stop(loop.get());
+
+      if (stream) {
+        pa_stream_disconnect(stream.get());
+      }
+      if (ctx) {
+        pa_context_disconnect(ctx.get());
+      }
+    }
 
     capture_e sample(std::vector<float> &sample_buf) override {
-      auto sample_size = sample_buf.size();
+      return frames.read(sample_buf, 1s);
+    }
+
+    std::optional<std::chrono::microseconds> latency() override {
+      return std::chrono::duration_cast<std::chrono::microseconds>(frames.latency());
+    }
+
+    static void ctx_state_cb(pa_context *ctx, void *userdata) {
+      auto mic = (mic_attr_t *) userdata;
 
-      auto buf = sample_buf.data();
-      int status;
-      if (pa_simple_read(mic.get(), buf, sample_size * sizeof(float), &status)) {
-        BOOST_LOG(error) << "pa_simple_read() failed: "sv << pa_strerror(status);
+      pa_threaded_mainloop_signal(mic->loop.get(), 0);
+    }
 
-        return capture_e::error;
+    static void stream_state_cb(pa_stream *stream, void *userdata) {
+      auto mic = (mic_attr_t *) userdata;
+
+      switch (pa_stream_get_state(stream)) {
+        case PA_STREAM_FAILED:
+          BOOST_LOG(error) << "Pulseaudio record stream failed: "sv << pa_strerror(pa_context_errno(mic->ctx.get()));
+          [[fallthrough]];
+        case PA_STREAM_TERMINATED:
+          mic->frames.stop(capture_e::error);
+          break;
+        default:
+          break;
       }
 
-      return capture_e::ok;
+      pa_threaded_mainloop_signal(mic->loop.get(), 0);
+    }
+
+    static void read_cb(pa_stream *stream, std::size_t, void *userdata) {
+      auto mic = (mic_attr_t *) userdata;
+
+      while (pa_stream_readable_size(stream) > 0) {
+        const void *data;
+        std::size_t bytes;
+        if (pa_stream_peek(stream, &data, &bytes) < 0) {
+          BOOST_LOG(error) << "pa_stream_peek() failed: "sv << pa_strerror(pa_context_errno(mic->ctx.get()));
+          mic->frames.stop(capture_e::error);
+          return;
+        }
+
+        if (!bytes) {
+          return;
+        }
+
+        // The latency is unknown until the first timing update arrived
+        pa_usec_t latency = 0;
+        int negative = 0;
+        if (pa_stream_get_latency(stream, &latency, &negative) || negative) {
+          latency = 0;
+        }
+
+        // data is nullptr for holes in the stream, they are filled with silence
+        mic->frames.write((const float *) data, bytes / sizeof(float), std::chrono::microseconds {latency});
+        pa_stream_drop(stream);
+      }
     }
+
+    loop_t loop;
+    ctx_t ctx;
+    stream_t stream;
+
+    audio::frame_queue_t frames;
   };
 
   std::unique_ptr<mic_t> microphone(const std::uint8_t *mapping, int channels, std::uint32_t sample_rate, std::uint32_t frame_size, std::string source_name) {
-    auto mic = std::make_unique<mic_attr_t>();
+    // Buffer about 100ms of audio for a capture thread that fell behind
+    auto mic = std::make_unique<mic_attr_t>(std::max<int>(4, sample_rate / 10 / frame_size), frame_size * channels);
 
     pa_sample_spec ss {PA_SAMPLE_FLOAT32, sample_rate, (std::uint8_t) channels};
     pa_channel_map pa_map;
@@ -79,6 +159,8 @@ namespace platf {
       channel = position_mapping[*mapping++];
     });
 
+    // With PA_STREAM_ADJUST_LATENCY, fragsize configures the latency of the source itself,
+    // so samples are delivered once per Opus frame
     pa_buffer_attr pa_attr = {
       .maxlength = uint32_t(-1),
       .tlength = uint32_t(-1),
@@ -87,18 +169,68 @@ namespace platf {
       .fragsize = uint32_t(frame_size * channels * sizeof(float))
     };
 
-    int status;
+    mic->loop.reset(pa_threaded_mainloop_new());
+    if (!mic->loop) {
+      BOOST_LOG(error) << "pa_threaded_mainloop_new() failed"sv;
+      return nullptr;
+    }
+
+    mic->ctx.reset(pa_context_new(pa_threaded_mainloop_get_api(mic->loop.get()), "sunshine"));
+    if (!mic->ctx) {
+      BOOST_LOG(error) << "pa_context_new() failed"sv;
+      return nullptr;
+    }
+
+    pa_context_set_state_callback(mic->ctx.get(), mic_attr_t::ctx_state_cb, mic.get());
+    if (pa_context_connect(mic->ctx.get(), nullptr, PA_CONTEXT_NOFLAGS, nullptr) < 0) {
+      BOOST_LOG(error) << "Couldn't connect to pulseaudio: "sv << pa_strerror(pa_context_errno(mic->ctx.get()));
+      return nullptr;
+    }
+
+    pa_threaded_mainloop_lock(mic->loop.get());
+    auto unlock = util::fail_guard([loop = mic->loop.get()]() {
+      pa_threaded_mainloop_unlock(loop);
+    });
+
+    if (pa_threaded_mainloop_start(mic->loop.get()) < 0) {
+      BOOST_LOG(error) << "pa_threaded_mainloop_start() failed"sv;
+      return nullptr;
+    }
 
-    mic->mic.reset(
-      pa_simple_new(nullptr, "sunshine", pa_stream_direction_t::PA_STREAM_RECORD, source_name.c_str(), "sunshine-record", &ss, &pa_map, &pa_attr, &status)
-    );
+    for (auto state = pa_context_get_state(mic->ctx.get()); state != PA_CONTEXT_READY; state = pa_context_get_state(mic->ctx.get())) {
+      if (!PA_CONTEXT_IS_GOOD(state)) {
+        BOOST_LOG(error) << "Couldn't connect to pulseaudio: "sv << pa_strerror(pa_context_errno(mic->ctx.get()));
+        return nullptr;
+      }
+      pa_threaded_mainloop_wait(mic->loop.get());
+    }
 
-    if (!mic->mic) {
-      auto err_str = pa_strerror(status);
-      BOOST_LOG(error) << "pa_simple_new() failed: "sv << err_str;
+    mic->stream.reset(pa_stream_new(mic->ctx.get(), "sunshine-record", &ss, &pa_map));
+    if (!mic->stream) {
+      BOOST_LOG(error) << "pa_stream_new() failed: "sv << pa_strerror(pa_context_errno(mic->ctx.get()));
       return nullptr;
     }
 
+    pa_stream_set_state_callback(mic->stream.get(), mic_attr_t::stream_state_cb, mic.get());
+    pa_stream_set_read_callback(mic->stream.get(), mic_attr_t::read_cb, mic.get());
+
+    auto flags = (pa_stream_flags_t) (PA_STREAM_ADJUST_LATENCY | PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_AUTO_TIMING_UPDATE);
+    if (pa_stream_connect_record(mic->stream.get(), source_name.empty() ? nullptr : source_name.c_str(), &pa_attr, flags) < 0) {
+      BOOST_LOG(error) << "pa_stream_connect_record() failed: "sv << pa_strerror(pa_context_errno(mic->ctx.get()));
+      return nullptr;
+    }
+
+    for (auto state = pa_stream_get_state(mic->stream.get()); state != PA_STREAM_READY; state = pa_stream_get_state(mic->stream.get())) {
+      if (!PA_STREAM_IS_GOOD(state)) {
+        return nullptr;
+      }
+      pa_threaded_mainloop_wait(mic->loop.get());
+    }
+
+    if (auto attr = pa_stream_get_buffer_attr(mic->stream.get())) {
+      BOOST_LOG(debug) << "Audio capture fragment size: "sv << attr->fragsize << " bytes, requested: "sv << pa_attr.fragsize << " bytes"sv;
+    }
+
     return mic;
   }
 
@@ -3,6 +3,7 @@
  * @brief Definitions for KMS screen capture.
  */
 // standard includes
+#include <cstring>
 #include <errno.h>
 #include <fcntl.h>
 #include <filesystem>
@@ -547,6 +548,29 @@ namespace platf {
       }
     };
 
+    /**
+     * @brief Hash the pixels of an image, to find images identical to the previous one.
+     */
+    std::uint64_t image_checksum(const img_t &img) {
+      // FNV-1a over 64-bit words
+      std::uint64_t hash = 0xcbf29ce484222325;
+      auto row_bytes = img.width * img.pixel_pitch;
+      for (int y = 0; y < img.height; ++y) {
+        auto row = img.data + (std::ptrdiff_t) y * img.row_pitch;
+        int x = 0;
+        for (; x + 8 <= row_bytes; x += 8) {
+          std::uint64_t word;
+          std::memcpy(&word, row + x, sizeof(word));
+          hash = (hash ^ word) * 0x100000001b3;
+        }
+        for (; x < row_bytes; ++x) {
+          hash = (hash ^ row[x]) * 0x100000001b3;
+        }
+      }
+
+      return hash;
+    }
+
     void print(plane_t::pointer plane, fb_t::pointer fb, crtc_t::pointer crtc) {
       if (crtc) {
         BOOST_LOG(debug) << "crtc("sv << crtc->x << ", "sv << crtc->y << ')';
@@ -1097,9 +1121,37 @@ namespace platf {
 
         update_cursor();
 
+        scanout_fb_id = plane->fb_id;
+
         return capture_e::ok;
       }
 
+      /**
+       * @brief Check whether the image may have changed since the previous capture.
+       * @details Compositors that page flip scan out a new framebuffer for every change, so once the
+       *          framebuffer has been seen changing, an unchanged framebuffer means an unchanged image.
+       *          Until then the compositor may be drawing straight into the framebuffer being scanned out.
+       * @param cursor Whether the cursor is part of the image.
+       * @return `true` if the image must be captured again.
+       */
+      bool take_damage(bool cursor) {
+        if (captured_fb_id && scanout_fb_id != captured_fb_id) {
+          page_flips_seen = true;
+        }
+
+        std::optional<std::tuple<std::int32_t, std::int32_t, unsigned long>> cursor_state;
+        if (cursor && captured_cursor.visible) {
+          cursor_state.emplace(captured_cursor.x, captured_cursor.y, captured_cursor.serial);
+        }
+
+        bool damaged = !page_flips_seen || scanout_fb_id != captured_fb_id || cursor_state != captured_cursor_state;
+
+        captured_fb_id = scanout_fb_id;
+        captured_cursor_state = cursor_state;
+
+        return damaged;
+      }
+
       mem_type_e mem_type;
 
       std::chrono::nanoseconds delay;
@@ -1117,6 +1169,14 @@ namespace platf {
       int cursor_plane_id;
       cursor_t captured_cursor {};
 
+      // Framebuffer found by the last refresh, and the one of the previous capture
+      std::uint32_t scanout_fb_id {};
+      std::uint32_t captured_fb_id {};
+      bool page_flips_seen {};
+
+      // Position and shape of the cursor in the previous capture, if it was visible
+      std::optional<std::tuple<std::int32_t, std::int32_t, unsigned long>> captured_cursor_state;
+
       card_t card;
     };
 
@@ -1277,6 +1337,10 @@ namespace platf {
           return status;
         }
 
+        if (!take_damage(cursor)) {
+          return capture_e::timeout;
+        }
+
         auto rgb_opt = egl::import_source(display.get(), sd);
 
         if (!rgb_opt) {
@@ -1305,6 +1369,20 @@ namespace platf {
           blend_cursor(*img_out);
         }
 
+        // Until the compositor is known to page flip, compare the content instead. Hashing every frame
+        // is expensive, so give up on it when the compositor doesn't page flip within a few seconds.
+        if (!page_flips_seen && checksum_frames < max_checksum_frames) {
+          if (++checksum_frames == max_checksum_frames) {
+            BOOST_LOG(info) << "No page flips seen, capturing every frame without comparing them"sv;
+          }
+
+          auto checksum = image_checksum(*img_out);
+          if (captured_checksum == checksum) {
+            return capture_e::timeout;
+          }
+          captured_checksum = checksum;
+        }
+
         return capture_e::ok;
       }
 
@@ -1326,6 +1404,12 @@ namespace platf {
       gbm::gbm_t gbm;
       egl::display_t display;
       egl::ctx_t ctx;
+
+      // Frames are only compared by content for this many captures without a page flip
+      static constexpr int max_checksum_frames = 300;
+
+      int checksum_frames {};
+      std::optional<std::uint64_t> captured_checksum;
     };
 
     class display_vram_t: public display_t {
@@ -1430,6 +1514,10 @@ namespace platf {
           return status;
         }
 
+        if (!take_damage(cursor)) {
+          return capture_e::timeout;
+        }
+
         img->sequence = ++sequence;
 
         if (cursor && captured_cursor.visible) {
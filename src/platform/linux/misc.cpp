@@ -9,6 +9,7 @@
 #endif
 
 // standard includes
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -16,8 +17,10 @@
 #include <arpa/inet.h>
 #include <dlfcn.h>
 #include <ifaddrs.h>
+#include <linux/errqueue.h>
 #include <netinet/udp.h>
 #include <pwd.h>
+#include <sys/utsname.h>
 
 // lib includes
 #include <boost/asio/ip/address.hpp>
@@ -40,6 +43,7 @@
 #include "src/entry_handler.h"
 #include "src/logging.h"
 #include "src/platform/common.h"
+#include "uring.h"
 #include "vaapi.h"
 
 #include <linux/rtnetlink.h>
@@ -446,6 +450,253 @@ std::string get_local_ip_for_gateway() {
     return saddr_v6;
   }
 
+#ifdef UDP_SEGMENT
+  // Set once a GSO batch was sent synchronously on this thread, since queued sends can't fall back
+  static thread_local bool udp_gso_works = false;
+
+  /**
+   * @brief Get the io_uring instance of the calling thread, creating it on first use.
+   * @return The ring, or nullptr if io_uring sends are disabled or unavailable.
+   */
+  static uring::ring_t *thread_ring() {
+    static thread_local std::unique_ptr<uring::ring_t> ring;
+    static thread_local bool initialized = false;
+
+    if (!initialized) {
+      initialized = true;
+
+      if (config::stream.io_uring) {
+        ring = uring::ring_t::create(256);
+        if (ring) {
+          BOOST_LOG(info) << "Using io_uring for batched sends"sv;
+        } else {
+          BOOST_LOG(warning) << "io_uring is unavailable, falling back to synchronous sends"sv;
+        }
+      }
+    }
+
+    return ring.get();
+  }
+
+  /**
+   * @brief Completion tracking for MSG_ZEROCOPY sends of the calling thread.
+   * @details The kernel numbers zero-copy sends on a socket sequentially and reports ranges
+   *          of completed sends on the socket error queue.
+   */
+  struct zerocopy_state_t {
+    int fd = -1;
+    bool unsupported = false;
+    bool copied_logged = false;
+
+    std::uint32_t sent = 0;
+    std::uint32_t completed = 0;
+  };
+
+  static thread_local zerocopy_state_t zerocopy;
+
+  /**
+   * @brief Read the zero-copy completions that are available without blocking.
+   */
+  static void zerocopy_reap() {
+    union {
+      char buf[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+      struct cmsghdr alignment;
+    } cmbuf;
+
+    while (zerocopy.completed != zerocopy.sent) {
+      struct msghdr msg = {};
+      msg.msg_control = cmbuf.buf;
+      msg.msg_controllen = sizeof(cmbuf.buf);
+
+      if (recvmsg(zerocopy.fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+        return;
+      }
+
+      for (auto cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+            !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+          continue;
+        }
+
+        auto serr = (struct sock_extended_err *) CMSG_DATA(cm);
+        if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0) {
+          continue;
+        }
+
+        // ee_info to ee_data is the inclusive range of completed sends
+        zerocopy.completed += serr->ee_data - serr->ee_info + 1;
+
+        if ((serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && !zerocopy.copied_logged) {
+          BOOST_LOG(info) << "The kernel is copying zero-copy sends, the network device doesn't support them"sv;
+          zerocopy.copied_logged = true;
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Wait until the kernel no longer references the buffers of any zero-copy send.
+   * @details Sends are only counted as complete once the kernel reports them. If no completion
+   *          arrives for 5 seconds, this gives up and turns zero-copy sends off on this thread.
+   *          The kernel may then still send from buffers that are reused for later packets.
+   */
+  static void zerocopy_wait() {
+    auto completed = zerocopy.completed;
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+
+    while (true) {
+      zerocopy_reap();
+      if (zerocopy.completed == zerocopy.sent) {
+        break;
+      }
+
+      if (zerocopy.completed != completed) {
+        completed = zerocopy.completed;
+        deadline = std::chrono::steady_clock::now() + 5s;
+      }
+      else if (std::chrono::steady_clock::now() >= deadline) {
+        BOOST_LOG(error) << "Gave up waiting for "sv << zerocopy.sent - zerocopy.completed << " zero-copy sends to complete, their data may be overwritten, disabling MSG_ZEROCOPY"sv;
+        zerocopy = {-1, true, zerocopy.copied_logged};
+        break;
+      }
+
+      // Pending errors are always reported as POLLERR
+      struct pollfd pfd = {zerocopy.fd, 0, 0};
+      auto ret = poll(&pfd, 1, 1000);
+      if (ret < 0) {
+        if (errno != EINTR) {
+          BOOST_LOG(warning) << "poll() failed: "sv << errno;
+          std::this_thread::sleep_for(10ms);
+        }
+        continue;
+      }
+
+      if (pfd.revents & POLLNVAL) {
+        // The completions were queued on the socket, so they can never be received now
+        BOOST_LOG(error) << "Socket was closed with "sv << zerocopy.sent - zerocopy.completed << " zero-copy sends pending, disabling MSG_ZEROCOPY"sv;
+        zerocopy = {-1, true, zerocopy.copied_logged};
+        break;
+      }
+
+      if (pfd.revents & POLLERR) {
+        // An ICMP error may be pending instead of a completion, so clear it to not spin on it
+        zerocopy_reap();
+
+        int err;
+        socklen_t len = sizeof(err);
+        getsockopt(zerocopy.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+      }
+    }
+  }
+
+  /**
+   * @brief Get the flags for a GSO send, enabling MSG_ZEROCOPY on the socket if requested.
+   * @param sockfd The socket to send on.
+   * @return MSG_ZEROCOPY if zero-copy sends should be used, otherwise 0.
+   */
+  static int zerocopy_flags(int sockfd) {
+    if (!config::stream.udp_zerocopy || zerocopy.unsupported) {
+      return 0;
+    }
+
+    if (zerocopy.fd != sockfd) {
+      zerocopy_wait();
+
+      int enable = 1;
+      if (setsockopt(sockfd, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable))) {
+        BOOST_LOG(warning) << "Failed to enable SO_ZEROCOPY: "sv << errno;
+        zerocopy.unsupported = true;
+        return 0;
+      }
+
+      BOOST_LOG(info) << "Using MSG_ZEROCOPY for batched sends"sv;
+      zerocopy = {sockfd};
+    }
+
+    // Don't let completions pile up on the error queue
+    zerocopy_reap();
+
+    return MSG_ZEROCOPY;
+  }
+
+  /**
+   * @brief Queue the GSO messages of a batch on the ring and return without waiting for them.
+   * @param ring The ring of the calling thread.
+   * @param send_info The batch to send.
+   * @param msg A message with the destination address and the source address control message filled in.
+   * @param cmbuflen The length of the control data in `msg`.
+   * @return `true` if all messages were queued.
+   */
+  static bool send_batch_queued(uring::ring_t &ring, batched_send_info_t &send_info, const msghdr &msg, socklen_t cmbuflen) {
+    // UDP GSO on Linux currently only supports sending 64K or 64 segments at a time
+    const size_t seg_max = 65536 / 1500;
+    auto msg_size = send_info.header_size + send_info.payload_size;
+
+    size_t seg_index = 0;
+    while (seg_index < send_info.block_count) {
+      auto slot = ring.acquire();
+      if (!slot) {
+        return false;
+      }
+
+      auto segs_in_batch = std::min(send_info.block_count - seg_index, seg_max);
+
+      slot->iovs.clear();
+      if (send_info.headers) {
+        // Interleave iovs for headers and payloads
+        for (auto i = 0; i < segs_in_batch; i++) {
+          slot->iovs.push_back({(void *) &send_info.headers[(send_info.block_offset + seg_index + i) * send_info.header_size], send_info.header_size});
+          auto payload_desc = send_info.buffer_for_payload_offset((send_info.block_offset + seg_index + i) * send_info.payload_size);
+          slot->iovs.push_back({(void *) payload_desc.buffer, send_info.payload_size});
+        }
+      } else {
+        // Translate buffer descriptors into iovs
+        auto payload_offset = (send_info.block_offset + seg_index) * send_info.payload_size;
+        auto payload_length = payload_offset + (segs_in_batch * send_info.payload_size);
+        while (payload_offset < payload_length) {
+          auto payload_desc = send_info.buffer_for_payload_offset(payload_offset);
+          auto len = std::min(payload_desc.size, payload_length - payload_offset);
+          slot->iovs.push_back({(void *) payload_desc.buffer, len});
+          payload_offset += len;
+        }
+      }
+
+      // The kernel reads the message when it gets to it, so it must live in the slot
+      slot->fd = (int) send_info.native_socket;
+      slot->flags = 0;
+      slot->zerocopy = config::stream.udp_zerocopy && ring.supports_zerocopy() && segs_in_batch > 1;
+      slot->control = {};
+      std::memcpy(&slot->name, msg.msg_name, msg.msg_namelen);
+      std::memcpy(slot->control.buf, msg.msg_control, cmbuflen);
+
+      slot->msg = {};
+      slot->msg.msg_name = &slot->name;
+      slot->msg.msg_namelen = msg.msg_namelen;
+      slot->msg.msg_iov = slot->iovs.data();
+      slot->msg.msg_iovlen = slot->iovs.size();
+      slot->msg.msg_control = slot->control.buf;
+      slot->msg.msg_controllen = cmbuflen;
+
+      // We should not use GSO if the data is <= one full block size
+      if (segs_in_batch > 1) {
+        slot->msg.msg_controllen = cmbuflen + CMSG_SPACE(sizeof(uint16_t));
+
+        // Enable GSO to perform segmentation of our buffer for us
+        auto cm = (struct cmsghdr *) &slot->control.buf[cmbuflen];
+        cm->cmsg_level = SOL_UDP;
+        cm->cmsg_type = UDP_SEGMENT;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        *((uint16_t *) CMSG_DATA(cm)) = msg_size;
+      }
+
+      ring.queue(slot);
+      seg_index += segs_in_batch;
+    }
+
+    return ring.submit();
+  }
+#endif
+
   bool send_batch(batched_send_info_t &send_info) {
     auto sockfd = (int) send_info.native_socket;
     struct msghdr msg = {};
@@ -509,6 +760,11 @@ std::string get_local_ip_for_gateway() {
     auto const max_iovs_per_msg = send_info.payload_buffers.size() + (send_info.headers ? 1 : 0);
 
 #ifdef UDP_SEGMENT
+    // Hand the batch to io_uring if enabled, so we don't block while the kernel sends it
+    if (auto ring = thread_ring(); ring && udp_gso_works) {
+      return send_batch_queued(*ring, send_info, msg, cmbuflen);
+    }
+
     {
       // UDP GSO on Linux currently only supports sending 64K or 64 segments at a time
       size_t seg_index = 0;
@@ -559,10 +815,20 @@ std::string get_local_ip_for_gateway() {
           msg.msg_controllen = cmbuflen;
         }
 
+        // Only large GSO sends are worth the cost of zero-copy completions
+        auto flags = segs_in_batch > 1 ? zerocopy_flags(sockfd) : 0;
+
         // This will fail if GSO is not available, so we will fall back to non-GSO if
         // it's the first sendmsg() call. On subsequent calls, we will treat errors as
         // actual failures and return to the caller.
-        auto bytes_sent = sendmsg(sockfd, &msg, 0);
+        auto bytes_sent = sendmsg(sockfd, &msg, flags);
+
+        // The socket may run out of memory for pinning pages, so just copy this one
+        if (bytes_sent < 0 && errno == ENOBUFS && flags) {
+          bytes_sent = sendmsg(sockfd, &msg, 0);
+          flags = 0;
+        }
+
         if (bytes_sent < 0) {
           // If there's no send buffer space, wait for some to be available
           if (errno == EAGAIN) {
@@ -584,6 +850,13 @@ std::string get_local_ip_for_gateway() {
           break;
         }
 
+        if (segs_in_batch > 1) {
+          udp_gso_works = true;
+        }
+        if (flags & MSG_ZEROCOPY) {
+          ++zerocopy.sent;
+        }
+
         seg_index += bytes_sent / msg_size;
       }
 
@@ -653,6 +926,21 @@ std::string get_local_ip_for_gateway() {
     }
   }
 
+  int send_batch_wait() {
+    int failed = 0;
+
+#ifdef UDP_SEGMENT
+    if (auto ring = thread_ring()) {
+      failed = ring->wait_all();
+    }
+
+    // Zero-copy sends keep referencing our buffers until the kernel reports them as complete
+    zerocopy_wait();
+#endif
+
+    return failed;
+  }
+
   bool send(send_info_t &send_info) {
     auto sockfd = (int) send_info.native_socket;
     struct msghdr msg = {};
@@ -753,6 +1041,121 @@ std::string get_local_ip_for_gateway() {
     return true;
   }
 
+  bool send_multiple(multi_send_info_t &send_info) {
+    auto sockfd = (int) send_info.native_socket;
+
+    // Convert the target address into a sockaddr
+    struct sockaddr_in taddr_v4 = {};
+    struct sockaddr_in6 taddr_v6 = {};
+    struct sockaddr *taddr;
+    socklen_t taddrlen;
+    if (send_info.target_address.is_v6()) {
+      taddr_v6 = to_sockaddr(send_info.target_address.to_v6(), send_info.target_port);
+
+      taddr = (struct sockaddr *) &taddr_v6;
+      taddrlen = sizeof(taddr_v6);
+    } else {
+      taddr_v4 = to_sockaddr(send_info.target_address.to_v4(), send_info.target_port);
+
+      taddr = (struct sockaddr *) &taddr_v4;
+      taddrlen = sizeof(taddr_v4);
+    }
+
+    union {
+      char buf[std::max(CMSG_SPACE(sizeof(struct in_pktinfo)), CMSG_SPACE(sizeof(struct in6_pktinfo)))];
+      struct cmsghdr alignment;
+    } cmbuf;
+
+    socklen_t cmbuflen = 0;
+
+    // Every message shares the same PKTINFO control message
+    auto pktinfo_cm = (struct cmsghdr *) cmbuf.buf;
+    if (send_info.source_address.is_v6()) {
+      struct in6_pktinfo pktInfo;
+
+      struct sockaddr_in6 saddr_v6 = to_sockaddr(send_info.source_address.to_v6(), 0);
+      pktInfo.ipi6_addr = saddr_v6.sin6_addr;
+      pktInfo.ipi6_ifindex = 0;
+
+      cmbuflen += CMSG_SPACE(sizeof(pktInfo));
+
+      pktinfo_cm->cmsg_level = IPPROTO_IPV6;
+      pktinfo_cm->cmsg_type = IPV6_PKTINFO;
+      pktinfo_cm->cmsg_len = CMSG_LEN(sizeof(pktInfo));
+      memcpy(CMSG_DATA(pktinfo_cm), &pktInfo, sizeof(pktInfo));
+    } else {
+      struct in_pktinfo pktInfo;
+
+      struct sockaddr_in saddr_v4 = to_sockaddr(send_info.source_address.to_v4(), 0);
+      pktInfo.ipi_spec_dst = saddr_v4.sin_addr;
+      pktInfo.ipi_ifindex = 0;
+
+      cmbuflen += CMSG_SPACE(sizeof(pktInfo));
+
+      pktinfo_cm->cmsg_level = IPPROTO_IP;
+      pktinfo_cm->cmsg_type = IP_PKTINFO;
+      pktinfo_cm->cmsg_len = CMSG_LEN(sizeof(pktInfo));
+      memcpy(CMSG_DATA(pktinfo_cm), &pktInfo, sizeof(pktInfo));
+    }
+
+    struct mmsghdr msgs[send_info.message_count];
+    struct iovec iovs[send_info.message_count * 2];
+    int iov_idx = 0;
+    for (size_t i = 0; i < send_info.message_count; i++) {
+      auto &message = send_info.messages[i];
+
+      msgs[i] = {};
+      msgs[i].msg_hdr.msg_iov = &iovs[iov_idx];
+      msgs[i].msg_hdr.msg_iovlen = message.header ? 2 : 1;
+
+      if (message.header) {
+        iovs[iov_idx].iov_base = (void *) message.header;
+        iovs[iov_idx].iov_len = message.header_size;
+        iov_idx++;
+      }
+      iovs[iov_idx].iov_base = (void *) message.payload;
+      iovs[iov_idx].iov_len = message.payload_size;
+      iov_idx++;
+
+      msgs[i].msg_hdr.msg_name = taddr;
+      msgs[i].msg_hdr.msg_namelen = taddrlen;
+      msgs[i].msg_hdr.msg_control = cmbuf.buf;
+      msgs[i].msg_hdr.msg_controllen = cmbuflen;
+    }
+
+    // Call sendmmsg() until all messages are sent
+    size_t messages_sent = 0;
+    send_info.system_calls = 0;
+    while (messages_sent < send_info.message_count) {
+      ++send_info.system_calls;
+      int msgs_sent = sendmmsg(sockfd, &msgs[messages_sent], send_info.message_count - messages_sent, 0);
+      if (msgs_sent < 0) {
+        // If there's no send buffer space, wait for some to be available
+        if (errno == EAGAIN) {
+          struct pollfd pfd;
+
+          pfd.fd = sockfd;
+          pfd.events = POLLOUT;
+
+          if (poll(&pfd, 1, -1) != 1) {
+            BOOST_LOG(warning) << "poll() failed: "sv << errno;
+            return false;
+          }
+
+          // Try to send again
+          continue;
+        }
+
+        BOOST_LOG(warning) << "sendmmsg() failed: "sv << errno;
+        return false;
+      }
+
+      messages_sent += msgs_sent;
+    }
+
+    return true;
+  }
+
   // We can't track QoS state separately for each destination on this OS,
   // so we keep a ref count to only disable QoS options when all clients
   // are disconnected.
@@ -952,6 +1355,47 @@ std::string get_local_ip_for_gateway() {
     return true;
   }
 
+  std::vector<std::string> gpu_fingerprint() {
+    auto read_attribute = [](const fs::path &path) {
+      std::string value;
+      std::ifstream in {path};
+      std::getline(in, value);
+      return value;
+    };
+
+    utsname kernel;
+    auto kernel_release = uname(&kernel) ? ""s : std::string {kernel.release};
+
+    std::vector<std::string> gpus;
+
+    std::error_code ec;
+    for (auto &entry : fs::directory_iterator {"/sys/class/drm", ec}) {
+      // Skip connectors (card0-DP-1) and render nodes
+      auto name = entry.path().filename().string();
+      if (!name.starts_with("card"sv) || name.find('-') != std::string::npos) {
+        continue;
+      }
+
+      auto device = entry.path() / "device";
+      auto driver = fs::read_symlink(device / "driver", ec).filename().string();
+
+      // Out of tree drivers report their own version, the others are part of the kernel
+      auto driver_version = read_attribute(fs::path {"/sys/module"} / driver / "version");
+      if (driver_version.empty()) {
+        driver_version = kernel_release;
+      }
+
+      gpus.emplace_back(
+        read_attribute(device / "vendor") + ':' + read_attribute(device / "device") + ':' +
+        read_attribute(device / "subsystem_vendor") + ':' + read_attribute(device / "subsystem_device") + ':' +
+        read_attribute(device / "revision") + ' ' + driver + ' ' + driver_version
+      );
+    }
+
+    std::sort(std::begin(gpus), std::end(gpus));
+    return gpus;
+  }
+
   std::shared_ptr<display_t> display(mem_type_e hwdevice_type, const std::string &display_name, const video::config_t &config) {
 #ifdef SUNSHINE_BUILD_CUDA
     if (sources[source::NVFBC] && hwdevice_type == mem_type_e::cuda) {
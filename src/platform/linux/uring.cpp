@@ -0,0 +1,275 @@
+/**
+ * @file src/platform/linux/uring.cpp
+ * @brief Definitions for the io_uring based asynchronous send path.
+ */
+// standard includes
+#include <cerrno>
+#include <cstring>
+
+// platform includes
+#include <linux/io_uring.h>
+#include <linux/version.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// local includes
+#include "src/logging.h"
+#include "uring.h"
+
+using namespace std::literals;
+
+// IORING_OP_SENDMSG_ZC is an enum value, so it can only be detected through the version
+// of the kernel headers. Older headers (e.g. Linux 5.15) only get the copying sendmsg().
+#if defined(IORING_CQE_F_NOTIF) && LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
+  #define URING_HAS_SENDMSG_ZC
+#endif
+
+namespace platf::uring {
+  static int io_uring_setup(unsigned entries, io_uring_params *params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+  }
+
+  static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+  }
+
+  static int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+  }
+
+  ring_t::~ring_t() {
+    if (fd < 0) {
+      return;
+    }
+
+    // The kernel may still be reading our buffers
+    wait_all();
+
+    if (sqes_ptr) {
+      munmap(sqes_ptr, sqes_size);
+    }
+    if (cq_ptr && cq_ptr != sq_ptr) {
+      munmap(cq_ptr, cq_size);
+    }
+    if (sq_ptr) {
+      munmap(sq_ptr, sq_size);
+    }
+    close(fd);
+  }
+
+  std::unique_ptr<ring_t> ring_t::create(unsigned entries) {
+    std::unique_ptr<ring_t> ring {new ring_t};
+
+    io_uring_params params {};
+    ring->fd = io_uring_setup(entries, &params);
+    if (ring->fd < 0) {
+      BOOST_LOG(warning) << "io_uring_setup() failed: "sv << errno;
+      return nullptr;
+    }
+
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      ring->sq_size = ring->cq_size = std::max(ring->sq_size, ring->cq_size);
+    }
+
+    ring->sq_ptr = mmap(nullptr, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+      ring->sq_ptr = nullptr;
+      BOOST_LOG(warning) << "Failed to map io_uring submission queue: "sv << errno;
+      return nullptr;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      ring->cq_ptr = ring->sq_ptr;
+    } else {
+      ring->cq_ptr = mmap(nullptr, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+      if (ring->cq_ptr == MAP_FAILED) {
+        ring->cq_ptr = nullptr;
+        BOOST_LOG(warning) << "Failed to map io_uring completion queue: "sv << errno;
+        return nullptr;
+      }
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes_ptr = mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes_ptr == MAP_FAILED) {
+      ring->sqes_ptr = nullptr;
+      BOOST_LOG(warning) << "Failed to map io_uring submission entries: "sv << errno;
+      return nullptr;
+    }
+
+    auto sq = (char *) ring->sq_ptr;
+    ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+
+    auto cq = (char *) ring->cq_ptr;
+    ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (io_uring_cqe *) (cq + params.cq_off.cqes);
+
+#ifdef URING_HAS_SENDMSG_ZC
+    // Zero-copy sendmsg() was added in Linux 6.1, so the running kernel may still lack it
+    std::vector<char> probe_buf(sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op));
+    auto probe = (io_uring_probe *) probe_buf.data();
+    if (io_uring_register(ring->fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == 0 && probe->ops_len > IORING_OP_SENDMSG_ZC) {
+      ring->zerocopy_supported = probe->ops[IORING_OP_SENDMSG_ZC].flags & IO_URING_OP_SUPPORTED;
+    }
+#endif
+
+    // Never have more sends in flight than submission entries, so neither queue can overflow
+    ring->slots.resize(params.sq_entries);
+    ring->free_slots.reserve(params.sq_entries);
+    for (std::uint32_t x = params.sq_entries; x > 0; --x) {
+      ring->free_slots.push_back(x - 1);
+    }
+
+    return ring;
+  }
+
+  msg_slot_t *ring_t::acquire() {
+    while (free_slots.empty()) {
+      if (!enter(1)) {
+        return nullptr;
+      }
+      reap();
+    }
+
+    auto slot = &slots[free_slots.back()];
+    free_slots.pop_back();
+
+    return slot;
+  }
+
+  void ring_t::queue(msg_slot_t *slot) {
+    auto tail = *sq_tail;
+    auto index = tail & *sq_mask;
+
+    auto sqe = (io_uring_sqe *) sqes_ptr + index;
+    std::memset(sqe, 0, sizeof(*sqe));
+#ifdef URING_HAS_SENDMSG_ZC
+    sqe->opcode = slot->zerocopy ? IORING_OP_SENDMSG_ZC : IORING_OP_SENDMSG;
+#else
+    sqe->opcode = IORING_OP_SENDMSG;
+#endif
+    sqe->fd = slot->fd;
+    sqe->addr = (std::uint64_t) &slot->msg;
+    sqe->len = 1;
+    sqe->msg_flags = slot->flags;
+    sqe->user_data = slot - slots.data();
+
+    sq_array[index] = index;
+    slot->retry = false;
+
+    // Publish the entry to the kernel
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++to_submit;
+  }
+
+  bool ring_t::submit() {
+    if (!to_submit) {
+      return true;
+    }
+
+    return enter(0);
+  }
+
+  int ring_t::wait_all() {
+    while (in_flight()) {
+      if (!enter(1)) {
+        // The slots stay allocated, since the kernel may still be reading them
+        BOOST_LOG(error) << "Failed to wait for "sv << in_flight() << " io_uring sends"sv;
+        break;
+      }
+      reap();
+    }
+
+    auto ret = failed;
+    failed = 0;
+
+    return ret;
+  }
+
+  bool ring_t::enter(unsigned min_complete) {
+    while (true) {
+      auto ret = io_uring_enter(fd, to_submit, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0);
+      if (ret >= 0) {
+        to_submit -= ret;
+
+        // Keep going until everything was submitted
+        if (!to_submit || min_complete) {
+          return true;
+        }
+        continue;
+      }
+
+      if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        BOOST_LOG(warning) << "io_uring_enter() failed: "sv << errno;
+        return false;
+      }
+    }
+  }
+
+  void ring_t::reap() {
+    auto head = *cq_head;
+    auto tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; ++head) {
+      auto cqe = &cqes[head & *cq_mask];
+      auto slot_index = (std::uint32_t) cqe->user_data;
+      auto &slot = slots[slot_index];
+      auto res = cqe->res;
+
+      auto notification_pending = false;
+#ifdef URING_HAS_SENDMSG_ZC
+      // Zero-copy sends post a second completion once the kernel no longer references the buffers
+      if (cqe->flags & IORING_CQE_F_NOTIF) {
+        if (slot.retry) {
+          retry(slot);
+        } else {
+          free_slots.push_back(slot_index);
+        }
+        continue;
+      }
+      notification_pending = (cqe->flags & IORING_CQE_F_MORE) != 0;
+#endif
+
+      if (res == -EAGAIN) {
+        // The socket buffer is full, so send the same message again when possible
+        if (notification_pending) {
+          slot.retry = true;
+        } else {
+          retry(slot);
+        }
+        continue;
+      } else if (res < 0) {
+        BOOST_LOG(verbose) << "io_uring sendmsg() failed: "sv << -res;
+        ++failed;
+      }
+
+      if (!notification_pending) {
+        free_slots.push_back(slot_index);
+      }
+    }
+
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+  }
+
+  void ring_t::retry(msg_slot_t &slot) {
+    // Wait for the socket buffer to drain before trying again
+    pollfd pfd {slot.fd, POLLOUT, 0};
+    if (poll(&pfd, 1, -1) != 1) {
+      BOOST_LOG(warning) << "poll() failed: "sv << errno;
+      ++failed;
+      free_slots.push_back(&slot - slots.data());
+      return;
+    }
+
+    queue(&slot);
+  }
+}  // namespace platf::uring
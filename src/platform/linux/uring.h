@@ -0,0 +1,133 @@
+/**
+ * @file src/platform/linux/uring.h
+ * @brief Declarations for the io_uring based asynchronous send path.
+ */
+#pragma once
+
+// standard includes
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// platform includes
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+struct io_uring_cqe;
+
+namespace platf::uring {
+  /**
+   * @brief Storage for a single queued sendmsg() call.
+   * @details Everything the kernel reads is kept here until the send completes.
+   */
+  struct msg_slot_t {
+    int fd;
+    int flags;
+
+    // Send without copying the payload, the slot is only released once the kernel is done with it
+    bool zerocopy;
+
+    // Set when a zero-copy send must be retried once its buffers are released
+    bool retry;
+
+    msghdr msg;
+    sockaddr_storage name;
+    std::vector<iovec> iovs;
+
+    union {
+      char buf[CMSG_SPACE(sizeof(std::uint16_t)) + std::max(CMSG_SPACE(sizeof(in_pktinfo)), CMSG_SPACE(sizeof(in6_pktinfo)))];
+      cmsghdr alignment;
+    } control;
+  };
+
+  /**
+   * @brief A minimal io_uring instance used to queue sendmsg() calls without blocking.
+   * @details A ring must only be used by a single thread.
+   */
+  class ring_t {
+  public:
+    ring_t(const ring_t &) = delete;
+    ring_t &operator=(const ring_t &) = delete;
+    ~ring_t();
+
+    /**
+     * @brief Create a ring.
+     * @param entries The maximum number of sends in flight.
+     * @return The ring, or nullptr if io_uring is unavailable.
+     */
+    static std::unique_ptr<ring_t> create(unsigned entries);
+
+    /**
+     * @brief Get a free message slot, waiting for an earlier send to complete if there is none.
+     * @return The slot, or nullptr if waiting failed.
+     */
+    msg_slot_t *acquire();
+
+    /**
+     * @brief Queue a send for the slot returned by `acquire()`. It is submitted by the next `submit()`.
+     * @param slot The slot to send.
+     */
+    void queue(msg_slot_t *slot);
+
+    /**
+     * @brief Hand all queued sends to the kernel without waiting for them.
+     * @return `true` on success.
+     */
+    bool submit();
+
+    /**
+     * @brief Wait until every queued send has completed.
+     * @return The number of sends that failed since the last call.
+     */
+    int wait_all();
+
+    /**
+     * @brief Get the number of sends that were queued and have not completed yet.
+     * @return The number of sends in flight.
+     */
+    std::size_t in_flight() const {
+      return slots.size() - free_slots.size();
+    }
+
+    /**
+     * @brief Check whether the kernel supports zero-copy sends through io_uring.
+     * @return `true` if slots may be queued with `zerocopy` set.
+     */
+    bool supports_zerocopy() const {
+      return zerocopy_supported;
+    }
+
+  private:
+    ring_t() = default;
+
+    bool enter(unsigned min_complete);
+    void reap();
+    void retry(msg_slot_t &slot);
+
+    int fd = -1;
+
+    void *sq_ptr = nullptr;
+    std::size_t sq_size = 0;
+    void *cq_ptr = nullptr;
+    std::size_t cq_size = 0;
+    void *sqes_ptr = nullptr;
+    std::size_t sqes_size = 0;
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    unsigned to_submit = 0;
+    int failed = 0;
+    bool zerocopy_supported = false;
+
+    std::vector<msg_slot_t> slots;
+    std::vector<std::uint32_t> free_slots;
+  };
+}  // namespace platf::uring
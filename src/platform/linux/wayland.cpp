@@ -298,6 +298,9 @@ namespace wl {
     shm_info.supported = false;
     dmabuf_info.supported = false;
 
+    // The first frame is copied right away, since the compositor has no damage to report for an idle output
+    with_damage = frame_copied && zwlr_screencopy_manager_v1_get_version(screencopy_manager) >= ZWLR_SCREENCOPY_FRAME_V1_COPY_WITH_DAMAGE_SINCE_VERSION;
+
     // Create new frame
     auto frame = zwlr_screencopy_manager_v1_capture_output(
       screencopy_manager,
@@ -454,7 +457,11 @@ namespace wl {
     self->current_wl_buffer = buffer;
 
     // Start the actual copy
-    zwlr_screencopy_frame_v1_copy(frame, buffer);
+    if (self->with_damage) {
+      zwlr_screencopy_frame_v1_copy_with_damage(frame, buffer);
+    } else {
+      zwlr_screencopy_frame_v1_copy(frame, buffer);
+    }
   }
 
   // Buffer params failed callback
@@ -495,6 +502,7 @@ namespace wl {
 
     zwlr_screencopy_frame_v1_destroy(frame);
     status = READY;
+    frame_copied = true;
   }
 
   // Failed callback
@@ -69,6 +69,9 @@ namespace wl {
     frame_t *current_frame;
     zwlr_screencopy_frame_v1_listener listener;
 
+    // Whether the pending frame is only copied once the output has been damaged
+    bool with_damage {false};
+
   private:
     bool init_gbm();
     void cleanup_gbm();
@@ -95,6 +98,9 @@ namespace wl {
     struct gbm_bo *current_bo {nullptr};
     struct wl_buffer *current_wl_buffer {nullptr};
     bool y_invert {false};
+
+    // Set once a frame has been copied, later frames only need to be copied when something changed
+    bool frame_copied {false};
   };
 
   class monitor_t {
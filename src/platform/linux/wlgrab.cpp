@@ -87,10 +87,18 @@ namespace wl {
     }
 
     inline platf::capture_e snapshot(const pull_free_image_cb_t &pull_free_image_cb, std::shared_ptr<platf::img_t> &img_out, std::chrono::milliseconds timeout, bool cursor) {
+      // A copy with damage stays pending until something changes, so it's kept across calls and
+      // only waited on for a frame at a time, to leave the capture loop responsive on an idle output
+      if (dmabuf.status != dmabuf_t::WAITING) {
+        dmabuf.listen(interface.screencopy_manager, interface.dmabuf_interface, output, cursor);
+      }
+      if (dmabuf.with_damage) {
+        timeout = std::min(timeout, std::chrono::duration_cast<std::chrono::milliseconds>(delay));
+      }
+
       auto to = std::chrono::steady_clock::now() + timeout;
 
       // Dispatch events until we get a new frame or the timeout expires
-      dmabuf.listen(interface.screencopy_manager, interface.dmabuf_interface, output, cursor);
       do {
         auto remaining_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(to - std::chrono::steady_clock::now());
         if (remaining_time_ms.count() < 0 || !display.dispatch(remaining_time_ms)) {
@@ -9,6 +9,7 @@
 // plaform includes
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <X11/extensions/Xdamage.h>
 #include <X11/extensions/Xfixes.h>
 #include <X11/extensions/Xrandr.h>
 #include <X11/X.h>
@@ -49,6 +50,9 @@ namespace platf {
     _FN(CloseDisplay, int, (Display * display));
     _FN(Free, int, (void *data));
     _FN(InitThreads, Status, (void) );
+    _FN(Pending, int, (Display * display));
+    _FN(NextEvent, int, (Display * display, XEvent *event_return));
+    _FN(Sync, int, (Display * display, Bool discard));
 
     namespace rr {
       _FN(GetScreenResources, XRRScreenResources *, (Display * dpy, Window window));
@@ -123,6 +127,43 @@ namespace platf {
       }
     }  // namespace fix
 
+    namespace dmg {
+      _FN(QueryExtension, Bool, (Display * dpy, int *event_base_return, int *error_base_return));
+      _FN(Create, Damage, (Display * dpy, Drawable drawable, int level));
+      _FN(Destroy, void, (Display * dpy, Damage damage));
+      _FN(Subtract, void, (Display * dpy, Damage damage, XserverRegion repair, XserverRegion parts));
+
+      static int init() {
+        static void *handle {nullptr};
+        static bool funcs_loaded = false;
+
+        if (funcs_loaded) {
+          return 0;
+        }
+
+        if (!handle) {
+          handle = dyn::handle({"libXdamage.so.1", "libXdamage.so"});
+          if (!handle) {
+            return -1;
+          }
+        }
+
+        std::vector<std::tuple<dyn::apiproc *, const char *>> funcs {
+          {(dyn::apiproc *) &QueryExtension, "XDamageQueryExtension"},
+          {(dyn::apiproc *) &Create, "XDamageCreate"},
+          {(dyn::apiproc *) &Destroy, "XDamageDestroy"},
+          {(dyn::apiproc *) &Subtract, "XDamageSubtract"},
+        };
+
+        if (dyn::load(handle, funcs)) {
+          return -1;
+        }
+
+        funcs_loaded = true;
+        return 0;
+      }
+    }  // namespace dmg
+
     static int init() {
       static void *handle {nullptr};
       static bool funcs_loaded = false;
@@ -145,6 +186,9 @@ namespace platf {
         {(dyn::apiproc *) &Free, "XFree"},
         {(dyn::apiproc *) &CloseDisplay, "XCloseDisplay"},
         {(dyn::apiproc *) &InitThreads, "XInitThreads"},
+        {(dyn::apiproc *) &Pending, "XPending"},
+        {(dyn::apiproc *) &NextEvent, "XNextEvent"},
+        {(dyn::apiproc *) &Sync, "XSync"},
       };
 
       if (dyn::load(handle, funcs)) {
@@ -313,35 +357,35 @@ namespace platf {
     }
   };
 
-  static void blend_cursor(Display *display, img_t &img, int offsetX, int offsetY) {
+  static xcursor_t get_cursor(Display *display) {
     xcursor_t overlay {x11::fix::GetCursorImage(display)};
 
     if (!overlay) {
       BOOST_LOG(error) << "Couldn't get cursor from XFixesGetCursorImage"sv;
-      return;
     }
 
-    overlay->x -= overlay->xhot;
-    overlay->y -= overlay->yhot;
+    return overlay;
+  }
 
-    overlay->x -= offsetX;
-    overlay->y -= offsetY;
+  static void blend_cursor(const XFixesCursorImage &overlay, img_t &img, int offsetX, int offsetY) {
+    short overlay_x = overlay.x - overlay.xhot - offsetX;
+    short overlay_y = overlay.y - overlay.yhot - offsetY;
 
-    overlay->x = std::max((short) 0, overlay->x);
-    overlay->y = std::max((short) 0, overlay->y);
+    overlay_x = std::max((short) 0, overlay_x);
+    overlay_y = std::max((short) 0, overlay_y);
 
     auto pixels = (int *) img.data;
 
     auto screen_height = img.height;
     auto screen_width = img.width;
 
-    auto delta_height = std::min<uint16_t>(overlay->height, std::max(0, screen_height - overlay->y));
-    auto delta_width = std::min<uint16_t>(overlay->width, std::max(0, screen_width - overlay->x));
+    auto delta_height = std::min<uint16_t>(overlay.height, std::max(0, screen_height - overlay_y));
+    auto delta_width = std::min<uint16_t>(overlay.width, std::max(0, screen_width - overlay_x));
     for (auto y = 0; y < delta_height; ++y) {
-      auto overlay_begin = &overlay->pixels[y * overlay->width];
-      auto overlay_end = &overlay->pixels[y * overlay->width + delta_width];
+      auto overlay_begin = &overlay.pixels[y * overlay.width];
+      auto overlay_end = &overlay.pixels[y * overlay.width + delta_width];
 
-      auto pixels_begin = &pixels[(y + overlay->y) * (img.row_pitch / img.pixel_pitch) + overlay->x];
+      auto pixels_begin = &pixels[(y + overlay_y) * (img.row_pitch / img.pixel_pitch) + overlay_x];
 
       std::for_each(overlay_begin, overlay_end, [&](long pixel) {
         int *pixel_p = (int *) &pixel;
@@ -362,6 +406,12 @@ namespace platf {
     }
   }
 
+  static void blend_cursor(Display *display, img_t &img, int offsetX, int offsetY) {
+    if (auto overlay = get_cursor(display)) {
+      blend_cursor(*overlay, img, offsetX, offsetY);
+    }
+  }
+
   struct x11_attr_t: public display_t {
     std::chrono::nanoseconds delay;
 
@@ -371,6 +421,16 @@ namespace platf {
 
     mem_type_e mem_type;
 
+    // Damage of the root window, if the X server supports XDamage
+    std::optional<Damage> damage;
+    int damage_event_base;
+
+    // The first capture always counts as damaged
+    bool damage_pending {true};
+
+    // Position and shape of the cursor blended into the previous capture
+    std::optional<std::tuple<short, short, unsigned long>> captured_cursor;
+
     /**
      * Last X (NOT the streamed monitor!) size.
      * This way we can trigger reinitialization if the dimensions changed while streaming
@@ -385,6 +445,12 @@ namespace platf {
       x11::InitThreads();
     }
 
+    ~x11_attr_t() override {
+      if (damage) {
+        x11::dmg::Destroy(xdisplay.get(), *damage);
+      }
+    }
+
     int init(const std::string &display_name, const ::video::config_t &config) {
       if (!xdisplay) {
         BOOST_LOG(error) << "Could not open X11 display"sv;
@@ -446,9 +512,55 @@ namespace platf {
       env_width = xattr.width;
       env_height = xattr.height;
 
+      int damage_error_base;
+      if (!x11::dmg::init() && x11::dmg::QueryExtension(xdisplay.get(), &damage_event_base, &damage_error_base)) {
+        damage = x11::dmg::Create(xdisplay.get(), xwindow, XDamageReportNonEmpty);
+      } else {
+        BOOST_LOG(info) << "XDamage is not available, every frame will be captured"sv;
+      }
+
       return 0;
     }
 
+    /**
+     * @brief Check whether the captured image may have changed since the previous capture.
+     * @details Without XDamage every capture counts as damaged.
+     * @param overlay The cursor that will be blended into the image, if any.
+     * @return `true` if the image must be captured again.
+     */
+    bool take_damage(const XFixesCursorImage *overlay) {
+      bool damaged = damage_pending || !damage;
+      damage_pending = false;
+
+      // The damage is reported once whenever the damaged region stops being empty
+      while (damage && x11::Pending(xdisplay.get())) {
+        XEvent event;
+        x11::NextEvent(xdisplay.get(), &event);
+
+        if (event.type == damage_event_base + XDamageNotify) {
+          damaged = true;
+        }
+      }
+
+      // Empty the damaged region before capturing, so anything drawn afterwards is reported again.
+      // The image may be requested on another connection, so the server must have processed this first.
+      if (damage && damaged) {
+        x11::dmg::Subtract(xdisplay.get(), *damage, None, None);
+        x11::Sync(xdisplay.get(), False);
+      }
+
+      std::optional<std::tuple<short, short, unsigned long>> cursor;
+      if (overlay) {
+        cursor.emplace(overlay->x, overlay->y, overlay->cursor_serial);
+      }
+      if (cursor != captured_cursor) {
+        captured_cursor = cursor;
+        damaged = true;
+      }
+
+      return damaged;
+    }
+
     /**
      * Called when the display attributes should change.
      */
@@ -510,26 +622,38 @@ namespace platf {
         return capture_e::reinit;
       }
 
+      xcursor_t overlay;
+      if (cursor) {
+        overlay = get_cursor(xdisplay.get());
+      }
+
+      if (!take_damage(overlay.get())) {
+        return capture_e::timeout;
+      }
+
       if (!pull_free_image_cb(img_out)) {
         return platf::capture_e::interrupted;
       }
-      auto img = (x11_img_t *) img_out.get();
 
+      grab(*(x11_img_t *) img_out.get(), overlay.get());
+
+      return capture_e::ok;
+    }
+
+    void grab(x11_img_t &img, const XFixesCursorImage *overlay) {
       XImage *x_img {x11::GetImage(xdisplay.get(), xwindow, offset_x, offset_y, width, height, AllPlanes, ZPixmap)};
-      img->frame_timestamp = std::chrono::steady_clock::now();
+      img.frame_timestamp = std::chrono::steady_clock::now();
 
-      img->width = x_img->width;
-      img->height = x_img->height;
-      img->data = (uint8_t *) x_img->data;
-      img->row_pitch = x_img->bytes_per_line;
-      img->pixel_pitch = x_img->bits_per_pixel / 8;
-      img->img.reset(x_img);
+      img.width = x_img->width;
+      img.height = x_img->height;
+      img.data = (uint8_t *) x_img->data;
+      img.row_pitch = x_img->bytes_per_line;
+      img.pixel_pitch = x_img->bits_per_pixel / 8;
+      img.img.reset(x_img);
 
-      if (cursor) {
-        blend_cursor(xdisplay.get(), *img, offset_x, offset_y);
+      if (overlay) {
+        blend_cursor(*overlay, img, offset_x, offset_y);
       }
-
-      return capture_e::ok;
     }
 
     std::shared_ptr<img_t> alloc_img() override {
@@ -557,12 +681,10 @@ namespace platf {
       if (!img) {
         return -1;
       };
-      auto pull_dummy_img_callback = [&img](std::shared_ptr<platf::img_t> &img_out) -> bool {
-        img_out = img->shared_from_this();
-        return true;
-      };
-      std::shared_ptr<platf::img_t> img_out;
-      snapshot(pull_dummy_img_callback, img_out, 0s, true);
+
+      // This runs on the encoding thread, so it must leave the damage of the capture thread alone
+      auto overlay = get_cursor(xdisplay.get());
+      grab(*(x11_img_t *) img, overlay.get());
       return 0;
     }
   };
@@ -646,6 +768,15 @@ namespace platf {
         BOOST_LOG(warning) << "X dimensions changed in SHM mode, request reinit"sv;
         return capture_e::reinit;
       } else {
+        xcursor_t overlay;
+        if (cursor) {
+          overlay = get_cursor(shm_xdisplay.get());
+        }
+
+        if (!take_damage(overlay.get())) {
+          return capture_e::timeout;
+        }
+
         auto img_cookie = xcb::shm_get_image_unchecked(xcb.get(), display->root, offset_x, offset_y, width, height, ~0, XCB_IMAGE_FORMAT_Z_PIXMAP, seg, 0);
         auto frame_timestamp = std::chrono::steady_clock::now();
 
@@ -662,8 +793,8 @@ namespace platf {
         std::copy_n((std::uint8_t *) data.data, frame_size(), img_out->data);
         img_out->frame_timestamp = frame_timestamp;
 
-        if (cursor) {
-          blend_cursor(shm_xdisplay.get(), *img_out, offset_x, offset_y);
+        if (overlay) {
+          blend_cursor(*overlay, *img_out, offset_x, offset_y);
         }
 
         return capture_e::ok;
@@ -2,6 +2,9 @@
  * @file src/platform/macos/display.mm
  * @brief Definitions for display capture on macOS.
  */
+// platform includes
+#include <sys/sysctl.h>
+
 // local includes
 #include "src/config.h"
 #include "src/logging.h"
@@ -215,4 +218,18 @@ namespace platf {
     // We don't track GPU state, so we will always reenumerate. Fortunately, it is fast on macOS.
     return true;
   }
+
+  std::vector<std::string> gpu_fingerprint() {
+    auto read_sysctl = [](const char *name) {
+      char value[256] {};
+      size_t size = sizeof(value) - 1;
+      if (sysctlbyname(name, value, &size, nullptr, 0)) {
+        return std::string {};
+      }
+      return std::string {value};
+    };
+
+    // The GPU is fixed for a given model and its drivers ship with the OS
+    return {read_sysctl("hw.model") + ' ' + read_sysctl("kern.osversion")};
+  }
 }  // namespace platf
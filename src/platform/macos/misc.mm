@@ -306,6 +306,11 @@ namespace platf {
     return false;
   }
 
+  int send_batch_wait() {
+    // Batches are never queued
+    return 0;
+  }
+
   bool send(send_info_t &send_info) {
     auto sockfd = (int) send_info.native_socket;
     struct msghdr msg = {};
@@ -406,6 +411,32 @@ namespace platf {
     return true;
   }
 
+  bool send_multiple(multi_send_info_t &send_info) {
+    // There is no system call for sending several messages at once
+    send_info.system_calls = 0;
+    for (size_t i = 0; i < send_info.message_count; i++) {
+      auto &message = send_info.messages[i];
+
+      send_info_t info {
+        message.header,
+        message.header_size,
+        message.payload,
+        message.payload_size,
+        send_info.native_socket,
+        send_info.target_address,
+        send_info.target_port,
+        send_info.source_address,
+      };
+
+      ++send_info.system_calls;
+      if (!send(info)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
   // We can't track QoS state separately for each destination on this OS,
   // so we keep a ref count to only disable QoS options when all clients
   // are disconnected.
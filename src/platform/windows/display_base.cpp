@@ -4,6 +4,7 @@
  */
 // standard includes
 #include <cmath>
+#include <sstream>
 #include <thread>
 
 // platform includes
@@ -1125,4 +1126,36 @@ namespace platf {
       return false;
     }
   }
+
+  std::vector<std::string> gpu_fingerprint() {
+    dxgi::factory1_t factory;
+    auto status = CreateDXGIFactory1(IID_IDXGIFactory1, (void **) &factory);
+    if (FAILED(status)) {
+      BOOST_LOG(error) << "Failed to create DXGIFactory1 [0x"sv << util::hex(status).to_string_view() << ']';
+      return {};
+    }
+
+    std::vector<std::string> gpus;
+
+    dxgi::adapter_t adapter;
+    for (int x = 0; factory->EnumAdapters1(x, &adapter) != DXGI_ERROR_NOT_FOUND; ++x) {
+      DXGI_ADAPTER_DESC1 adapter_desc;
+      adapter->GetDesc1(&adapter_desc);
+
+      // The user mode driver version changes with every driver update
+      LARGE_INTEGER driver_version {};
+      adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driver_version);
+
+      std::stringstream ss;
+      ss << util::hex(adapter_desc.VendorId).to_string_view() << ':'
+         << util::hex(adapter_desc.DeviceId).to_string_view() << ':'
+         << util::hex(adapter_desc.SubSysId).to_string_view() << ':'
+         << util::hex(adapter_desc.Revision).to_string_view() << ' '
+         << HIWORD(driver_version.HighPart) << '.' << LOWORD(driver_version.HighPart) << '.'
+         << HIWORD(driver_version.LowPart) << '.' << LOWORD(driver_version.LowPart);
+      gpus.emplace_back(ss.str());
+    }
+
+    return gpus;
+  }
 }  // namespace platf
@@ -1508,6 +1508,11 @@ namespace platf {
     return WSASendMsg((SOCKET) send_info.native_socket, &msg, 0, &bytes_sent, nullptr, nullptr) != SOCKET_ERROR;
   }
 
+  int send_batch_wait() {
+    // Batches are always sent synchronously
+    return 0;
+  }
+
   bool send(send_info_t &send_info) {
     WSAMSG msg;
 
@@ -1588,6 +1593,32 @@ namespace platf {
     return true;
   }
 
+  bool send_multiple(multi_send_info_t &send_info) {
+    // There is no system call for sending several messages at once
+    send_info.system_calls = 0;
+    for (size_t i = 0; i < send_info.message_count; i++) {
+      auto &message = send_info.messages[i];
+
+      send_info_t info {
+        message.header,
+        message.header_size,
+        message.payload,
+        message.payload_size,
+        send_info.native_socket,
+        send_info.target_address,
+        send_info.target_port,
+        send_info.source_address,
+      };
+
+      ++send_info.system_calls;
+      if (!send(info)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
   class qos_t: public deinit_t {
   public:
     qos_t(QOS_FLOWID flow_id):
@@ -117,30 +117,159 @@ reed_solomon_release_t reed_solomon_release_fn;
 reed_solomon_encode_t reed_solomon_encode_fn;
 reed_solomon_decode_t reed_solomon_decode_fn;
 
+static const char *reed_solomon_isa_name;
+
+#if defined(__x86_64) || defined(__x86_64__) || defined(__amd64) || defined(__amd64__) || defined(_M_AMD64)
+  #include <immintrin.h>
+  #include <string.h>
+
+  #define GFNI_TARGET __attribute__((target("avx512f,avx512bw,gfni")))
+
+// GF2P8AFFINEQB matrices for multiplying by each GF(2^8) constant
+static uint64_t gfni_mul_matrices[256];
+
+/**
+ * @brief Encode parity shards using GFNI affine transforms in place of table lookups.
+ * @details Multiplication by a constant is linear over GF(2), so it can be expressed as an 8x8 bit
+ *          matrix regardless of the field polynomial. This keeps the output identical to nanors.
+ */
+GFNI_TARGET static int reed_solomon_encode_gfni(reed_solomon *rs, uint8_t **shards, int nr_shards, int bs) {
+  if (nr_shards < rs->ds + rs->ps) {
+    return -1;
+  }
+
+  uint8_t **data = shards;
+  uint8_t **parity = shards + rs->ds;
+
+  for (int offset = 0; offset < bs; offset += 64) {
+    __mmask64 mask = bs - offset >= 64 ? ~(__mmask64) 0 : ((__mmask64) 1 << (bs - offset)) - 1;
+
+    for (int row = 0; row < rs->ps; row++) {
+      const uint8_t *coefficients = &rs->p[row * rs->ds];
+
+      __m512i acc = _mm512_setzero_si512();
+      for (int col = 0; col < rs->ds; col++) {
+        __m512i in = _mm512_maskz_loadu_epi8(mask, data[col] + offset);
+        __m512i matrix = _mm512_set1_epi64((long long) gfni_mul_matrices[coefficients[col]]);
+        acc = _mm512_xor_si512(acc, _mm512_gf2p8affine_epi64_epi8(in, matrix, 0));
+      }
+
+      _mm512_mask_storeu_epi8(parity[row] + offset, mask, acc);
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Derive the GFNI multiplication matrices from the default codec and verify the GFNI encoder against it.
+ * @return 0 if the GFNI encoder produces identical parity, -1 otherwise.
+ */
+static int reed_solomon_init_gfni(void) {
+  reed_solomon_init_def();
+
+  // Multiply each power of two by every constant to obtain the columns of its matrix
+  reed_solomon *rs = reed_solomon_new_def(1, 1);
+  if (!rs) {
+    return -1;
+  }
+
+  uint8_t basis[8];
+  uint8_t products[8];
+  uint8_t *shards[2] = {basis, products};
+  for (int bit = 0; bit < 8; bit++) {
+    basis[bit] = 1 << bit;
+  }
+
+  for (int c = 0; c < 256; c++) {
+    rs->p[0] = c;
+    reed_solomon_encode_def(rs, shards, 2, sizeof(basis));
+
+    // Row i of the matrix (stored in byte 7 - i) selects the input bits contributing to output bit i
+    uint64_t matrix = 0;
+    for (int out_bit = 0; out_bit < 8; out_bit++) {
+      uint8_t row = 0;
+      for (int in_bit = 0; in_bit < 8; in_bit++) {
+        row |= ((products[in_bit] >> out_bit) & 1) << in_bit;
+      }
+      matrix |= (uint64_t) row << (8 * (7 - out_bit));
+    }
+    gfni_mul_matrices[c] = matrix;
+  }
+  reed_solomon_release_def(rs);
+
+  // Compare against the default codec with a shard size that exercises the masked tail
+  enum {
+    data_shards = 5,
+    parity_shards = 3,
+    block_size = 100
+  };
+
+  uint8_t buffers[data_shards + 2 * parity_shards][block_size];
+  uint8_t *expected[data_shards + parity_shards];
+  uint8_t *actual[data_shards + parity_shards];
+  for (int x = 0; x < data_shards; x++) {
+    for (int y = 0; y < block_size; y++) {
+      buffers[x][y] = (uint8_t) (x * 31 + y * 7 + 1);
+    }
+    expected[x] = actual[x] = buffers[x];
+  }
+  for (int x = 0; x < parity_shards; x++) {
+    expected[data_shards + x] = buffers[data_shards + x];
+    actual[data_shards + x] = buffers[data_shards + parity_shards + x];
+  }
+
+  rs = reed_solomon_new_def(data_shards, parity_shards);
+  if (!rs) {
+    return -1;
+  }
+
+  int result = -1;
+  if (reed_solomon_encode_def(rs, expected, data_shards + parity_shards, block_size) == 0 &&
+      reed_solomon_encode_gfni(rs, actual, data_shards + parity_shards, block_size) == 0) {
+    result = memcmp(buffers[data_shards], buffers[data_shards + parity_shards], parity_shards * block_size) ? -1 : 0;
+  }
+  reed_solomon_release_def(rs);
+
+  return result;
+}
+#endif
+
 /**
  * @brief This initializes the RS function pointers to the best vectorized version available.
  * @details The streaming code will directly invoke these function pointers during encoding.
  */
 void reed_solomon_init(void) {
 #if defined(__x86_64) || defined(__x86_64__) || defined(__amd64) || defined(__amd64__) || defined(_M_AMD64)
-  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("gfni") && reed_solomon_init_gfni() == 0) {
+    // Only encoding is on the streaming path, so the rest comes from the AVX-512 variant
+    reed_solomon_new_fn = reed_solomon_new_avx512;
+    reed_solomon_release_fn = reed_solomon_release_avx512;
+    reed_solomon_encode_fn = reed_solomon_encode_gfni;
+    reed_solomon_decode_fn = reed_solomon_decode_avx512;
+    reed_solomon_init_avx512();
+    reed_solomon_isa_name = "AVX-512 GFNI";
+  } else if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
     reed_solomon_new_fn = reed_solomon_new_avx512;
     reed_solomon_release_fn = reed_solomon_release_avx512;
     reed_solomon_encode_fn = reed_solomon_encode_avx512;
     reed_solomon_decode_fn = reed_solomon_decode_avx512;
     reed_solomon_init_avx512();
+    reed_solomon_isa_name = "AVX-512";
   } else if (__builtin_cpu_supports("avx2")) {
     reed_solomon_new_fn = reed_solomon_new_avx2;
     reed_solomon_release_fn = reed_solomon_release_avx2;
     reed_solomon_encode_fn = reed_solomon_encode_avx2;
     reed_solomon_decode_fn = reed_solomon_decode_avx2;
     reed_solomon_init_avx2();
+    reed_solomon_isa_name = "AVX2";
   } else if (__builtin_cpu_supports("ssse3")) {
     reed_solomon_new_fn = reed_solomon_new_ssse3;
     reed_solomon_release_fn = reed_solomon_release_ssse3;
     reed_solomon_encode_fn = reed_solomon_encode_ssse3;
     reed_solomon_decode_fn = reed_solomon_decode_ssse3;
     reed_solomon_init_ssse3();
+    reed_solomon_isa_name = "SSSE3";
   } else
 #endif
   {
@@ -149,5 +278,15 @@ void reed_solomon_init(void) {
     reed_solomon_encode_fn = reed_solomon_encode_def;
     reed_solomon_decode_fn = reed_solomon_decode_def;
     reed_solomon_init_def();
+#if defined(__ARM_NEON) || defined(__aarch64__)
+    // NEON is part of the baseline, so the default variant is already vectorized
+    reed_solomon_isa_name = "NEON";
+#else
+    reed_solomon_isa_name = "generic";
+#endif
   }
 }
+
+const char *reed_solomon_isa(void) {
+  return reed_solomon_isa_name;
+}
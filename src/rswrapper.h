@@ -30,3 +30,9 @@ extern reed_solomon_decode_t reed_solomon_decode_fn;
  * @details The streaming code will directly invoke these function pointers during encoding.
  */
 void reed_solomon_init(void);
+
+/**
+ * @brief Get the name of the instruction set used by the selected RS implementation.
+ * @return The instruction set name, or `NULL` before `reed_solomon_init()` is called.
+ */
+const char *reed_solomon_isa(void);
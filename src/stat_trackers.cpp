@@ -2,9 +2,16 @@
  * @file src/stat_trackers.cpp
  * @brief Definitions for streaming statistic tracking.
  */
+// standard includes
+#include <bit>
+#include <cmath>
+#include <string_view>
+
 // local includes
 #include "stat_trackers.h"
 
+using namespace std::literals;
+
 namespace stat_trackers {
 
   boost::format one_digit_after_decimal() {
@@ -15,4 +22,225 @@ namespace stat_trackers {
     return boost::format("%1$.2f");
   }
 
+  void latency_histogram_t::record(std::chrono::microseconds value) {
+    auto us = (std::uint64_t) std::max<std::int64_t>(value.count(), 0);
+
+    ++buckets[bucket_index(us)];
+    ++total;
+    max_value = std::max(max_value, us);
+  }
+
+  std::chrono::microseconds latency_histogram_t::percentile(double percentile) const {
+    if (!total) {
+      return 0us;
+    }
+
+    auto target = std::max<std::uint64_t>(1, (std::uint64_t) std::ceil(percentile / 100.0 * total));
+
+    std::uint64_t seen = 0;
+    for (std::size_t x = 0; x < buckets.size(); ++x) {
+      seen += buckets[x];
+      if (seen >= target) {
+        return std::chrono::microseconds(std::min(bucket_value(x), max_value));
+      }
+    }
+
+    return max();
+  }
+
+  void latency_histogram_t::reset() {
+    buckets.fill(0);
+    total = 0;
+    max_value = 0;
+  }
+
+  std::size_t latency_histogram_t::bucket_index(std::uint64_t value) {
+    if (value < sub_buckets) {
+      return value;
+    }
+
+    // Keep the top sub_bucket_bits + 1 bits of the value
+    auto shift = std::bit_width(value) - (sub_bucket_bits + 1);
+    return (shift + 1) * sub_buckets + (value >> shift) - sub_buckets;
+  }
+
+  std::uint64_t latency_histogram_t::bucket_value(std::size_t index) {
+    if (index < sub_buckets) {
+      return index;
+    }
+
+    // The largest value that falls into the bucket
+    auto shift = index / sub_buckets - 1;
+    auto lowest = (std::uint64_t) (index % sub_buckets + sub_buckets) << shift;
+    return lowest + ((std::uint64_t) 1 << shift) - 1;
+  }
+
+  namespace {
+    struct stage_t {
+      std::string_view name;
+      std::chrono::steady_clock::time_point frame_trace_t::*begin;
+      std::chrono::steady_clock::time_point frame_trace_t::*end;
+    };
+
+    constexpr std::array<stage_t, frame_latency_tracker_t::stage_count> stages {{
+      {"convert"sv, &frame_trace_t::captured, &frame_trace_t::converted},
+      {"encode_queue"sv, &frame_trace_t::converted, &frame_trace_t::encode_submitted},
+      {"encode"sv, &frame_trace_t::encode_submitted, &frame_trace_t::encoded},
+      {"packetize"sv, &frame_trace_t::encoded, &frame_trace_t::first_sent},
+      {"send"sv, &frame_trace_t::first_sent, &frame_trace_t::last_sent},
+      {"total"sv, &frame_trace_t::captured, &frame_trace_t::last_sent},
+    }};
+
+    constexpr std::size_t max_recent_traces = 1024;
+
+    nlohmann::json histogram_stats(const latency_histogram_t &histogram) {
+      return {
+        {"count", histogram.count()},
+        {"p50_us", histogram.percentile(50).count()},
+        {"p90_us", histogram.percentile(90).count()},
+        {"p99_us", histogram.percentile(99).count()},
+        {"max_us", histogram.max().count()},
+      };
+    }
+
+    std::int64_t to_us(std::chrono::steady_clock::time_point point) {
+      return std::chrono::duration_cast<std::chrono::microseconds>(point.time_since_epoch()).count();
+    }
+  }  // namespace
+
+  void frame_latency_tracker_t::record(std::int64_t frame_index, const frame_trace_t &trace) {
+    std::lock_guard lg {lock};
+
+    for (std::size_t x = 0; x < stages.size(); ++x) {
+      auto begin = trace.*stages[x].begin;
+      auto end = trace.*stages[x].end;
+
+      if (begin.time_since_epoch().count() && end.time_since_epoch().count()) {
+        histograms[x].record(std::chrono::duration_cast<std::chrono::microseconds>(end - begin));
+      }
+    }
+
+    if (recent.size() < max_recent_traces) {
+      recent.emplace_back(frame_index, trace);
+    } else {
+      recent[recent_next] = {frame_index, trace};
+    }
+    recent_next = (recent_next + 1) % max_recent_traces;
+  }
+
+  nlohmann::json frame_latency_tracker_t::stats() {
+    std::lock_guard lg {lock};
+
+    nlohmann::json output = nlohmann::json::object();
+    for (std::size_t x = 0; x < stages.size(); ++x) {
+      output[std::string {stages[x].name}] = histogram_stats(histograms[x]);
+    }
+
+    return output;
+  }
+
+  nlohmann::json frame_latency_tracker_t::chrome_trace() {
+    std::lock_guard lg {lock};
+
+    auto events = nlohmann::json::array();
+
+    // Show each stage on its own row, the total is implied by the rows together
+    for (std::size_t x = 0; x + 1 < stages.size(); ++x) {
+      events.push_back({
+        {"name", "thread_name"},
+        {"ph", "M"},
+        {"pid", 1},
+        {"tid", x + 1},
+        {"args", {{"name", stages[x].name}}},
+      });
+    }
+
+    for (auto &[frame_index, trace] : recent) {
+      for (std::size_t x = 0; x + 1 < stages.size(); ++x) {
+        auto begin = trace.*stages[x].begin;
+        auto end = trace.*stages[x].end;
+
+        if (!begin.time_since_epoch().count() || !end.time_since_epoch().count()) {
+          continue;
+        }
+
+        events.push_back({
+          {"name", stages[x].name},
+          {"ph", "X"},
+          {"pid", 1},
+          {"tid", x + 1},
+          {"ts", to_us(begin)},
+          {"dur", to_us(end) - to_us(begin)},
+          {"args", {{"frame", frame_index}}},
+        });
+      }
+    }
+
+    return {
+      {"traceEvents", std::move(events)},
+      {"displayTimeUnit", "ms"},
+    };
+  }
+
+  void frame_latency_tracker_t::reset() {
+    std::lock_guard lg {lock};
+
+    for (auto &histogram : histograms) {
+      histogram.reset();
+    }
+    recent.clear();
+    recent_next = 0;
+  }
+
+  frame_latency_tracker_t &frame_latency() {
+    static frame_latency_tracker_t tracker;
+    return tracker;
+  }
+
+  void latency_tracker_t::record(std::chrono::microseconds value) {
+    std::lock_guard lg {lock};
+    histogram.record(value);
+  }
+
+  nlohmann::json latency_tracker_t::stats() {
+    std::lock_guard lg {lock};
+    return histogram_stats(histogram);
+  }
+
+  void latency_tracker_t::reset() {
+    std::lock_guard lg {lock};
+    histogram.reset();
+  }
+
+  latency_tracker_t &input_latency() {
+    static latency_tracker_t tracker;
+    return tracker;
+  }
+
+  void send_syscall_tracker_t::record(std::uint64_t packets, std::uint64_t system_calls) {
+    this->packets.fetch_add(packets, std::memory_order_relaxed);
+    this->system_calls.fetch_add(system_calls, std::memory_order_relaxed);
+  }
+
+  nlohmann::json send_syscall_tracker_t::stats() const {
+    auto packets = this->packets.load(std::memory_order_relaxed);
+    auto system_calls = this->system_calls.load(std::memory_order_relaxed);
+
+    return {
+      {"packets", packets},
+      {"system_calls", system_calls},
+      {"system_calls_per_packet", packets ? (double) system_calls / packets : 0.0},
+    };
+  }
+
+  void send_syscall_tracker_t::reset() {
+    packets.store(0, std::memory_order_relaxed);
+    system_calls.store(0, std::memory_order_relaxed);
+  }
+
+  send_syscall_tracker_t &audio_sends() {
+    static send_syscall_tracker_t tracker;
+    return tracker;
+  }
+
 }  // namespace stat_trackers
@@ -5,12 +5,18 @@
 #pragma once
 
 // standard includes
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <limits>
+#include <mutex>
+#include <vector>
 
 // lib includes
 #include <boost/format.hpp>
+#include <nlohmann/json.hpp>
 
 namespace stat_trackers {
 
@@ -50,4 +56,155 @@ namespace stat_trackers {
     } data;
   };
 
+  /**
+   * @brief A histogram of durations with logarithmic buckets, in the spirit of HdrHistogram.
+   * @details Every power of two is split into 32 linear buckets, so percentiles are precise to about 3%
+   *          without storing the recorded values.
+   */
+  class latency_histogram_t {
+  public:
+    void record(std::chrono::microseconds value);
+
+    /**
+     * @brief Get the smallest value that the given percentage of recorded values does not exceed.
+     * @param percentile The percentile, between 0 and 100.
+     * @return The value, or 0 if nothing was recorded.
+     */
+    std::chrono::microseconds percentile(double percentile) const;
+
+    std::chrono::microseconds max() const {
+      return std::chrono::microseconds(max_value);
+    }
+
+    std::uint64_t count() const {
+      return total;
+    }
+
+    void reset();
+
+  private:
+    static constexpr int sub_bucket_bits = 5;
+    static constexpr int sub_buckets = 1 << sub_bucket_bits;
+
+    static std::size_t bucket_index(std::uint64_t value);
+    static std::uint64_t bucket_value(std::size_t index);
+
+    std::array<std::uint64_t, (64 - sub_bucket_bits + 1) * sub_buckets> buckets {};
+    std::uint64_t total = 0;
+    std::uint64_t max_value = 0;
+  };
+
+  /**
+   * @brief The time at which a video frame finished each stage of the pipeline.
+   * @details Stages a frame skipped are left at the epoch, e.g. `captured` and `converted`
+   *          when the encoder repeats the previous image.
+   */
+  struct frame_trace_t {
+    std::chrono::steady_clock::time_point captured;
+    std::chrono::steady_clock::time_point converted;
+    std::chrono::steady_clock::time_point encode_submitted;
+    std::chrono::steady_clock::time_point encoded;
+    std::chrono::steady_clock::time_point first_sent;
+    std::chrono::steady_clock::time_point last_sent;
+  };
+
+  /**
+   * @brief Latency histograms for every stage of the video pipeline, fed with the trace of each sent frame.
+   */
+  class frame_latency_tracker_t {
+  public:
+    static constexpr std::size_t stage_count = 6;
+
+    /**
+     * @brief Add the trace of a frame once its last packet was sent.
+     * @param frame_index The frame index, used to label the frame in the Chrome trace.
+     * @param trace The trace of the frame.
+     */
+    void record(std::int64_t frame_index, const frame_trace_t &trace);
+
+    /**
+     * @brief Summarize each stage since the last reset.
+     * @return Percentiles and maximum of every stage in microseconds.
+     */
+    nlohmann::json stats();
+
+    /**
+     * @brief Export the most recent frames in the Chrome trace event format.
+     * @return A JSON object that can be loaded by chrome://tracing or Perfetto.
+     */
+    nlohmann::json chrome_trace();
+
+    void reset();
+
+  private:
+    std::mutex lock;
+
+    std::array<latency_histogram_t, stage_count> histograms;
+
+    // The most recent traces, overwritten in a circle
+    std::vector<std::pair<std::int64_t, frame_trace_t>> recent;
+    std::size_t recent_next = 0;
+  };
+
+  /**
+   * @brief Get the tracker of all video streams.
+   */
+  frame_latency_tracker_t &frame_latency();
+
+  /**
+   * @brief A latency histogram that any thread may record into.
+   */
+  class latency_tracker_t {
+  public:
+    void record(std::chrono::microseconds value);
+
+    /**
+     * @brief Summarize the recorded values since the last reset.
+     * @return The count, percentiles and maximum in microseconds.
+     */
+    nlohmann::json stats();
+
+    void reset();
+
+  private:
+    std::mutex lock;
+    latency_histogram_t histogram;
+  };
+
+  /**
+   * @brief Get the tracker of the time from receiving an input message to injecting it, of all sessions.
+   */
+  latency_tracker_t &input_latency();
+
+  /**
+   * @brief Counts sent packets and the system calls that carried them, to tell how well sends are batched.
+   * @details The counters are updated with relaxed atomics, so any thread may record sends.
+   */
+  class send_syscall_tracker_t {
+  public:
+    /**
+     * @brief Add packets that were sent together.
+     * @param packets The number of packets.
+     * @param system_calls The number of system calls it took to send them.
+     */
+    void record(std::uint64_t packets, std::uint64_t system_calls);
+
+    /**
+     * @brief Summarize the sends since the last reset.
+     * @return The packet and system call counts, and the system calls per packet.
+     */
+    nlohmann::json stats() const;
+
+    void reset();
+
+  private:
+    std::atomic<std::uint64_t> packets {};
+    std::atomic<std::uint64_t> system_calls {};
+  };
+
+  /**
+   * @brief Get the tracker of audio packet sends of all streams.
+   */
+  send_syscall_tracker_t &audio_sends();
+
 }  // namespace stat_trackers
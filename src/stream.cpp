@@ -20,9 +20,11 @@ extern "C" {
 }
 
 // local includes
+#include "adaptive_bitrate.h"
 #include "config.h"
 #include "crypto.h"
 #include "display_device.h"
+#include "fec.h"
 #include "globals.h"
 #include "input.h"
 #include "logging.h"
@@ -32,6 +34,7 @@ extern "C" {
 #include "stream.h"
 #include "sync.h"
 #include "system_tray.h"
+#include "thread_pool.h"
 #include "thread_safe.h"
 #include "utility.h"
 
@@ -145,6 +148,9 @@ namespace stream {
     RTP_PACKET rtp;
   };
 
+  // There are 2 bits for FEC block count for a maximum of 4 FEC blocks
+  constexpr auto MAX_FEC_BLOCKS = 4;
+
   struct control_header_v2 {
     std::uint16_t type;
     std::uint16_t payloadLength;
@@ -372,9 +378,16 @@ namespace stream {
       std::optional<crypto::cipher::gcm_t> cipher;
       std::uint64_t gcm_iv_counter;
 
+      // Cipher contexts for FEC blocks after the first, so blocks can be encrypted concurrently
+      std::array<std::optional<crypto::cipher::gcm_t>, MAX_FEC_BLOCKS - 1> block_ciphers;
+
       safe::mail_raw_t::event_t<bool> idr_events;
       safe::mail_raw_t::event_t<std::pair<int64_t, int64_t>> invalidate_ref_frames_events;
 
+      // Congestion control, when adaptive bitrate is enabled
+      std::optional<adaptive_bitrate_t> adaptive_bitrate;
+      safe::mail_raw_t::event_t<int> bitrate_events;
+
       std::unique_ptr<platf::deinit_t> qos;
     } video;
 
@@ -615,115 +628,50 @@ namespace stream {
     }
   }
 
-  namespace fec {
-    using rs_t = util::safe_ptr<reed_solomon, [](reed_solomon *rs) {
-      reed_solomon_release(rs);
-    }>;
-
-    struct fec_t {
-      size_t data_shards;
-      size_t nr_shards;
-      size_t percentage;
-
-      size_t blocksize;
-      size_t prefixsize;
-      util::buffer_t<char> shards;
-      util::buffer_t<char> headers;
-      util::buffer_t<uint8_t *> shards_p;
-
-      std::vector<platf::buffer_descriptor_t> payload_buffers;
-
-      char *data(size_t el) {
-        return (char *) shards_p[el];
-      }
-
-      char *prefix(size_t el) {
-        return prefixsize ? &headers[el * prefixsize] : nullptr;
-      }
-
-      size_t size() const {
-        return nr_shards;
-      }
-    };
-
-    static fec_t encode(const std::string_view &payload, size_t blocksize, size_t fecpercentage, size_t minparityshards, size_t prefixsize) {
-      auto payload_size = payload.size();
-
-      auto pad = payload_size % blocksize != 0;
-
-      auto aligned_data_shards = payload_size / blocksize;
-      auto data_shards = aligned_data_shards + (pad ? 1 : 0);
-      auto parity_shards = (data_shards * fecpercentage + 99) / 100;
-
-      // increase the FEC percentage for this frame if the parity shard minimum is not met
-      if (parity_shards < minparityshards && fecpercentage != 0) {
-        parity_shards = minparityshards;
-        fecpercentage = (100 * parity_shards) / data_shards;
-
-        BOOST_LOG(verbose) << "Increasing FEC percentage to "sv << fecpercentage << " to meet parity shard minimum"sv << std::endl;
-      }
+  /**
+   * @brief Gathers payload segments into a buffer and inserts zeroed space at each slice boundary of the result.
+   * @details The destination buffer is resized in place, so a buffer reused across frames
+   *          stops allocating once it has grown to the largest frame size.
+   * @param insert_size The number of bytes to insert.
+   * @param slice_size The number of bytes between insertions.
+   * @param segments The data segments, in order.
+   * @param dest The destination buffer.
+   */
+  void gather_and_insert(uint64_t insert_size, uint64_t slice_size, const std::vector<std::string_view> &segments, std::vector<uint8_t> &dest) {
+    size_t data_size = 0;
+    for (auto &segment : segments) {
+      data_size += segment.size();
+    }
 
-      auto nr_shards = data_shards + parity_shards;
-
-      // If we need to store a zero-padded data shard, allocate that first to
-      // to keep the shards in order and reduce buffer fragmentation
-      auto parity_shard_offset = pad ? 1 : 0;
-      util::buffer_t<char> shards {(parity_shard_offset + parity_shards) * blocksize};
-      util::buffer_t<uint8_t *> shards_p {nr_shards};
-      std::vector<platf::buffer_descriptor_t> payload_buffers;
-      payload_buffers.reserve(2);
-
-      // Point into the payload buffer for all except the final padded data shard
-      auto next = std::begin(payload);
-      for (auto x = 0; x < aligned_data_shards; ++x) {
-        shards_p[x] = (uint8_t *) next;
-        next += blocksize;
-      }
-      payload_buffers.emplace_back(std::begin(payload), aligned_data_shards * blocksize);
-
-      // If the last data shard needs to be zero-padded, we must use the shards buffer
-      if (pad) {
-        shards_p[aligned_data_shards] = (uint8_t *) &shards[0];
-
-        // GCC doesn't figure out that std::copy_n() can be replaced with memcpy() here
-        // and ends up compiling a horribly slow element-by-element copy loop, so we
-        // help it by using memcpy()/memset() directly.
-        auto copy_len = std::min<size_t>(blocksize, std::end(payload) - next);
-        std::memcpy(shards_p[aligned_data_shards], next, copy_len);
-        if (copy_len < blocksize) {
-          // Zero any additional space after the end of the payload
-          std::memset(shards_p[aligned_data_shards] + copy_len, 0, blocksize - copy_len);
-        }
-      }
+    auto elements = (data_size + (slice_size - 1)) / slice_size;
+    dest.resize(elements * insert_size + data_size);
 
-      // Add a payload buffer describing the shard buffer
-      payload_buffers.emplace_back(std::begin(shards), shards.size());
+    auto out = dest.data();
+    auto segment = std::begin(segments);
+    size_t segment_offset = 0;
+    for (size_t x = 0; x < elements; ++x) {
+      // The destination may hold stale data from a previous frame
+      std::memset(out, 0, insert_size);
+      out += insert_size;
 
-      if (fecpercentage != 0) {
-        // Point into our allocated buffer for the parity shards
-        for (auto x = 0; x < parity_shards; ++x) {
-          shards_p[data_shards + x] = (uint8_t *) &shards[(parity_shard_offset + x) * blocksize];
+      // For the last iteration, only copy to the end of the data
+      auto remaining = std::min<size_t>(slice_size, data_size - x * slice_size);
+      while (remaining > 0) {
+        auto available = segment->size() - segment_offset;
+        if (available == 0) {
+          ++segment;
+          segment_offset = 0;
+          continue;
         }
 
-        // packets = parity_shards + data_shards
-        rs_t rs {reed_solomon_new(data_shards, parity_shards)};
-
-        reed_solomon_encode(rs.get(), shards_p.begin(), nr_shards, blocksize);
+        auto copy_len = std::min(available, remaining);
+        std::memcpy(out, segment->data() + segment_offset, copy_len);
+        out += copy_len;
+        segment_offset += copy_len;
+        remaining -= copy_len;
       }
-
-      return {
-        data_shards,
-        nr_shards,
-        fecpercentage,
-        blocksize,
-        prefixsize,
-        std::move(shards),
-        util::buffer_t<char> {nr_shards * prefixsize},
-        std::move(shards_p),
-        std::move(payload_buffers),
-      };
     }
-  }  // namespace fec
+  }
 
   /**
    * @brief Combines two buffers and inserts new buffers at each slice boundary of the result.
@@ -733,58 +681,38 @@ namespace stream {
    * @param data2 The second data buffer.
    */
   std::vector<uint8_t> concat_and_insert(uint64_t insert_size, uint64_t slice_size, const std::string_view &data1, const std::string_view &data2) {
-    auto data_size = data1.size() + data2.size();
-    auto pad = data_size % slice_size != 0;
-    auto elements = data_size / slice_size + (pad ? 1 : 0);
-
     std::vector<uint8_t> result;
-    result.resize(elements * insert_size + data_size);
-
-    auto next = std::begin(data1);
-    auto end = std::end(data1);
-    for (auto x = 0; x < elements; ++x) {
-      void *p = &result[x * (insert_size + slice_size)];
-
-      // For the last iteration, only copy to the end of the data
-      if (x == elements - 1) {
-        slice_size = data_size - (x * slice_size);
-      }
-
-      // Test if this slice will extend into the next buffer
-      if (next + slice_size > end) {
-        // Copy the first portion from the first buffer
-        auto copy_len = end - next;
-        std::copy(next, end, (char *) p + insert_size);
-
-        // Copy the remaining portion from the second buffer
-        next = std::begin(data2);
-        end = std::end(data2);
-        std::copy(next, next + (slice_size - copy_len), (char *) p + copy_len + insert_size);
-        next += slice_size - copy_len;
-      } else {
-        std::copy(next, next + slice_size, (char *) p + insert_size);
-        next += slice_size;
-      }
-    }
+    gather_and_insert(insert_size, slice_size, {data1, data2}, result);
 
     return result;
   }
 
-  std::vector<uint8_t> replace(const std::string_view &original, const std::string_view &old, const std::string_view &_new) {
-    std::vector<uint8_t> replaced;
-    replaced.reserve(original.size() + _new.size() - old.size());
+  /**
+   * @brief Replaces the first occurrence of a byte sequence by splitting the segment containing it.
+   * @details Nothing is copied: the replacement is referenced as its own segment,
+   *          so it must outlive the segment list.
+   * @param segments The data segments, in order.
+   * @param old The byte sequence to replace.
+   * @param _new The replacement byte sequence.
+   * @return The change in total data size.
+   */
+  std::ptrdiff_t splice_replace(std::vector<std::string_view> &segments, const std::string_view &old, const std::string_view &_new) {
+    for (auto it = std::begin(segments); it != std::end(segments); ++it) {
+      auto pos = it->find(old);
+      if (pos == std::string_view::npos) {
+        continue;
+      }
+
+      auto after = it->substr(pos + old.size());
+      *it = it->substr(0, pos);
 
-    auto begin = std::begin(original);
-    auto end = std::end(original);
-    auto next = std::search(begin, end, std::begin(old), std::end(old));
+      it = segments.insert(it + 1, _new);
+      segments.insert(it + 1, after);
 
-    std::copy(begin, next, std::back_inserter(replaced));
-    if (next != end) {
-      std::copy(std::begin(_new), std::end(_new), std::back_inserter(replaced));
-      std::copy(next + old.size(), end, std::back_inserter(replaced));
+      return (std::ptrdiff_t) _new.size() - (std::ptrdiff_t) old.size();
     }
 
-    return replaced;
+    return 0;
   }
 
   /**
@@ -927,6 +855,22 @@ namespace stream {
     return 0;
   }
 
+  /**
+   * @brief Let the congestion control of a session know that the client lost frames.
+   * @param session The session.
+   * @param count The number of lost frames.
+   */
+  void report_frame_loss(session_t *session, int count) {
+    if (!session->video.adaptive_bitrate) {
+      return;
+    }
+
+    if (auto bitrate = session->video.adaptive_bitrate->frames_lost(count, std::chrono::steady_clock::now())) {
+      BOOST_LOG(debug) << "Lowering bitrate to "sv << *bitrate << " Kbps after losing "sv << count << " frames"sv;
+      session->video.bitrate_events->raise(*bitrate);
+    }
+  }
+
   void controlBroadcastThread(control_server_t *server) {
     server->map(packetTypes[IDX_PERIODIC_PING], [](session_t *session, const std::string_view &payload) {
       BOOST_LOG(verbose) << "type [IDX_PERIODIC_PING]"sv;
@@ -954,11 +898,18 @@ namespace stream {
         << "time in milli since last report [" << t.count() << ']' << std::endl
         << "last good frame [" << lastGoodFrame << ']' << std::endl
         << "---end stats---";
+
+      report_frame_loss(session, count);
     });
 
     server->map(packetTypes[IDX_REQUEST_IDR_FRAME], [&](session_t *session, const std::string_view &payload) {
       BOOST_LOG(debug) << "type [IDX_REQUEST_IDR_FRAME]"sv;
 
+      // Clients that can't invalidate reference frames request an IDR frame after loss
+      if (session->video.adaptive_bitrate && session->video.adaptive_bitrate->started()) {
+        report_frame_loss(session, 1);
+      }
+
       session->video.idr_events->raise(true);
     });
 
@@ -972,6 +923,8 @@ namespace stream {
         << "firstFrame [" << firstFrame << ']' << std::endl
         << "lastFrame [" << lastFrame << ']';
 
+      report_frame_loss(session, (int) std::clamp<std::int64_t>(lastFrame - firstFrame + 1, 1, std::numeric_limits<int>::max()));
+
       session->video.invalidate_ref_frames_events->raise(std::make_pair(firstFrame, lastFrame));
     });
 
@@ -1279,7 +1232,7 @@ namespace stream {
         });
 
         auto type_str = buf_elem ? "AUDIO"sv : "VIDEO"sv;
-        BOOST_LOG(verbose) << "Recv: "sv << peer.address().to_string() << ':' << peer.port() << " :: " << type_str;
+        LOG_DEFERRED(verbose, "Recv: {}:{} :: {}", peer.address().to_string(), peer.port(), type_str);
 
         populate_peer_to_session();
 
@@ -1297,7 +1250,7 @@ namespace stream {
           // For legacy PING packets, find the matching session by address.
           auto it = peer_to_session.find(peer.address());
           if (it != std::end(peer_to_session)) {
-            BOOST_LOG(debug) << "RAISE: "sv << peer.address().to_string() << ':' << peer.port() << " :: " << type_str;
+            LOG_DEFERRED(debug, "RAISE: {}:{} :: {}", peer.address().to_string(), peer.port(), type_str);
             it->second->raise(peer, std::string {buf[buf_elem].data(), bytes});
           }
         } else if (bytes >= sizeof(SS_PING)) {
@@ -1306,7 +1259,7 @@ namespace stream {
           // For new PING packets that include a client identifier, search by payload.
           auto it = peer_to_session.find(std::string {ping->payload, sizeof(ping->payload)});
           if (it != std::end(peer_to_session)) {
-            BOOST_LOG(debug) << "RAISE: "sv << peer.address().to_string() << ':' << peer.port() << " :: " << type_str;
+            LOG_DEFERRED(debug, "RAISE: {}:{} :: {}", peer.address().to_string(), peer.port(), type_str);
             it->second->raise(peer, std::string {buf[buf_elem].data(), bytes});
           }
         }
@@ -1324,10 +1277,43 @@ namespace stream {
     }
   }
 
+  /**
+   * @brief Warns about packets that a full packet ring dropped because its broadcast thread fell behind.
+   * @details Logs at most every few seconds, with the number of packets dropped since the last warning.
+   */
+  class dropped_packets_logger_t {
+  public:
+    explicit dropped_packets_logger_t(std::string_view type):
+        type {type} {
+    }
+
+    /**
+     * @param dropped The number of packets the ring dropped so far.
+     */
+    void check(std::uint64_t dropped) {
+      if (dropped == logged) {
+        return;
+      }
+
+      auto now = std::chrono::steady_clock::now();
+      if (now - log_time >= 5s) {
+        BOOST_LOG(warning) << "Dropped "sv << dropped - logged << ' ' << type << " packets because the send queue was full"sv;
+        logged = dropped;
+        log_time = now;
+      }
+    }
+
+  private:
+    std::string_view type;
+    std::uint64_t logged = 0;
+    std::chrono::steady_clock::time_point log_time;
+  };
+
   void videoBroadcastThread(udp::socket &sock) {
     auto shutdown_event = mail::man->event<bool>(mail::broadcast_shutdown);
-    auto packets = mail::man->queue<video::packet_t>(mail::video_packets);
+    auto packets = mail::man->ring<video::packet_t>(mail::video_packets);
     auto video_epoch = std::chrono::steady_clock::now();
+    dropped_packets_logger_t dropped_packets_logger {"video"sv};
 
     // Video traffic is sent on this thread
     platf::adjust_thread_priority(platf::thread_priority_e::high);
@@ -1338,7 +1324,46 @@ namespace stream {
     logging::time_delta_periodic_logger frame_fec_latency_logger(debug, "Network: each FEC block latency");
     logging::time_delta_periodic_logger frame_network_latency_logger(debug, "Network: frame's overall network latency");
 
-    crypto::aes_t iv(12);
+    // Shards to encrypt in a single call, one batch per FEC block since blocks may be encrypted concurrently
+    std::array<std::vector<crypto::cipher::gcm_t::batch_entry_t>, MAX_FEC_BLOCKS> encrypt_batches;
+
+    // Blocks after the first FEC block of a frame are prepared on these workers, if enabled
+    std::optional<thread_pool_util::ThreadPool> fec_pool;
+    if (config::stream.fec_threads > 0) {
+      fec_pool.emplace(config::stream.fec_threads);
+    }
+
+    // Reused across frames to avoid allocating and copying the whole frame more than once
+    std::vector<std::string_view> payload_segments;
+    std::vector<uint8_t> packetized_payload;
+
+    // One arena per FEC block, owned by this thread rather than the session because
+    // queued sends may still reference them after the session has ended
+    std::array<fec::arena_t, MAX_FEC_BLOCKS> fec_arenas;
+
+    // Queued sends only report failures once we wait for them, so count them and
+    // log a warning at most every few seconds instead of once per failed send
+    std::uint64_t queued_send_failures = 0;
+    std::uint64_t queued_send_failures_logged = 0;
+    auto queued_send_failures_log_time = std::chrono::steady_clock::time_point {};
+    auto send_batch_wait = [&]() {
+      queued_send_failures += platf::send_batch_wait();
+      if (queued_send_failures == queued_send_failures_logged) {
+        return;
+      }
+
+      auto now = std::chrono::steady_clock::now();
+      if (now - queued_send_failures_log_time >= 5s) {
+        BOOST_LOG(warning) << queued_send_failures - queued_send_failures_logged << " queued video sends failed ("sv << queued_send_failures << " in total)"sv;
+        queued_send_failures_logged = queued_send_failures;
+        queued_send_failures_log_time = now;
+      }
+    };
+
+    // Don't free the buffers above while the platform may still be sending from them
+    auto send_fg = util::fail_guard([&]() {
+      send_batch_wait();
+    });
 
     auto timer = platf::create_high_precision_timer();
     if (!timer || !*timer) {
@@ -1353,25 +1378,26 @@ namespace stream {
         break;
       }
 
+      dropped_packets_logger.check(packets->dropped());
       frame_network_latency_logger.first_point_now();
 
       auto session = (session_t *) packet->channel_data;
       auto lowseq = session->video.lowseq;
 
       std::string_view payload {(char *) packet->data(), packet->data_size()};
-      std::vector<uint8_t> payload_with_replacements;
+      auto payload_size = payload.size();
+
+      payload_segments.clear();
+      payload_segments.emplace_back(payload);
 
       // Apply replacements on the packet payload before performing any other operations.
       // We need to know the final frame size to calculate the last packet size, and we
       // must avoid matching replacements against the frame header or any other non-video
-      // part of the payload.
+      // part of the payload. Replacements are spliced in as separate segments, so the
+      // encoded frame itself is only copied once while packetizing it below.
       if (packet->is_idr() && packet->replacements) {
         for (auto &replacement : *packet->replacements) {
-          auto frame_old = replacement.old;
-          auto frame_new = replacement._new;
-
-          payload_with_replacements = replace(payload, frame_old, frame_new);
-          payload = {(char *) payload_with_replacements.data(), payload_with_replacements.size()};
+          payload_size += splice_replace(payload_segments, replacement.old, replacement._new);
         }
       }
 
@@ -1380,7 +1406,7 @@ namespace stream {
       frame_header.frameType = packet->is_idr()                     ? 2 :
                                packet->after_ref_frame_invalidation ? 5 :
                                                                       1;
-      frame_header.lastPayloadLen = (payload.size() + sizeof(frame_header)) % (session->config.packetsize - sizeof(NV_VIDEO_PACKET));
+      frame_header.lastPayloadLen = (payload_size + sizeof(frame_header)) % (session->config.packetsize - sizeof(NV_VIDEO_PACKET));
       if (frame_header.lastPayloadLen == 0) {
         frame_header.lastPayloadLen = session->config.packetsize - sizeof(NV_VIDEO_PACKET);
       }
@@ -1398,17 +1424,18 @@ namespace stream {
         frame_header.frame_processing_latency = 0;
       }
 
-      auto fecPercentage = config::stream.fec_percentage;
+      auto fecPercentage = session->video.adaptive_bitrate ? session->video.adaptive_bitrate->fec_percentage() : config::stream.fec_percentage;
 
       // Insert space for packet headers
       auto blocksize = session->config.packetsize + MAX_RTP_HEADER_SIZE;
       auto payload_blocksize = blocksize - sizeof(video_packet_raw_t);
-      auto payload_new = concat_and_insert(sizeof(video_packet_raw_t), payload_blocksize, std::string_view {(char *) &frame_header, sizeof(frame_header)}, payload);
+      payload_segments.emplace(std::begin(payload_segments), (char *) &frame_header, sizeof(frame_header));
 
-      payload = std::string_view {(char *) payload_new.data(), payload_new.size()};
+      // The previous frame may still be queued for sending from the buffers we are about to reuse
+      send_batch_wait();
+      gather_and_insert(sizeof(video_packet_raw_t), payload_blocksize, payload_segments, packetized_payload);
 
-      // There are 2 bits for FEC block count for a maximum of 4 FEC blocks
-      constexpr auto MAX_FEC_BLOCKS = 4;
+      payload = std::string_view {(char *) packetized_payload.data(), packetized_payload.size()};
 
       // The max number of data shards per block is found by solving this system of equations for D:
       // D = 255 - P
@@ -1432,11 +1459,8 @@ namespace stream {
       }
 
       std::array<std::string_view, MAX_FEC_BLOCKS> fec_blocks;
-      decltype(fec_blocks)::iterator
-        fec_blocks_begin = std::begin(fec_blocks),
-        fec_blocks_end = std::begin(fec_blocks) + fec_blocks_needed;
 
-      BOOST_LOG(verbose) << "Generating "sv << fec_blocks_needed << " FEC blocks"sv;
+      LOG_DEFERRED(verbose, "Generating {} FEC blocks", fec_blocks_needed);
 
       // Align individual FEC blocks to blocksize
       auto unaligned_size = payload.size() / fec_blocks_needed;
@@ -1459,6 +1483,135 @@ namespace stream {
         }
       }
 
+      // RTP video timestamps use a 90 KHz clock and the frame_timestamp from when the frame was captured
+      // When a timestamp isn't available (duplicate frames), the timestamp from rate control is used instead.
+      bool frame_is_dupe = false;
+      if (!packet->frame_timestamp) {
+        packet->frame_timestamp = ratecontrol_next_frame_start;
+        frame_is_dupe = true;
+      }
+      using rtp_tick = std::chrono::duration<uint32_t, std::ratio<1, 90000>>;
+      uint32_t timestamp = std::chrono::round<rtp_tick>(*packet->frame_timestamp - video_epoch).count();
+
+      // If video encryption is enabled, we allocate space for the encryption header before each shard
+      auto prefixsize = session->video.cipher ? sizeof(video_packet_enc_prefix_t) : 0;
+
+      // Assign sequence numbers and IVs to every FEC block up front, so the blocks can be prepared independently
+      std::array<int, MAX_FEC_BLOCKS> block_lowseq;
+      std::array<std::uint64_t, MAX_FEC_BLOCKS> block_iv_counter;
+      for (int x = 0; x < fec_blocks_needed; ++x) {
+        auto counts = fec::shard_counts(fec_blocks[x].size(), blocksize, fecPercentage, session->config.minRequiredFecPackets);
+        auto nr_shards = counts.data_shards + counts.parity_shards;
+
+        block_lowseq[x] = lowseq;
+        block_iv_counter[x] = session->video.gcm_iv_counter;
+
+        lowseq += nr_shards;
+        if (session->video.cipher) {
+          session->video.gcm_iv_counter += nr_shards;
+        }
+      }
+
+      // Fill in the headers, compute the parity shards and encrypt a single FEC block.
+      // This only touches state belonging to that block, so it may run on the FEC workers.
+      auto prepare_fec_block = [&](int blockIndex) {
+        auto &current_payload = fec_blocks[blockIndex];
+        auto lowseq = block_lowseq[blockIndex];
+        auto packets = (current_payload.size() + (blocksize - 1)) / blocksize;
+
+        for (int x = 0; x < packets; ++x) {
+          auto *inspect = (video_packet_raw_t *) &current_payload[x * blocksize];
+
+          inspect->packet.frameIndex = packet->frame_index();
+          inspect->packet.streamPacketIndex = ((uint32_t) lowseq + x) << 8;
+
+          // Match multiFecFlags with Moonlight
+          inspect->packet.multiFecFlags = 0x10;
+          inspect->packet.multiFecBlocks = (blockIndex << 4) | ((fec_blocks_needed - 1) << 6);
+
+          inspect->packet.flags = FLAG_CONTAINS_PIC_DATA;
+          if (x == 0) {
+            inspect->packet.flags |= FLAG_SOF;
+          }
+          if (x == packets - 1) {
+            inspect->packet.flags |= FLAG_EOF;
+          }
+        }
+
+        auto shards = fec_arenas[blockIndex].encode(current_payload, blocksize, fecPercentage, session->config.minRequiredFecPackets, prefixsize);
+
+        auto iv_counter = block_iv_counter[blockIndex];
+        auto *cipher = blockIndex == 0 ? &session->video.cipher : &session->video.block_ciphers[blockIndex - 1];
+
+        auto &encrypt_batch = encrypt_batches[blockIndex];
+        encrypt_batch.clear();
+
+        // set FEC info now that we know for sure what our percentage will be for this frame
+        for (auto x = 0; x < shards.size(); ++x) {
+          auto *inspect = (video_packet_raw_t *) shards.data(x);
+
+          inspect->packet.fecInfo =
+            (x << 12 |
+             shards.data_shards << 22 |
+             shards.percentage << 4);
+
+          inspect->rtp.header = 0x80 | FLAG_EXTENSION;
+          inspect->rtp.sequenceNumber = util::endian::big<uint16_t>(lowseq + x);
+          inspect->rtp.timestamp = util::endian::big<uint32_t>(timestamp);
+
+          inspect->packet.multiFecBlocks = (blockIndex << 4) | ((fec_blocks_needed - 1) << 6);
+          inspect->packet.frameIndex = packet->frame_index();
+
+          // Queue this shard for encryption if video encryption is enabled
+          if (*cipher) {
+            // We use the deterministic IV construction algorithm specified in NIST SP 800-38D
+            // Section 8.2.1. The sequence number is our "invocation" field and the 'V' in the
+            // high bytes is the "fixed" field. Because each client provides their own unique
+            // key, our values in the fixed field need only uniquely identify each independent
+            // use of the client's key with AES-GCM in our code.
+            //
+            // The IV counter is 64 bits long which allows for 2^64 encrypted video packets
+            // to be sent to each client before the IV repeats.
+            //
+            // The IV is generated directly into the encryption prefix that is sent with the shard.
+            auto *prefix = (video_packet_enc_prefix_t *) shards.prefix(x);
+            std::copy_n((uint8_t *) &iv_counter, sizeof(iv_counter), prefix->iv);
+            std::fill(prefix->iv + sizeof(iv_counter), std::end(prefix->iv) - 1, 0);
+            prefix->iv[11] = 'V';  // Video stream
+            iv_counter++;
+
+            prefix->frameNumber = packet->frame_index();
+
+            // The target buffer is encrypted in place
+            encrypt_batch.push_back({std::string_view {(char *) inspect, (size_t) blocksize}, (uint8_t *) inspect, prefix->tag, prefix->iv});
+          }
+        }
+
+        // Encrypt all shards of the block at once, reusing the cipher context between them
+        if (*cipher && (*cipher)->encrypt(encrypt_batch.data(), encrypt_batch.size(), sizeof(video_packet_enc_prefix_t::iv))) {
+          BOOST_LOG(error) << "Failed to encrypt video FEC block "sv << blockIndex;
+        }
+
+        return shards;
+      };
+
+      // Hand every FEC block but the first to the workers, the first one is prepared on this thread
+      std::array<std::future<fec::fec_t>, MAX_FEC_BLOCKS> pending_blocks;
+      if (fec_pool) {
+        for (int x = 1; x < fec_blocks_needed; ++x) {
+          pending_blocks[x] = fec_pool->push(prepare_fec_block, x);
+        }
+      }
+
+      // The workers reference this frame, so they must be done before we move on to the next one
+      auto fg = util::fail_guard([&]() {
+        for (auto &pending_block : pending_blocks) {
+          if (pending_block.valid()) {
+            pending_block.wait();
+          }
+        }
+      });
+
       try {
         // Use around 80% of 1Gbps          1Gbps            percent    ms     packet      byte
         size_t ratecontrol_packets_in_1ms = std::giga::num * 80 / 100 / 1000 / blocksize / 8;
@@ -1479,37 +1632,14 @@ namespace stream {
         size_t ratecontrol_frame_packets_sent = 0;
         size_t ratecontrol_group_packets_sent = 0;
 
-        auto blockIndex = 0;
-        std::for_each(fec_blocks_begin, fec_blocks_end, [&](std::string_view &current_payload) {
-          auto packets = (current_payload.size() + (blocksize - 1)) / blocksize;
-
-          for (int x = 0; x < packets; ++x) {
-            auto *inspect = (video_packet_raw_t *) &current_payload[x * blocksize];
-
-            inspect->packet.frameIndex = packet->frame_index();
-            inspect->packet.streamPacketIndex = ((uint32_t) lowseq + x) << 8;
-
-            // Match multiFecFlags with Moonlight
-            inspect->packet.multiFecFlags = 0x10;
-            inspect->packet.multiFecBlocks = (blockIndex << 4) | ((fec_blocks_needed - 1) << 6);
-
-            inspect->packet.flags = FLAG_CONTAINS_PIC_DATA;
-            if (x == 0) {
-              inspect->packet.flags |= FLAG_SOF;
-            }
-            if (x == packets - 1) {
-              inspect->packet.flags |= FLAG_EOF;
-            }
-          }
-
+        for (int blockIndex = 0; blockIndex < fec_blocks_needed; ++blockIndex) {
           frame_fec_latency_logger.first_point_now();
-          // If video encryption is enabled, we allocate space for the encryption header before each shard
-          auto shards = fec::encode(current_payload, blocksize, fecPercentage, session->config.minRequiredFecPackets, session->video.cipher ? sizeof(video_packet_enc_prefix_t) : 0);
+          auto shards = pending_blocks[blockIndex].valid() ? pending_blocks[blockIndex].get() : prepare_fec_block(blockIndex);
           frame_fec_latency_logger.second_point_now_and_log();
 
           auto peer_address = session->video.peer.address();
           auto batch_info = platf::batched_send_info_t {
-            shards.headers.begin(),
+            shards.headers,
             shards.prefixsize,
             shards.payload_buffers,
             shards.blocksize,
@@ -1523,53 +1653,7 @@ namespace stream {
 
           size_t next_shard_to_send = 0;
 
-          // RTP video timestamps use a 90 KHz clock and the frame_timestamp from when the frame was captured
-          // When a timestamp isn't available (duplicate frames), the timestamp from rate control is used instead.
-          bool frame_is_dupe = false;
-          if (!packet->frame_timestamp) {
-            packet->frame_timestamp = ratecontrol_next_frame_start;
-            frame_is_dupe = true;
-          }
-          using rtp_tick = std::chrono::duration<uint32_t, std::ratio<1, 90000>>;
-          uint32_t timestamp = std::chrono::round<rtp_tick>(*packet->frame_timestamp - video_epoch).count();
-
-          // set FEC info now that we know for sure what our percentage will be for this frame
           for (auto x = 0; x < shards.size(); ++x) {
-            auto *inspect = (video_packet_raw_t *) shards.data(x);
-
-            inspect->packet.fecInfo =
-              (x << 12 |
-               shards.data_shards << 22 |
-               shards.percentage << 4);
-
-            inspect->rtp.header = 0x80 | FLAG_EXTENSION;
-            inspect->rtp.sequenceNumber = util::endian::big<uint16_t>(lowseq + x);
-            inspect->rtp.timestamp = util::endian::big<uint32_t>(timestamp);
-
-            inspect->packet.multiFecBlocks = (blockIndex << 4) | ((fec_blocks_needed - 1) << 6);
-            inspect->packet.frameIndex = packet->frame_index();
-
-            // Encrypt this shard if video encryption is enabled
-            if (session->video.cipher) {
-              // We use the deterministic IV construction algorithm specified in NIST SP 800-38D
-              // Section 8.2.1. The sequence number is our "invocation" field and the 'V' in the
-              // high bytes is the "fixed" field. Because each client provides their own unique
-              // key, our values in the fixed field need only uniquely identify each independent
-              // use of the client's key with AES-GCM in our code.
-              //
-              // The IV counter is 64 bits long which allows for 2^64 encrypted video packets
-              // to be sent to each client before the IV repeats.
-              std::copy_n((uint8_t *) &session->video.gcm_iv_counter, sizeof(session->video.gcm_iv_counter), std::begin(iv));
-              iv[11] = 'V';  // Video stream
-              session->video.gcm_iv_counter++;
-
-              // Encrypt the target buffer in place
-              auto *prefix = (video_packet_enc_prefix_t *) shards.prefix(x);
-              prefix->frameNumber = packet->frame_index();
-              std::copy(std::begin(iv), std::end(iv), prefix->iv);
-              session->video.cipher->encrypt(std::string_view {(char *) inspect, (size_t) blocksize}, prefix->tag, (uint8_t *) inspect, &iv);
-            }
-
             if (x - next_shard_to_send + 1 >= send_batch_size ||
                 x + 1 == shards.size()) {
               // Do pacing within the frame.
@@ -1597,7 +1681,7 @@ namespace stream {
               // Use a batched send if it's supported on this platform
               if (!platf::send_batch(batch_info)) {
                 // Batched send is not available, so send each packet individually
-                BOOST_LOG(verbose) << "Falling back to unbatched send"sv;
+                LOG_DEFERRED(verbose, "Falling back to unbatched send");
                 for (auto y = 0; y < current_batch_size; y++) {
                   auto send_info = platf::send_info_t {
                     shards.prefix(next_shard_to_send + y),
@@ -1615,6 +1699,10 @@ namespace stream {
               }
               frame_send_batch_latency_logger.second_point_now_and_log();
 
+              if (!packet->trace.first_sent.time_since_epoch().count()) {
+                packet->trace.first_sent = std::chrono::steady_clock::now();
+              }
+
               ratecontrol_group_packets_sent += current_batch_size;
               ratecontrol_frame_packets_sent += current_batch_size;
               next_shard_to_send = x + 1;
@@ -1628,15 +1716,20 @@ namespace stream {
 
           frame_network_latency_logger.second_point_now_and_log();
 
-          BOOST_LOG(verbose) << "Sent Frame seq ["sv << packet->frame_index() << "] pts ["sv << timestamp
-                             << "] shards ["sv << shards.size() << "/"sv << shards.percentage << "%]"sv
-                             << (frame_is_dupe ? " Dupe" : "")
-                             << (packet->is_idr() ? " Key" : "")
-                             << (packet->after_ref_frame_invalidation ? " RFI" : "");
+          LOG_DEFERRED(verbose, "Sent Frame seq [{}] pts [{}] shards [{}/{}%]{}{}{}", packet->frame_index(), timestamp, shards.size(), shards.percentage, frame_is_dupe ? " Dupe" : "", packet->is_idr() ? " Key" : "", packet->after_ref_frame_invalidation ? " RFI" : "");
 
-          ++blockIndex;
-          lowseq += shards.size();
-        });
+        }
+
+        packet->trace.last_sent = std::chrono::steady_clock::now();
+
+        // Frames that keep taking too long to send mean the link can't keep up with the bitrate
+        if (session->video.adaptive_bitrate && packet->trace.encoded.time_since_epoch().count()) {
+          auto send_time = packet->trace.last_sent - packet->trace.encoded;
+          if (auto bitrate = session->video.adaptive_bitrate->frame_sent(send_time, packet->trace.last_sent)) {
+            session->video.bitrate_events->raise(*bitrate);
+          }
+        }
+        stat_trackers::frame_latency().record(packet->frame_index(), packet->trace);
 
         session->video.lowseq = lowseq;
       } catch (const std::exception &e) {
@@ -1650,9 +1743,8 @@ namespace stream {
 
   void audioBroadcastThread(udp::socket &sock) {
     auto shutdown_event = mail::man->event<bool>(mail::broadcast_shutdown);
-    auto packets = mail::man->queue<audio::packet_t>(mail::audio_packets);
+    auto packets = mail::man->ring<audio::packet_t>(mail::audio_packets);
 
-    audio_packet_t audio_packet;
     fec::rs_t rs {reed_solomon_new(RTPA_DATA_SHARDS, RTPA_FEC_SHARDS)};
     crypto::aes_t iv(16);
 
@@ -1664,21 +1756,68 @@ namespace stream {
     const unsigned char parity[] = {0x77, 0x40, 0x38, 0x0e, 0xc7, 0xa7, 0x0d, 0x6c};
     memcpy(rs.get()->p, parity, sizeof(parity));
 
-    audio_packet.rtp.header = 0x80;
-    audio_packet.rtp.packetType = 97;
-    audio_packet.rtp.ssrc = 0;
+    // Packets of a session that are sent with a single call: the data packets that were ready together,
+    // followed by the parity packets once they complete a FEC block. A batch never spans FEC blocks,
+    // so the shards it references are not overwritten before it is sent.
+    session_t *batch_session = nullptr;
+    std::array<audio_packet_t, RTPA_DATA_SHARDS> data_headers;
+    std::array<audio_fec_packet_t, RTPA_FEC_SHARDS> fec_headers;
+    std::array<platf::send_message_t, RTPA_TOTAL_SHARDS> messages;
+    std::size_t data_count = 0;
+    std::size_t message_count = 0;
+
+    for (auto &header : data_headers) {
+      header.rtp.header = 0x80;
+      header.rtp.packetType = 97;
+      header.rtp.ssrc = 0;
+    }
+
+    auto flush_batch = [&]() {
+      if (!message_count) {
+        return;
+      }
+
+      try {
+        auto peer_address = batch_session->audio.peer.address();
+        auto send_info = platf::multi_send_info_t {
+          messages.data(),
+          message_count,
+          (uintptr_t) sock.native_handle(),
+          peer_address,
+          batch_session->audio.peer.port(),
+          batch_session->localAddress,
+        };
+        platf::send_multiple(send_info);
+
+        stat_trackers::audio_sends().record(message_count, send_info.system_calls);
+      } catch (const std::exception &e) {
+        BOOST_LOG(error) << "Broadcast audio failed "sv << e.what();
+        std::this_thread::sleep_for(100ms);
+      }
+
+      batch_session = nullptr;
+      data_count = 0;
+      message_count = 0;
+    };
 
     // Audio traffic is sent on this thread
     platf::adjust_thread_priority(platf::thread_priority_e::high);
 
+    dropped_packets_logger_t dropped_packets_logger {"audio"sv};
     while (auto packet = packets->pop()) {
       if (shutdown_event->peek()) {
         break;
       }
 
+      dropped_packets_logger.check(packets->dropped());
       TUPLE_2D_REF(channel_data, packet_data, *packet);
       auto session = (session_t *) channel_data;
 
+      if (batch_session != session) {
+        flush_batch();
+        batch_session = session;
+      }
+
       auto sequenceNumber = session->audio.sequenceNumber;
       auto timestamp = session->audio.timestamp;
 
@@ -1686,7 +1825,7 @@ namespace stream {
 
       auto &shards_p = session->audio.shards_p;
 
-      auto bytes = encode_audio(session->config.encryptionFlagsEnabled & SS_ENC_AUDIO, packet_data, shards_p[sequenceNumber % RTPA_DATA_SHARDS], iv, session->audio.cipher);
+      auto bytes = encode_audio(session->config.encryptionFlagsEnabled & SS_ENC_AUDIO, *packet_data, shards_p[sequenceNumber % RTPA_DATA_SHARDS], iv, session->audio.cipher);
       if (bytes < 0) {
         BOOST_LOG(error) << "Couldn't encode audio packet"sv;
         break;
@@ -1694,58 +1833,50 @@ namespace stream {
 
       BOOST_LOG(verbose) << "Audio [seq "sv << sequenceNumber << ", pts "sv << timestamp << "] ::  send..."sv;
 
+      auto &audio_packet = data_headers[data_count++];
       audio_packet.rtp.sequenceNumber = util::endian::big(sequenceNumber);
       audio_packet.rtp.timestamp = util::endian::big(timestamp);
 
+      messages[message_count++] = {
+        (const char *) &audio_packet,
+        sizeof(audio_packet),
+        (const char *) shards_p[sequenceNumber % RTPA_DATA_SHARDS],
+        (size_t) bytes,
+      };
+
       session->audio.sequenceNumber++;
       session->audio.timestamp += session->config.audio.packetDuration;
 
-      auto peer_address = session->audio.peer.address();
-      try {
-        auto send_info = platf::send_info_t {
-          (const char *) &audio_packet,
-          sizeof(audio_packet),
-          (const char *) shards_p[sequenceNumber % RTPA_DATA_SHARDS],
-          (size_t) bytes,
-          (uintptr_t) sock.native_handle(),
-          peer_address,
-          session->audio.peer.port(),
-          session->localAddress,
-        };
-        platf::send(send_info);
+      auto &fec_packet = session->audio.fec_packet;
+      // initialize the FEC header at the beginning of the FEC block
+      if (sequenceNumber % RTPA_DATA_SHARDS == 0) {
+        fec_packet.fecHeader.baseSequenceNumber = util::endian::big(sequenceNumber);
+        fec_packet.fecHeader.baseTimestamp = util::endian::big(timestamp);
+      }
 
-        auto &fec_packet = session->audio.fec_packet;
-        // initialize the FEC header at the beginning of the FEC block
-        if (sequenceNumber % RTPA_DATA_SHARDS == 0) {
-          fec_packet.fecHeader.baseSequenceNumber = util::endian::big(sequenceNumber);
-          fec_packet.fecHeader.baseTimestamp = util::endian::big(timestamp);
+      // generate parity shards at the end of the FEC block, they go out with the last data packet
+      if ((sequenceNumber + 1) % RTPA_DATA_SHARDS == 0) {
+        reed_solomon_encode(rs.get(), shards_p.begin(), RTPA_TOTAL_SHARDS, bytes);
+
+        for (auto x = 0; x < RTPA_FEC_SHARDS; ++x) {
+          auto &fec_header = fec_headers[x];
+          fec_header = fec_packet;
+          fec_header.rtp.sequenceNumber = util::endian::big<std::uint16_t>(sequenceNumber + x + 1);
+          fec_header.fecHeader.fecShardIndex = x;
+
+          messages[message_count++] = {
+            (const char *) &fec_header,
+            sizeof(fec_header),
+            (const char *) shards_p[RTPA_DATA_SHARDS + x],
+            (size_t) bytes,
+          };
+          BOOST_LOG(verbose) << "Audio FEC ["sv << (sequenceNumber & ~(RTPA_DATA_SHARDS - 1)) << ' ' << x << "] ::  send..."sv;
         }
 
-        // generate parity shards at the end of the FEC block
-        if ((sequenceNumber + 1) % RTPA_DATA_SHARDS == 0) {
-          reed_solomon_encode(rs.get(), shards_p.begin(), RTPA_TOTAL_SHARDS, bytes);
-
-          for (auto x = 0; x < RTPA_FEC_SHARDS; ++x) {
-            fec_packet.rtp.sequenceNumber = util::endian::big<std::uint16_t>(sequenceNumber + x + 1);
-            fec_packet.fecHeader.fecShardIndex = x;
-
-            auto send_info = platf::send_info_t {
-              (const char *) &fec_packet,
-              sizeof(fec_packet),
-              (const char *) shards_p[RTPA_DATA_SHARDS + x],
-              (size_t) bytes,
-              (uintptr_t) sock.native_handle(),
-              peer_address,
-              session->audio.peer.port(),
-              session->localAddress,
-            };
-            platf::send(send_info);
-            BOOST_LOG(verbose) << "Audio FEC ["sv << (sequenceNumber & ~(RTPA_DATA_SHARDS - 1)) << ' ' << x << "] ::  send..."sv;
-          }
-        }
-      } catch (const std::exception &e) {
-        BOOST_LOG(error) << "Broadcast audio failed "sv << e.what();
-        std::this_thread::sleep_for(100ms);
+        flush_batch();
+      } else if (!packets->peek()) {
+        // Don't hold back data packets when no other packet is ready to go out with them
+        flush_batch();
       }
     }
 
@@ -1817,8 +1948,8 @@ namespace stream {
 
     broadcast_shutdown_event->raise(true);
 
-    auto video_packets = mail::man->queue<video::packet_t>(mail::video_packets);
-    auto audio_packets = mail::man->queue<audio::packet_t>(mail::audio_packets);
+    auto video_packets = mail::man->ring<video::packet_t>(mail::video_packets);
+    auto audio_packets = mail::man->ring<audio::packet_t>(mail::audio_packets);
 
     // Minimize delay stopping video/audio threads
     video_packets->stop();
@@ -2172,6 +2303,10 @@ namespace stream {
 
       session->video.idr_events = mail->event<bool>(mail::idr);
       session->video.invalidate_ref_frames_events = mail->event<std::pair<int64_t, int64_t>>(mail::invalidate_ref_frames);
+      if (config::stream.adaptive_bitrate) {
+        session->video.adaptive_bitrate.emplace(config.monitor.bitrate, config::stream.fec_percentage, config.monitor.framerate);
+        session->video.bitrate_events = mail->event<int>(mail::bitrate);
+      }
       session->video.lowseq = 0;
       session->video.ping_payload = launch_session.av_ping_payload;
       if (config.encryptionFlagsEnabled & SS_ENC_VIDEO) {
@@ -2180,6 +2315,12 @@ namespace stream {
           launch_session.gcm_key,
           false
         };
+        for (auto &block_cipher : session->video.block_ciphers) {
+          block_cipher = crypto::cipher::gcm_t {
+            launch_session.gcm_key,
+            false
+          };
+        }
         session->video.gcm_iv_counter = 0;
       }
 
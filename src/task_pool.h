@@ -13,10 +13,10 @@
 #include <optional>
 #include <type_traits>
 #include <utility>
-#include <vector>
 
 // local includes
 #include "move_by_copy.h"
+#include "timer_wheel.h"
 #include "utility.h"
 
 namespace task_pool_util {
@@ -65,7 +65,7 @@ namespace task_pool_util {
 
   protected:
     std::deque<__task> _tasks;
-    std::vector<std::pair<__time_point, __task>> _timer_tasks;
+    timer_wheel_t<__task> _timer_tasks;
     std::mutex _task_mutex;
 
   public:
@@ -90,11 +90,7 @@ namespace task_pool_util {
       using __return = std::invoke_result_t<Function, Args &&...>;
       using task_t = std::packaged_task<__return()>;
 
-      auto bind = [task = std::forward<Function>(newTask), tuple_args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
-        return std::apply(task, std::move(tuple_args));
-      };
-
-      task_t task(std::move(bind));
+      task_t task(_bind(std::forward<Function>(newTask), std::forward<Args>(args)...));
 
       auto future = task.get_future();
 
@@ -107,14 +103,7 @@ namespace task_pool_util {
     void pushDelayed(std::pair<__time_point, __task> &&task) {
       std::lock_guard lg(_task_mutex);
 
-      auto it = _timer_tasks.cbegin();
-      for (; it < _timer_tasks.cend(); ++it) {
-        if (std::get<0>(*it) < task.first) {
-          break;
-        }
-      }
-
-      _timer_tasks.emplace(it, task.first, std::move(task.second));
+      _timer_tasks.insert(task.first, std::move(task.second));
     }
 
     /**
@@ -134,11 +123,7 @@ namespace task_pool_util {
         time_point = std::chrono::steady_clock::now() + duration;
       }
 
-      auto bind = [task = std::forward<Function>(newTask), tuple_args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
-        return std::apply(task, std::move(tuple_args));
-      };
-
-      task_t task(std::move(bind));
+      task_t task(_bind(std::forward<Function>(newTask), std::forward<Args>(args)...));
 
       auto future = task.get_future();
       auto runnable = toRunnable(std::move(task));
@@ -158,62 +143,19 @@ namespace task_pool_util {
     void delay(task_id_t task_id, std::chrono::duration<X, Y> duration) {
       std::lock_guard<std::mutex> lg(_task_mutex);
 
-      auto it = _timer_tasks.begin();
-      for (; it < _timer_tasks.cend(); ++it) {
-        const __task &task = std::get<1>(*it);
-
-        if (&*task == task_id) {
-          std::get<0>(*it) = std::chrono::steady_clock::now() + duration;
-
-          break;
-        }
-      }
-
-      if (it == _timer_tasks.cend()) {
-        return;
-      }
-
-      // smaller time goes to the back
-      auto prev = it - 1;
-      while (it > _timer_tasks.cbegin()) {
-        if (std::get<0>(*it) > std::get<0>(*prev)) {
-          std::swap(*it, *prev);
-        }
-
-        --prev;
-        --it;
-      }
+      _timer_tasks.reschedule(task_id, std::chrono::steady_clock::now() + duration);
     }
 
     bool cancel(task_id_t task_id) {
       std::lock_guard lg(_task_mutex);
 
-      auto it = _timer_tasks.begin();
-      for (; it < _timer_tasks.cend(); ++it) {
-        const __task &task = std::get<1>(*it);
-
-        if (&*task == task_id) {
-          _timer_tasks.erase(it);
-
-          return true;
-        }
-      }
-
-      return false;
+      return _timer_tasks.remove(task_id).has_value();
     }
 
     std::optional<std::pair<__time_point, __task>> pop(task_id_t task_id) {
       std::lock_guard lg(_task_mutex);
 
-      auto pos = std::find_if(std::begin(_timer_tasks), std::end(_timer_tasks), [&task_id](const auto &t) {
-        return t.second.get() == task_id;
-      });
-
-      if (pos == std::end(_timer_tasks)) {
-        return std::nullopt;
-      }
-
-      return std::move(*pos);
+      return _timer_tasks.remove(task_id);
     }
 
     std::optional<__task> pop() {
@@ -225,32 +167,35 @@ namespace task_pool_util {
         return task;
       }
 
-      if (!_timer_tasks.empty() && std::get<0>(_timer_tasks.back()) <= std::chrono::steady_clock::now()) {
-        __task task = std::move(std::get<1>(_timer_tasks.back()));
-        _timer_tasks.pop_back();
-        return task;
-      }
-
-      return std::nullopt;
+      return _timer_tasks.pop(std::chrono::steady_clock::now());
     }
 
     bool ready() {
       std::lock_guard<std::mutex> lg(_task_mutex);
 
-      return !_tasks.empty() || (!_timer_tasks.empty() && std::get<0>(_timer_tasks.back()) <= std::chrono::steady_clock::now());
+      return !_tasks.empty() || _timer_tasks.ready(std::chrono::steady_clock::now());
     }
 
+    /**
+     * @return The time at which timers need attention next, it may come before the next deadline.
+     */
     std::optional<__time_point> next() {
       std::lock_guard<std::mutex> lg(_task_mutex);
 
-      if (_timer_tasks.empty()) {
-        return std::nullopt;
-      }
+      return _timer_tasks.next();
+    }
 
-      return std::get<0>(_timer_tasks.back());
+  protected:
+    /**
+     * @brief Bind the arguments to the function, so it can be called without arguments.
+     */
+    template<class Function, class... Args>
+    static auto _bind(Function &&newTask, Args &&...args) {
+      return [task = std::forward<Function>(newTask), tuple_args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+        return std::apply(task, std::move(tuple_args));
+      };
     }
 
-  private:
     template<class Function>
     std::unique_ptr<_ImplBase> toRunnable(Function &&f) {
       return std::make_unique<_Impl<Function>>(std::forward<Function &&>(f));
@@ -5,6 +5,7 @@
 #pragma once
 
 // standard includes
+#include <atomic>
 #include <thread>
 
 // local includes
@@ -13,18 +14,37 @@
 namespace thread_pool_util {
   /**
    * Allow threads to execute unhindered while keeping full control over the threads.
+   *
+   * One idle thread at a time waits for the next timer, the other idle threads only wait for tasks.
+   * Adding a timer wakes the timer thread only when the timer is due before the time it waits for.
    */
   class ThreadPool: public task_pool_util::TaskPool {
   public:
     typedef TaskPool::__task __task;
 
   private:
+    /**
+     * @brief Wake the timer thread if it waits past the given time. Must be called with _lock held.
+     */
+    void _notify_timer(const std::optional<__time_point> &time_point) {
+      if (_timer_waiting && time_point && (!_timer_deadline || *time_point < *_timer_deadline)) {
+        _timer_cv.notify_one();
+      }
+    }
+
     std::vector<std::thread> _thread;
 
     std::condition_variable _cv;
+    std::condition_variable _timer_cv;
     std::mutex _lock;
 
-    bool _continue;
+    // The number of threads waiting on _cv, and whether a thread waits on _timer_cv and until when
+    int _idle = 0;
+    bool _timer_waiting = false;
+    std::optional<__time_point> _timer_deadline;
+
+    // Read by the threads between tasks without holding _lock
+    std::atomic_bool _continue;
 
   public:
     ThreadPool():
@@ -53,14 +73,43 @@ namespace thread_pool_util {
       std::lock_guard lg(_lock);
       auto future = TaskPool::push(std::forward<Function>(newTask), std::forward<Args>(args)...);
 
-      _cv.notify_one();
+      if (_idle > 0) {
+        _cv.notify_one();
+      } else {
+        _timer_cv.notify_one();
+      }
       return future;
     }
 
+    /**
+     * @brief Run a task without a future to wait for it, which saves allocating its shared state.
+     */
+    template<class Function, class... Args>
+    void post(Function &&newTask, Args &&...args) {
+      static_assert(std::is_invocable_v<Function, Args &&...>, "arguments don't match the function");
+
+      auto task = toRunnable(_bind(std::forward<Function>(newTask), std::forward<Args>(args)...));
+
+      std::lock_guard lg(_lock);
+      {
+        std::lock_guard task_lg(_task_mutex);
+        _tasks.emplace_back(std::move(task));
+      }
+
+      if (_idle > 0) {
+        _cv.notify_one();
+      } else {
+        _timer_cv.notify_one();
+      }
+    }
+
     void pushDelayed(std::pair<__time_point, __task> &&task) {
       std::lock_guard lg(_lock);
 
+      auto time_point = task.first;
       TaskPool::pushDelayed(std::move(task));
+
+      _notify_timer(time_point);
     }
 
     template<class Function, class X, class Y, class... Args>
@@ -68,11 +117,18 @@ namespace thread_pool_util {
       std::lock_guard lg(_lock);
       auto future = TaskPool::pushDelayed(std::forward<Function>(newTask), duration, std::forward<Args>(args)...);
 
-      // Update all timers for wait_until
-      _cv.notify_all();
+      _notify_timer(next());
       return future;
     }
 
+    template<class X, class Y>
+    void delay(task_id_t task_id, std::chrono::duration<X, Y> duration) {
+      std::lock_guard lg(_lock);
+      TaskPool::delay(task_id, duration);
+
+      _notify_timer(next());
+    }
+
     void start(int threads) {
       _continue = true;
 
@@ -88,6 +144,7 @@ namespace thread_pool_util {
 
       _continue = false;
       _cv.notify_all();
+      _timer_cv.notify_all();
     }
 
     void join() {
@@ -112,10 +169,26 @@ namespace thread_pool_util {
             break;
           }
 
-          if (auto tp = next()) {
-            _cv.wait_until(uniq_lock, *tp);
-          } else {
+          if (_timer_waiting) {
+            ++_idle;
             _cv.wait(uniq_lock);
+            --_idle;
+
+            continue;
+          }
+
+          _timer_waiting = true;
+          _timer_deadline = next();
+          if (_timer_deadline) {
+            _timer_cv.wait_until(uniq_lock, *_timer_deadline);
+          } else {
+            _timer_cv.wait(uniq_lock);
+          }
+          _timer_waiting = false;
+
+          // Let an idle thread take over waiting for timers while this one runs tasks
+          if (_idle > 0) {
+            _cv.notify_one();
           }
         }
       }
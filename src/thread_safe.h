@@ -7,10 +7,12 @@
 // standard includes
 #include <array>
 #include <atomic>
+#include <bit>
 #include <condition_variable>
 #include <functional>
 #include <map>
 #include <mutex>
+#include <optional>
 #include <vector>
 
 // local includes
@@ -346,6 +348,272 @@ namespace safe {
     std::vector<T> _queue;
   };
 
+  /**
+   * @brief A bounded lock-free queue with any number of producers and a single consumer.
+   * @details Handing over an element costs a few atomic operations. The mutex and condition variable are only
+   *          touched when the consumer found the ring empty and went to sleep.
+   *          Unlike `queue_t`, which empties itself when it is full, a full ring drops the new element and keeps
+   *          the ones queued before it. Producers can't remove elements without racing the consumer, so dropping
+   *          the oldest element is not an option. Dropped elements are counted, see `dropped()`.
+   */
+  template<class T>
+  class ring_t {
+  public:
+    using status_t = util::optional_t<T>;
+
+    /**
+     * @param max_elements The capacity, rounded up to a power of two.
+     */
+    ring_t(std::uint32_t max_elements = 32):
+        _cells(std::bit_ceil(std::max<std::uint32_t>(max_elements, 2))),
+        _mask {_cells.size() - 1} {
+      for (std::size_t x = 0; x < _cells.size(); ++x) {
+        _cells[x].sequence.store(x, std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * @brief Construct an element at the back of the ring.
+     * @return `false` if the ring is full or stopped, in which case the element is dropped.
+     */
+    template<class... Args>
+    bool raise(Args &&...args) {
+      if (!_continue.load(std::memory_order_relaxed)) {
+        return false;
+      }
+
+      auto pos = _tail.load(std::memory_order_relaxed);
+      cell_t *cell;
+      while (true) {
+        cell = &_cells[pos & _mask];
+        auto seq = cell->sequence.load(std::memory_order_acquire);
+        auto diff = (std::intptr_t) seq - (std::intptr_t) pos;
+
+        if (diff == 0) {
+          // The cell is free, claim it unless another producer got there first
+          if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            break;
+          }
+        } else if (diff < 0) {
+          // The consumer has not freed this cell yet
+          _dropped.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        } else {
+          pos = _tail.load(std::memory_order_relaxed);
+        }
+      }
+
+      cell->value.emplace(std::forward<Args>(args)...);
+      cell->sequence.store(pos + 1, std::memory_order_release);
+
+      // Pairs with the fence in pop(), either the consumer sees the element or we see it sleeping
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (_sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard lg {_lock};
+        _cv.notify_one();
+      }
+
+      return true;
+    }
+
+    /**
+     * @brief Check whether an element is ready. Only the consumer may call this.
+     */
+    bool peek() {
+      auto cell = &_cells[_head & _mask];
+      return _continue && cell->sequence.load(std::memory_order_acquire) == _head + 1;
+    }
+
+    /**
+     * @brief Wait for the next element. Only the consumer may call this.
+     * @return The element, or a false value once the ring is stopped.
+     */
+    status_t pop() {
+      while (_continue) {
+        if (auto val = try_pop()) {
+          return val;
+        }
+
+        std::unique_lock ul {_lock};
+        _sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        // Check again, a producer that raised before seeing the flag does not notify us
+        auto val = try_pop();
+        if (!val && _continue) {
+          _cv.wait(ul);
+        }
+
+        _sleeping.store(false, std::memory_order_relaxed);
+        if (val) {
+          return val;
+        }
+      }
+
+      return util::false_v<status_t>;
+    }
+
+    void stop() {
+      std::lock_guard lg {_lock};
+
+      _continue = false;
+
+      _cv.notify_all();
+    }
+
+    [[nodiscard]] bool running() const {
+      return _continue;
+    }
+
+    /**
+     * @brief Get the number of elements the ring can hold.
+     */
+    [[nodiscard]] std::uint32_t capacity() const {
+      return _cells.size();
+    }
+
+    /**
+     * @brief Get the number of elements dropped so far because the ring was full.
+     */
+    [[nodiscard]] std::uint64_t dropped() const {
+      return _dropped.load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct cell_t {
+      std::atomic<std::size_t> sequence;
+      std::optional<T> value;
+    };
+
+    status_t try_pop() {
+      auto cell = &_cells[_head & _mask];
+      if (cell->sequence.load(std::memory_order_acquire) != _head + 1) {
+        return util::false_v<status_t>;
+      }
+
+      status_t val = std::move(*cell->value);
+      cell->value.reset();
+
+      // Hand the cell back to the producers for the next lap around the ring
+      cell->sequence.store(_head + _cells.size(), std::memory_order_release);
+      ++_head;
+
+      return val;
+    }
+
+    std::atomic_bool _continue {true};
+
+    std::vector<cell_t> _cells;
+    std::size_t _mask;
+
+    // Producers and the consumer update these on every element, keep them on separate cache lines
+    alignas(64) std::atomic<std::size_t> _tail {0};
+    alignas(64) std::size_t _head {0};
+
+    alignas(64) std::atomic_bool _sleeping {false};
+    std::mutex _lock;
+    std::condition_variable _cv;
+
+    std::atomic<std::uint64_t> _dropped {0};
+  };
+
+  /**
+   * @brief A fixed set of objects that are handed out and recycled without allocating.
+   * @details All objects are constructed up front. An object returns to the pool when its handle is destroyed,
+   *          which may happen on any thread, even after the pool itself was destroyed.
+   *          Only one thread at a time may pull objects from the pool.
+   */
+  template<class T>
+  class pool_t {
+    struct state_t {
+      state_t(std::uint32_t count, const T &prototype):
+          objects(count, prototype),
+          free(count) {
+        for (std::uint32_t x = 0; x < count; ++x) {
+          free.raise(x);
+        }
+      }
+
+      std::vector<T> objects;
+
+      // The ring has room for every object, so handing one back never fails
+      ring_t<std::uint32_t> free;
+    };
+
+  public:
+    /**
+     * @brief An object taken from the pool, it is handed back on destruction.
+     */
+    class handle_t {
+    public:
+      handle_t() = default;
+
+      handle_t(handle_t &&other) noexcept:
+          _state {std::move(other._state)},
+          _index {other._index} {
+      }
+
+      handle_t &operator=(handle_t &&other) noexcept {
+        std::swap(_state, other._state);
+        std::swap(_index, other._index);
+
+        return *this;
+      }
+
+      ~handle_t() {
+        if (_state) {
+          _state->free.raise(_index);
+        }
+      }
+
+      T &operator*() const {
+        return _state->objects[_index];
+      }
+
+      T *operator->() const {
+        return &_state->objects[_index];
+      }
+
+      explicit operator bool() const {
+        return (bool) _state;
+      }
+
+    private:
+      friend class pool_t;
+
+      handle_t(std::shared_ptr<state_t> state, std::uint32_t index):
+          _state {std::move(state)},
+          _index {index} {
+      }
+
+      std::shared_ptr<state_t> _state;
+      std::uint32_t _index {};
+    };
+
+    /**
+     * @param count The number of objects.
+     * @param prototype Every object starts as a copy of it.
+     */
+    pool_t(std::uint32_t count, const T &prototype = T {}):
+        _state {std::make_shared<state_t>(count, prototype)} {
+    }
+
+    /**
+     * @brief Take an object from the pool.
+     * @return The object, or an empty handle if all of them are in use.
+     */
+    handle_t pull() {
+      if (!_state->free.peek()) {
+        return {};
+      }
+
+      return {_state, *_state->free.pop()};
+    }
+
+  private:
+    std::shared_ptr<state_t> _state;
+  };
+
   template<class T>
   class shared_t {
   public:
@@ -505,6 +773,9 @@ namespace safe {
     template<class T>
     using queue_t = std::shared_ptr<post_t<queue_t<T>>>;
 
+    template<class T>
+    using ring_t = std::shared_ptr<post_t<ring_t<T>>>;
+
     template<class T>
     event_t<T> event(const std::string_view &id) {
       std::lock_guard lg {mutex};
@@ -535,6 +806,21 @@ namespace safe {
       return post;
     }
 
+    template<class T>
+    ring_t<T> ring(const std::string_view &id) {
+      std::lock_guard lg {mutex};
+
+      auto it = id_to_post.find(id);
+      if (it != std::end(id_to_post)) {
+        return lock<ring_t<T>>(it->second);
+      }
+
+      auto post = std::make_shared<typename ring_t<T>::element_type>(shared_from_this(), 32);
+      id_to_post.emplace(std::pair<std::string, std::weak_ptr<void>> {std::string {id}, post});
+
+      return post;
+    }
+
     void cleanup() {
       std::lock_guard lg {mutex};
 
@@ -0,0 +1,351 @@
+/**
+ * @file src/timer_wheel.h
+ * @brief Declarations for the hierarchical timer wheel of the task pool.
+ */
+#pragma once
+
+// standard includes
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace task_pool_util {
+  /**
+   * @brief A hierarchical timer wheel with a resolution of one millisecond.
+   * @details Insert, cancel and reschedule take constant time, whatever the number of pending timers.
+   *          Timers live in one of four levels of 64 slots, the level being chosen by how far away
+   *          the deadline is. When the wheel reaches a slot of a higher level, its timers cascade
+   *          into the levels below until they expire. Deadlines more than 4.6 hours away wait in
+   *          an overflow list that is sorted into the wheel when it comes within range.
+   *
+   *          A timer never expires before its deadline, but up to a millisecond after it.
+   *          The wheel is not thread safe.
+   * @tparam T An owning pointer to the value of a timer, its raw pointer identifies the timer.
+   */
+  template<class T>
+  class timer_wheel_t {
+  public:
+    using clock = std::chrono::steady_clock;
+    using id_t = typename T::pointer;
+
+    static constexpr int slot_bits = 6;
+    static constexpr int slots = 1 << slot_bits;
+    static constexpr int levels = 4;
+
+    timer_wheel_t():
+        _origin {clock::now()} {
+    }
+
+    /**
+     * @brief Add a timer.
+     * @param deadline The time at which the timer expires.
+     * @param value The value of the timer, its address is the id of the timer.
+     * @return The id of the timer.
+     */
+    id_t insert(clock::time_point deadline, T &&value) {
+      auto id = &*value;
+
+      auto &timer = _timers.try_emplace(id).first->second;
+      timer.value = std::move(value);
+      timer.deadline = deadline;
+
+      link(timer);
+
+      return id;
+    }
+
+    /**
+     * @brief Move a timer to a new deadline.
+     * @return `false` if there is no timer with that id.
+     */
+    bool reschedule(id_t id, clock::time_point deadline) {
+      auto it = _timers.find(id);
+      if (it == std::end(_timers)) {
+        return false;
+      }
+
+      auto &timer = it->second;
+      unlink(timer);
+      timer.deadline = deadline;
+      link(timer);
+
+      return true;
+    }
+
+    /**
+     * @brief Remove a timer without expiring it.
+     * @return The deadline and value of the timer, if there is a timer with that id.
+     */
+    std::optional<std::pair<clock::time_point, T>> remove(id_t id) {
+      auto it = _timers.find(id);
+      if (it == std::end(_timers)) {
+        return std::nullopt;
+      }
+
+      auto &timer = it->second;
+      unlink(timer);
+
+      std::pair<clock::time_point, T> result {timer.deadline, std::move(timer.value)};
+      _timers.erase(it);
+
+      return result;
+    }
+
+    /**
+     * @brief Remove the next timer that expired by the given time.
+     * @param now The current time.
+     * @return The value of the timer, if one expired.
+     */
+    std::optional<T> pop(clock::time_point now) {
+      advance(now);
+
+      auto timer = _heads[expired_list];
+      if (!timer) {
+        return std::nullopt;
+      }
+
+      unlink(*timer);
+
+      auto it = _timers.find(&*timer->value);
+      T value = std::move(it->second.value);
+      _timers.erase(it);
+
+      return value;
+    }
+
+    /**
+     * @brief Check whether a timer expired by the given time.
+     */
+    bool ready(clock::time_point now) {
+      advance(now);
+
+      return _heads[expired_list] != nullptr;
+    }
+
+    /**
+     * @brief Get the time at which the wheel has to advance next.
+     * @details It can be earlier than the next deadline, when timers only cascade to a lower level then.
+     * @return The time, or `std::nullopt` if there are no timers.
+     */
+    std::optional<clock::time_point> next() const {
+      if (_heads[expired_list]) {
+        return to_time_point(_tick);
+      }
+
+      auto tick = next_tick();
+      if (!tick) {
+        return std::nullopt;
+      }
+
+      return to_time_point(*tick);
+    }
+
+    std::size_t size() const {
+      return _timers.size();
+    }
+
+    bool empty() const {
+      return _timers.empty();
+    }
+
+  private:
+    struct timer_t {
+      T value;
+      clock::time_point deadline;
+      std::uint64_t tick;
+
+      // The list the timer is in, and its neighbours there
+      int list;
+      timer_t *prev;
+      timer_t *next;
+    };
+
+    static constexpr int overflow_list = levels * slots;
+    static constexpr int expired_list = overflow_list + 1;
+
+    static constexpr int level_shift(int level) {
+      return level * slot_bits;
+    }
+
+    static constexpr int slot_of(std::uint64_t tick, int level) {
+      return (tick >> level_shift(level)) & (slots - 1);
+    }
+
+    std::uint64_t to_tick(clock::time_point time_point, bool round_up) const {
+      if (time_point <= _origin) {
+        return 0;
+      }
+
+      auto elapsed = time_point - _origin;
+      auto ticks = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+      if (round_up && ticks < elapsed) {
+        ++ticks;
+      }
+
+      return ticks.count();
+    }
+
+    clock::time_point to_time_point(std::uint64_t tick) const {
+      return _origin + std::chrono::milliseconds(tick);
+    }
+
+    /**
+     * @brief Put a timer in the list for its deadline, relative to the current tick.
+     */
+    void link(timer_t &timer) {
+      // Rounding up makes sure the timer never expires early
+      timer.tick = to_tick(timer.deadline, true);
+
+      if (timer.tick <= _tick) {
+        push_back(expired_list, timer);
+        return;
+      }
+
+      // The highest group of bits that differs from the current tick picks the level
+      auto level = (std::bit_width(timer.tick ^ _tick) - 1) / slot_bits;
+      if (level >= levels) {
+        push_front(overflow_list, timer);
+        return;
+      }
+
+      auto slot = slot_of(timer.tick, level);
+      push_front(level * slots + slot, timer);
+      _occupied[level] |= std::uint64_t {1} << slot;
+    }
+
+    void unlink(timer_t &timer) {
+      if (timer.prev) {
+        timer.prev->next = timer.next;
+      } else {
+        _heads[timer.list] = timer.next;
+      }
+
+      if (timer.next) {
+        timer.next->prev = timer.prev;
+      } else if (timer.list == expired_list) {
+        _expired_tail = timer.prev;
+      }
+
+      if (timer.list < overflow_list && !_heads[timer.list]) {
+        _occupied[timer.list / slots] &= ~(std::uint64_t {1} << (timer.list % slots));
+      }
+    }
+
+    void push_front(int list, timer_t &timer) {
+      timer.list = list;
+      timer.prev = nullptr;
+      timer.next = _heads[list];
+
+      if (timer.next) {
+        timer.next->prev = &timer;
+      }
+      _heads[list] = &timer;
+    }
+
+    void push_back(int list, timer_t &timer) {
+      timer.list = list;
+      timer.prev = _expired_tail;
+      timer.next = nullptr;
+
+      if (_expired_tail) {
+        _expired_tail->next = &timer;
+      } else {
+        _heads[list] = &timer;
+      }
+      _expired_tail = &timer;
+    }
+
+    /**
+     * @brief Get the next tick at which timers expire or cascade.
+     */
+    std::optional<std::uint64_t> next_tick() const {
+      std::optional<std::uint64_t> result;
+
+      for (int level = 0; level < levels; ++level) {
+        // Only slots after the current one can be occupied, the rest of this level is in the past
+        auto current = slot_of(_tick, level);
+        auto later = current + 1 < slots ? _occupied[level] & (~std::uint64_t {0} << (current + 1)) : 0;
+        if (!later) {
+          continue;
+        }
+
+        auto shift = level_shift(level + 1);
+        auto tick = (_tick >> shift << shift) | ((std::uint64_t) std::countr_zero(later) << level_shift(level));
+        if (!result || tick < *result) {
+          result = tick;
+        }
+      }
+
+      if (_heads[overflow_list]) {
+        // The overflow is sorted into the wheel when the top level wraps around
+        auto shift = level_shift(levels);
+        auto tick = ((_tick >> shift) + 1) << shift;
+        if (!result || tick < *result) {
+          result = tick;
+        }
+      }
+
+      return result;
+    }
+
+    /**
+     * @brief Move the wheel to the given time, expiring and cascading timers on the way.
+     */
+    void advance(clock::time_point now) {
+      const auto target = to_tick(now, false);
+
+      while (_tick < target) {
+        auto tick = next_tick();
+        if (!tick || *tick > target) {
+          _tick = target;
+          return;
+        }
+        _tick = *tick;
+
+        if (_tick % (std::uint64_t {1} << level_shift(levels)) == 0) {
+          relink(overflow_list);
+        }
+
+        // Cascade from the top, so timers land in the lowest level that fits them
+        for (int level = levels - 1; level > 0; --level) {
+          if (_tick % (std::uint64_t {1} << level_shift(level)) == 0) {
+            relink(level * slots + slot_of(_tick, level));
+          }
+        }
+
+        relink(slot_of(_tick, 0));
+      }
+    }
+
+    void relink(int list) {
+      auto timer = _heads[list];
+
+      _heads[list] = nullptr;
+      if (list < overflow_list) {
+        _occupied[list / slots] &= ~(std::uint64_t {1} << (list % slots));
+      }
+
+      while (timer) {
+        auto next = timer->next;
+        link(*timer);
+        timer = next;
+      }
+    }
+
+    clock::time_point _origin;
+
+    // Every timer whose tick is not after the current tick is in the expired list
+    std::uint64_t _tick = 0;
+
+    // The nodes of an unordered_map don't move, so the lists can link them directly
+    std::unordered_map<id_t, timer_t> _timers;
+
+    std::array<timer_t *, expired_list + 1> _heads {};
+    timer_t *_expired_tail = nullptr;
+    std::array<std::uint64_t, levels> _occupied {};
+  };
+}  // namespace task_pool_util
@@ -5,13 +5,19 @@
 // standard includes
 #include <atomic>
 #include <bitset>
+#include <filesystem>
 #include <list>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
 #include <thread>
 
 // lib includes
 #include <boost/pointer_cast.hpp>
+#include <nlohmann/json.hpp>
 
 extern "C" {
+#include <libavutil/avutil.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/mastering_display_metadata.h>
 #include <libavutil/opt.h>
@@ -23,13 +29,16 @@ extern "C" {
 #include "cbs.h"
 #include "config.h"
 #include "display_device.h"
+#include "file_handler.h"
 #include "globals.h"
+#include "image_pool.h"
 #include "input.h"
 #include "logging.h"
 #include "nvenc/nvenc_base.h"
 #include "platform/common.h"
 #include "sync.h"
 #include "video.h"
+#include "video_convert.h"
 
 #ifdef _WIN32
   #include "platform/windows/virtual_display.h"
@@ -139,20 +148,24 @@ namespace video {
       // If we need to add aspect ratio padding, we need to scale into an intermediate output buffer
       bool requires_padding = (sw_frame->width != sws_output_frame->width || sw_frame->height != sws_output_frame->height);
 
-      // Setup the input frame using the caller's img_t
-      sws_input_frame->data[0] = img.data;
-      sws_input_frame->linesize[0] = img.row_pitch;
+      if (converter) {
+        convert_direct(img);
+      } else {
+        // Setup the input frame using the caller's img_t
+        sws_input_frame->data[0] = img.data;
+        sws_input_frame->linesize[0] = img.row_pitch;
 
-      // Perform color conversion and scaling to the final size
-      auto status = sws_scale_frame(sws.get(), requires_padding ? sws_output_frame.get() : sw_frame.get(), sws_input_frame.get());
-      if (status < 0) {
-        char string[AV_ERROR_MAX_STRING_SIZE];
-        BOOST_LOG(error) << "Couldn't scale frame: "sv << av_make_error_string(string, AV_ERROR_MAX_STRING_SIZE, status);
-        return -1;
+        // Perform color conversion and scaling to the final size
+        auto status = sws_scale_frame(sws.get(), requires_padding ? sws_output_frame.get() : sw_frame.get(), sws_input_frame.get());
+        if (status < 0) {
+          char string[AV_ERROR_MAX_STRING_SIZE];
+          BOOST_LOG(error) << "Couldn't scale frame: "sv << av_make_error_string(string, AV_ERROR_MAX_STRING_SIZE, status);
+          return -1;
+        }
       }
 
       // If we require aspect ratio padding, copy the output frame into the final padded frame
-      if (requires_padding) {
+      if (requires_padding && !converter) {
         auto fmt_desc = av_pix_fmt_desc_get((AVPixelFormat) sws_output_frame->format);
         auto planes = av_pix_fmt_count_planes((AVPixelFormat) sws_output_frame->format);
         for (int plane = 0; plane < planes; plane++) {
@@ -181,6 +194,45 @@ namespace video {
       return 0;
     }
 
+    /**
+     * @brief Convert the image straight into the padded frame, splitting the rows between the workers.
+     */
+    void convert_direct(platf::img_t &img) {
+      auto fmt_desc = av_pix_fmt_desc_get((AVPixelFormat) sw_frame->format);
+
+      std::uint8_t *planes[3] {};
+      int pitches[3] {};
+      for (int plane = 0; plane < av_pix_fmt_count_planes((AVPixelFormat) sw_frame->format); plane++) {
+        auto shift_h = plane == 0 ? 0 : fmt_desc->log2_chroma_h;
+        auto shift_w = plane == 0 ? 0 : fmt_desc->log2_chroma_w;
+
+        planes[plane] = sw_frame->data[plane] + ((offsetW >> shift_w) * fmt_desc->comp[plane].step) + (offsetH >> shift_h) * sw_frame->linesize[plane];
+        pitches[plane] = sw_frame->linesize[plane];
+      }
+
+      auto width = sws_input_frame->width;
+      auto height = sws_input_frame->height;
+      auto convert_band = [&](int first_row, int last_row) {
+        converter->convert(img.data, img.row_pitch, width, height, planes, pitches, first_row, last_row);
+      };
+
+      // Bands must start on a row where a row of chroma starts
+      auto bands = convert_pool ? config::video.min_threads : 1;
+      auto alignment = converter->row_alignment();
+      auto band_height = std::max((height / bands + alignment - 1) / alignment * alignment, alignment);
+
+      // The first band is converted on this thread while the workers convert the others
+      std::vector<std::future<void>> pending_bands;
+      for (int row = band_height; row < height; row += band_height) {
+        pending_bands.emplace_back(convert_pool->push(convert_band, row, std::min(row + band_height, height)));
+      }
+      convert_band(0, std::min(band_height, height));
+
+      for (auto &pending_band : pending_bands) {
+        pending_band.wait();
+      }
+    }
+
     int set_frame(AVFrame *frame, AVBufferRef *hw_frames_ctx) override {
       this->frame = frame;
 
@@ -201,6 +253,10 @@ namespace video {
     void apply_colorspace() override {
       auto avcodec_colorspace = avcodec_colorspace_from_sunshine_colorspace(colorspace);
       sws_setColorspaceDetails(sws.get(), sws_getCoefficients(SWS_CS_DEFAULT), 0, sws_getCoefficients(avcodec_colorspace.software_format), avcodec_colorspace.range - 1, 0, 1 << 16, 1 << 16);
+
+      if (direct_conversion) {
+        converter.emplace((AVPixelFormat) sws_output_frame->format, colorspace);
+      }
     }
 
     /**
@@ -281,6 +337,19 @@ namespace video {
         return -1;
       }
 
+      // Without scaling, common formats are converted without swscale straight into the padded frame.
+      // Subsampled chroma can only be written from an offset aligned to the chroma samples.
+      auto fmt_desc = av_pix_fmt_desc_get(format);
+      direct_conversion = out_width == in_width && out_height == in_height && bgr0_converter_t::supports(format) &&
+                          offsetW % (1 << fmt_desc->log2_chroma_w) == 0 && offsetH % (1 << fmt_desc->log2_chroma_h) == 0;
+      if (direct_conversion) {
+        BOOST_LOG(debug) << "Converting frames with "sv << bgr0_converter_t::isa() << " instead of swscale"sv;
+
+        if (config::video.min_threads > 1) {
+          convert_pool.emplace(config::video.min_threads - 1);
+        }
+      }
+
       return 0;
     }
 
@@ -295,6 +364,13 @@ namespace video {
     // Offset of input image to output frame in pixels
     int offsetW;
     int offsetH;
+
+    // Set when swscale isn't needed, the converter is created once the colorspace is known
+    bool direct_conversion {};
+    std::optional<bgr0_converter_t> converter;
+
+    // Workers converting bands of rows, in addition to the thread calling convert()
+    std::optional<thread_pool_util::ThreadPool> convert_pool;
   };
 
   enum flag_e : uint32_t {
@@ -312,6 +388,26 @@ namespace video {
     ASYNC_TEARDOWN = 1 << 11,  ///< Encoder supports async teardown on a different thread
   };
 
+  /**
+   * @brief Check whether an FFmpeg encoder applies bitrate changes of its context to the next frame.
+   * @details Other encoders only read the bitrate when they are opened.
+   * @param codec The encoder.
+   * @return `true` if the bitrate can be changed on the fly.
+   */
+  bool supports_dynamic_bitrate(const AVCodec *codec) {
+    static constexpr std::string_view codec_names[] {
+      "libx264"sv,
+      "h264_nvenc"sv,
+      "hevc_nvenc"sv,
+      "av1_nvenc"sv,
+      "h264_qsv"sv,
+      "hevc_qsv"sv,
+      "av1_qsv"sv,
+    };
+
+    return codec && std::find(std::begin(codec_names), std::end(codec_names), codec->name) != std::end(codec_names);
+  }
+
   class avcodec_encode_session_t: public encode_session_t {
   public:
     avcodec_encode_session_t() = default;
@@ -377,6 +473,28 @@ namespace video {
       request_idr_frame();
     }
 
+    bool set_bitrate(int bitrate) override {
+      auto ctx = avcodec_ctx.get();
+      if (!ctx || ctx->rc_max_rate <= 0 || !supports_dynamic_bitrate(ctx->codec)) {
+        return false;
+      }
+
+      auto new_max_rate = (std::int64_t) bitrate * 1000;
+      auto old_max_rate = ctx->rc_max_rate;
+
+      // Keep what make_avcodec_encode_session() derived from the bitrate, like the offset forcing VBR mode
+      ctx->bit_rate = new_max_rate - (old_max_rate - ctx->bit_rate);
+      if (ctx->rc_min_rate) {
+        ctx->rc_min_rate = new_max_rate;
+      }
+      if (ctx->rc_buffer_size) {
+        ctx->rc_buffer_size = (int) (ctx->rc_buffer_size * new_max_rate / old_max_rate);
+      }
+      ctx->rc_max_rate = new_max_rate;
+
+      return true;
+    }
+
     avcodec_ctx_t avcodec_ctx;
     std::unique_ptr<platf::avcodec_encode_device_t> device;
 
@@ -420,6 +538,14 @@ namespace video {
       }
     }
 
+    bool set_bitrate(int bitrate) override {
+      if (!device || !device->nvenc) {
+        return false;
+      }
+
+      return device->nvenc->set_bitrate(bitrate);
+    }
+
     nvenc::nvenc_encoded_frame encode_frame(uint64_t frame_index) {
       if (!device || !device->nvenc) {
         return {};
@@ -438,8 +564,9 @@ namespace video {
   struct sync_session_ctx_t {
     safe::signal_t *join_event;
     safe::mail_raw_t::event_t<bool> shutdown_event;
-    safe::mail_raw_t::queue_t<packet_t> packets;
+    safe::mail_raw_t::ring_t<packet_t> packets;
     safe::mail_raw_t::event_t<bool> idr_events;
+    safe::mail_raw_t::event_t<int> bitrate_events;
     safe::mail_raw_t::event_t<hdr_info_t> hdr_events;
     safe::mail_raw_t::event_t<input::touch_port_t> touch_port_events;
 
@@ -483,6 +610,9 @@ namespace video {
   auto capture_thread_async = safe::make_shared<capture_thread_async_ctx_t>(start_capture_async, end_capture_async);
   auto capture_thread_sync = safe::make_shared<capture_thread_sync_ctx_t>(start_capture_sync, end_capture_sync);
 
+  // Encoders offered to other sessions when config::video.shared_encode is enabled
+  sync_util::sync_t<std::vector<std::shared_ptr<shared_encode_t>>> shared_encodes;
+
 #ifdef _WIN32
   encoder_t nvenc {
     "nvenc"sv,
@@ -1059,6 +1189,10 @@ namespace video {
   };
 
   static encoder_t *chosen_encoder;
+
+  // Held shared while a session captures, and exclusively while probing in the background replaces the chosen encoder
+  static std::shared_mutex encoder_lock;
+
   int active_hevc_mode;
   int active_av1_mode;
   bool last_encoder_probe_supported_ref_frames_invalidation = false;
@@ -1194,106 +1328,41 @@ namespace video {
 
     display_wp = disp;
 
+    // Images are reused once every session is done with them
     constexpr auto capture_buffer_size = 12;
-    std::list<std::shared_ptr<platf::img_t>> imgs(capture_buffer_size);
-
-    std::vector<std::optional<std::chrono::steady_clock::time_point>> imgs_used_timestamps;
-    const std::chrono::seconds trim_timeot = 3s;
-    auto trim_imgs = [&]() {
-      // count allocated and used within current pool
-      size_t allocated_count = 0;
-      size_t used_count = 0;
-      for (const auto &img : imgs) {
-        if (img) {
-          allocated_count += 1;
-          if (img.use_count() > 1) {
-            used_count += 1;
-          }
-        }
-      }
-
-      // remember the timestamp of currently used count
-      const auto now = std::chrono::steady_clock::now();
-      if (imgs_used_timestamps.size() <= used_count) {
-        imgs_used_timestamps.resize(used_count + 1);
-      }
-      imgs_used_timestamps[used_count] = now;
+    image_pool_t imgs(capture_buffer_size, 3s, [&]() {
+      return disp->alloc_img();
+    });
 
-      // decide whether to trim allocated unused above the currently used count
-      // based on last used timestamp and universal timeout
-      size_t trim_target = used_count;
-      for (size_t i = used_count; i < imgs_used_timestamps.size(); i++) {
-        if (imgs_used_timestamps[i] && now - *imgs_used_timestamps[i] < trim_timeot) {
-          trim_target = i;
-        }
+    auto log_exhaustion = util::fail_guard([&]() {
+      if (auto exhausted = imgs.exhausted_count()) {
+        BOOST_LOG(info) << "Capture waited for a free image "sv << exhausted << " times for a total of "sv
+                        << std::chrono::duration_cast<std::chrono::milliseconds>(imgs.exhausted_wait()).count() << "ms"sv;
       }
-
-      // trim allocated unused above the newly decided trim target
-      if (allocated_count > trim_target) {
-        size_t to_trim = allocated_count - trim_target;
-        // prioritize trimming least recently used
-        for (auto it = imgs.rbegin(); it != imgs.rend(); it++) {
-          auto &img = *it;
-          if (img && img.use_count() == 1) {
-            img.reset();
-            to_trim -= 1;
-            if (to_trim == 0) {
-              break;
-            }
-          }
-        }
-        // forget timestamps that no longer relevant
-        imgs_used_timestamps.resize(trim_target + 1);
-      }
-    };
+    });
 
     auto pull_free_image_callback = [&](std::shared_ptr<platf::img_t> &img_out) -> bool {
+      // The previous image may be the one to free up the pool
       img_out.reset();
-      while (capture_ctx_queue->running()) {
-        // pick first allocated but unused
-        for (auto it = imgs.begin(); it != imgs.end(); it++) {
-          if (*it && it->use_count() == 1) {
-            img_out = *it;
-            if (it != imgs.begin()) {
-              // move image to the front of the list to prioritize its reusal
-              imgs.erase(it);
-              imgs.push_front(img_out);
-            }
-            break;
-          }
-        }
-        // otherwise pick first unallocated
-        if (!img_out) {
-          for (auto it = imgs.begin(); it != imgs.end(); it++) {
-            if (!*it) {
-              // allocate image
-              *it = disp->alloc_img();
-              img_out = *it;
-              if (it != imgs.begin()) {
-                // move image to the front of the list to prioritize its reusal
-                imgs.erase(it);
-                imgs.push_front(img_out);
-              }
-              break;
-            }
-          }
-        }
-        if (img_out) {
-          // trim allocated but unused portion of the pool based on timeouts
-          trim_imgs();
-          img_out->frame_timestamp.reset();
-          return true;
-        } else {
-          // sleep and retry if image pool is full
-          std::this_thread::sleep_for(1ms);
-        }
+
+      img_out = imgs.pull([&]() {
+        return capture_ctx_queue->running();
+      });
+      if (!img_out) {
+        return false;
       }
-      return false;
+
+      img_out->frame_timestamp.reset();
+      return true;
     };
 
     // Capture takes place on this thread
     platf::adjust_thread_priority(platf::thread_priority_e::critical);
 
+    // Displays that track damage only deliver images when something changed, so sessions
+    // joining while nothing changes start from the last image instead
+    std::shared_ptr<platf::img_t> last_img;
+
     while (capture_ctx_queue->running()) {
       bool artificial_reinit = false;
 
@@ -1312,12 +1381,19 @@ namespace video {
           ++capture_ctx;
         })
 
+        if (frame_captured) {
+          last_img = img;
+        }
+
         if (!capture_ctx_queue->running()) {
           return false;
         }
 
         while (capture_ctx_queue->peek()) {
-          capture_ctxs.emplace_back(std::move(*capture_ctx_queue->pop()));
+          auto &capture_ctx = capture_ctxs.emplace_back(std::move(*capture_ctx_queue->pop()));
+          if (last_img) {
+            capture_ctx.images->raise(last_img);
+          }
         }
 
         if (switch_display_event->peek()) {
@@ -1342,9 +1418,8 @@ namespace video {
             reinit_event.raise(true);
 
             // Some classes of images contain references to the display --> display won't delete unless img is deleted
-            for (auto &img : imgs) {
-              img.reset();
-            }
+            imgs.clear();
+            last_img.reset();
 
             // display_wp is modified in this thread only
             // Wait for the other shared_ptr's of display to be destroyed.
@@ -1411,7 +1486,85 @@ namespace video {
     }
   }
 
-  int encode_avcodec(int64_t frame_nr, avcodec_encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
+  /**
+   * @brief Find the shared encoder owned by a session.
+   * @param owner The channel data of the owning session.
+   * @return The shared encoder, or nullptr if the session does not share its encoder.
+   * @note The caller must hold the lock of `shared_encodes`.
+   */
+  shared_encode_t *find_shared_encode(void *owner) {
+    for (auto &shared : *shared_encodes) {
+      if (shared->owner == owner) {
+        return shared.get();
+      }
+    }
+
+    return nullptr;
+  }
+
+  /**
+   * @brief Queue an encoded packet for its session and for every session viewing the same encoder.
+   * @param packets The queue of the video broadcast thread.
+   * @param packet The packet encoded for the owning session.
+   */
+  void raise_packet(safe::mail_raw_t::ring_t<packet_t> &packets, packet_t &&packet) {
+    if (config::video.shared_encode) {
+      auto lg = shared_encodes.lock();
+
+      auto shared = find_shared_encode(packet->channel_data);
+      if (shared && !shared->viewers.empty()) {
+        // The broadcast thread only reads the payload, so all sessions share the encoded packet
+        std::shared_ptr<packet_raw_t> encoded = std::move(packet);
+        for (auto &viewer : shared->viewers) {
+          if (!viewer.frame_offset) {
+            // Wait for the IDR frame requested when the viewer joined
+            if (!encoded->is_idr()) {
+              continue;
+            }
+
+            viewer.frame_offset = encoded->frame_index() - viewer.frame_nr;
+          }
+
+          auto view = std::make_unique<packet_raw_shared>(encoded, encoded->frame_index() - *viewer.frame_offset, viewer.channel_data);
+          viewer.frame_nr = view->index + 1;
+          packets->raise(std::move(view));
+        }
+
+        packets->raise(std::make_unique<packet_raw_shared>(encoded, encoded->frame_index(), encoded->channel_data));
+        return;
+      }
+    }
+
+    packets->raise(std::move(packet));
+  }
+
+  /**
+   * @brief Remember the display state of a shared encoder and forward it to its viewers.
+   * @param owner The channel data of the owning session.
+   * @param touch_port The touch port sent to the owner.
+   * @param hdr_info The HDR state sent to the owner.
+   */
+  void share_display_state(void *owner, const input::touch_port_t &touch_port, const hdr_info_raw_t &hdr_info) {
+    if (!config::video.shared_encode) {
+      return;
+    }
+
+    auto lg = shared_encodes.lock();
+
+    auto shared = find_shared_encode(owner);
+    if (!shared) {
+      return;
+    }
+
+    shared->touch_port = touch_port;
+    shared->hdr_info = hdr_info;
+    for (auto &viewer : shared->viewers) {
+      viewer.touch_port_events->raise(touch_port);
+      viewer.hdr_events->raise(std::make_unique<hdr_info_raw_t>(hdr_info));
+    }
+  }
+
+  int encode_avcodec(int64_t frame_nr, avcodec_encode_session_t &session, safe::mail_raw_t::ring_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp, const stat_trackers::frame_trace_t &trace) {
     auto &frame = session.device->frame;
     frame->pts = frame_nr;
 
@@ -1421,6 +1574,7 @@ namespace video {
     auto &vps = session.vps;
 
     // send the frame to the encoder
+    auto encode_submitted = std::chrono::steady_clock::now();
     auto ret = avcodec_send_frame(ctx.get(), frame);
     if (ret < 0) {
       char err_str[AV_ERROR_MAX_STRING_SIZE] {0};
@@ -1439,6 +1593,7 @@ namespace video {
       } else if (ret < 0) {
         return ret;
       }
+      packet->trace.encoded = std::chrono::steady_clock::now();
 
       if (av_packet->flags & AV_PKT_FLAG_KEY) {
         BOOST_LOG(debug) << "Frame "sv << frame_nr << ": IDR Keyframe (AV_FRAME_FLAG_KEY)"sv;
@@ -1473,19 +1628,24 @@ namespace video {
         );
       }
 
+      // The encoder may output packets of earlier frames, their trace is unknown here
       if (av_packet && av_packet->pts == frame_nr) {
         packet->frame_timestamp = frame_timestamp;
+        packet->trace.captured = trace.captured;
+        packet->trace.converted = trace.converted;
+        packet->trace.encode_submitted = encode_submitted;
       }
 
       packet->replacements = &session.replacements;
       packet->channel_data = channel_data;
-      packets->raise(std::move(packet));
+      raise_packet(packets, std::move(packet));
     }
 
     return 0;
   }
 
-  int encode_nvenc(int64_t frame_nr, nvenc_encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
+  int encode_nvenc(int64_t frame_nr, nvenc_encode_session_t &session, safe::mail_raw_t::ring_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp, const stat_trackers::frame_trace_t &trace) {
+    auto encode_submitted = std::chrono::steady_clock::now();
     auto encoded_frame = session.encode_frame(frame_nr);
     if (encoded_frame.data.empty()) {
       BOOST_LOG(error) << "NvENC returned empty packet";
@@ -1500,16 +1660,23 @@ namespace video {
     packet->channel_data = channel_data;
     packet->after_ref_frame_invalidation = encoded_frame.after_ref_frame_invalidation;
     packet->frame_timestamp = frame_timestamp;
-    packets->raise(std::move(packet));
+    packet->trace = trace;
+    packet->trace.encode_submitted = encode_submitted;
+    packet->trace.encoded = std::chrono::steady_clock::now();
+    raise_packet(packets, std::move(packet));
 
     return 0;
   }
 
-  int encode(int64_t frame_nr, encode_session_t &session, safe::mail_raw_t::queue_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp) {
+  /**
+   * @brief Encode the image currently loaded into the session and queue the resulting packets.
+   * @param trace When the image was captured and converted, copied into the trace of the packets.
+   */
+  int encode(int64_t frame_nr, encode_session_t &session, safe::mail_raw_t::ring_t<packet_t> &packets, void *channel_data, std::optional<std::chrono::steady_clock::time_point> frame_timestamp, const stat_trackers::frame_trace_t &trace) {
     if (auto avcodec_session = dynamic_cast<avcodec_encode_session_t *>(&session)) {
-      return encode_avcodec(frame_nr, *avcodec_session, packets, channel_data, frame_timestamp);
+      return encode_avcodec(frame_nr, *avcodec_session, packets, channel_data, frame_timestamp, trace);
     } else if (auto nvenc_session = dynamic_cast<nvenc_encode_session_t *>(&session)) {
-      return encode_nvenc(frame_nr, *nvenc_session, packets, channel_data, frame_timestamp);
+      return encode_nvenc(frame_nr, *nvenc_session, packets, channel_data, frame_timestamp, trace);
     }
 
     return -1;
@@ -1907,11 +2074,32 @@ namespace video {
     return nullptr;
   }
 
+  /**
+   * @brief Apply a bitrate requested by the congestion control of the stream.
+   * @param session The encode session.
+   * @param config The configuration of the session, encoders created after a reinit start at the new bitrate.
+   * @param bitrate The new bitrate in Kbps.
+   */
+  void apply_bitrate(encode_session_t &session, config_t &config, int bitrate) {
+    config.bitrate = bitrate;
+
+    if (session.set_bitrate(bitrate)) {
+      BOOST_LOG(debug) << "Encoder bitrate changed to "sv << bitrate << " Kbps"sv;
+      return;
+    }
+
+    // Reinitializing the encoder would cost an IDR frame, which is what adapting the bitrate tries to avoid
+    static std::once_flag warning_logged;
+    std::call_once(warning_logged, []() {
+      BOOST_LOG(warning) << "Encoder can't change its bitrate on the fly, adaptive bitrate only adjusts FEC"sv;
+    });
+  }
+
   void encode_run(
     int &frame_nr,  // Store progress of the frame number
     safe::mail_t mail,
     img_event_t images,
-    config_t config,
+    config_t &config,  // Store the bitrate set by congestion control
     std::shared_ptr<platf::display_t> disp,
     std::unique_ptr<platf::encode_device_t> encode_device,
     safe::signal_t &reinit_event,
@@ -1950,9 +2138,10 @@ namespace video {
     BOOST_LOG(info) << "Encoding Frame threshold: "sv << encode_frame_threshold;
 
     auto shutdown_event = mail->event<bool>(mail::shutdown);
-    auto packets = mail::man->queue<packet_t>(mail::video_packets);
+    auto packets = mail::man->ring<packet_t>(mail::video_packets);
     auto idr_events = mail->event<bool>(mail::idr);
     auto invalidate_ref_frames_events = mail->event<std::pair<int64_t, int64_t>>(mail::invalidate_ref_frames);
+    auto bitrate_events = mail->event<int>(mail::bitrate);
 
     {
       // Load a dummy image into the AVFrame to ensure we have something to encode
@@ -1969,7 +2158,7 @@ namespace video {
       BOOST_LOG(info) << "Input only session, video will not be captured."sv;
 
       // Encode the dummy img only once
-      if (encode(frame_nr++, *session, packets, channel_data, std::chrono::steady_clock::now())) {
+      if (encode(frame_nr++, *session, packets, channel_data, std::chrono::steady_clock::now(), {})) {
         BOOST_LOG(error) << "Could not encode dummy video packet"sv;
         return;
       }
@@ -2015,7 +2204,14 @@ namespace video {
         session->request_idr_frame();
       }
 
+      if (bitrate_events->peek()) {
+        if (auto bitrate = bitrate_events->pop(0ms)) {
+          apply_bitrate(*session, config, *bitrate);
+        }
+      }
+
       std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
+      stat_trackers::frame_trace_t trace;
 
       // Encode at a minimum FPS to avoid image quality issues with static content
       if (!requested_idr_frame || images->peek()) {
@@ -2041,6 +2237,8 @@ namespace video {
             BOOST_LOG(error) << "Could not convert image"sv;
             break;
           }
+          trace.captured = current_timestamp;
+          trace.converted = std::chrono::steady_clock::now();
 
           if (time_diff < frame_variation_threshold) {
             *frame_timestamp = encode_frame_timestamp;
@@ -2054,7 +2252,7 @@ namespace video {
         }
       }
 
-      if (encode(frame_nr++, *session, packets, channel_data, frame_timestamp)) {
+      if (encode(frame_nr++, *session, packets, channel_data, frame_timestamp, trace)) {
         BOOST_LOG(error) << "Could not encode video packet"sv;
         break;
       }
@@ -2155,7 +2353,8 @@ namespace video {
     }
 
     // absolute mouse coordinates require that the dimensions of the screen are known
-    ctx.touch_port_events->raise(make_port(disp, ctx.config));
+    auto touch_port = make_port(disp, ctx.config);
+    ctx.touch_port_events->raise(touch_port);
 
     // Update client with our current HDR display state
     hdr_info_t hdr_info = std::make_unique<hdr_info_raw_t>(false);
@@ -2166,6 +2365,7 @@ namespace video {
         BOOST_LOG(error) << "Couldn't get display hdr metadata when colorspace selection indicates it should have one";
       }
     }
+    share_display_state(ctx.channel_data, touch_port, *hdr_info);
     ctx.hdr_events->raise(std::move(hdr_info));
 
     auto session = make_encode_session(disp, encoder, ctx.config, img.width, img.height, std::move(encode_device));
@@ -2283,6 +2483,12 @@ namespace video {
             ctx->idr_events->pop();
           }
 
+          if (ctx->bitrate_events->peek()) {
+            if (auto bitrate = ctx->bitrate_events->pop(0ms)) {
+              apply_bitrate(*pos->session, ctx->config, *bitrate);
+            }
+          }
+
           if (frame_captured && pos->session->convert(*img)) {
             BOOST_LOG(error) << "Could not convert image"sv;
             ctx->shutdown_event->raise(true);
@@ -2295,7 +2501,13 @@ namespace video {
             frame_timestamp = img->frame_timestamp;
           }
 
-          if (encode(ctx->frame_nr++, *pos->session, ctx->packets, ctx->channel_data, frame_timestamp)) {
+          stat_trackers::frame_trace_t trace;
+          if (frame_captured && frame_timestamp) {
+            trace.captured = *frame_timestamp;
+            trace.converted = std::chrono::steady_clock::now();
+          }
+
+          if (encode(ctx->frame_nr++, *pos->session, ctx->packets, ctx->channel_data, frame_timestamp, trace)) {
             BOOST_LOG(error) << "Could not encode video packet"sv;
             ctx->shutdown_event->raise(true);
 
@@ -2363,10 +2575,94 @@ namespace video {
     while (encode_run_sync(synced_session_ctxs, ctx, display_names, display_p) == encode_e::reinit) {}
   }
 
+  std::shared_ptr<shared_encode_t> join_shared_encode(safe::mail_t &mail, const config_t &config, const std::string &display_name, void *channel_data, int &frame_nr) {
+    auto shutdown_event = mail->event<bool>(mail::shutdown);
+    auto idr_events = mail->event<bool>(mail::idr);
+    auto invalidate_ref_frames_events = mail->event<std::pair<int64_t, int64_t>>(mail::invalidate_ref_frames);
+
+    while (!shutdown_event->peek()) {
+      std::shared_ptr<shared_encode_t> shared;
+      {
+        auto lg = shared_encodes.lock();
+
+        auto it = std::find_if(std::begin(*shared_encodes), std::end(*shared_encodes), [&](auto &shared) {
+          return shared->config == config && shared->display_name == display_name;
+        });
+        if (it == std::end(*shared_encodes)) {
+          // Nobody else encodes this configuration yet
+          shared = std::make_shared<shared_encode_t>();
+          shared->config = config;
+          shared->display_name = display_name;
+          shared->owner = channel_data;
+          shared->idr_events = std::move(idr_events);
+          shared_encodes->emplace_back(shared);
+
+          return shared;
+        }
+
+        shared = *it;
+        auto &viewer = shared->viewers.emplace_back(shared_viewer_t {
+          channel_data,
+          mail->event<hdr_info_t>(mail::hdr),
+          mail->event<input::touch_port_t>(mail::touch_port),
+          frame_nr,
+          std::nullopt,
+        });
+
+        if (shared->touch_port) {
+          viewer.touch_port_events->raise(*shared->touch_port);
+        }
+        if (shared->hdr_info) {
+          viewer.hdr_events->raise(std::make_unique<hdr_info_raw_t>(*shared->hdr_info));
+        }
+      }
+
+      BOOST_LOG(info) << "Sharing the video encoder of another session"sv;
+
+      // The viewer can only start decoding at an IDR frame
+      shared->idr_events->raise(true);
+
+      while (!shutdown_event->peek() && !shared->stopped) {
+        auto requested_idr_frame = false;
+
+        while (invalidate_ref_frames_events->peek()) {
+          invalidate_ref_frames_events->pop(0ms);
+          requested_idr_frame = true;
+        }
+
+        if (idr_events->pop(10ms)) {
+          requested_idr_frame = true;
+        }
+
+        if (requested_idr_frame) {
+          shared->idr_events->raise(true);
+        }
+      }
+
+      auto lg = shared_encodes.lock();
+
+      auto viewer = std::find_if(std::begin(shared->viewers), std::end(shared->viewers), [channel_data](auto &viewer) {
+        return viewer.channel_data == channel_data;
+      });
+      frame_nr = (int) viewer->frame_nr;
+      shared->viewers.erase(viewer);
+    }
+
+    return nullptr;
+  }
+
+  void stop_shared_encode(const std::shared_ptr<shared_encode_t> &shared) {
+    auto lg = shared_encodes.lock();
+
+    std::erase(*shared_encodes, shared);
+    shared->stopped = true;
+  }
+
   void capture_async(
     safe::mail_t mail,
     config_t &config,
-    void *channel_data
+    void *channel_data,
+    int frame_nr
   ) {
     auto shutdown_event = mail->event<bool>(mail::shutdown);
 
@@ -2387,8 +2683,6 @@ namespace video {
       return;
     }
 
-    int frame_nr = 1;
-
     auto touch_port_event = mail->event<input::touch_port_t>(mail::touch_port);
     auto hdr_event = mail->event<hdr_info_t>(mail::hdr);
 
@@ -2420,7 +2714,8 @@ namespace video {
       }
 
       // absolute mouse coordinates require that the dimensions of the screen are known
-      touch_port_event->raise(make_port(display.get(), config));
+      auto touch_port = make_port(display.get(), config);
+      touch_port_event->raise(touch_port);
 
       // Update client with our current HDR display state
       hdr_info_t hdr_info = std::make_unique<hdr_info_raw_t>(false);
@@ -2431,6 +2726,7 @@ namespace video {
           BOOST_LOG(error) << "Couldn't get display hdr metadata when colorspace selection indicates it should have one";
         }
       }
+      share_display_state(channel_data, touch_port, *hdr_info);
       hdr_event->raise(std::move(hdr_info));
 
       encode_run(
@@ -2447,28 +2743,64 @@ namespace video {
     }
   }
 
+  /**
+   * @brief Get the name of the display that a capture started now would use.
+   * @return The display of the running app, or the configured output if no app chose one.
+   */
+  std::string capture_display_name() {
+    if (!proc::proc.display_name.empty()) {
+      return proc::proc.display_name;
+    }
+
+    return display_device::map_output_name(config::video.output_name);
+  }
+
   void capture(
     safe::mail_t mail,
     config_t config,
     void *channel_data
   ) {
+    // Don't let the chosen encoder be replaced while this session captures with it
+    std::shared_lock encoder_lg {encoder_lock};
+    if (!chosen_encoder) {
+      BOOST_LOG(error) << "No working encoder was found, unable to capture"sv;
+      return;
+    }
+
     auto idr_events = mail->event<bool>(mail::idr);
 
+    int frame_nr = 1;
+
+    // Input only sessions never encode more than a single frame, so there is nothing to share
+    std::shared_ptr<shared_encode_t> shared;
+    if (config::video.shared_encode && !config.input_only) {
+      shared = join_shared_encode(mail, config, capture_display_name(), channel_data, frame_nr);
+      if (!shared) {
+        return;
+      }
+    }
+    auto shared_fg = util::fail_guard([&shared]() {
+      if (shared) {
+        stop_shared_encode(shared);
+      }
+    });
+
     idr_events->raise(true);
     if (chosen_encoder->flags & PARALLEL_ENCODING) {
-      capture_async(std::move(mail), config, channel_data);
+      capture_async(std::move(mail), config, channel_data, frame_nr);
     } else {
       safe::signal_t join_event;
       auto ref = capture_thread_sync.ref();
       ref->encode_session_ctx_queue.raise(sync_session_ctx_t {
         &join_event,
         mail->event<bool>(mail::shutdown),
-        mail::man->queue<packet_t>(mail::video_packets),
+        mail::man->ring<packet_t>(mail::video_packets),
         std::move(idr_events),
+        mail->event<int>(mail::bitrate),
         mail->event<hdr_info_t>(mail::hdr),
         mail->event<input::touch_port_t>(mail::touch_port),
         config,
-        1,
+        frame_nr,
         channel_data,
       });
 
@@ -2502,9 +2834,10 @@ namespace video {
 
     session->request_idr_frame();
 
-    auto packets = mail::man->queue<packet_t>(mail::video_packets);
+    // Use a private mailbox, since other encoders may be validated at the same time
+    auto packets = std::make_shared<safe::mail_raw_t>()->ring<packet_t>(mail::video_packets);
     while (!packets->peek()) {
-      if (encode(1, *session, packets, nullptr, {})) {
+      if (encode(1, *session, packets, nullptr, {}, {})) {
         return -1;
       }
     }
@@ -2533,10 +2866,31 @@ namespace video {
     return flag;
   }
 
-  bool validate_encoder(encoder_t &encoder, bool expect_failure) {
+  // Only one display is created at a time while encoders are validated concurrently
+  static std::mutex validate_display_lock;
+
+  /**
+   * @brief Validate an encoder while other encoders may be validated concurrently.
+   * @param encoder The encoder to validate.
+   * @param expect_failure Whether the encoder is expected to fail.
+   * @param cancel Stops validation early when set, the encoder then fails validation.
+   * @param display_failed Set when no display could be created for the encoder.
+   * @return `true` if the encoder passed validation.
+   */
+  static bool validate_encoder(encoder_t &encoder, bool expect_failure, const std::atomic_bool &cancel, bool &display_failed) {
     const auto output_name {display_device::map_output_name(config::video.output_name)};
     std::shared_ptr<platf::display_t> disp;
 
+    auto reset_validate_display = [&](const config_t &config) {
+      std::lock_guard lg {validate_display_lock};
+      reset_display(disp, encoder.platform_formats->dev_type, output_name, config);
+      display_failed = !disp;
+    };
+
+    auto validate = [&](const config_t &config) {
+      return cancel ? -1 : validate_config(disp, encoder, config);
+    };
+
     BOOST_LOG(info) << "Trying encoder ["sv << encoder.name << ']';
     auto fg = util::fail_guard([&]() {
       BOOST_LOG(info) << "Encoder ["sv << encoder.name << "] failed"sv;
@@ -2554,7 +2908,7 @@ namespace video {
     config_t config_autoselect {1920, 1080, 60, 1000, 1, 0, 1, 0, 0, 0};
 
     // If the encoder isn't supported at all (not even H.264), bail early
-    reset_display(disp, encoder.platform_formats->dev_type, output_name, config_autoselect);
+    reset_validate_display(config_autoselect);
     if (!disp) {
       return false;
     }
@@ -2566,13 +2920,13 @@ namespace video {
 
     // If we're expecting failure, use the autoselect ref config first since that will always succeed
     // if the encoder is available.
-    auto max_ref_frames_h264 = expect_failure ? -1 : validate_config(disp, encoder, config_max_ref_frames);
-    auto autoselect_h264 = max_ref_frames_h264 >= 0 ? max_ref_frames_h264 : validate_config(disp, encoder, config_autoselect);
+    auto max_ref_frames_h264 = expect_failure ? -1 : validate(config_max_ref_frames);
+    auto autoselect_h264 = max_ref_frames_h264 >= 0 ? max_ref_frames_h264 : validate(config_autoselect);
     if (autoselect_h264 < 0) {
       return false;
     } else if (expect_failure) {
       // We expected failure, but actually succeeded. Do the max_ref_frames probe we skipped.
-      max_ref_frames_h264 = validate_config(disp, encoder, config_max_ref_frames);
+      max_ref_frames_h264 = validate(config_max_ref_frames);
     }
 
     std::vector<std::pair<validate_flag_e, encoder_t::flag_e>> packet_deficiencies {
@@ -2591,13 +2945,13 @@ namespace video {
       config_autoselect.videoFormat = 1;
 
       if (disp->is_codec_supported(encoder.hevc.name, config_autoselect)) {
-        auto max_ref_frames_hevc = validate_config(disp, encoder, config_max_ref_frames);
+        auto max_ref_frames_hevc = validate(config_max_ref_frames);
 
         // If H.264 succeeded with max ref frames specified, assume that we can count on
         // HEVC to also succeed with max ref frames specified if HEVC is supported.
         auto autoselect_hevc = (max_ref_frames_hevc >= 0 || max_ref_frames_h264 >= 0) ?
                                  max_ref_frames_hevc :
-                                 validate_config(disp, encoder, config_autoselect);
+                                 validate(config_autoselect);
 
         for (auto [validate_flag, encoder_flag] : packet_deficiencies) {
           encoder.hevc[encoder_flag] = (max_ref_frames_hevc & validate_flag && autoselect_hevc & validate_flag);
@@ -2619,13 +2973,13 @@ namespace video {
       config_autoselect.videoFormat = 2;
 
       if (disp->is_codec_supported(encoder.av1.name, config_autoselect)) {
-        auto max_ref_frames_av1 = validate_config(disp, encoder, config_max_ref_frames);
+        auto max_ref_frames_av1 = validate(config_max_ref_frames);
 
         // If H.264 succeeded with max ref frames specified, assume that we can count on
         // AV1 to also succeed with max ref frames specified if AV1 is supported.
         auto autoselect_av1 = (max_ref_frames_av1 >= 0 || max_ref_frames_h264 >= 0) ?
                                 max_ref_frames_av1 :
-                                validate_config(disp, encoder, config_autoselect);
+                                validate(config_autoselect);
 
         for (auto [validate_flag, encoder_flag] : packet_deficiencies) {
           encoder.av1[encoder_flag] = (max_ref_frames_av1 & validate_flag && autoselect_av1 & validate_flag);
@@ -2648,7 +3002,7 @@ namespace video {
       if (encoder.flags & YUV444_SUPPORT) {
         config_t config_h264_yuv444 {1920, 1080, 60, 1000, 1, 0, 1, 0, 0, 1};
         encoder.h264[encoder_t::YUV444] = disp->is_codec_supported(encoder.h264.name, config_h264_yuv444) &&
-                                          validate_config(disp, encoder, config_h264_yuv444) >= 0;
+                                          validate(config_h264_yuv444) >= 0;
       } else {
         encoder.h264[encoder_t::YUV444] = false;
       }
@@ -2656,7 +3010,7 @@ namespace video {
       const config_t generic_hdr_config = {1920, 1080, 60, 1000, 1, 0, 3, 1, 1, 0};
 
       // Reset the display since we're switching from SDR to HDR
-      reset_display(disp, encoder.platform_formats->dev_type, output_name, generic_hdr_config);
+      reset_validate_display(generic_hdr_config);
       if (!disp) {
         return false;
       }
@@ -2675,7 +3029,7 @@ namespace video {
         config.chromaSamplingType = 1;
         if ((encoder.flags & YUV444_SUPPORT) &&
             disp->is_codec_supported(encoder_codec_name, config) &&
-            validate_config(disp, encoder, config) >= 0) {
+            validate(config) >= 0) {
           flag_map[encoder_t::DYNAMIC_RANGE] = true;
           flag_map[encoder_t::YUV444] = true;
           return;
@@ -2686,7 +3040,7 @@ namespace video {
         // Test 4:2:0 HDR
         config.chromaSamplingType = 0;
         if (disp->is_codec_supported(encoder_codec_name, config) &&
-            validate_config(disp, encoder, config) >= 0) {
+            validate(config) >= 0) {
           flag_map[encoder_t::DYNAMIC_RANGE] = true;
         } else {
           flag_map[encoder_t::DYNAMIC_RANGE] = false;
@@ -2714,19 +3068,130 @@ namespace video {
     return true;
   }
 
-  int probe_encoders() {
-    if (!allow_encoder_probing()) {
-      // Error already logged
-      return -1;
+  bool validate_encoder(encoder_t &encoder, bool expect_failure) {
+    std::atomic_bool cancel {false};
+    bool display_failed = false;
+
+    return validate_encoder(encoder, expect_failure, cancel, display_failed);
+  }
+
+  /**
+   * @brief Fall back to the codecs the chosen encoder supports if it cannot satisfy the configured ones.
+   * @param encoder The chosen encoder.
+   */
+  static void adjust_encoder_constraints(encoder_t *encoder) {
+    // If we can't satisfy both the encoder and codec requirement, prefer the encoder over codec support
+    if (active_hevc_mode == 3 && !encoder->hevc[encoder_t::DYNAMIC_RANGE]) {
+      BOOST_LOG(warning) << "Encoder ["sv << encoder->name << "] does not support HEVC Main10 on this system"sv;
+      active_hevc_mode = 0;
+    } else if (active_hevc_mode == 2 && !encoder->hevc[encoder_t::PASSED]) {
+      BOOST_LOG(warning) << "Encoder ["sv << encoder->name << "] does not support HEVC on this system"sv;
+      active_hevc_mode = 0;
+    }
+
+    if (active_av1_mode == 3 && !encoder->av1[encoder_t::DYNAMIC_RANGE]) {
+      BOOST_LOG(warning) << "Encoder ["sv << encoder->name << "] does not support AV1 Main10 on this system"sv;
+      active_av1_mode = 0;
+    } else if (active_av1_mode == 2 && !encoder->av1[encoder_t::PASSED]) {
+      BOOST_LOG(warning) << "Encoder ["sv << encoder->name << "] does not support AV1 on this system"sv;
+      active_av1_mode = 0;
     }
+  }
 
-    auto encoder_list = encoders;
+  encoder_validator_t::encoder_validator_t(const std::vector<encoder_t *> &encoder_list, encoder_t *previous_encoder):
+      encoder_validator_t(encoder_list, previous_encoder, [](encoder_t &encoder, bool expect_failure, const std::atomic_bool &cancel, bool &display_failed) {
+        return validate_encoder(encoder, expect_failure, cancel, display_failed);
+      }) {
+  }
 
-    // If we already have a good encoder, check to see if another probe is required
-    if (chosen_encoder && !(chosen_encoder->flags & ALWAYS_REPROBE) && !platf::needs_encoder_reenumeration()) {
-      return 0;
+  encoder_validator_t::encoder_validator_t(const std::vector<encoder_t *> &encoder_list, encoder_t *previous_encoder, validate_t validate_fn):
+      previous_encoder {previous_encoder},
+      validate_one {std::move(validate_fn)} {
+    // Validate the encoder chosen by the user first, since it's used if it works
+    auto ordered = encoder_list;
+    std::stable_partition(std::begin(ordered), std::end(ordered), [](auto encoder) {
+      return encoder->name == config::video.encoder;
+    });
+
+    for (auto encoder : ordered) {
+      auto &task = tasks[encoder];
+      task.result = pool.push([this, encoder]() -> std::optional<bool> {
+        if (cancel) {
+          return std::nullopt;
+        }
+
+        bool display_failed = false;
+        auto passed = validate_one(*encoder, expect_failure(encoder), cancel, display_failed);
+
+        // The result can't be trusted if validation was cancelled or another encoder held the display
+        if (!passed && (cancel || display_failed)) {
+          return std::nullopt;
+        }
+        return passed;
+      });
+    }
+
+    pool.start(std::clamp<int>(ordered.size(), 1, max_threads));
+  }
+
+  encoder_validator_t::~encoder_validator_t() {
+    finish();
+  }
+
+  bool encoder_validator_t::validate(encoder_t *encoder) {
+    auto &task = tasks.at(encoder);
+
+    if (!task.passed && task.result.valid()) {
+      task.passed = task.result.get();
     }
 
+    // An encoder may fail only because others were validated at the same time, e.g. if the GPU limits
+    // the number of encoding sessions. Only a failure without concurrent validations is final.
+    if (!task.passed || (!*task.passed && !task.sequential)) {
+      finish();
+
+      std::atomic_bool cancel {false};
+      bool display_failed = false;
+      task.passed = validate_one(*encoder, expect_failure(encoder), cancel, display_failed);
+      task.sequential = true;
+    }
+
+    return *task.passed;
+  }
+
+  void encoder_validator_t::finish() {
+    if (finished) {
+      return;
+    }
+    finished = true;
+
+    cancel = true;
+    pool.stop();
+    pool.join();
+
+    // Keep the results of validations that completed, the others never started
+    for (auto &[_, task] : tasks) {
+      if (task.result.valid() && task.result.wait_for(0s) == std::future_status::ready) {
+        task.passed = task.result.get();
+      }
+      task.result = {};
+    }
+  }
+
+  bool encoder_validator_t::expect_failure(encoder_t *encoder) const {
+    // If we've used a previous encoder and it's not this one, we expect this encoder to
+    // fail to validate. It will use a slightly different order of checks to more quickly
+    // eliminate failing encoders.
+    return previous_encoder && previous_encoder != encoder;
+  }
+
+  /**
+   * @brief Validate the encoders in order of preference until one of them works.
+   * @return 0 on success, -1 if no encoder could be used.
+   */
+  static int select_encoder() {
+    auto encoder_list = encoders;
+
     // Restart encoder selection
     auto previous_encoder = chosen_encoder;
     chosen_encoder = nullptr;
@@ -2734,24 +3199,7 @@ namespace video {
     active_av1_mode = config::video.av1_mode;
     last_encoder_probe_supported_ref_frames_invalidation = false;
 
-    auto adjust_encoder_constraints = [&](encoder_t *encoder) {
-      // If we can't satisfy both the encoder and codec requirement, prefer the encoder over codec support
-      if (active_hevc_mode == 3 && !encoder->hevc[encoder_t::DYNAMIC_RANGE]) {
-        BOOST_LOG(warning) << "Encoder ["sv << encoder->name << "] does not support HEVC Main10 on this system"sv;
-        active_hevc_mode = 0;
-      } else if (active_hevc_mode == 2 && !encoder->hevc[encoder_t::PASSED]) {
-        BOOST_LOG(warning) << "Encoder ["sv << encoder->name << "] does not support HEVC on this system"sv;
-        active_hevc_mode = 0;
-      }
-
-      if (active_av1_mode == 3 && !encoder->av1[encoder_t::DYNAMIC_RANGE]) {
-        BOOST_LOG(warning) << "Encoder ["sv << encoder->name << "] does not support AV1 Main10 on this system"sv;
-        active_av1_mode = 0;
-      } else if (active_av1_mode == 2 && !encoder->av1[encoder_t::PASSED]) {
-        BOOST_LOG(warning) << "Encoder ["sv << encoder->name << "] does not support AV1 on this system"sv;
-        active_av1_mode = 0;
-      }
-    };
+    encoder_validator_t validator {encoder_list, previous_encoder};
 
     if (!config::video.encoder.empty()) {
       // If there is a specific encoder specified, use it if it passes validation
@@ -2760,12 +3208,13 @@ namespace video {
 
         if (encoder->name == config::video.encoder) {
           // Remove the encoder from the list entirely if it fails validation
-          if (!validate_encoder(*encoder, previous_encoder && previous_encoder != encoder)) {
+          if (!validator.validate(encoder)) {
             pos = encoder_list.erase(pos);
             break;
           }
 
           // We will return an encoder here even if it fails one of the codec requirements specified by the user
+          validator.finish();
           adjust_encoder_constraints(encoder);
 
           chosen_encoder = encoder;
@@ -2788,7 +3237,7 @@ namespace video {
         auto encoder = *pos;
 
         // Remove the encoder from the list entirely if it fails validation
-        if (!validate_encoder(*encoder, previous_encoder && previous_encoder != encoder)) {
+        if (!validator.validate(encoder)) {
           pos = encoder_list.erase(pos);
           continue;
         }
@@ -2822,15 +3271,13 @@ namespace video {
       KITTY_WHILE_LOOP(auto pos = std::begin(encoder_list), pos != std::end(encoder_list), {
         auto encoder = *pos;
 
-        // If we've used a previous encoder and it's not this one, we expect this encoder to
-        // fail to validate. It will use a slightly different order of checks to more quickly
-        // eliminate failing encoders.
-        if (!validate_encoder(*encoder, previous_encoder && previous_encoder != encoder)) {
+        if (!validator.validate(encoder)) {
           pos = encoder_list.erase(pos);
           continue;
         }
 
         // We will return an encoder here even if it fails one of the codec requirements specified by the user
+        validator.finish();
         adjust_encoder_constraints(encoder);
 
         chosen_encoder = encoder;
@@ -2853,6 +3300,13 @@ namespace video {
     BOOST_LOG(info) << "// Ignore any errors mentioned above, they are not relevant. //"sv;
     BOOST_LOG(info);
 
+    return 0;
+  }
+
+  /**
+   * @brief Publish the capabilities of the chosen encoder.
+   */
+  static void apply_chosen_encoder() {
     auto &encoder = *chosen_encoder;
 
     last_encoder_probe_supported_ref_frames_invalidation = (encoder.flags & REF_FRAMES_INVALIDATION);
@@ -2900,10 +3354,233 @@ namespace video {
     if (active_av1_mode == 0) {
       active_av1_mode = encoder.av1[encoder_t::PASSED] ? (encoder.av1[encoder_t::DYNAMIC_RANGE] ? 3 : 2) : 1;
     }
+  }
+
+  // Serializes probing, since cached results are revalidated in the background
+  static std::mutex probe_lock;
+
+  /**
+   * @brief Everything probing changes, so the results of a probe can be discarded.
+   */
+  struct probe_state_t {
+    encoder_t *encoder;
+    int hevc_mode;
+    int av1_mode;
+    bool ref_frames_invalidation;
+    std::vector<std::array<std::bitset<encoder_t::MAX_FLAGS>, 3>> capabilities;
+
+    static probe_state_t save() {
+      probe_state_t state {chosen_encoder, active_hevc_mode, active_av1_mode, last_encoder_probe_supported_ref_frames_invalidation};
+      for (auto encoder : encoders) {
+        state.capabilities.push_back({encoder->h264.capabilities, encoder->hevc.capabilities, encoder->av1.capabilities});
+      }
 
+      return state;
+    }
+
+    /**
+     * @brief Get the saved capabilities of the chosen encoder.
+     */
+    const std::array<std::bitset<encoder_t::MAX_FLAGS>, 3> &chosen_capabilities() const {
+      return capabilities[std::find(std::begin(encoders), std::end(encoders), encoder) - std::begin(encoders)];
+    }
+
+    void restore() const {
+      for (std::size_t x = 0; x < encoders.size(); ++x) {
+        encoders[x]->h264.capabilities = capabilities[x][0];
+        encoders[x]->hevc.capabilities = capabilities[x][1];
+        encoders[x]->av1.capabilities = capabilities[x][2];
+      }
+
+      chosen_encoder = encoder;
+      active_hevc_mode = hevc_mode;
+      active_av1_mode = av1_mode;
+      last_encoder_probe_supported_ref_frames_invalidation = ref_frames_invalidation;
+    }
+  };
+
+  // Set when the chosen encoder was restored from the cache and not probed yet
+  static bool probe_cache_unconfirmed = false;
+
+  static constexpr int probe_cache_version = 1;
+
+  static std::filesystem::path probe_cache_path() {
+    return platf::appdata() / "encoder_cache.json";
+  }
+
+  /**
+   * @brief Describe everything that can change the outcome of probing.
+   * @return The fingerprint the cached results are keyed by.
+   */
+  static nlohmann::json probe_fingerprint() {
+    auto config_file = file_handler::read_file(config::sunshine.config_file.c_str());
+
+    return {
+      {"version", PROJECT_VERSION},
+      {"commit", PROJECT_VERSION_COMMIT},
+      {"ffmpeg", av_version_info()},
+      {"gpus", platf::gpu_fingerprint()},
+      {"displays", platf::display_names(platf::mem_type_e::system)},
+      {"encoder", config::video.encoder},
+      {"adapter_name", config::video.adapter_name},
+      {"output_name", config::video.output_name},
+      {"hevc_mode", config::video.hevc_mode},
+      {"av1_mode", config::video.av1_mode},
+      {"force_video_header_replace", (bool) config::sunshine.flags[config::flag::FORCE_VIDEO_HEADER_REPLACE]},
+      // Encoder options are validated too, so any change to the configuration invalidates the cache
+      {"config", std::hash<std::string> {}(config_file)},
+    };
+  }
+
+  /**
+   * @brief Restore the chosen encoder from the cache if it was probed on an identical system.
+   * @param fingerprint The fingerprint of the current system.
+   * @return `true` if the cached encoder was restored.
+   */
+  static bool restore_probe_cache(const nlohmann::json &fingerprint) {
+    auto content = file_handler::read_file(probe_cache_path().string().c_str());
+    if (content.empty()) {
+      return false;
+    }
+
+    try {
+      auto cache = nlohmann::json::parse(content);
+      if (cache["version"] != probe_cache_version || cache["fingerprint"] != fingerprint) {
+        BOOST_LOG(info) << "Cached encoder probe results are outdated"sv;
+        return false;
+      }
+
+      auto name = cache["encoder"].get<std::string>();
+      auto pos = std::find_if(std::begin(encoders), std::end(encoders), [&name](auto encoder) {
+        return encoder->name == name;
+      });
+      if (pos == std::end(encoders)) {
+        return false;
+      }
+
+      auto encoder = *pos;
+      encoder->h264.capabilities = std::bitset<encoder_t::MAX_FLAGS> {cache["h264"].get<std::string>()};
+      encoder->hevc.capabilities = std::bitset<encoder_t::MAX_FLAGS> {cache["hevc"].get<std::string>()};
+      encoder->av1.capabilities = std::bitset<encoder_t::MAX_FLAGS> {cache["av1"].get<std::string>()};
+
+      active_hevc_mode = config::video.hevc_mode;
+      active_av1_mode = config::video.av1_mode;
+      adjust_encoder_constraints(encoder);
+      chosen_encoder = encoder;
+
+      BOOST_LOG(info) << "Using cached encoder probe results, saved "sv << cache["probe_time_ms"].get<std::int64_t>() << "ms"sv;
+      return true;
+    } catch (const std::exception &e) {
+      BOOST_LOG(warning) << "Couldn't read cached encoder probe results: "sv << e.what();
+      return false;
+    }
+  }
+
+  /**
+   * @brief Store the chosen encoder so the next start can skip probing.
+   * @param fingerprint The fingerprint of the system the encoder was probed on.
+   * @param probe_time How long probing took.
+   */
+  static void save_probe_cache(const nlohmann::json &fingerprint, std::chrono::milliseconds probe_time) {
+    if (config::sunshine.flags[config::flag::FRESH_STATE]) {
+      return;
+    }
+
+    auto &encoder = *chosen_encoder;
+    nlohmann::json cache {
+      {"version", probe_cache_version},
+      {"fingerprint", fingerprint},
+      {"probe_time_ms", probe_time.count()},
+      {"encoder", encoder.name},
+      {"h264", encoder.h264.capabilities.to_string()},
+      {"hevc", encoder.hevc.capabilities.to_string()},
+      {"av1", encoder.av1.capabilities.to_string()},
+    };
+
+    if (file_handler::write_file(probe_cache_path().string().c_str(), cache.dump(2))) {
+      BOOST_LOG(warning) << "Couldn't write cached encoder probe results to "sv << probe_cache_path();
+    }
+  }
+
+  /**
+   * @brief Probe the encoders and update the cache.
+   * @param fingerprint The fingerprint of the current system.
+   * @return 0 on success, -1 if no encoder could be used.
+   */
+  static int probe_and_cache(const nlohmann::json &fingerprint) {
+    auto start = std::chrono::steady_clock::now();
+    if (select_encoder()) {
+      std::error_code ec;
+      std::filesystem::remove(probe_cache_path(), ec);
+      return -1;
+    }
+
+    auto probe_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    BOOST_LOG(info) << "Encoder probing took "sv << probe_time.count() << "ms"sv;
+
+    save_probe_cache(fingerprint, probe_time);
     return 0;
   }
 
+  int probe_encoders() {
+    std::lock_guard lg {probe_lock};
+
+    if (!allow_encoder_probing()) {
+      // Error already logged
+      return -1;
+    }
+
+    // If we already have a good encoder, check to see if another probe is required
+    if (chosen_encoder && !(chosen_encoder->flags & ALWAYS_REPROBE) && !platf::needs_encoder_reenumeration()) {
+      return 0;
+    }
+
+    auto fingerprint = probe_fingerprint();
+
+    auto use_cache = !config::sunshine.flags[config::flag::REPROBE] && !config::sunshine.flags[config::flag::FRESH_STATE];
+    probe_cache_unconfirmed = use_cache && restore_probe_cache(fingerprint);
+    if (!probe_cache_unconfirmed && probe_and_cache(fingerprint)) {
+      return -1;
+    }
+
+    apply_chosen_encoder();
+    return 0;
+  }
+
+  void revalidate_probe_cache() {
+    std::lock_guard lg {probe_lock};
+
+    if (!probe_cache_unconfirmed) {
+      return;
+    }
+
+    // Validation writes its results into the encoders, so nothing may capture with them until probing is done.
+    // Sessions that start in the meantime wait for the lock, probing while streaming is skipped.
+    std::unique_lock encoder_lg {encoder_lock, std::try_to_lock};
+    if (!encoder_lg || !allow_encoder_probing()) {
+      BOOST_LOG(info) << "Skipping revalidation of cached encoder probe results"sv;
+      return;
+    }
+    probe_cache_unconfirmed = false;
+
+    auto cached = probe_state_t::save();
+
+    BOOST_LOG(info) << "Revalidating cached encoder probe results"sv;
+    if (probe_and_cache(probe_fingerprint())) {
+      // The failure may be temporary, keep streaming with the cached encoder until the next probe
+      BOOST_LOG(error) << "Cached encoder ["sv << cached.encoder->name << "] failed revalidation, keeping it until the next probe"sv;
+      cached.restore();
+      return;
+    }
+
+    auto probed = probe_state_t::save();
+    if (probed.encoder != cached.encoder || probed.chosen_capabilities() != cached.chosen_capabilities()) {
+      BOOST_LOG(warning) << "Cached encoder probe results were outdated, switching to the probed results"sv;
+    }
+
+    apply_chosen_encoder();
+  }
+
   // Linux only declaration
   typedef int (*vaapi_init_avcodec_hardware_input_buffer_fn)(platf::avcodec_encode_device_t *encode_device, AVBufferRef **hw_device_buf);
 
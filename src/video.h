@@ -4,9 +4,18 @@
  */
 #pragma once
 
+// standard includes
+#include <atomic>
+#include <functional>
+#include <future>
+#include <map>
+#include <optional>
+
 // local includes
 #include "input.h"
 #include "platform/common.h"
+#include "stat_trackers.h"
+#include "thread_pool.h"
 #include "thread_safe.h"
 #include "video_colorspace.h"
 
@@ -48,6 +57,8 @@ namespace video {
 
     int encodingFramerate; // Requested display framerate
     bool input_only;
+
+    bool operator==(const config_t &) const = default;
   };
 
   platf::mem_type_e map_base_dev_type(AVHWDeviceType type);
@@ -213,6 +224,13 @@ namespace video {
     virtual void request_normal_frame() = 0;
 
     virtual void invalidate_ref_frames(int64_t first_frame, int64_t last_frame) = 0;
+
+    /**
+     * @brief Change the target bitrate without reinitializing the encoder.
+     * @param bitrate The new bitrate in Kbps.
+     * @return `true` if the next frame is encoded at the new bitrate, `false` if the encoder can't change it on the fly.
+     */
+    virtual bool set_bitrate(int bitrate) = 0;
   };
 
   // encoders
@@ -262,6 +280,7 @@ namespace video {
     void *channel_data = nullptr;
     bool after_ref_frame_invalidation = false;
     std::optional<std::chrono::steady_clock::time_point> frame_timestamp;
+    stat_trackers::frame_trace_t trace;
   };
 
   struct packet_raw_avcodec: packet_raw_t {
@@ -320,6 +339,41 @@ namespace video {
     bool idr;
   };
 
+  /**
+   * @brief A packet that refers to the payload of a packet encoded for another session.
+   * @details Sessions viewing a shared encoder get one of these per frame, numbered in their own sequence.
+   */
+  struct packet_raw_shared: packet_raw_t {
+    packet_raw_shared(std::shared_ptr<packet_raw_t> packet, int64_t frame_index, void *channel_data):
+        packet {std::move(packet)},
+        index {frame_index} {
+      this->replacements = this->packet->replacements;
+      this->channel_data = channel_data;
+      this->after_ref_frame_invalidation = this->packet->after_ref_frame_invalidation;
+      this->frame_timestamp = this->packet->frame_timestamp;
+      this->trace = this->packet->trace;
+    }
+
+    bool is_idr() override {
+      return packet->is_idr();
+    }
+
+    int64_t frame_index() override {
+      return index;
+    }
+
+    uint8_t *data() override {
+      return packet->data();
+    }
+
+    size_t data_size() override {
+      return packet->data_size();
+    }
+
+    std::shared_ptr<packet_raw_t> packet;
+    int64_t index;
+  };
+
   using packet_t = std::unique_ptr<packet_raw_t>;
 
   struct hdr_info_raw_t {
@@ -336,6 +390,38 @@ namespace video {
 
   using hdr_info_t = std::unique_ptr<hdr_info_raw_t>;
 
+  /**
+   * @brief A session receiving the packets of an encoder owned by another session.
+   */
+  struct shared_viewer_t {
+    void *channel_data;
+    safe::mail_raw_t::event_t<hdr_info_t> hdr_events;
+    safe::mail_raw_t::event_t<input::touch_port_t> touch_port_events;
+
+    // The frame index the viewer expects next, so its stream stays continuous when the encoder changes
+    int64_t frame_nr;
+
+    // Subtracted from the frame index of the encoder, unset until the first IDR frame for this viewer
+    std::optional<int64_t> frame_offset;
+  };
+
+  /**
+   * @brief An encoder whose packets are sent to every session streaming the same configuration of the same display.
+   */
+  struct shared_encode_t {
+    config_t config;
+    std::string display_name;
+    void *owner;
+    safe::mail_raw_t::event_t<bool> idr_events;
+
+    // The last display state sent to the owner, replayed to viewers when they join
+    std::optional<input::touch_port_t> touch_port;
+    std::optional<hdr_info_raw_t> hdr_info;
+
+    std::vector<shared_viewer_t> viewers;
+    std::atomic_bool stopped;
+  };
+
   extern int active_hevc_mode;
   extern int active_av1_mode;
   extern bool last_encoder_probe_supported_ref_frames_invalidation;
@@ -347,8 +433,83 @@ namespace video {
     void *channel_data
   );
 
+  /**
+   * @brief Watch the encoder of another session with the same configuration, or offer this session's encoder to others.
+   * @details While watching, keyframe requests of this session are coalesced into the IDR events of the owner.
+   *          Reference frame invalidation only makes sense for a single decoder, so it is answered with an IDR frame.
+   * @param mail The mail of this session.
+   * @param config The encoding configuration requested by this session.
+   * @param display_name The display captured for this session, only encoders of the same display are shared.
+   * @param channel_data The channel data of this session.
+   * @param frame_nr The next frame index of this session, kept when the owner of a watched encoder stops.
+   * @return The encoder this session must run and share, or nullptr once this session has been stopped.
+   */
+  std::shared_ptr<shared_encode_t> join_shared_encode(safe::mail_t &mail, const config_t &config, const std::string &display_name, void *channel_data, int &frame_nr);
+
+  /**
+   * @brief Stop offering an encoder to other sessions. Its viewers look for another encoder, or start their own.
+   * @param shared The encoder owned by this session.
+   */
+  void stop_shared_encode(const std::shared_ptr<shared_encode_t> &shared);
+
   bool validate_encoder(encoder_t &encoder, bool expect_failure);
 
+  /**
+   * @brief Validates encoders concurrently on a bounded pool and hands out the results in order of preference.
+   * @details Some capture APIs only allow capturing a display once. If an encoder fails because its display
+   *          couldn't be created, the remaining encoders are validated one at a time like before.
+   *          Any other failure is confirmed by validating the encoder again on its own before it is reported.
+   */
+  class encoder_validator_t {
+  public:
+    /**
+     * @brief Validates a single encoder.
+     * @details Arguments are the encoder, whether it is expected to fail, a flag that cancels validation
+     *          and a flag to set when no display could be created. Returns `true` if the encoder passed.
+     */
+    using validate_t = std::function<bool(encoder_t &, bool, const std::atomic_bool &, bool &)>;
+
+    static constexpr int max_threads = 4;
+
+    encoder_validator_t(const std::vector<encoder_t *> &encoder_list, encoder_t *previous_encoder);
+    encoder_validator_t(const std::vector<encoder_t *> &encoder_list, encoder_t *previous_encoder, validate_t validate_fn);
+    ~encoder_validator_t();
+
+    /**
+     * @brief Get the validation result of an encoder, waiting for it if necessary.
+     * @param encoder The encoder passed to the constructor.
+     * @return `true` if the encoder passed validation.
+     */
+    bool validate(encoder_t *encoder);
+
+    /**
+     * @brief Stop validating concurrently.
+     * @details Must be called before the probe changes any state that validation depends on.
+     */
+    void finish();
+
+  private:
+    bool expect_failure(encoder_t *encoder) const;
+
+    struct task_t {
+      std::future<std::optional<bool>> result;
+      std::optional<bool> passed;
+
+      // Set once the result came from validating the encoder on its own
+      bool sequential = false;
+    };
+
+    encoder_t *previous_encoder;
+    validate_t validate_one;
+    std::map<encoder_t *, task_t> tasks;
+
+    std::atomic_bool cancel {false};
+    bool finished = false;
+
+    // Declared last, so the tasks can't outlive what they use
+    thread_pool_util::ThreadPool pool;
+  };
+
   /**
    * @brief Check if we can allow probing for the encoders.
    * @return True if there should be no issues with the probing, false if we should prevent it.
@@ -360,8 +521,18 @@ namespace video {
    * This is called once at startup and each time a stream is launched to
    * ensure the best encoder is selected. Encoder availability can change
    * at runtime due to all sorts of things from driver updates to eGPUs.
+   * Encoders are validated concurrently, but chosen in the same order of preference.
+   * The results are cached, keyed by the GPUs, drivers, FFmpeg build and displays,
+   * and reused as long as those do not change, unless started with `--reprobe`.
    *
    * @warning This is only safe to call when there is no client actively streaming.
    */
   int probe_encoders();
+
+  /**
+   * @brief Probe the encoders again if the chosen encoder was restored from the probe cache.
+   * @details This runs in the background after startup and replaces the cached results if they were outdated.
+   * It is skipped while a client is streaming.
+   */
+  void revalidate_probe_cache();
 }  // namespace video
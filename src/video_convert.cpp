@@ -0,0 +1,306 @@
+/**
+ * @file src/video_convert.cpp
+ * @brief Definitions for the BGR0 to YUV converter of the software encode path.
+ */
+// this include
+#include "video_convert.h"
+
+// standard includes
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+namespace video {
+  namespace {
+    // Fractional bits of the fixed point coefficients
+    constexpr int precision = 16;
+
+    template<class T, int N>
+    struct vec {
+      typedef T type __attribute__((vector_size(N * sizeof(T))));
+    };
+
+    template<class T, int N>
+    using vec_t = typename vec<T, N>::type;
+
+    using params_t = bgr0_converter_t::params_t;
+    using coefficients_t = bgr0_converter_t::coefficients_t;
+
+    struct image_t {
+      const std::uint8_t *src;
+      int src_pitch;
+      int width;
+      int height;
+      std::uint8_t *const *dst;
+      const int *dst_pitch;
+    };
+
+    // Everything below is inlined into the variant for each instruction set, so that the
+    // generic vectors are compiled with the widest registers available.
+
+    /**
+     * @brief Convert the sum of `count` pixels to a component, rounded to nearest.
+     */
+    template<int count, class V>
+    [[gnu::always_inline]] inline V component(V r, V g, V b, const coefficients_t &c, const params_t &params) {
+      constexpr int shift = precision + std::bit_width((unsigned) count) - 1;
+
+      V value = (r * c.rgb[0] + g * c.rgb[1] + b * c.rgb[2] + c.add * count + (1 << (shift - 1))) >> shift;
+      if constexpr (std::is_scalar_v<V>) {
+        value = std::min(value, params.max);
+      } else {
+        V over = value > params.max;
+        value = (value & ~over) | (params.max & over);
+      }
+
+      return value << params.shift;
+    }
+
+    /**
+     * @brief Convert a row of pixels to one full resolution component.
+     */
+    template<int width_bytes, class T>
+    [[gnu::always_inline]] inline void convert_row(const std::uint8_t *src, int width, T *dst, const coefficients_t &c, const params_t &params) {
+      constexpr int lanes = width_bytes / 4;
+      using u32 = vec_t<std::uint32_t, lanes>;
+      using i32 = vec_t<std::int32_t, lanes>;
+
+      int x = 0;
+      for (; x + lanes <= width; x += lanes) {
+        u32 pixels;
+        std::memcpy(&pixels, src + x * 4, sizeof(pixels));
+
+        auto b = (i32) (pixels & 0xFF);
+        auto g = (i32) ((pixels >> 8) & 0xFF);
+        auto r = (i32) ((pixels >> 16) & 0xFF);
+
+        auto out = __builtin_convertvector(component<1>(r, g, b, c, params), vec_t<T, lanes>);
+        std::memcpy(dst + x, &out, sizeof(out));
+      }
+
+      for (; x < width; ++x) {
+        auto pixel = src + x * 4;
+        dst[x] = (T) component<1>((std::int32_t) pixel[2], (std::int32_t) pixel[1], (std::int32_t) pixel[0], c, params);
+      }
+    }
+
+    /**
+     * @brief Convert two rows of pixels to one row of 4:2:0 chroma.
+     * @details Both chroma components are computed from the sum of each 2x2 block of pixels.
+     */
+    template<int width_bytes, class T, bool interleaved>
+    [[gnu::always_inline]] inline void convert_chroma_row_420(const std::uint8_t *src0, const std::uint8_t *src1, int width, T *dst_u, T *dst_v, const params_t &params) {
+      constexpr int lanes = width_bytes / 4;
+      using u64 = vec_t<std::uint64_t, lanes>;
+      using u32 = vec_t<std::uint32_t, lanes>;
+      using i32 = vec_t<std::int32_t, lanes>;
+
+      // Split each pair of pixels into 16-bit fields, so the sums of the 2x2 blocks can't overflow
+      constexpr std::uint64_t mask = 0x00FF00FF00FF00FF;
+
+      int x = 0;
+      for (; x + lanes <= width / 2; x += lanes) {
+        u64 pairs0;
+        u64 pairs1;
+        std::memcpy(&pairs0, src0 + x * 8, sizeof(pairs0));
+        std::memcpy(&pairs1, src1 + x * 8, sizeof(pairs1));
+
+        u64 br = (pairs0 & mask) + (pairs1 & mask);
+        u64 g0 = ((pairs0 >> 8) & mask) + ((pairs1 >> 8) & mask);
+        br += br >> 32;
+        g0 += g0 >> 32;
+
+        auto br32 = __builtin_convertvector(br, u32);
+        auto b = (i32) (br32 & 0xFFFF);
+        auto r = (i32) (br32 >> 16);
+        auto g = (i32) (__builtin_convertvector(g0, u32) & 0xFFFF);
+
+        auto u = component<4>(r, g, b, params.u, params);
+        auto v = component<4>(r, g, b, params.v, params);
+
+        if constexpr (interleaved) {
+          using pair_t = std::conditional_t<sizeof(T) == 1, std::uint16_t, std::uint32_t>;
+
+          auto out = __builtin_convertvector((u32) u | ((u32) v << (sizeof(T) * 8)), vec_t<pair_t, lanes>);
+          std::memcpy(dst_u + x * 2, &out, sizeof(out));
+        } else {
+          auto out_u = __builtin_convertvector(u, vec_t<T, lanes>);
+          auto out_v = __builtin_convertvector(v, vec_t<T, lanes>);
+          std::memcpy(dst_u + x, &out_u, sizeof(out_u));
+          std::memcpy(dst_v + x, &out_v, sizeof(out_v));
+        }
+      }
+
+      // The last column is repeated for odd widths
+      for (; x < (width + 1) / 2; ++x) {
+        auto left = x * 2;
+        auto right = std::min(left + 1, width - 1);
+
+        std::int32_t b = src0[left * 4] + src0[right * 4] + src1[left * 4] + src1[right * 4];
+        std::int32_t g = src0[left * 4 + 1] + src0[right * 4 + 1] + src1[left * 4 + 1] + src1[right * 4 + 1];
+        std::int32_t r = src0[left * 4 + 2] + src0[right * 4 + 2] + src1[left * 4 + 2] + src1[right * 4 + 2];
+
+        auto u = (T) component<4>(r, g, b, params.u, params);
+        auto v = (T) component<4>(r, g, b, params.v, params);
+        if constexpr (interleaved) {
+          dst_u[x * 2] = u;
+          dst_u[x * 2 + 1] = v;
+        } else {
+          dst_u[x] = u;
+          dst_v[x] = v;
+        }
+      }
+    }
+
+    template<int width_bytes, class T, bool chroma_420, bool interleaved>
+    [[gnu::always_inline]] inline void convert_rows(const image_t &image, const params_t &params, int first_row, int last_row) {
+      auto plane_row = [&image](int plane, int row) {
+        return (T *) (image.dst[plane] + (std::ptrdiff_t) row * image.dst_pitch[plane]);
+      };
+
+      for (int row = first_row; row < last_row; ++row) {
+        auto src = image.src + (std::ptrdiff_t) row * image.src_pitch;
+
+        convert_row<width_bytes>(src, image.width, plane_row(0, row), params.y, params);
+        if constexpr (!chroma_420) {
+          convert_row<width_bytes>(src, image.width, plane_row(1, row), params.u, params);
+          convert_row<width_bytes>(src, image.width, plane_row(2, row), params.v, params);
+        }
+      }
+
+      if constexpr (chroma_420) {
+        for (int row = first_row; row < last_row; row += 2) {
+          auto src0 = image.src + (std::ptrdiff_t) row * image.src_pitch;
+
+          // The last row is repeated for odd heights
+          auto src1 = row + 1 < image.height ? src0 + image.src_pitch : src0;
+
+          auto dst_v = interleaved ? nullptr : plane_row(2, row / 2);
+          convert_chroma_row_420<width_bytes, T, interleaved>(src0, src1, image.width, plane_row(1, row / 2), dst_v, params);
+        }
+      }
+    }
+
+    struct layout_t {
+      bool high_bit_depth;
+      bool chroma_420;
+      bool interleaved_chroma;
+    };
+
+    template<int width_bytes>
+    [[gnu::always_inline]] inline void convert_band(const image_t &image, const params_t &params, const layout_t &layout, int first_row, int last_row) {
+      if (layout.high_bit_depth) {
+        if (!layout.chroma_420) {
+          convert_rows<width_bytes, std::uint16_t, false, false>(image, params, first_row, last_row);
+        } else if (layout.interleaved_chroma) {
+          convert_rows<width_bytes, std::uint16_t, true, true>(image, params, first_row, last_row);
+        } else {
+          convert_rows<width_bytes, std::uint16_t, true, false>(image, params, first_row, last_row);
+        }
+      } else {
+        if (!layout.chroma_420) {
+          convert_rows<width_bytes, std::uint8_t, false, false>(image, params, first_row, last_row);
+        } else if (layout.interleaved_chroma) {
+          convert_rows<width_bytes, std::uint8_t, true, true>(image, params, first_row, last_row);
+        } else {
+          convert_rows<width_bytes, std::uint8_t, true, false>(image, params, first_row, last_row);
+        }
+      }
+    }
+
+    using convert_band_fn = void (*)(const image_t &image, const params_t &params, const layout_t &layout, int first_row, int last_row);
+
+    // The baseline is SSE2 on x86-64 and NEON on AArch64
+    void convert_band_default(const image_t &image, const params_t &params, const layout_t &layout, int first_row, int last_row) {
+      convert_band<16>(image, params, layout, first_row, last_row);
+    }
+
+#if defined(__x86_64) || defined(__x86_64__) || defined(__amd64) || defined(__amd64__) || defined(_M_AMD64)
+    #define VIDEO_CONVERT_X86
+
+    __attribute__((target("avx2"))) void convert_band_avx2(const image_t &image, const params_t &params, const layout_t &layout, int first_row, int last_row) {
+      convert_band<32>(image, params, layout, first_row, last_row);
+    }
+#endif
+
+    struct implementation_t {
+      convert_band_fn convert_band;
+      const char *isa;
+    };
+
+    const implementation_t &implementation() {
+      static const implementation_t impl = []() -> implementation_t {
+#ifdef VIDEO_CONVERT_X86
+        if (__builtin_cpu_supports("avx2")) {
+          return {convert_band_avx2, "AVX2"};
+        }
+        return {convert_band_default, "SSE2"};
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+        return {convert_band_default, "NEON"};
+#else
+        return {convert_band_default, "generic"};
+#endif
+      }();
+
+      return impl;
+    }
+
+    coefficients_t to_fixed_point(const float (&color_vec)[4]) {
+      coefficients_t c;
+
+      // The color vectors take components normalized to [0, 1]
+      for (int x = 0; x < 3; ++x) {
+        c.rgb[x] = (std::int32_t) std::lround(color_vec[x] / 255.0 * (1 << precision));
+      }
+      // The color vectors add 0.5 so that truncating rounds to nearest, component() rounds by itself
+      c.add = (std::int32_t) std::lround((color_vec[3] - 0.5) * (1 << precision));
+
+      return c;
+    }
+  }  // namespace
+
+  bool bgr0_converter_t::supports(AVPixelFormat format) {
+    switch (format) {
+      case AV_PIX_FMT_NV12:
+      case AV_PIX_FMT_P010:
+      case AV_PIX_FMT_YUV420P:
+      case AV_PIX_FMT_YUV420P10:
+      case AV_PIX_FMT_YUV444P:
+      case AV_PIX_FMT_YUV444P10:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  const char *bgr0_converter_t::isa() {
+    return implementation().isa;
+  }
+
+  bgr0_converter_t::bgr0_converter_t(AVPixelFormat format, const sunshine_colorspace_t &colorspace) {
+    high_bit_depth = format == AV_PIX_FMT_P010 || format == AV_PIX_FMT_YUV420P10 || format == AV_PIX_FMT_YUV444P10;
+    chroma_420 = format != AV_PIX_FMT_YUV444P && format != AV_PIX_FMT_YUV444P10;
+    interleaved_chroma = format == AV_PIX_FMT_NV12 || format == AV_PIX_FMT_P010;
+
+    auto format_colorspace = colorspace;
+    format_colorspace.bit_depth = high_bit_depth ? 10 : 8;
+
+    auto color_vectors = new_color_vectors_from_colorspace(format_colorspace);
+    params.y = to_fixed_point(color_vectors->color_vec_y);
+    params.u = to_fixed_point(color_vectors->color_vec_u);
+    params.v = to_fixed_point(color_vectors->color_vec_v);
+    params.max = (1 << format_colorspace.bit_depth) - 1;
+
+    // P010 stores the 10 bits in the high bits of each 16-bit component
+    params.shift = format == AV_PIX_FMT_P010 ? 6 : 0;
+  }
+
+  void bgr0_converter_t::convert(const std::uint8_t *src, int src_pitch, int width, int height, std::uint8_t *const dst[3], const int dst_pitch[3], int first_row, int last_row) const {
+    image_t image {src, src_pitch, width, height, dst, dst_pitch};
+    layout_t layout {high_bit_depth, chroma_420, interleaved_chroma};
+
+    implementation().convert_band(image, params, layout, first_row, last_row);
+  }
+}  // namespace video
@@ -0,0 +1,95 @@
+/**
+ * @file src/video_convert.h
+ * @brief Declarations for the BGR0 to YUV converter of the software encode path.
+ */
+#pragma once
+
+// standard includes
+#include <cstdint>
+
+// local includes
+#include "video_colorspace.h"
+
+namespace video {
+  /**
+   * @brief Converts BGR0 images to YUV without scaling.
+   * @details This applies the same matrices as `new_color_vectors_from_colorspace()` in fixed point,
+   *          vectorized for the instruction set of the CPU. Scaling and any other formats are left to swscale.
+   */
+  class bgr0_converter_t {
+  public:
+    /**
+     * @brief Check whether BGR0 images can be converted to a pixel format.
+     * @param format The destination pixel format.
+     * @return `true` if the format is supported.
+     */
+    static bool supports(AVPixelFormat format);
+
+    /**
+     * @brief Get the name of the instruction set used for conversion.
+     * @return The instruction set name.
+     */
+    static const char *isa();
+
+    /**
+     * @brief Set up conversion to a pixel format.
+     * @param format The destination pixel format, it must be supported.
+     * @param colorspace The destination colorspace, the bit depth is taken from the format.
+     */
+    bgr0_converter_t(AVPixelFormat format, const sunshine_colorspace_t &colorspace);
+
+    /**
+     * @brief Get the number of rows that bands of rows must be a multiple of.
+     * @return 2 for formats with vertically subsampled chroma, 1 otherwise.
+     */
+    int row_alignment() const {
+      return chroma_420 ? 2 : 1;
+    }
+
+    /**
+     * @brief Convert a band of rows of an image.
+     * @details Bands of the same image may be converted concurrently.
+     * @param src The first pixel of the image.
+     * @param src_pitch Bytes per row of the image.
+     * @param width Width of the image.
+     * @param height Height of the image.
+     * @param dst Planes of the destination, pointing to where the first pixel of the image goes.
+     * @param dst_pitch Bytes per row of each destination plane.
+     * @param first_row The first row of the band, a multiple of `row_alignment()`.
+     * @param last_row One past the last row of the band.
+     */
+    void convert(const std::uint8_t *src, int src_pitch, int width, int height, std::uint8_t *const dst[3], const int dst_pitch[3], int first_row, int last_row) const;
+
+    /**
+     * @brief Fixed point conversion from BGR0 to one YUV component.
+     * @details The component is `(r * rgb[0] + g * rgb[1] + b * rgb[2] + add + (1 << (precision - 1))) >> precision`,
+     *          which rounds to nearest.
+     */
+    struct coefficients_t {
+      std::int32_t rgb[3];
+      std::int32_t add;
+    };
+
+    /**
+     * @brief Layout and coefficients of the destination format.
+     */
+    struct params_t {
+      coefficients_t y;
+      coefficients_t u;
+      coefficients_t v;
+
+      // Largest value of a component before `shift` is applied
+      std::int32_t max;
+
+      // Components are stored shifted left by this many bits, e.g. P010 keeps them in the high bits
+      int shift;
+    };
+
+  private:
+    params_t params;
+
+    bool high_bit_depth;
+    bool chroma_420;
+    bool interleaved_chroma;
+  };
+}  // namespace video
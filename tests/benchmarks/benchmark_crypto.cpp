@@ -0,0 +1,115 @@
+/**
+ * @file tests/benchmarks/benchmark_crypto.cpp
+ * @brief Benchmark src/crypto.*
+ */
+#include "../tests_common.h"
+
+#include <src/crypto.h>
+
+#include <chrono>
+
+struct GcmBatchBenchmark: testing::Test {
+  static constexpr size_t iv_size = 12;
+
+  crypto::aes_t key = crypto::aes_t(16, 0x42);
+
+  static std::vector<uint8_t> make_iv(std::uint64_t counter) {
+    std::vector<uint8_t> iv(iv_size);
+    std::copy_n((uint8_t *) &counter, sizeof(counter), std::begin(iv));
+    iv[11] = 'V';
+    return iv;
+  }
+};
+
+TEST_F(GcmBatchBenchmark, Throughput) {
+  constexpr size_t shards = 256;
+  constexpr int iterations = 100;
+
+  for (size_t shard_size : {1024, 1400}) {
+    std::vector<uint8_t> buffer(shards * shard_size, 0x5A);
+    std::vector<uint8_t> tags(shards * crypto::cipher::tag_size);
+    std::vector<std::vector<uint8_t>> ivs;
+    for (size_t x = 0; x < shards; ++x) {
+      ivs.emplace_back(make_iv(x));
+    }
+
+    crypto::cipher::gcm_t single {key, false};
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      for (size_t x = 0; x < shards; ++x) {
+        single.encrypt({(char *) &buffer[x * shard_size], shard_size}, &tags[x * crypto::cipher::tag_size], &buffer[x * shard_size], &ivs[x]);
+      }
+    }
+    std::chrono::duration<double> per_packet = std::chrono::steady_clock::now() - start;
+
+    crypto::cipher::gcm_t batched {key, false};
+    std::vector<crypto::cipher::gcm_t::batch_entry_t> entries;
+    for (size_t x = 0; x < shards; ++x) {
+      entries.push_back({{(char *) &buffer[x * shard_size], shard_size}, &buffer[x * shard_size], &tags[x * crypto::cipher::tag_size], ivs[x].data()});
+    }
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      ASSERT_EQ(batched.encrypt(entries.data(), entries.size(), iv_size), 0);
+    }
+    std::chrono::duration<double> batch = std::chrono::steady_clock::now() - start;
+
+    auto bytes = (double) iterations * shards * shard_size;
+    BOOST_LOG(tests) << shard_size << " byte shards: per-packet "sv << bytes / per_packet.count() / (1024 * 1024) << " MiB/s, batched "sv
+                     << bytes / batch.count() / (1024 * 1024) << " MiB/s"sv;
+  }
+}
+
+struct CertChainBenchmark: testing::Test {
+  static inline crypto::creds_t creds = crypto::gen_creds("Moonlight"sv, 2048);
+
+  // Devices get certificates of their own, but share a key, since generating 1,000 keys takes too long
+  static crypto::p_named_cert_t make_device(int id) {
+    crypto::x509_t x509 {X509_dup(crypto::x509(creds.x509).get())};
+    auto pkey = crypto::pkey(creds.pkey);
+
+    auto cn = "Moonlight "s + std::to_string(id);
+    auto name = X509_get_subject_name(x509.get());
+    X509_NAME_delete_entry(name, 0);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const std::uint8_t *) cn.data(), cn.size(), -1, 0);
+    X509_set_issuer_name(x509.get(), name);
+    X509_sign(x509.get(), pkey.get(), EVP_sha256());
+
+    auto named_cert_p = std::make_shared<crypto::named_cert_t>();
+    named_cert_p->name = cn;
+    named_cert_p->cert = crypto::pem(x509);
+    return named_cert_p;
+  }
+};
+
+TEST_F(CertChainBenchmark, Verify) {
+  constexpr int iterations = 200;
+
+  for (int clients : {1, 100, 1000}) {
+    crypto::cert_chain_t cert_chain;
+    std::vector<crypto::p_named_cert_t> devices;
+    for (int x = 0; x < clients; ++x) {
+      devices.emplace_back(make_device(x));
+      cert_chain.add(devices.back());
+    }
+
+    // The device paired last, the last one a linear search would find
+    auto x509 = crypto::x509(devices.back()->cert);
+    crypto::p_named_cert_t named_cert_p;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      ASSERT_EQ(cert_chain.verify(x509.get(), named_cert_p), nullptr);
+    }
+    std::chrono::duration<double, std::micro> full = std::chrono::steady_clock::now() - start;
+
+    util::safe_ptr<SSL_SESSION, SSL_SESSION_free> session {SSL_SESSION_new()};
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      ASSERT_EQ(cert_chain.verify(x509.get(), session.get(), named_cert_p), nullptr);
+    }
+    std::chrono::duration<double, std::micro> cached = std::chrono::steady_clock::now() - start;
+
+    BOOST_LOG(tests) << clients << " paired clients: verify "sv << full.count() / iterations << "us, resumed session "sv
+                     << cached.count() / iterations << "us"sv;
+  }
+}
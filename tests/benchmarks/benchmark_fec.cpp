@@ -0,0 +1,105 @@
+/**
+ * @file tests/benchmarks/benchmark_fec.cpp
+ * @brief Benchmark src/rswrapper.* and src/fec.*
+ */
+extern "C" {
+#include <src/rswrapper.h>
+}
+
+#include "../tests_allocations.h"
+#include "../tests_common.h"
+
+#include <src/fec.h>
+
+#include <chrono>
+#include <numeric>
+#include <vector>
+
+TEST(FecBenchmark, ParityThroughput) {
+  reed_solomon_init();
+
+  struct profile_t {
+    std::string_view name;
+    int data_shards;
+    int parity_shards;
+    int block_size;
+  };
+
+  for (auto &profile : {
+         // A full video FEC block at 20% FEC with the default Moonlight packet size
+         profile_t {"video", 212, 43, 1392 + 16},
+         // An audio FEC block with 5 ms Opus packets
+         profile_t {"audio", 4, 2, 400},
+       }) {
+    auto rs = reed_solomon_new(profile.data_shards, profile.parity_shards);
+    ASSERT_NE(rs, nullptr);
+
+    auto nr_shards = profile.data_shards + profile.parity_shards;
+    std::vector<uint8_t> buffer(nr_shards * profile.block_size);
+    std::vector<uint8_t *> shards;
+    for (int x = 0; x < nr_shards; ++x) {
+      shards.push_back(&buffer[x * profile.block_size]);
+    }
+    for (size_t x = 0; x < profile.data_shards * profile.block_size; ++x) {
+      buffer[x] = (uint8_t) (x * 7 + 3);
+    }
+
+    constexpr int iterations = 200;
+    auto start = std::chrono::steady_clock::now();
+    for (int x = 0; x < iterations; ++x) {
+      ASSERT_EQ(reed_solomon_encode(rs, shards.data(), nr_shards, profile.block_size), 0);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    auto data_bytes = (double) iterations * profile.data_shards * profile.block_size;
+    BOOST_LOG(tests) << reed_solomon_isa() << ' ' << profile.name << " parity: "sv
+                     << data_bytes / elapsed.count() / (1024 * 1024) << " MiB/s of data, "sv
+                     << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / iterations << " ns/block"sv;
+
+    reed_solomon_release(rs);
+  }
+}
+
+TEST(FecBenchmark, SteadyState) {
+  reed_solomon_init();
+
+  struct profile_t {
+    std::string_view name;
+    size_t frame_size;
+  };
+
+  // Packet size requested by Moonlight by default, plus the RTP header space
+  constexpr size_t blocksize = 1392 + 16;
+  constexpr size_t frames = 240;
+
+  for (auto &profile : {
+         profile_t {"1080p60 at 20 Mbps", 20'000'000 / 8 / 60},
+         profile_t {"2160p120 at 150 Mbps", 150'000'000 / 8 / 120},
+       }) {
+    std::vector<char> payload(profile.frame_size);
+    std::iota(std::begin(payload), std::end(payload), 0);
+
+    auto frame_size = [&](size_t frame) {
+      // Vary the frame size like an encoder would
+      return profile.frame_size - (frame % 8) * blocksize;
+    };
+
+    stream::fec::arena_t arena;
+    for (size_t x = 0; x < 8; ++x) {
+      arena.encode({payload.data(), frame_size(x)}, blocksize, 20, 2, 32);
+    }
+
+    auto allocations = test_utils::allocation_count();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t x = 0; x < frames; ++x) {
+      auto shards = arena.encode({payload.data(), frame_size(x)}, blocksize, 20, 2, 32);
+      ASSERT_GT(shards.size(), shards.data_shards);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    allocations = test_utils::allocation_count() - allocations;
+
+    BOOST_LOG(tests) << profile.name << ": "sv
+                     << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / frames << " ns/frame, "sv
+                     << (double) allocations / frames << " allocations/frame"sv;
+  }
+}
@@ -0,0 +1,58 @@
+/**
+ * @file tests/benchmarks/benchmark_logging.cpp
+ * @brief Benchmark src/logging.*
+ */
+#include "../tests_common.h"
+
+#include <chrono>
+#include <src/logging.h>
+
+struct DeferredLoggingBenchmark: testing::Test {
+  void SetUp() override {
+    deinit_log = logging::init(0, "test_sunshine.log", true);
+  }
+
+  void TearDown() override {
+    // Initializing again replaces the deferred logging, the test environment deinitializes it in the end
+    deinit_log.release();
+    logging::init(0, "test_sunshine.log").release();
+  }
+
+  std::unique_ptr<logging::deinit_t> deinit_log;
+};
+
+TEST_F(DeferredLoggingBenchmark, PerRecord) {
+  // Batches that fit into a ring, so no record is dropped
+  constexpr int rounds = 20;
+  constexpr int batch = 500;
+
+  auto measure = [](auto &&f) {
+    std::chrono::nanoseconds total {};
+    for (int round = 0; round < rounds; ++round) {
+      auto start = std::chrono::steady_clock::now();
+      for (int x = 0; x < batch; ++x) {
+        f(x);
+      }
+      total += std::chrono::steady_clock::now() - start;
+
+      logging::log_flush();
+    }
+
+    return total.count() / (rounds * batch);
+  };
+
+  auto boost_log = measure([](int x) {
+    BOOST_LOG(verbose) << "Sent Frame seq ["sv << x << "] shards ["sv << 64 << "/"sv << 20 << "%]"sv;
+  });
+  auto deferred = measure([](int x) {
+    LOG_DEFERRED(verbose, "Sent Frame seq [{}] shards [{}/{}%]", x, 64, 20);
+  });
+
+  logging::deferred::min_level = 1;
+  auto filtered = measure([](int x) {
+    LOG_DEFERRED(verbose, "Sent Frame seq [{}] shards [{}/{}%]", x, 64, 20);
+  });
+  logging::deferred::min_level = 0;
+
+  BOOST_LOG(tests) << "BOOST_LOG "sv << boost_log << "ns, LOG_DEFERRED "sv << deferred << "ns, LOG_DEFERRED below the log level "sv << filtered << "ns per record"sv;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file tests/benchmarks/benchmark_task_pool.cpp
+ * @brief Benchmark src/thread_pool.h.
+ */
+#include "../tests_common.h"
+
+#include <src/thread_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+using namespace std::literals;
+
+TEST(ThreadPoolBenchmark, Timers) {
+  constexpr int count = 10000;
+
+  auto per_op = [](auto elapsed) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / count;
+  };
+
+  thread_pool_util::ThreadPool pool {1};
+
+  std::mt19937 rng {42};
+  std::uniform_int_distribution<int> delays {1000, 60000};
+
+  std::vector<thread_pool_util::ThreadPool::task_id_t> ids;
+  ids.reserve(count);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int x = 0; x < count; ++x) {
+    ids.push_back(pool.pushDelayed([]() {}, std::chrono::milliseconds(delays(rng))).task_id);
+  }
+  auto inserted = std::chrono::steady_clock::now();
+
+  for (auto id : ids) {
+    pool.delay(id, std::chrono::milliseconds(delays(rng)));
+  }
+  auto rescheduled = std::chrono::steady_clock::now();
+
+  std::shuffle(std::begin(ids), std::end(ids), rng);
+  for (auto id : ids) {
+    ASSERT_TRUE(pool.cancel(id));
+  }
+  auto cancelled = std::chrono::steady_clock::now();
+
+  BOOST_LOG(tests) << count << " pending timers: insert "sv << per_op(inserted - start) << "ns, reschedule "sv
+                   << per_op(rescheduled - inserted) << "ns, cancel "sv << per_op(cancelled - rescheduled) << "ns"sv;
+}
+
+TEST(ThreadPoolBenchmark, Post) {
+  constexpr int producers = 4;
+  constexpr int count = 50000;
+
+  auto measure = [](auto submit) {
+    thread_pool_util::ThreadPool pool {producers};
+    std::atomic<int> remaining {producers * count};
+    std::promise<void> done;
+
+    auto task = [&remaining, &done]() {
+      if (--remaining == 0) {
+        done.set_value();
+      }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int x = 0; x < producers; ++x) {
+      threads.emplace_back([&pool, &submit, &task]() {
+        for (int y = 0; y < count; ++y) {
+          submit(pool, task);
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    done.get_future().wait();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / (producers * count);
+  };
+
+  auto push = measure([](auto &pool, auto &task) {
+    pool.push(task);
+  });
+  auto post = measure([](auto &pool, auto &task) {
+    pool.post(task);
+  });
+
+  BOOST_LOG(tests) << producers << " producers: push "sv << push << "ns, post "sv << post << "ns per task"sv;
+}
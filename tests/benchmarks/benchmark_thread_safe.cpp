@@ -0,0 +1,78 @@
+/**
+ * @file tests/benchmarks/benchmark_thread_safe.cpp
+ * @brief Benchmark src/thread_safe.*
+ */
+#include "../tests_common.h"
+
+#include <src/thread_safe.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using time_point_t = std::chrono::steady_clock::time_point;
+
+namespace {
+  /**
+   * @brief Measure how long elements take from `raise()` until `pop()` returns them.
+   * @details The producer raises bursts of elements while other threads keep the CPU busy. Single elements
+   *          mostly measure waking the consumer, larger bursts mostly the cost of each handoff.
+   */
+  template<class Q>
+  std::vector<std::chrono::nanoseconds> measure_handoff(Q &queue, int count, int burst) {
+    std::atomic_bool done {false};
+    std::vector<std::thread> load;
+    for (int x = 0; x < 2; ++x) {
+      load.emplace_back([&done]() {
+        while (!done) {}
+      });
+    }
+
+    std::thread producer {[&queue, count, burst]() {
+      auto next = std::chrono::steady_clock::now();
+      for (int i = 0; i < count; i += burst) {
+        next += 50us * burst;
+        std::this_thread::sleep_until(next);
+
+        for (int x = 0; x < burst; ++x) {
+          queue.raise(std::make_unique<time_point_t>(std::chrono::steady_clock::now()));
+        }
+      }
+    }};
+
+    std::vector<std::chrono::nanoseconds> latencies;
+    latencies.reserve(count);
+    for (int i = 0; i < count; ++i) {
+      auto val = queue.pop();
+      latencies.emplace_back(std::chrono::steady_clock::now() - *val);
+    }
+
+    producer.join();
+    done = true;
+    for (auto &thread : load) {
+      thread.join();
+    }
+
+    std::sort(std::begin(latencies), std::end(latencies));
+    return latencies;
+  }
+}  // namespace
+
+TEST(RingBenchmark, HandoffLatency) {
+  constexpr int count = 16384;
+
+  auto percentile = [](auto &latencies, int p) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(latencies[latencies.size() * p / 100]).count();
+  };
+
+  for (int burst : {1, 32}) {
+    safe::queue_t<std::unique_ptr<time_point_t>> queue {count};
+    auto queue_latencies = measure_handoff(queue, count, burst);
+
+    safe::ring_t<std::unique_ptr<time_point_t>> ring {count};
+    auto ring_latencies = measure_handoff(ring, count, burst);
+
+    BOOST_LOG(tests) << "Bursts of "sv << burst << ": queue_t p50 "sv << percentile(queue_latencies, 50) << "us, p99 "sv << percentile(queue_latencies, 99)
+                     << "us; ring_t p50 "sv << percentile(ring_latencies, 50) << "us, p99 "sv << percentile(ring_latencies, 99) << "us"sv;
+  }
+}
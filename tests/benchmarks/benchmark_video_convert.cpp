@@ -0,0 +1,53 @@
+/**
+ * @file tests/benchmarks/benchmark_video_convert.cpp
+ * @brief Benchmark src/video_convert.*
+ */
+#include "../tests_common.h"
+
+#include <src/video_convert.h>
+
+#include <chrono>
+#include <vector>
+
+TEST(VideoConvertBenchmark, Conversion) {
+  constexpr int width = 1920;
+  constexpr int height = 1080;
+  constexpr int iterations = 20;
+
+  struct format_t {
+    AVPixelFormat format;
+    std::string_view name;
+  };
+
+  std::vector<std::uint8_t> src((std::size_t) width * 4 * height, 0x80);
+  video::sunshine_colorspace_t colorspace {video::colorspace_e::rec709, false, 8};
+
+  for (auto &format : {
+         format_t {AV_PIX_FMT_NV12, "nv12"sv},
+         format_t {AV_PIX_FMT_P010, "p010"sv},
+         format_t {AV_PIX_FMT_YUV420P, "yuv420p"sv},
+         format_t {AV_PIX_FMT_YUV420P10, "yuv420p10"sv},
+         format_t {AV_PIX_FMT_YUV444P, "yuv444p"sv},
+         format_t {AV_PIX_FMT_YUV444P10, "yuv444p10"sv},
+       }) {
+    video::bgr0_converter_t converter {format.format, colorspace};
+
+    // Planes large enough for any of the formats: 16 bits per component, full resolution chroma
+    std::vector<std::uint8_t> buffers[3];
+    std::uint8_t *planes[3];
+    int pitch[3];
+    for (int plane = 0; plane < 3; ++plane) {
+      pitch[plane] = width * 2 * 2;
+      buffers[plane].resize((std::size_t) pitch[plane] * height);
+      planes[plane] = buffers[plane].data();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int x = 0; x < iterations; ++x) {
+      converter.convert(src.data(), width * 4, width, height, planes, pitch, 0, height);
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    BOOST_LOG(tests) << video::bgr0_converter_t::isa() << ' ' << format.name << ": "sv << elapsed.count() / iterations << " ms per 1080p frame"sv;
+  }
+}
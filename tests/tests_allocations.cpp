@@ -0,0 +1,62 @@
+/**
+ * @file tests/tests_allocations.cpp
+ * @brief Definitions for heap allocation counting.
+ * @details Replaces the global allocation functions of the test binary with counting wrappers around malloc().
+ */
+// standard includes
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// local includes
+#include "tests_allocations.h"
+
+namespace {
+  thread_local std::size_t thread_allocations = 0;
+  std::atomic<std::size_t> allocations = 0;
+
+  void *counted_alloc(std::size_t size) {
+    ++thread_allocations;
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (auto p = std::malloc(size ? size : 1)) {
+      return p;
+    }
+
+    throw std::bad_alloc {};
+  }
+}  // namespace
+
+namespace test_utils {
+  std::size_t thread_allocation_count() {
+    return thread_allocations;
+  }
+
+  std::size_t allocation_count() {
+    return allocations.load(std::memory_order_relaxed);
+  }
+}  // namespace test_utils
+
+void *operator new(std::size_t size) {
+  return counted_alloc(size);
+}
+
+void *operator new[](std::size_t size) {
+  return counted_alloc(size);
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+  std::free(p);
+}
@@ -0,0 +1,22 @@
+/**
+ * @file tests/tests_allocations.h
+ * @brief Declarations for heap allocation counting.
+ */
+#pragma once
+
+// standard includes
+#include <cstddef>
+
+namespace test_utils {
+  /**
+   * @brief Get the number of `operator new` calls made so far on the calling thread.
+   * @return The allocation count.
+   */
+  std::size_t thread_allocation_count();
+
+  /**
+   * @brief Get the number of `operator new` calls made so far on all threads.
+   * @return The allocation count.
+   */
+  std::size_t allocation_count();
+}  // namespace test_utils
@@ -5,8 +5,12 @@
 #include "../../tests_common.h"
 
 #include <boost/asio/ip/host_name.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <src/config.h>
 #include <src/platform/common.h>
 
+#include <thread>
+
 struct SetEnvTest: ::testing::TestWithParam<std::tuple<std::string, std::string, int>> {
 protected:
   void TearDown() override {
@@ -53,3 +57,119 @@ TEST(HostnameTests, TestAsioEquality) {
   // These should be equivalent on all platforms for ASCII hostnames
   ASSERT_EQ(platf::get_host_name(), boost::asio::ip::host_name());
 }
+
+struct SendBatchTest: ::testing::TestWithParam<std::tuple<bool, bool>> {
+  void TearDown() override {
+    config::stream.io_uring = false;
+    config::stream.udp_zerocopy = false;
+  }
+};
+
+TEST_P(SendBatchTest, DeliversEveryPacket) {
+  using boost::asio::ip::udp;
+
+  constexpr size_t header_size = 4;
+  constexpr size_t payload_size = 1000;
+  constexpr size_t packets = 40;
+
+  boost::asio::io_context io;
+  udp::socket receiver {io, udp::endpoint {boost::asio::ip::address_v4::loopback(), 0}};
+  udp::socket sender {io, udp::endpoint {boost::asio::ip::address_v4::loopback(), 0}};
+
+  std::vector<char> headers(packets * header_size);
+  std::vector<char> payload(packets * payload_size);
+  for (size_t x = 0; x < packets; ++x) {
+    std::fill_n(&headers[x * header_size], header_size, (char) x);
+    std::fill_n(&payload[x * payload_size], payload_size, (char) ~x);
+  }
+  std::vector<platf::buffer_descriptor_t> payload_buffers {{payload.data(), payload.size()}};
+
+  auto target_address = receiver.local_endpoint().address();
+  auto source_address = sender.local_endpoint().address();
+
+  std::tie(config::stream.io_uring, config::stream.udp_zerocopy) = GetParam();
+
+  // Send state is kept per thread, so use a fresh thread for each backend
+  bool sent = false;
+  std::thread {[&]() {
+    // Send twice so the io_uring path is used once GSO is known to work
+    for (size_t offset : {(size_t) 0, packets / 2}) {
+      platf::batched_send_info_t send_info {
+        headers.data(),
+        header_size,
+        payload_buffers,
+        payload_size,
+        offset,
+        packets / 2,
+        (uintptr_t) sender.native_handle(),
+        target_address,
+        receiver.local_endpoint().port(),
+        source_address,
+      };
+      sent = platf::send_batch(send_info);
+      if (!sent) {
+        return;
+      }
+    }
+    platf::send_batch_wait();
+  }}.join();
+
+  if (!sent) {
+    GTEST_SKIP() << "Batched sends are not supported on this platform";
+  }
+
+  std::array<char, header_size + payload_size> packet;
+  for (size_t x = 0; x < packets; ++x) {
+    ASSERT_EQ(receiver.receive(boost::asio::buffer(packet)), packet.size());
+    ASSERT_EQ(packet.front(), (char) x);
+    ASSERT_EQ(packet.back(), (char) ~x);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  SendBatchTests,
+  SendBatchTest,
+  ::testing::Combine(::testing::Bool(), ::testing::Bool())
+);
+
+TEST(SendMultipleTest, DeliversPacketsOfDifferentSizes) {
+  using boost::asio::ip::udp;
+
+  boost::asio::io_context io;
+  udp::socket receiver {io, udp::endpoint {boost::asio::ip::address_v4::loopback(), 0}};
+  udp::socket sender {io, udp::endpoint {boost::asio::ip::address_v4::loopback(), 0}};
+
+  // Data packets with a short header, followed by parity packets with a longer one
+  std::string short_header(12, 'd');
+  std::string long_header(24, 'f');
+  std::string payload(200, 'p');
+
+  std::vector<platf::send_message_t> messages {
+    {short_header.data(), short_header.size(), payload.data(), payload.size()},
+    {short_header.data(), short_header.size(), payload.data(), 100},
+    {long_header.data(), long_header.size(), payload.data(), payload.size()},
+    {nullptr, 0, payload.data(), 50},
+  };
+
+  auto target_address = receiver.local_endpoint().address();
+  auto source_address = sender.local_endpoint().address();
+
+  platf::multi_send_info_t send_info {
+    messages.data(),
+    messages.size(),
+    (uintptr_t) sender.native_handle(),
+    target_address,
+    receiver.local_endpoint().port(),
+    source_address,
+  };
+  ASSERT_TRUE(platf::send_multiple(send_info));
+  ASSERT_GE(send_info.system_calls, 1);
+  ASSERT_LE(send_info.system_calls, messages.size());
+
+  std::array<char, 512> packet;
+  for (auto &message : messages) {
+    auto size = receiver.receive(boost::asio::buffer(packet));
+    ASSERT_EQ(size, message.header_size + message.payload_size);
+    ASSERT_EQ(packet.front(), message.header ? message.header[0] : 'p');
+  }
+}
@@ -0,0 +1,105 @@
+/**
+ * @file tests/unit/test_adaptive_bitrate.cpp
+ * @brief Test src/adaptive_bitrate.*
+ */
+#include "../tests_common.h"
+
+#include <src/adaptive_bitrate.h>
+
+using namespace std::literals;
+
+namespace {
+  constexpr auto frame_interval = 1000ms / 60;
+  const auto start = std::chrono::steady_clock::time_point {} + 1h;
+
+  /**
+   * @brief Send frames on time for a while, collecting the last bitrate change.
+   */
+  std::optional<int> send_clean(stream::adaptive_bitrate_t &controller, std::chrono::steady_clock::time_point &now, std::chrono::milliseconds duration) {
+    std::optional<int> last_change;
+    for (auto end = now + duration; now < end; now += frame_interval) {
+      if (auto bitrate = controller.frame_sent(1ms, now)) {
+        last_change = bitrate;
+      }
+    }
+    return last_change;
+  }
+}  // namespace
+
+TEST(AdaptiveBitrateTest, LossLowersBitrateAndRaisesFec) {
+  stream::adaptive_bitrate_t controller {20000, 20, 60};
+  ASSERT_FALSE(controller.started());
+
+  auto now = start;
+  controller.frame_sent(1ms, now);
+  ASSERT_TRUE(controller.started());
+
+  ASSERT_EQ(controller.frames_lost(2, now), 16000);
+  ASSERT_EQ(controller.fec_percentage(), 30);
+
+  // Reports of the same episode don't lower the bitrate again
+  ASSERT_FALSE(controller.frames_lost(1, now + 100ms));
+  ASSERT_EQ(controller.bitrate(), 16000);
+  ASSERT_EQ(controller.frames_lost(1, now + 600ms), 12800);
+
+  // No loss reported
+  ASSERT_FALSE(controller.frames_lost(0, now + 2s));
+}
+
+TEST(AdaptiveBitrateTest, BitrateStaysWithinLimits) {
+  stream::adaptive_bitrate_t controller {20000, 20, 60};
+
+  auto now = start;
+  for (int x = 0; x < 50; ++x) {
+    controller.frames_lost(1, now);
+    now += 1s;
+  }
+  ASSERT_EQ(controller.bitrate(), 4000);
+  ASSERT_EQ(controller.fec_percentage(), 50);
+
+  send_clean(controller, now, 60s);
+  ASSERT_EQ(controller.bitrate(), 20000);
+  ASSERT_EQ(controller.fec_percentage(), 20);
+
+  // Low bitrates keep a floor of 500 Kbps, but never exceed what the client asked for
+  stream::adaptive_bitrate_t low {300, 20, 60};
+  ASSERT_FALSE(low.frames_lost(1, start));
+  ASSERT_EQ(low.bitrate(), 300);
+}
+
+TEST(AdaptiveBitrateTest, RecoversGradually) {
+  stream::adaptive_bitrate_t controller {20000, 20, 60};
+
+  auto now = start;
+  controller.frames_lost(1, now);
+  ASSERT_EQ(controller.bitrate(), 16000);
+
+  // Nothing changes until the stream has been clean for a while
+  ASSERT_FALSE(send_clean(controller, now, 1900ms));
+  ASSERT_EQ(controller.fec_percentage(), 30);
+
+  // Then the bitrate grows by 5% of the requested bitrate at a time
+  ASSERT_EQ(send_clean(controller, now, 200ms), 17000);
+  ASSERT_EQ(send_clean(controller, now, 500ms), 18000);
+
+  // FEC decays once there was no loss for longer
+  send_clean(controller, now, 3500ms);
+  ASSERT_LT(controller.fec_percentage(), 30);
+}
+
+TEST(AdaptiveBitrateTest, BacklogLowersBitrate) {
+  stream::adaptive_bitrate_t controller {20000, 20, 60};
+
+  auto now = start;
+
+  // A single slow frame is not congestion
+  ASSERT_FALSE(controller.frame_sent(50ms, now));
+  ASSERT_FALSE(controller.frame_sent(1ms, now += frame_interval));
+
+  ASSERT_FALSE(controller.frame_sent(50ms, now += frame_interval));
+  ASSERT_FALSE(controller.frame_sent(50ms, now += frame_interval));
+  ASSERT_EQ(controller.frame_sent(50ms, now += frame_interval), 18000);
+
+  // Backlog doesn't raise FEC, which would only add to it
+  ASSERT_EQ(controller.fec_percentage(), 20);
+}
@@ -2,6 +2,7 @@
  * @file tests/unit/test_audio.cpp
  * @brief Test src/audio.*.
  */
+#include "../tests_allocations.h"
 #include "../tests_common.h"
 
 #include <src/audio.h>
@@ -45,18 +46,18 @@ TEST_P(AudioTest, TestEncode) {
     // Terminate the audio capture after 100 ms
     std::this_thread::sleep_for(100ms);
     const auto shutdown_event = m_mail->event<bool>(mail::shutdown);
-    const auto audio_packets = m_mail->queue<packet_t>(mail::audio_packets);
+    const auto audio_packets = mail::man->ring<packet_t>(mail::audio_packets);
     shutdown_event->raise(true);
     audio_packets->stop();
   });
   std::thread capture([&] {
-    const auto packets = m_mail->queue<packet_t>(mail::audio_packets);
+    const auto packets = mail::man->ring<packet_t>(mail::audio_packets);
     const auto shutdown_event = m_mail->event<bool>(mail::shutdown);
     while (const auto packet = packets->pop()) {
       if (shutdown_event->peek()) {
         break;
       }
-      if (auto packet_data = packet->second; packet_data.size() == 0) {
+      if (packet->second->size() == 0) {
         FAIL() << "Empty packet data";
       }
     }
@@ -66,3 +67,69 @@ TEST_P(AudioTest, TestEncode) {
   timer.join();
   capture.join();
 }
+
+struct FakeSourceAudioTest: testing::Test {
+  void SetUp() override {
+    audio::use_fake_audio_source(true);
+    m_mail = std::make_shared<safe::mail_raw_t>();
+  }
+
+  void TearDown() override {
+    audio::use_fake_audio_source(false);
+  }
+
+  /**
+   * @brief Capture from the fake source while the function runs.
+   * @return The number of packets that were encoded.
+   */
+  int capture_while(const std::function<void()> &f) {
+    // Keep the mailbox alive until the capture is done
+    const auto packets = mail::man->ring<packet_t>(mail::audio_packets);
+
+    std::atomic_int packet_count = 0;
+    std::thread timer([&] {
+      f();
+      m_mail->event<bool>(mail::shutdown)->raise(true);
+      packets->stop();
+    });
+    std::thread receiver([&] {
+      while (const auto packet = packets->pop()) {
+        if (packet->second->size() == 0) {
+          ADD_FAILURE() << "Empty packet data";
+        }
+        ++packet_count;
+      }
+    });
+    audio::capture(m_mail, {5, 2, 0x3, {0}, config_flags()}, nullptr);
+
+    timer.join();
+    receiver.join();
+
+    return packet_count;
+  }
+
+  safe::mail_t m_mail;
+};
+
+TEST_F(FakeSourceAudioTest, TestEncode) {
+  auto packet_count = capture_while([] {
+    std::this_thread::sleep_for(100ms);
+  });
+
+  // The fake source produces 20 frames of 5 ms in 100 ms
+  ASSERT_GT(packet_count, 10);
+}
+
+TEST_F(FakeSourceAudioTest, NoSteadyStateAllocations) {
+  std::size_t allocations = 0;
+  auto packet_count = capture_while([&allocations] {
+    // Let the pipeline start up, then count allocations of all threads while it runs
+    std::this_thread::sleep_for(100ms);
+    auto start = test_utils::allocation_count();
+    std::this_thread::sleep_for(200ms);
+    allocations = test_utils::allocation_count() - start;
+  });
+
+  ASSERT_GT(packet_count, 40);
+  ASSERT_EQ(allocations, 0);
+}
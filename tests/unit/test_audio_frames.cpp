@@ -0,0 +1,105 @@
+/**
+ * @file tests/unit/test_audio_frames.cpp
+ * @brief Test src/audio_frames.*
+ */
+#include "../tests_common.h"
+
+#include <src/audio_frames.h>
+
+#include <future>
+#include <numeric>
+#include <thread>
+
+using namespace std::literals;
+
+TEST(AudioFramesTest, AssemblesFramesFromChunks) {
+  audio::frame_queue_t queue {4, 6};
+  std::vector<float> frame(6);
+
+  std::vector<float> samples(10);
+  std::iota(std::begin(samples), std::end(samples), 0.0f);
+
+  queue.write(samples.data(), 4);
+  ASSERT_EQ(queue.read(frame, 0ms), platf::capture_e::timeout);
+
+  queue.write(samples.data() + 4, 6);
+  ASSERT_EQ(queue.read(frame, 0ms), platf::capture_e::ok);
+  ASSERT_EQ(frame, (std::vector<float> {0, 1, 2, 3, 4, 5}));
+
+  // The rest of the chunk starts the next frame, holes are filled with silence
+  queue.write(nullptr, 2);
+  ASSERT_EQ(queue.read(frame, 0ms), platf::capture_e::ok);
+  ASSERT_EQ(frame, (std::vector<float> {6, 7, 8, 9, 0, 0}));
+}
+
+TEST(AudioFramesTest, DropsOldestFramesOnOverrun) {
+  audio::frame_queue_t queue {2, 2};
+  std::vector<float> frame(2);
+
+  std::vector<float> samples {1, 1, 2, 2, 3, 3};
+  queue.write(samples.data(), samples.size());
+  ASSERT_EQ(queue.overruns(), 1);
+
+  ASSERT_EQ(queue.read(frame, 0ms), platf::capture_e::ok);
+  ASSERT_EQ(frame, (std::vector<float> {2, 2}));
+  ASSERT_EQ(queue.read(frame, 0ms), platf::capture_e::ok);
+  ASSERT_EQ(frame, (std::vector<float> {3, 3}));
+  ASSERT_EQ(queue.read(frame, 0ms), platf::capture_e::timeout);
+}
+
+TEST(AudioFramesTest, WritesWakeReader) {
+  audio::frame_queue_t queue {2, 2};
+  std::vector<float> frame(2);
+
+  auto writer = std::async(std::launch::async, [&queue]() {
+    std::this_thread::sleep_for(10ms);
+
+    float samples[] {1, 2};
+    queue.write(samples, 2, 5ms);
+  });
+
+  ASSERT_EQ(queue.read(frame, 1s), platf::capture_e::ok);
+  writer.get();
+
+  ASSERT_EQ(frame, (std::vector<float> {1, 2}));
+  ASSERT_GE(queue.latency(), 5ms);
+}
+
+TEST(AudioFramesTest, StopWakesReader) {
+  audio::frame_queue_t queue {2, 2};
+  std::vector<float> frame(2);
+
+  auto stopper = std::async(std::launch::async, [&queue]() {
+    std::this_thread::sleep_for(10ms);
+    queue.stop(platf::capture_e::error);
+  });
+
+  ASSERT_EQ(queue.read(frame, 1s), platf::capture_e::error);
+  stopper.get();
+  ASSERT_EQ(queue.read(frame, 0ms), platf::capture_e::error);
+}
+
+TEST(AudioFramesTest, FakeSourceCapturesInRealTime) {
+  auto control = audio::fake_audio_control();
+  ASSERT_TRUE(control->sink_info());
+
+  constexpr int channels = 2;
+  constexpr int frame_size = 240;
+  auto mic = control->microphone(platf::speaker::map_stereo, channels, 48000, frame_size);
+  ASSERT_TRUE(mic);
+
+  std::vector<float> frame(frame_size * channels);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int x = 0; x < 10; ++x) {
+    ASSERT_EQ(mic->sample(frame), platf::capture_e::ok);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  // 10 frames of 5ms can't be captured faster than a sound card would
+  ASSERT_GE(elapsed, 40ms);
+  ASSERT_TRUE(mic->latency());
+  ASSERT_TRUE(std::any_of(std::begin(frame), std::end(frame), [](float sample) {
+    return sample != 0.0f;
+  }));
+}
@@ -0,0 +1,126 @@
+/**
+ * @file tests/unit/test_crypto.cpp
+ * @brief Test src/crypto.*
+ */
+#include "../tests_common.h"
+
+#include <src/crypto.h>
+
+#include <numeric>
+
+struct GcmBatchTest: testing::Test {
+  static constexpr size_t iv_size = 12;
+
+  crypto::aes_t key = crypto::aes_t(16, 0x42);
+
+  static std::vector<uint8_t> make_iv(std::uint64_t counter) {
+    std::vector<uint8_t> iv(iv_size);
+    std::copy_n((uint8_t *) &counter, sizeof(counter), std::begin(iv));
+    iv[11] = 'V';
+    return iv;
+  }
+};
+
+TEST_F(GcmBatchTest, MatchesPerPacketEncryption) {
+  constexpr size_t shards = 8;
+  constexpr size_t shard_size = 1400;
+
+  std::vector<uint8_t> plaintext(shards * shard_size);
+  std::iota(std::begin(plaintext), std::end(plaintext), 0);
+
+  crypto::cipher::gcm_t single {key, false};
+  std::vector<uint8_t> expected(plaintext.size());
+  std::vector<uint8_t> expected_tags(shards * crypto::cipher::tag_size);
+  for (size_t x = 0; x < shards; ++x) {
+    auto iv = make_iv(x);
+    auto ret = single.encrypt({(char *) &plaintext[x * shard_size], shard_size}, &expected_tags[x * crypto::cipher::tag_size], &expected[x * shard_size], &iv);
+    ASSERT_EQ(ret, shard_size);
+  }
+
+  // Encrypt the batch in place
+  crypto::cipher::gcm_t batched {key, false};
+  std::vector<uint8_t> buffer = plaintext;
+  std::vector<uint8_t> tags(shards * crypto::cipher::tag_size);
+  std::vector<std::vector<uint8_t>> ivs;
+  std::vector<crypto::cipher::gcm_t::batch_entry_t> entries;
+  for (size_t x = 0; x < shards; ++x) {
+    ivs.emplace_back(make_iv(x));
+  }
+  for (size_t x = 0; x < shards; ++x) {
+    entries.push_back({{(char *) &buffer[x * shard_size], shard_size}, &buffer[x * shard_size], &tags[x * crypto::cipher::tag_size], ivs[x].data()});
+  }
+  ASSERT_EQ(batched.encrypt(entries.data(), entries.size(), iv_size), 0);
+
+  ASSERT_EQ(buffer, expected);
+  ASSERT_EQ(tags, expected_tags);
+}
+
+struct CertChainTest: testing::Test {
+  static inline crypto::creds_t creds = crypto::gen_creds("Moonlight"sv, 2048);
+
+  // Devices get certificates of their own, but share a key, since generating 1,000 keys takes too long
+  static crypto::p_named_cert_t make_device(int id) {
+    crypto::x509_t x509 {X509_dup(crypto::x509(creds.x509).get())};
+    auto pkey = crypto::pkey(creds.pkey);
+
+    auto cn = "Moonlight "s + std::to_string(id);
+    auto name = X509_get_subject_name(x509.get());
+    X509_NAME_delete_entry(name, 0);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const std::uint8_t *) cn.data(), cn.size(), -1, 0);
+    X509_set_issuer_name(x509.get(), name);
+    X509_sign(x509.get(), pkey.get(), EVP_sha256());
+
+    auto named_cert_p = std::make_shared<crypto::named_cert_t>();
+    named_cert_p->name = cn;
+    named_cert_p->cert = crypto::pem(x509);
+    return named_cert_p;
+  }
+};
+
+TEST_F(CertChainTest, FindsDeviceOfCertificate) {
+  crypto::cert_chain_t cert_chain;
+  std::vector<crypto::p_named_cert_t> devices;
+  for (int x = 0; x < 3; ++x) {
+    devices.emplace_back(make_device(x));
+    cert_chain.add(devices.back());
+  }
+
+  for (auto &device : devices) {
+    crypto::p_named_cert_t named_cert_p;
+    ASSERT_EQ(cert_chain.verify(crypto::x509(device->cert).get(), named_cert_p), nullptr);
+    ASSERT_EQ(named_cert_p, device);
+  }
+
+  crypto::p_named_cert_t named_cert_p;
+  ASSERT_NE(cert_chain.verify(crypto::x509(make_device(3)->cert).get(), named_cert_p), nullptr);
+
+  cert_chain.remove(devices[1]);
+  ASSERT_NE(cert_chain.verify(crypto::x509(devices[1]->cert).get(), named_cert_p), nullptr);
+  ASSERT_EQ(cert_chain.verify(crypto::x509(devices[2]->cert).get(), named_cert_p), nullptr);
+}
+
+TEST_F(CertChainTest, CachesResultInSession) {
+  crypto::cert_chain_t cert_chain;
+  auto device = make_device(0);
+  cert_chain.add(device);
+
+  auto x509 = crypto::x509(device->cert);
+  util::safe_ptr<SSL_SESSION, SSL_SESSION_free> session {SSL_SESSION_new()};
+
+  crypto::p_named_cert_t named_cert_p;
+  ASSERT_EQ(cert_chain.verify(x509.get(), session.get(), named_cert_p), nullptr);
+  ASSERT_EQ(named_cert_p, device);
+
+  // A copy of the session keeps the result
+  util::safe_ptr<SSL_SESSION, SSL_SESSION_free> copy {SSL_SESSION_dup(session.get())};
+  named_cert_p.reset();
+  ASSERT_EQ(cert_chain.verify(x509.get(), copy.get(), named_cert_p), nullptr);
+  ASSERT_EQ(named_cert_p, device);
+
+  // Unpairing invalidates the result
+  cert_chain.remove(device);
+  ASSERT_NE(cert_chain.verify(x509.get(), session.get(), named_cert_p), nullptr);
+
+  cert_chain.add(device);
+  ASSERT_EQ(cert_chain.verify(x509.get(), session.get(), named_cert_p), nullptr);
+}
@@ -0,0 +1,125 @@
+/**
+ * @file tests/unit/test_fec.cpp
+ * @brief Test src/fec.*
+ */
+#include "../tests_allocations.h"
+#include "../tests_common.h"
+
+#include <src/fec.h>
+
+#include <numeric>
+
+struct FecTest: testing::Test {
+  void SetUp() override {
+    reed_solomon_init();
+  }
+
+  static std::vector<char> make_payload(size_t size) {
+    std::vector<char> payload(size);
+    std::iota(std::begin(payload), std::end(payload), 0);
+    return payload;
+  }
+};
+
+TEST_F(FecTest, RecoverLostDataShard) {
+  constexpr size_t blocksize = 64;
+  auto payload = make_payload(blocksize * 4 + 10);
+
+  stream::fec::arena_t arena;
+  auto shards = arena.encode({payload.data(), payload.size()}, blocksize, 50, 2, 0);
+  ASSERT_EQ(shards.data_shards, 5);
+  ASSERT_EQ(shards.size(), 8);
+
+  // The aligned data shards must reference the payload in place
+  ASSERT_EQ(shards.data(0), payload.data());
+  ASSERT_EQ(shards.data(3), payload.data() + 3 * blocksize);
+
+  std::vector<std::vector<uint8_t>> copies;
+  std::vector<uint8_t *> copies_p;
+  for (size_t x = 0; x < shards.size(); ++x) {
+    copies.emplace_back((uint8_t *) shards.data(x), (uint8_t *) shards.data(x) + blocksize);
+  }
+  for (auto &copy : copies) {
+    copies_p.push_back(copy.data());
+  }
+
+  // Lose a data shard and recover it from parity
+  std::uint8_t marks[8] = {};
+  std::fill(std::begin(copies[1]), std::end(copies[1]), 0);
+  marks[1] = 1;
+
+  auto rs = reed_solomon_new(5, 3);
+  ASSERT_NE(rs, nullptr);
+  ASSERT_EQ(reed_solomon_decode(rs, copies_p.data(), marks, 8, blocksize), 0);
+  reed_solomon_release(rs);
+
+  ASSERT_TRUE(std::equal(std::begin(copies[1]), std::end(copies[1]), (uint8_t *) payload.data() + blocksize));
+}
+
+TEST_F(FecTest, ReusesArenaForSmallerBlocks) {
+  constexpr size_t blocksize = 64;
+  auto payload = make_payload(blocksize * 16 + 1);
+  std::string_view large_block {payload.data(), payload.size()};
+  std::string_view small_block {payload.data(), blocksize * 2 + 3};
+
+  stream::fec::arena_t arena;
+  arena.encode(large_block, blocksize, 20, 2, 32);
+  arena.encode(small_block, blocksize, 20, 2, 32);
+  arena.encode(large_block, blocksize, 20, 2, 32);
+
+  auto allocations = test_utils::thread_allocation_count();
+  auto shards = arena.encode(small_block, blocksize, 20, 2, 32);
+  ASSERT_EQ(test_utils::thread_allocation_count(), allocations);
+
+  // The parity shard minimum applies to small_block blocks
+  ASSERT_EQ(shards.data_shards, 3);
+  ASSERT_EQ(shards.size(), 5);
+  ASSERT_EQ(shards.percentage, 66);
+
+  // The padded final data shard must not contain data left over from the larger block
+  auto last = (uint8_t *) shards.data(2);
+  ASSERT_EQ(last[2], (uint8_t) payload[blocksize * 2 + 2]);
+  ASSERT_TRUE(std::all_of(last + 3, last + blocksize, [](auto b) {
+    return b == 0;
+  }));
+}
+
+TEST_F(FecTest, ShardCountsMatchEncode) {
+  constexpr size_t blocksize = 64;
+  auto payload = make_payload(blocksize * 40 + 7);
+
+  stream::fec::arena_t arena;
+  for (auto size : {blocksize, blocksize * 2 + 3, blocksize * 40, payload.size()}) {
+    auto counts = stream::fec::shard_counts(size, blocksize, 20, 2);
+    auto shards = arena.encode({payload.data(), size}, blocksize, 20, 2, 0);
+
+    EXPECT_EQ(counts.data_shards, shards.data_shards) << size;
+    EXPECT_EQ(counts.data_shards + counts.parity_shards, shards.size()) << size;
+    EXPECT_EQ(counts.percentage, shards.percentage) << size;
+  }
+}
+
+TEST_F(FecTest, SteadyStateDoesNotAllocate) {
+  // Packet size requested by Moonlight by default, plus the RTP header space
+  constexpr size_t blocksize = 1392 + 16;
+  constexpr size_t frame_size = 150'000'000 / 8 / 120;
+
+  auto payload = make_payload(frame_size);
+  auto size_of = [&](size_t frame) {
+    // Vary the frame size like an encoder would
+    return frame_size - (frame % 8) * blocksize;
+  };
+
+  stream::fec::arena_t arena;
+  for (size_t x = 0; x < 8; ++x) {
+    arena.encode({payload.data(), size_of(x)}, blocksize, 20, 2, 32);
+  }
+
+  auto allocations = test_utils::thread_allocation_count();
+  for (size_t x = 0; x < 32; ++x) {
+    auto shards = arena.encode({payload.data(), size_of(x)}, blocksize, 20, 2, 32);
+    ASSERT_GT(shards.size(), shards.data_shards);
+  }
+
+  ASSERT_EQ(test_utils::thread_allocation_count(), allocations);
+}
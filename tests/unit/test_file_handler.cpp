@@ -90,6 +90,17 @@ TEST_P(FileHandlerTests, ReadFileTest) {
   EXPECT_EQ(file_handler::read_file(fileName.c_str()), content);
 }
 
+TEST(FileHandlerTests, WriteFileSyncedTest) {
+  const std::string fileName = "write_file_synced_test.txt";
+  EXPECT_EQ(file_handler::write_file_synced(fileName.c_str(), "first\n"), 0);
+  EXPECT_EQ(file_handler::write_file_synced(fileName.c_str(), "second\n", true), 0);
+  EXPECT_EQ(file_handler::read_file(fileName.c_str()), "first\nsecond\n");
+
+  // Without appending, the contents are replaced
+  EXPECT_EQ(file_handler::write_file_synced(fileName.c_str(), "third\n"), 0);
+  EXPECT_EQ(file_handler::read_file(fileName.c_str()), "third\n");
+}
+
 TEST(FileHandlerTests, ReadMissingFileTest) {
   // read missing file
   EXPECT_EQ(file_handler::read_file("non-existing-file.txt"), "");
@@ -5,6 +5,10 @@
 
 #include "../tests_common.h"
 
+#include <filesystem>
+#include <fstream>
+#include <src/config.h>
+#include <src/httpcommon.h>
 #include <src/nvhttp.h>
 
 using namespace nvhttp;
@@ -265,3 +269,124 @@ TEST(PairingTest, OutOfOrderCalls) {
   getservercert(sess, tree, "test");
   ASSERT_FALSE(tree.get<int>("root.paired") == 1);
 }
+
+struct PairingStateTest: testing::Test {
+  void SetUp() override {
+    saved_file_state = config::nvhttp.file_state;
+    saved_unique_id = http::unique_id;
+    config::nvhttp.file_state = (std::filesystem::temp_directory_path() / "sunshine_test_state.json").string();
+    http::unique_id = uuid_util::uuid_t::generate().string();
+
+    // Starts from a state file without devices and no journal
+    erase_all_clients();
+  }
+
+  void TearDown() override {
+    erase_all_clients();
+    std::filesystem::remove(config::nvhttp.file_state);
+    config::nvhttp.file_state = saved_file_state;
+    http::unique_id = saved_unique_id;
+  }
+
+  static std::string journal() {
+    return config::nvhttp.file_state + ".journal";
+  }
+
+  static std::size_t journal_entries() {
+    std::ifstream in(journal());
+
+    std::size_t entries = 0;
+    for (std::string line; std::getline(in, line);) {
+      ++entries;
+    }
+    return entries;
+  }
+
+  static std::size_t saved_devices() {
+    std::ifstream in(config::nvhttp.file_state);
+    auto tree = nlohmann::json::parse(in);
+
+    return tree["root"]["named_devices"].size();
+  }
+
+  static crypto::p_named_cert_t pair(const std::string &name) {
+    auto named_cert_p = std::make_shared<crypto::named_cert_t>();
+    named_cert_p->name = name;
+    named_cert_p->cert = crypto::gen_creds(name, 2048).x509;
+    named_cert_p->perm = crypto::PERM::_all;
+
+    add_authorized_client(named_cert_p);
+    return named_cert_p;
+  }
+
+  static void update(const crypto::p_named_cert_t &named_cert_p, const std::string &name, const std::string &display_mode) {
+    ASSERT_TRUE(update_device_info(named_cert_p->uuid, name, display_mode, named_cert_p->do_cmds, named_cert_p->undo_cmds, named_cert_p->perm, named_cert_p->enable_legacy_ordering, named_cert_p->allow_client_commands, named_cert_p->always_use_virtual_display));
+  }
+
+  static std::vector<std::string> names() {
+    std::vector<std::string> names;
+    for (auto &client : get_all_clients()) {
+      names.emplace_back(client["name"]);
+    }
+    return names;
+  }
+
+  std::string saved_file_state;
+  std::string saved_unique_id;
+};
+
+TEST_F(PairingStateTest, ReplaysJournal) {
+  pair("Deck");
+  auto renamed = pair("Laptop");
+  pair("Deck");
+  update(renamed, "Deck", "1920x1080x60");
+  auto removed = pair("Phone");
+  ASSERT_TRUE(unpair_client(removed->uuid));
+
+  // Every change went to the journal, the state file is as it was
+  ASSERT_EQ(journal_entries(), 6);
+  ASSERT_EQ(saved_devices(), 0);
+
+  auto clients = get_all_clients();
+  load_state();
+  ASSERT_EQ(get_all_clients(), clients);
+  ASSERT_EQ(names(), (std::vector<std::string> {"Deck", "Deck (3)", "Deck (2)"}));
+
+  // The renamed device still counts towards the names in use
+  pair("Deck");
+  ASSERT_EQ(names().back(), "Deck (4)");
+}
+
+TEST_F(PairingStateTest, IgnoresTruncatedJournalEntry) {
+  pair("Deck");
+  pair("Laptop");
+
+  // Sunshine stopped while appending a change
+  {
+    std::ofstream out(journal(), std::ios::app);
+    out << R"({"op":"add","device":{"name":"Pho)";
+  }
+
+  load_state();
+  ASSERT_EQ(names(), (std::vector<std::string> {"Deck", "Laptop"}));
+
+  // The intact changes were saved to the state file, so new changes aren't appended after the cut off one
+  ASSERT_FALSE(std::filesystem::exists(journal()));
+  ASSERT_EQ(saved_devices(), 2);
+}
+
+TEST_F(PairingStateTest, CompactsJournal) {
+  auto named_cert_p = pair("Deck");
+  for (int x = 0; x < 70; ++x) {
+    update(named_cert_p, "Deck", std::to_string(x));
+  }
+
+  // The 65th change rewrote the state file, the ones after it are in the journal
+  ASSERT_EQ(journal_entries(), 6);
+  ASSERT_EQ(saved_devices(), 1);
+
+  load_state();
+  auto clients = get_all_clients();
+  ASSERT_EQ(clients.size(), 1);
+  ASSERT_EQ(clients[0]["display_mode"], "69");
+}
@@ -0,0 +1,138 @@
+/**
+ * @file tests/unit/test_image_pool.cpp
+ * @brief Test src/image_pool.*
+ */
+#include "../tests_common.h"
+
+#include <src/image_pool.h>
+
+#include <future>
+#include <thread>
+
+using namespace std::literals;
+
+namespace {
+  auto alloc_counted(int &allocations) {
+    return [&allocations]() {
+      ++allocations;
+      return std::make_shared<platf::img_t>();
+    };
+  }
+
+  auto always_running = []() {
+    return true;
+  };
+}  // namespace
+
+TEST(ImagePoolTest, ReusesReleasedImages) {
+  int allocations = 0;
+  video::image_pool_t pool {2, 1h, alloc_counted(allocations)};
+
+  auto first = pool.pull(always_running);
+  auto first_ptr = first.get();
+  first.reset();
+
+  auto second = pool.pull(always_running);
+  ASSERT_EQ(second.get(), first_ptr);
+  ASSERT_EQ(allocations, 1);
+
+  auto third = pool.pull(always_running);
+  ASSERT_NE(third.get(), second.get());
+  ASSERT_EQ(allocations, 2);
+  ASSERT_EQ(pool.allocated(), 2);
+}
+
+TEST(ImagePoolTest, ImageIsReleasedByLastCopy) {
+  int allocations = 0;
+  video::image_pool_t pool {1, 1h, alloc_counted(allocations)};
+
+  auto img = pool.pull(always_running);
+  auto copy = img;
+  img.reset();
+
+  // The copy still holds the only image
+  ASSERT_FALSE(pool.pull([]() {
+    return false;
+  }));
+  ASSERT_EQ(pool.exhausted_count(), 1);
+
+  copy.reset();
+  ASSERT_TRUE(pool.pull(always_running));
+  ASSERT_EQ(allocations, 1);
+}
+
+TEST(ImagePoolTest, WaitsForRelease) {
+  int allocations = 0;
+  video::image_pool_t pool {1, 1h, alloc_counted(allocations)};
+
+  auto img = pool.pull(always_running);
+  auto img_ptr = img.get();
+
+  auto release = std::async(std::launch::async, [img = std::move(img)]() mutable {
+    std::this_thread::sleep_for(20ms);
+    img.reset();
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  auto next = pool.pull(always_running);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  release.get();
+
+  ASSERT_EQ(next.get(), img_ptr);
+  ASSERT_EQ(pool.exhausted_count(), 1);
+  ASSERT_GT(pool.exhausted_wait(), 0ms);
+
+  // The release wakes the capture rather than the periodic check of running()
+  ASSERT_LT(elapsed, 90ms);
+}
+
+TEST(ImagePoolTest, TrimsUnusedImages) {
+  int allocations = 0;
+  video::image_pool_t pool {4, 0s, alloc_counted(allocations)};
+
+  {
+    auto a = pool.pull(always_running);
+    auto b = pool.pull(always_running);
+    auto c = pool.pull(always_running);
+  }
+  ASSERT_EQ(pool.allocated(), 3);
+
+  // Only a single image was needed since the timeout
+  auto img = pool.pull(always_running);
+  ASSERT_EQ(pool.allocated(), 1);
+}
+
+TEST(ImagePoolTest, ClearFreesImagesInUseOnRelease) {
+  int allocations = 0;
+  video::image_pool_t pool {2, 1h, alloc_counted(allocations)};
+
+  auto in_use = pool.pull(always_running);
+  pool.pull(always_running).reset();
+  ASSERT_EQ(pool.allocated(), 2);
+
+  pool.clear();
+  ASSERT_EQ(pool.allocated(), 1);
+
+  in_use.reset();
+  ASSERT_EQ(pool.allocated(), 0);
+
+  pool.pull(always_running);
+  ASSERT_EQ(allocations, 3);
+}
+
+TEST(ImagePoolTest, ImagesOutliveThePool) {
+  std::weak_ptr<platf::img_t> allocated;
+  std::shared_ptr<platf::img_t> img;
+  {
+    video::image_pool_t pool {1, 1h, [&allocated]() {
+                                auto img = std::make_shared<platf::img_t>();
+                                allocated = img;
+                                return img;
+                              }};
+    img = pool.pull(always_running);
+  }
+
+  ASSERT_FALSE(allocated.expired());
+  img.reset();
+  ASSERT_TRUE(allocated.expired());
+}
@@ -45,3 +45,65 @@ TEST_P(LogLevelsTest, PutMessage) {
 
   ASSERT_TRUE(log_checker::line_contains(log_file, test_message));
 }
+
+struct DeferredLoggingTest: testing::Test {
+  void SetUp() override {
+    deinit_log = logging::init(0, log_file, true);
+  }
+
+  void TearDown() override {
+    // Initializing again replaces the deferred logging, the test environment deinitializes it in the end
+    deinit_log.release();
+    logging::init(0, log_file).release();
+  }
+
+  std::unique_ptr<logging::deinit_t> deinit_log;
+};
+
+TEST_F(DeferredLoggingTest, FormatsRawArguments) {
+  std::random_device rand_dev;
+  std::mt19937_64 rand_gen(rand_dev());
+  auto id = rand_gen();
+
+  std::string text = "text";
+  LOG_DEFERRED(info, "Deferred {} {} {:.1f} {} {}", id, text, 2.5, "literal"sv, true);
+
+  ASSERT_TRUE(log_checker::line_contains(log_file, std::format("Info: Deferred {} text 2.5 literal true", id)));
+}
+
+TEST_F(DeferredLoggingTest, KeepsOrderAcrossThreads) {
+  std::random_device rand_dev;
+  std::mt19937_64 rand_gen(rand_dev());
+  auto id = rand_gen();
+
+  for (int x = 0; x < 4; ++x) {
+    std::thread {[id, x]() {
+      LOG_DEFERRED(debug, "Deferred thread {} {}", id, x);
+    }}.join();
+  }
+
+  logging::log_flush();
+
+  std::ifstream input(log_file);
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(input, line);) {
+    if (line.find(std::format("Deferred thread {} ", id)) != std::string::npos) {
+      lines.emplace_back(log_checker::remove_timestamp_prefix(line));
+    }
+  }
+
+  ASSERT_EQ(lines.size(), 4);
+  for (int x = 0; x < 4; ++x) {
+    ASSERT_EQ(lines[x], std::format("Debug: Deferred thread {} {}", id, x));
+  }
+}
+
+TEST_F(DeferredLoggingTest, ReportsDroppedRecords) {
+  // Far more than a ring holds, without giving the writer a chance to catch up
+  std::string text(logging::deferred::max_string_size, 'x');
+  for (int x = 0; x < 10000; ++x) {
+    LOG_DEFERRED(verbose, "Deferred flood {}", text);
+  }
+
+  ASSERT_TRUE(log_checker::line_contains(log_file, "deferred log records, the log ring of a thread was full"));
+}
@@ -34,3 +34,9 @@ TEST(ReedSolomonWrapperTests, EncodeTest) {
 
   reed_solomon_release(rs);
 }
+
+TEST(ReedSolomonWrapperTests, IsaNameTest) {
+  reed_solomon_init();
+
+  ASSERT_NE(reed_solomon_isa(), nullptr);
+}
@@ -0,0 +1,127 @@
+/**
+ * @file tests/unit/test_stat_trackers.cpp
+ * @brief Test src/stat_trackers.*
+ */
+#include "../tests_common.h"
+
+#include <src/stat_trackers.h>
+
+#include <thread>
+
+using namespace std::literals;
+
+TEST(LatencyHistogramTest, Percentiles) {
+  stat_trackers::latency_histogram_t histogram;
+  ASSERT_EQ(histogram.percentile(50), 0us);
+
+  for (int x = 1; x <= 1000; ++x) {
+    histogram.record(std::chrono::microseconds(x));
+  }
+
+  ASSERT_EQ(histogram.count(), 1000);
+  ASSERT_EQ(histogram.max(), 1000us);
+
+  // Buckets are precise to about 3%
+  auto within = [](std::chrono::microseconds value, std::chrono::microseconds expected) {
+    return value >= expected && value <= expected + expected * 4 / 100;
+  };
+  ASSERT_TRUE(within(histogram.percentile(50), 500us));
+  ASSERT_TRUE(within(histogram.percentile(99), 990us));
+  ASSERT_EQ(histogram.percentile(100), 1000us);
+
+  // Small values are exact
+  histogram.reset();
+  histogram.record(3us);
+  histogram.record(7us);
+  ASSERT_EQ(histogram.percentile(50), 3us);
+  ASSERT_EQ(histogram.percentile(100), 7us);
+}
+
+TEST(LatencyHistogramTest, LargeValues) {
+  stat_trackers::latency_histogram_t histogram;
+
+  histogram.record(std::chrono::hours(24 * 365));
+  histogram.record(-1us);
+
+  ASSERT_EQ(histogram.count(), 2);
+  ASSERT_EQ(histogram.percentile(50), 0us);
+  ASSERT_EQ(histogram.percentile(100), std::chrono::hours(24 * 365));
+}
+
+TEST(FrameLatencyTrackerTest, StagesAndChromeTrace) {
+  stat_trackers::frame_latency_tracker_t tracker;
+
+  auto start = std::chrono::steady_clock::now();
+  stat_trackers::frame_trace_t trace {
+    start,
+    start + 1ms,
+    start + 1ms,
+    start + 5ms,
+    start + 6ms,
+    start + 8ms,
+  };
+  tracker.record(1, trace);
+
+  // A repeated frame was neither captured nor converted
+  trace.captured = {};
+  trace.converted = {};
+  tracker.record(2, trace);
+
+  auto stats = tracker.stats();
+  ASSERT_EQ(stats["convert"]["count"], 1);
+  ASSERT_EQ(stats["encode"]["count"], 2);
+  ASSERT_EQ(stats["encode"]["p50_us"], 4000);
+  ASSERT_EQ(stats["send"]["max_us"], 2000);
+  ASSERT_EQ(stats["total"]["count"], 1);
+  ASSERT_EQ(stats["total"]["max_us"], 8000);
+
+  auto chrome = tracker.chrome_trace();
+  auto &events = chrome["traceEvents"];
+  auto frames = std::count_if(std::begin(events), std::end(events), [](auto &event) {
+    return event["ph"] == "X";
+  });
+  ASSERT_EQ(frames, 5 + 3);
+
+  tracker.reset();
+  ASSERT_EQ(tracker.stats()["encode"]["count"], 0);
+}
+
+TEST(SendSyscallTrackerTest, CountsPacketsPerSystemCall) {
+  stat_trackers::send_syscall_tracker_t tracker;
+  ASSERT_EQ(tracker.stats()["system_calls_per_packet"], 0.0);
+
+  tracker.record(1, 1);
+  tracker.record(3, 1);
+
+  auto stats = tracker.stats();
+  ASSERT_EQ(stats["packets"], 4);
+  ASSERT_EQ(stats["system_calls"], 2);
+  ASSERT_EQ(stats["system_calls_per_packet"], 0.5);
+
+  tracker.reset();
+  ASSERT_EQ(tracker.stats()["packets"], 0);
+}
+
+TEST(LatencyTrackerTest, RecordsFromManyThreads) {
+  stat_trackers::latency_tracker_t tracker;
+
+  std::vector<std::thread> threads;
+  for (int x = 0; x < 4; ++x) {
+    threads.emplace_back([&tracker]() {
+      for (int y = 1; y <= 1000; ++y) {
+        tracker.record(std::chrono::microseconds(y));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  auto stats = tracker.stats();
+  ASSERT_EQ(stats["count"], 4000);
+  ASSERT_EQ(stats["max_us"], 1000);
+  ASSERT_NEAR(stats["p50_us"].get<double>(), 500, 500 * 0.04);
+
+  tracker.reset();
+  ASSERT_EQ(tracker.stats()["count"], 0);
+}
@@ -10,6 +10,8 @@
 
 namespace stream {
   std::vector<uint8_t> concat_and_insert(uint64_t insert_size, uint64_t slice_size, const std::string_view &data1, const std::string_view &data2);
+  void gather_and_insert(uint64_t insert_size, uint64_t slice_size, const std::vector<std::string_view> &segments, std::vector<uint8_t> &dest);
+  std::ptrdiff_t splice_replace(std::vector<std::string_view> &segments, const std::string_view &old, const std::string_view &_new);
 }
 
 #include "../tests_common.h"
@@ -37,3 +39,29 @@ TEST(ConcatAndInsertTests, ConcatSmallStrideTest) {
   auto expected = std::vector<uint8_t> {0, 'a', 0, 'b', 0, 'c', 0, 'd', 0, 'e'};
   ASSERT_EQ(res, expected);
 }
+
+TEST(ConcatAndInsertTests, GatherReusedBufferTest) {
+  std::vector<uint8_t> dest(16, 0xFF);
+  std::vector<std::string_view> segments {"ab", "", "cde"};
+  stream::gather_and_insert(1, 2, segments, dest);
+  auto expected = std::vector<uint8_t> {0, 'a', 'b', 0, 'c', 'd', 0, 'e'};
+  ASSERT_EQ(dest, expected);
+}
+
+TEST(SpliceReplaceTests, ReplaceMiddleTest) {
+  std::vector<std::string_view> segments {"abcdef"};
+  auto delta = stream::splice_replace(segments, "cd", "XYZ");
+  ASSERT_EQ(delta, 1);
+
+  std::vector<uint8_t> dest;
+  stream::gather_and_insert(0, 1, segments, dest);
+  auto expected = std::vector<uint8_t> {'a', 'b', 'X', 'Y', 'Z', 'e', 'f'};
+  ASSERT_EQ(dest, expected);
+}
+
+TEST(SpliceReplaceTests, NoMatchTest) {
+  std::vector<std::string_view> segments {"abcdef"};
+  auto delta = stream::splice_replace(segments, "xy", "z");
+  ASSERT_EQ(delta, 0);
+  ASSERT_EQ(segments.size(), 1);
+}
@@ -0,0 +1,143 @@
+/**
+ * @file tests/unit/test_task_pool.cpp
+ * @brief Test src/timer_wheel.h and src/thread_pool.h.
+ */
+#include "../tests_common.h"
+
+#include <src/thread_pool.h>
+#include <src/timer_wheel.h>
+
+#include <random>
+
+using namespace std::literals;
+
+namespace {
+  using wheel_t = task_pool_util::timer_wheel_t<std::unique_ptr<int>>;
+  using clock = wheel_t::clock;
+
+  std::vector<int> expire(wheel_t &wheel, clock::time_point now) {
+    std::vector<int> values;
+    while (auto value = wheel.pop(now)) {
+      values.push_back(**value);
+    }
+
+    return values;
+  }
+}  // namespace
+
+TEST(TimerWheelTest, ExpiresInOrderAndNeverEarly) {
+  wheel_t wheel;
+  auto start = clock::now();
+
+  wheel.insert(start + 5s, std::make_unique<int>(3));
+  wheel.insert(start + 10ms, std::make_unique<int>(1));
+  wheel.insert(start + 300ms, std::make_unique<int>(2));
+  wheel.insert(start + 2h, std::make_unique<int>(4));
+  wheel.insert(start + 10h, std::make_unique<int>(5));
+  ASSERT_EQ(wheel.size(), 5);
+
+  ASSERT_EQ(expire(wheel, start + 9ms), std::vector<int> {});
+  ASSERT_EQ(expire(wheel, start + 10ms + 1ms), std::vector<int> {1});
+  ASSERT_EQ(expire(wheel, start + 299ms), std::vector<int> {});
+  ASSERT_EQ(expire(wheel, start + 5s + 1ms), (std::vector<int> {2, 3}));
+  ASSERT_EQ(expire(wheel, start + 2h - 1ms), std::vector<int> {});
+  ASSERT_EQ(expire(wheel, start + 2h + 1ms), std::vector<int> {4});
+
+  // Beyond the range of the wheel, the timer waits in the overflow
+  ASSERT_EQ(expire(wheel, start + 10h - 1ms), std::vector<int> {});
+  ASSERT_EQ(expire(wheel, start + 10h + 1ms), std::vector<int> {5});
+  ASSERT_TRUE(wheel.empty());
+  ASSERT_FALSE(wheel.next());
+}
+
+TEST(TimerWheelTest, NextNeverPassesADeadline) {
+  wheel_t wheel;
+  auto start = clock::now();
+
+  std::mt19937 rng {42};
+  std::uniform_int_distribution<int> delays {1, 100000};
+  std::vector<clock::time_point> deadlines;
+  for (int x = 0; x < 1000; ++x) {
+    deadlines.push_back(start + std::chrono::milliseconds(delays(rng)));
+    wheel.insert(deadlines.back(), std::make_unique<int>(x));
+  }
+
+  // Follow next() like the timer thread does, every timer must expire when it is reached
+  auto now = start;
+  while (auto next = wheel.next()) {
+    ASSERT_GE(*next, now);
+    now = *next;
+
+    while (auto value = wheel.pop(now)) {
+      ASSERT_GE(now, deadlines[**value]);
+      ASSERT_LE(now, deadlines[**value] + 1ms);
+    }
+  }
+  ASSERT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, CancelAndReschedule) {
+  wheel_t wheel;
+  auto start = clock::now();
+
+  auto first = wheel.insert(start + 100ms, std::make_unique<int>(1));
+  auto second = wheel.insert(start + 200ms, std::make_unique<int>(2));
+  auto third = wheel.insert(start + 300ms, std::make_unique<int>(3));
+
+  auto removed = wheel.remove(second);
+  ASSERT_TRUE(removed);
+  ASSERT_EQ(removed->first, start + 200ms);
+  ASSERT_EQ(*removed->second, 2);
+  ASSERT_FALSE(wheel.remove(second));
+
+  ASSERT_TRUE(wheel.reschedule(third, start + 50ms));
+  ASSERT_TRUE(wheel.reschedule(first, start + 1s));
+
+  ASSERT_EQ(expire(wheel, start + 100ms), std::vector<int> {3});
+  ASSERT_FALSE(wheel.reschedule(third, start + 1s));
+  ASSERT_EQ(expire(wheel, start + 999ms), std::vector<int> {});
+  ASSERT_EQ(expire(wheel, start + 1s + 1ms), std::vector<int> {1});
+}
+
+TEST(ThreadPoolTest, RunsDelayedTasks) {
+  thread_pool_util::ThreadPool pool {2};
+
+  auto start = std::chrono::steady_clock::now();
+  auto late = pool.pushDelayed([]() {
+    return 2;
+  },
+                               50ms);
+  auto early = pool.pushDelayed([]() {
+    return 1;
+  },
+                                10ms);
+  auto cancelled = pool.pushDelayed([]() {
+    return 3;
+  },
+                                    20ms);
+  ASSERT_TRUE(pool.cancel(cancelled.task_id));
+
+  ASSERT_EQ(early.future.get(), 1);
+  ASSERT_EQ(late.future.get(), 2);
+  ASSERT_GE(std::chrono::steady_clock::now() - start, 50ms);
+  ASSERT_THROW(cancelled.future.get(), std::future_error);
+
+  // Moving a timer forward wakes the timer thread
+  auto delayed = pool.pushDelayed([]() {
+    return 4;
+  },
+                                  1h);
+  pool.delay(delayed.task_id, 10ms);
+  ASSERT_EQ(delayed.future.wait_for(5s), std::future_status::ready);
+}
+
+TEST(ThreadPoolTest, RunsTasksPushedBeforeStart) {
+  thread_pool_util::ThreadPool pool;
+
+  auto future = pool.push([]() {
+    return 1;
+  });
+  pool.start(2);
+
+  ASSERT_EQ(future.get(), 1);
+}
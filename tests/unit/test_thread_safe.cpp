@@ -0,0 +1,131 @@
+/**
+ * @file tests/unit/test_thread_safe.cpp
+ * @brief Test src/thread_safe.*
+ */
+#include "../tests_common.h"
+
+#include <src/thread_safe.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using time_point_t = std::chrono::steady_clock::time_point;
+
+TEST(RingTest, DeliversInOrder) {
+  safe::ring_t<std::unique_ptr<int>> ring {8};
+
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_TRUE(ring.raise(std::make_unique<int>(i)));
+  }
+
+  // A full ring drops new elements and keeps the ones queued before them
+  ASSERT_EQ(ring.dropped(), 0);
+  ASSERT_FALSE(ring.raise(std::make_unique<int>(8)));
+  ASSERT_FALSE(ring.raise(std::make_unique<int>(9)));
+  ASSERT_EQ(ring.dropped(), 2);
+
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_TRUE(ring.peek());
+    auto val = ring.pop();
+    ASSERT_EQ(*val, i);
+  }
+  ASSERT_FALSE(ring.peek());
+}
+
+TEST(RingTest, MultipleProducers) {
+  constexpr int producers = 4;
+  constexpr int count = 20000;
+
+  safe::ring_t<std::pair<int, int>> ring {64};
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&ring, p]() {
+      for (int i = 0; i < count;) {
+        if (ring.raise(p, i)) {
+          ++i;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // Elements of each producer must arrive in the order they were raised
+  std::array<int, producers> next {};
+  for (int received = 0; received < producers * count; ++received) {
+    auto val = ring.pop();
+    ASSERT_TRUE(val);
+    ASSERT_EQ(val->second, next[val->first]++);
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+TEST(RingTest, StopWakesConsumer) {
+  safe::ring_t<std::unique_ptr<int>> ring;
+
+  std::thread consumer {[&ring]() {
+    ASSERT_FALSE(ring.pop());
+  }};
+
+  std::this_thread::sleep_for(10ms);
+  ring.stop();
+  consumer.join();
+
+  ASSERT_FALSE(ring.running());
+  ASSERT_FALSE(ring.raise(std::make_unique<int>(0)));
+}
+
+TEST(PoolTest, RecyclesObjects) {
+  safe::pool_t<std::vector<int>> pool {2, std::vector<int>(4)};
+
+  auto first = pool.pull();
+  auto second = pool.pull();
+  ASSERT_TRUE(first);
+  ASSERT_TRUE(second);
+  ASSERT_EQ(first->size(), 4);
+
+  // Every object is in use
+  ASSERT_FALSE(pool.pull());
+
+  auto first_ptr = &*first;
+  first = {};
+  ASSERT_EQ(&*pool.pull(), first_ptr);
+}
+
+TEST(PoolTest, ObjectsAreReleasedOnOtherThreads) {
+  safe::pool_t<int> pool {1};
+  safe::ring_t<safe::pool_t<int>::handle_t> ring {4};
+
+  std::thread consumer {[&ring]() {
+    while (auto handle = ring.pop()) {
+    }
+  }};
+
+  for (int x = 0; x < 1000; ++x) {
+    safe::pool_t<int>::handle_t handle;
+    while (!(handle = pool.pull())) {
+      std::this_thread::yield();
+    }
+
+    *handle = x;
+    ring.raise(std::move(handle));
+  }
+
+  ring.stop();
+  consumer.join();
+}
+
+TEST(PoolTest, ObjectsOutliveThePool) {
+  safe::pool_t<std::vector<int>>::handle_t handle;
+  {
+    safe::pool_t<std::vector<int>> pool {1, std::vector<int>(4, 7)};
+    handle = pool.pull();
+  }
+
+  ASSERT_EQ((*handle)[3], 7);
+}
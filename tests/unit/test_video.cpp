@@ -4,8 +4,12 @@
  */
 #include "../tests_common.h"
 
+#include <future>
+
 #include <src/video.h>
 
+using namespace std::literals;
+
 struct EncoderTest: PlatformTestSuite, testing::WithParamInterface<video::encoder_t *> {
   void SetUp() override {
     auto &encoder = *GetParam();
@@ -48,3 +52,149 @@ INSTANTIATE_TEST_SUITE_P(
 TEST_P(EncoderTest, ValidateEncoder) {
   // todo:: test something besides fixture setup
 }
+
+struct SharedEncodeTest: testing::Test {
+  video::config_t config {1920, 1080, 60, 20000, 1, 1, 0, 0, 0, 0, 0, 60, false};
+
+  safe::mail_t owner_mail = std::make_shared<safe::mail_raw_t>();
+  safe::mail_t viewer_mail = std::make_shared<safe::mail_raw_t>();
+
+  // Only the addresses are used to tell the sessions apart
+  int owner_session;
+  int viewer_session;
+
+  std::vector<std::shared_ptr<video::shared_encode_t>> owned;
+
+  void TearDown() override {
+    owner_mail->event<bool>(mail::shutdown)->raise(true);
+    viewer_mail->event<bool>(mail::shutdown)->raise(true);
+
+    for (auto &shared : owned) {
+      video::stop_shared_encode(shared);
+    }
+  }
+
+  std::shared_ptr<video::shared_encode_t> join_as_owner(safe::mail_t &mail, const std::string &display_name, void *channel_data) {
+    int frame_nr = 1;
+    auto shared = video::join_shared_encode(mail, config, display_name, channel_data, frame_nr);
+    if (shared) {
+      owned.emplace_back(shared);
+    }
+    return shared;
+  }
+
+  /**
+   * @brief Join as the viewer on another thread, since watching blocks until the viewer leaves.
+   */
+  std::future<std::pair<std::shared_ptr<video::shared_encode_t>, int>> join_as_viewer(const std::string &display_name, int frame_nr) {
+    return std::async(std::launch::async, [this, display_name, frame_nr]() mutable {
+      auto shared = video::join_shared_encode(viewer_mail, config, display_name, &viewer_session, frame_nr);
+      return std::make_pair(shared, frame_nr);
+    });
+  }
+};
+
+TEST_F(SharedEncodeTest, ViewerJoinsAndLeaves) {
+  auto shared = join_as_owner(owner_mail, "display", &owner_session);
+  ASSERT_TRUE(shared);
+  EXPECT_EQ(shared->owner, &owner_session);
+
+  auto owner_idr = owner_mail->event<bool>(mail::idr);
+  auto viewer = join_as_viewer("display", 5);
+
+  // The viewer requests an IDR frame from the owner once it joined
+  ASSERT_TRUE(owner_idr->pop(5s));
+  ASSERT_EQ(shared->viewers.size(), 1);
+  EXPECT_EQ(shared->viewers.front().channel_data, &viewer_session);
+
+  viewer_mail->event<bool>(mail::shutdown)->raise(true);
+  auto [result, frame_nr] = viewer.get();
+  EXPECT_FALSE(result);
+  EXPECT_EQ(frame_nr, 5);
+  EXPECT_TRUE(shared->viewers.empty());
+}
+
+TEST_F(SharedEncodeTest, ViewerTakesOverWhenOwnerStops) {
+  auto shared = join_as_owner(owner_mail, "display", &owner_session);
+  ASSERT_TRUE(shared);
+
+  auto owner_idr = owner_mail->event<bool>(mail::idr);
+  auto viewer = join_as_viewer("display", 7);
+  ASSERT_TRUE(owner_idr->pop(5s));
+
+  video::stop_shared_encode(shared);
+  owned.clear();
+
+  // Without another encoder to watch, the viewer starts its own and keeps its frame index
+  auto [result, frame_nr] = viewer.get();
+  ASSERT_TRUE(result);
+  owned.emplace_back(result);
+  EXPECT_NE(result, shared);
+  EXPECT_EQ(result->owner, &viewer_session);
+  EXPECT_EQ(frame_nr, 7);
+  EXPECT_TRUE(shared->viewers.empty());
+}
+
+TEST_F(SharedEncodeTest, DifferentDisplayIsNotShared) {
+  auto shared = join_as_owner(owner_mail, "display", &owner_session);
+  ASSERT_TRUE(shared);
+
+  auto other = join_as_owner(viewer_mail, "other display", &viewer_session);
+  ASSERT_TRUE(other);
+  EXPECT_NE(other, shared);
+  EXPECT_EQ(other->owner, &viewer_session);
+  EXPECT_TRUE(shared->viewers.empty());
+}
+
+TEST_F(SharedEncodeTest, DifferentConfigIsNotShared) {
+  auto shared = join_as_owner(owner_mail, "display", &owner_session);
+  ASSERT_TRUE(shared);
+
+  config.bitrate /= 2;
+  auto other = join_as_owner(viewer_mail, "display", &viewer_session);
+  ASSERT_TRUE(other);
+  EXPECT_NE(other, shared);
+  EXPECT_TRUE(shared->viewers.empty());
+}
+
+TEST(EncoderValidatorTest, RechecksFailuresOnTheirOwn) {
+  video::encoder_t flaky {"flaky"sv, nullptr, {}, {}, {}, 0};
+  video::encoder_t broken {"broken"sv, nullptr, {}, {}, {}, 0};
+
+  std::atomic_int flaky_runs = 0;
+  std::atomic_int broken_runs = 0;
+
+  // The flaky encoder only fails while other encoders are validated, e.g. due to a limit of encoding sessions
+  video::encoder_validator_t validator {{&flaky, &broken}, nullptr, [&](video::encoder_t &encoder, bool, const std::atomic_bool &, bool &) {
+                                          if (&encoder == &flaky) {
+                                            return ++flaky_runs > 1;
+                                          }
+
+                                          ++broken_runs;
+                                          return false;
+                                        }};
+
+  EXPECT_TRUE(validator.validate(&flaky));
+  EXPECT_EQ(flaky_runs, 2);
+
+  EXPECT_FALSE(validator.validate(&broken));
+  EXPECT_EQ(broken_runs, 2);
+
+  // A confirmed failure is final
+  EXPECT_FALSE(validator.validate(&broken));
+  EXPECT_EQ(broken_runs, 2);
+}
+
+TEST(EncoderValidatorTest, KeepsConcurrentSuccess) {
+  video::encoder_t encoder {"encoder"sv, nullptr, {}, {}, {}, 0};
+
+  std::atomic_int runs = 0;
+  video::encoder_validator_t validator {{&encoder}, nullptr, [&](video::encoder_t &, bool, const std::atomic_bool &, bool &) {
+                                          ++runs;
+                                          return true;
+                                        }};
+
+  EXPECT_TRUE(validator.validate(&encoder));
+  EXPECT_TRUE(validator.validate(&encoder));
+  EXPECT_EQ(runs, 1);
+}
@@ -0,0 +1,261 @@
+/**
+ * @file tests/unit/test_video_convert.cpp
+ * @brief Test src/video_convert.*
+ */
+#include "../tests_common.h"
+
+#include <src/video_convert.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+  struct format_t {
+    AVPixelFormat format;
+    std::string_view name;
+    int bit_depth;
+    int shift;
+    bool chroma_420;
+    bool interleaved;
+  };
+
+  constexpr format_t formats[] {
+    {AV_PIX_FMT_NV12, "nv12"sv, 8, 0, true, true},
+    {AV_PIX_FMT_P010, "p010"sv, 10, 6, true, true},
+    {AV_PIX_FMT_YUV420P, "yuv420p"sv, 8, 0, true, false},
+    {AV_PIX_FMT_YUV420P10, "yuv420p10"sv, 10, 0, true, false},
+    {AV_PIX_FMT_YUV444P, "yuv444p"sv, 8, 0, false, false},
+    {AV_PIX_FMT_YUV444P10, "yuv444p10"sv, 10, 0, false, false},
+  };
+
+  /**
+   * @brief A destination image with padding around it, to catch writes outside of the image.
+   */
+  struct yuv_image_t {
+    static constexpr int padding = 32;
+    static constexpr std::uint8_t canary = 0xA5;
+
+    yuv_image_t(const format_t &format, int width, int height):
+        format {format},
+        width {width},
+        height {height} {
+      auto bytes = format.bit_depth > 8 ? 2 : 1;
+      auto chroma_width = format.chroma_420 ? (width + 1) / 2 : width;
+      auto chroma_height = format.chroma_420 ? (height + 1) / 2 : height;
+
+      plane_width[0] = width;
+      plane_height[0] = height;
+      for (int plane = 1; plane < 3; ++plane) {
+        plane_width[plane] = format.interleaved ? chroma_width * 2 : chroma_width;
+        plane_height[plane] = chroma_height;
+      }
+
+      for (int plane = 0; plane < 3; ++plane) {
+        pitch[plane] = (plane_width[plane] + padding * 2) * bytes;
+        buffers[plane].assign((std::size_t) pitch[plane] * (plane_height[plane] + 2), canary);
+        planes[plane] = buffers[plane].data() + pitch[plane] + padding * bytes;
+      }
+    }
+
+    int component(int plane, int x, int y) const {
+      auto row = planes[plane] + (std::ptrdiff_t) y * pitch[plane];
+      if (format.bit_depth > 8) {
+        std::uint16_t value;
+        std::memcpy(&value, row + x * 2, sizeof(value));
+        return value >> format.shift;
+      }
+      return row[x];
+    }
+
+    bool padding_intact() const {
+      auto bytes = format.bit_depth > 8 ? 2 : 1;
+      for (int plane = 0; plane < 3; ++plane) {
+        if (format.interleaved && plane == 2) {
+          continue;
+        }
+
+        for (int y = -1; y <= plane_height[plane]; ++y) {
+          auto row = planes[plane] + (std::ptrdiff_t) y * pitch[plane];
+          for (int x = -padding * bytes; x < (plane_width[plane] + padding) * bytes; ++x) {
+            auto inside = y >= 0 && y < plane_height[plane] && x >= 0 && x < plane_width[plane] * bytes;
+            if (!inside && row[x] != canary) {
+              return false;
+            }
+          }
+        }
+      }
+      return true;
+    }
+
+    format_t format;
+    int width;
+    int height;
+    int plane_width[3];
+    int plane_height[3];
+    int pitch[3];
+    std::uint8_t *planes[3];
+    std::vector<std::uint8_t> buffers[3];
+  };
+
+  std::vector<std::uint8_t> random_bgr0(int width, int height, int pitch) {
+    std::vector<std::uint8_t> image((std::size_t) pitch * height);
+
+    std::uint32_t state = 12345;
+    for (auto &byte : image) {
+      state = state * 1664525 + 1013904223;
+      byte = (std::uint8_t) (state >> 24);
+    }
+
+    // Include the extremes of each channel
+    for (int x = 0; x < std::min(width, 4); ++x) {
+      std::memset(&image[x * 4], x % 2 ? 0xFF : 0x00, 4);
+    }
+
+    return image;
+  }
+
+  /**
+   * @brief Convert a pixel with the color vectors in floating point.
+   * @return The exact component, before rounding.
+   */
+  double reference_component(const float (&color_vec)[4], double r, double g, double b) {
+    // The color vectors add 0.5 so that truncating rounds to nearest, leave it to the caller instead
+    return r / 255 * color_vec[0] + g / 255 * color_vec[1] + b / 255 * color_vec[2] + color_vec[3] - 0.5;
+  }
+
+  /**
+   * @brief Check that a converted component is the exact component rounded to nearest.
+   * @details The fixed point coefficients are off by up to half a unit of 2^-16 for each 1/255 step of the input.
+   *          An exact component that is closer to a tie than that error may round either way.
+   */
+  bool rounds_to_nearest(int component, double exact, int max) {
+    constexpr double tie_margin = 3 * 255 * 0.5 / (1 << 16);
+
+    auto expected = (int) std::clamp(std::round(exact), 0.0, (double) max);
+    if (component == expected) {
+      return true;
+    }
+
+    // Close to a tie, the other neighbor of the exact component is fine too
+    auto tie = std::abs(exact - std::floor(exact) - 0.5) < tie_margin;
+    return tie && std::abs(component - exact) < 1;
+  }
+
+  /**
+   * @brief Compare a converted image with a floating point conversion using the same color vectors.
+   * @return The number of components that are not the exact component rounded to nearest.
+   */
+  int count_mismatches(const yuv_image_t &image, const std::uint8_t *src, int src_pitch, const video::sunshine_colorspace_t &colorspace) {
+    auto &format = image.format;
+    auto color_vectors = video::new_color_vectors_from_colorspace({colorspace.colorspace, colorspace.full_range, (unsigned) format.bit_depth});
+    auto max = (1 << format.bit_depth) - 1;
+
+    auto channel = [&](int x, int y, int c) -> double {
+      x = std::min(x, image.width - 1);
+      y = std::min(y, image.height - 1);
+      return src[(std::ptrdiff_t) y * src_pitch + x * 4 + c];
+    };
+
+    int mismatches = 0;
+    auto check = [&](int component, double exact) {
+      mismatches += !rounds_to_nearest(component, exact, max);
+    };
+
+    for (int y = 0; y < image.height; ++y) {
+      for (int x = 0; x < image.width; ++x) {
+        check(image.component(0, x, y), reference_component(color_vectors->color_vec_y, channel(x, y, 2), channel(x, y, 1), channel(x, y, 0)));
+      }
+    }
+
+    auto chroma_width = format.chroma_420 ? (image.width + 1) / 2 : image.width;
+    auto chroma_height = format.chroma_420 ? (image.height + 1) / 2 : image.height;
+    auto block = format.chroma_420 ? 2 : 1;
+    for (int y = 0; y < chroma_height; ++y) {
+      for (int x = 0; x < chroma_width; ++x) {
+        double rgb[3] {};
+        for (int c = 0; c < 3; ++c) {
+          for (int dy = 0; dy < block; ++dy) {
+            for (int dx = 0; dx < block; ++dx) {
+              rgb[c] += channel(x * block + dx, y * block + dy, 2 - c) / (block * block);
+            }
+          }
+        }
+
+        auto u = reference_component(color_vectors->color_vec_u, rgb[0], rgb[1], rgb[2]);
+        auto v = reference_component(color_vectors->color_vec_v, rgb[0], rgb[1], rgb[2]);
+        if (format.interleaved) {
+          check(image.component(1, x * 2, y), u);
+          check(image.component(1, x * 2 + 1, y), v);
+        } else {
+          check(image.component(1, x, y), u);
+          check(image.component(2, x, y), v);
+        }
+      }
+    }
+
+    return mismatches;
+  }
+}  // namespace
+
+TEST(VideoConvertTest, IsaName) {
+  ASSERT_NE(video::bgr0_converter_t::isa(), nullptr);
+}
+
+TEST(VideoConvertTest, SupportedFormats) {
+  for (auto &format : formats) {
+    ASSERT_TRUE(video::bgr0_converter_t::supports(format.format)) << format.name;
+  }
+  ASSERT_FALSE(video::bgr0_converter_t::supports(AV_PIX_FMT_VUYX));
+}
+
+TEST(VideoConvertTest, MatchesColorVectors) {
+  using video::colorspace_e;
+
+  // Odd sizes exercise the scalar tails and the repeated last row and column of 4:2:0 chroma
+  for (auto [width, height] : {std::pair {64, 8}, std::pair {67, 9}, std::pair {1, 1}}) {
+    auto src_pitch = width * 4 + 12;
+    auto src = random_bgr0(width, height, src_pitch);
+
+    for (auto &format : formats) {
+      for (auto color : {colorspace_e::rec601, colorspace_e::rec709, colorspace_e::bt2020}) {
+        for (bool full_range : {false, true}) {
+          video::sunshine_colorspace_t colorspace {color, full_range, 8};
+          video::bgr0_converter_t converter {format.format, colorspace};
+
+          yuv_image_t image {format, width, height};
+          converter.convert(src.data(), src_pitch, width, height, image.planes, image.pitch, 0, height);
+
+          ASSERT_EQ(count_mismatches(image, src.data(), src_pitch, colorspace), 0) << format.name << ' ' << width << 'x' << height;
+          ASSERT_TRUE(image.padding_intact()) << format.name << ' ' << width << 'x' << height;
+        }
+      }
+    }
+  }
+}
+
+TEST(VideoConvertTest, BandsMatchWholeImage) {
+  constexpr int width = 99;
+  constexpr int height = 37;
+
+  auto src = random_bgr0(width, height, width * 4);
+  video::sunshine_colorspace_t colorspace {video::colorspace_e::rec709, false, 8};
+
+  for (auto &format : formats) {
+    video::bgr0_converter_t converter {format.format, colorspace};
+
+    yuv_image_t whole {format, width, height};
+    converter.convert(src.data(), width * 4, width, height, whole.planes, whole.pitch, 0, height);
+
+    yuv_image_t bands {format, width, height};
+    auto band_height = converter.row_alignment() * 3;
+    for (int row = 0; row < height; row += band_height) {
+      converter.convert(src.data(), width * 4, width, height, bands.planes, bands.pitch, row, std::min(row + band_height, height));
+    }
+
+    for (int plane = 0; plane < 3; ++plane) {
+      ASSERT_EQ(whole.buffers[plane], bands.buffers[plane]) << format.name;
+    }
+  }
+}